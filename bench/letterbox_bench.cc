@@ -0,0 +1,127 @@
+/**
+ * Микробенчмарк подготовки входа модели из YUV кадра.
+ *
+ * Сборка вне SDK:
+ *   g++ -O2 -std=c++17 -Iinclude bench/letterbox_bench.cc src/letterbox.cc -o letterbox_bench \
+ *       $(pkg-config --cflags --libs opencv4)
+ *
+ * Сравнивает YuvLetterbox (перевод, билинейное масштабирование и поля
+ * за один проход) с цепочкой OpenCV cv::cvtColor + cv::resize + cv::copyMakeBorder
+ * и копией строк в буфер с шагом тензора. Печатает время кадра
+ * (p50/p99) и наибольшее расхождение результатов по каналу.
+ */
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <time.h>
+#include <vector>
+
+#include <opencv2/core/core.hpp>
+#include <opencv2/imgproc/imgproc.hpp>
+
+#include "letterbox.h"
+
+static uint64_t nowNs() {
+    struct timespec time = {0, 0};
+    clock_gettime(CLOCK_MONOTONIC, &time);
+    return (uint64_t)time.tv_sec * 1000000000ull + (uint64_t)time.tv_nsec;
+}
+
+static void printTiming(const char *name, std::vector<uint64_t>& samples) {
+    std::sort(samples.begin(), samples.end());
+    printf("  %-24s p50=%7.3f ms  p99=%7.3f ms\n", name,
+           samples[samples.size() / 2] / 1e6, samples[samples.size() * 99 / 100] / 1e6);
+}
+
+// Кадр с плавными градиентами и шумом: билинейная интерполяция различима
+static void fillFrame(cv::Mat& frame, uint32_t seed) {
+    cv::RNG rng(seed);
+    for (int y = 0; y < frame.rows; y++) {
+        uint8_t *row = frame.ptr<uint8_t>(y);
+        for (int x = 0; x < frame.cols; x++) {
+            row[x] = (uint8_t)((x * 3 + y * 5) / 8 + rng.uniform(0, 16));
+        }
+    }
+}
+
+// Эталон OpenCV: RGB кадр, масштаб, поля и раскладка по шагу тензора
+static void referenceLetterbox(const cv::Mat& yuv, int code, const Letterbox& box,
+                               int modelWidth, int modelHeight, size_t pitch,
+                               cv::Mat& rgb, cv::Mat& resized, cv::Mat& bordered, uint8_t *dst) {
+    cv::cvtColor(yuv, rgb, code);
+    cv::resize(rgb, resized, cv::Size(box.width, box.height), 0, 0, cv::INTER_LINEAR);
+    cv::copyMakeBorder(resized, bordered, box.offsetY, modelHeight - box.height - box.offsetY,
+                       box.offsetX, modelWidth - box.width - box.offsetX,
+                       cv::BORDER_CONSTANT, cv::Scalar(114, 114, 114));
+    for (int y = 0; y < modelHeight; y++) {
+        memcpy(dst + y * pitch, bordered.ptr<uint8_t>(y), modelWidth * 3);
+    }
+}
+
+static void benchLayout(YuvLayout layout, int width, int height, int modelWidth, int modelHeight,
+                        int iterations) {
+    const bool packed = layout == YuvLayout::Yuyv;
+    // Шаг строки тензора RKNN выровнен, как size_with_stride у нативного входа
+    const size_t pitch = ((size_t)modelWidth * 3 + 15) & ~(size_t)15;
+
+    cv::Mat yuv = packed ? cv::Mat(height, width, CV_8UC2) : cv::Mat(height * 3 / 2, width, CV_8UC1);
+    cv::Mat plane(yuv.rows, width * yuv.channels(), CV_8UC1, yuv.data);
+    fillFrame(plane, 1);
+
+    YuvImage image;
+    image.layout = layout;
+    image.data = yuv.data;
+    image.uv = packed ? nullptr : yuv.data + (size_t)width * height;
+    image.width = width;
+    image.height = height;
+    image.stride = yuv.step;
+
+    YuvLetterbox letterbox;
+    if (letterbox.configure(layout, width, height, modelWidth, modelHeight, pitch) != 0) {
+        return;
+    }
+    const Letterbox& box = letterbox.getLetterbox();
+
+    std::vector<uint8_t> fused(pitch * modelHeight);
+    std::vector<uint8_t> reference(pitch * modelHeight);
+    cv::Mat rgb, resized, bordered;
+    const int code = packed ? cv::COLOR_YUV2RGB_YUYV : cv::COLOR_YUV2RGB_NV12;
+
+    std::vector<uint64_t> fusedNs, referenceNs;
+    for (int i = 0; i < iterations; i++) {
+        uint64_t startNs = nowNs();
+        letterbox.convert(image, fused.data());
+        fusedNs.push_back(nowNs() - startNs);
+
+        startNs = nowNs();
+        referenceLetterbox(yuv, code, box, modelWidth, modelHeight, pitch,
+                           rgb, resized, bordered, reference.data());
+        referenceNs.push_back(nowNs() - startNs);
+    }
+
+    int maxDiff = 0;
+    for (int y = 0; y < modelHeight; y++) {
+        for (int x = 0; x < modelWidth * 3; x++) {
+            maxDiff = std::max(maxDiff, abs((int)fused[y * pitch + x] - (int)reference[y * pitch + x]));
+        }
+    }
+
+    printf("%s %dx%d -> %dx%d (image %dx%d at %d,%d), max diff %d\n",
+           packed ? "YUYV" : "NV12", width, height, modelWidth, modelHeight,
+           box.width, box.height, box.offsetX, box.offsetY, maxDiff);
+    printTiming("fused", fusedNs);
+    printTiming("cvtColor+resize+border", referenceNs);
+}
+
+int main(int argc, char *argv[]) {
+    int iterations = argc > 1 ? atoi(argv[1]) : 200;
+    cv::setNumThreads(1);
+
+    printf("Letterbox benchmark: %d iterations, single thread\n", iterations);
+    benchLayout(YuvLayout::Nv12, 720, 480, 640, 640, iterations);
+    benchLayout(YuvLayout::Nv12, 1920, 1080, 640, 640, iterations);
+    benchLayout(YuvLayout::Yuyv, 640, 480, 640, 640, iterations);
+    benchLayout(YuvLayout::Yuyv, 1280, 720, 320, 320, iterations);
+    return 0;
+}
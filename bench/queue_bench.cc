@@ -0,0 +1,180 @@
+/**
+ * Микробенчмарк очередей из lockfree_queue.h на хосте.
+ *
+ * Сборка вне SDK:
+ *   g++ -O2 -std=c++17 -Iinclude bench/queue_bench.cc -o queue_bench -lpthread
+ *
+ * Измеряет пропускную способность (элементов в секунду) и задержку передачи
+ * элемента от производителя к потребителю (p50/p99/max) для неблокирующего
+ * (spin) и блокирующего (eventfd) режимов.
+ */
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <thread>
+#include <time.h>
+#include <vector>
+
+#include "lockfree_queue.h"
+
+static uint64_t nowNs() {
+    struct timespec time = {0, 0};
+    clock_gettime(CLOCK_MONOTONIC, &time);
+    return (uint64_t)time.tv_sec * 1000000000ull + (uint64_t)time.tv_nsec;
+}
+
+static void printLatency(const char *name, std::vector<uint64_t>& samples) {
+    if (samples.empty()) {
+        return;
+    }
+
+    std::sort(samples.begin(), samples.end());
+    printf("%-28s p50=%6llu ns  p99=%7llu ns  max=%8llu ns\n", name,
+           (unsigned long long)samples[samples.size() / 2],
+           (unsigned long long)samples[samples.size() * 99 / 100],
+           (unsigned long long)samples.back());
+}
+
+static void benchSpscThroughput(size_t count, bool blocking) {
+    SpscQueue<uint64_t> queue(256);
+
+    uint64_t startNs = nowNs();
+    std::thread producer([&] {
+        for (uint64_t i = 0; i < count; i++) {
+            if (blocking) {
+                queue.push(i);
+            } else {
+                while (!queue.tryPush(i)) {}
+            }
+        }
+    });
+
+    uint64_t value = 0;
+    uint64_t sum = 0;
+    for (size_t i = 0; i < count; i++) {
+        if (blocking) {
+            queue.pop(value);
+        } else {
+            while (!queue.tryPop(value)) {}
+        }
+        sum += value;
+    }
+    producer.join();
+    uint64_t elapsedNs = nowNs() - startNs;
+
+    QueueStats stats = queue.getStats();
+    printf("spsc %-23s %8.2f Mitems/s  (push stalls %llu, pop stalls %llu, checksum %llu)\n",
+           blocking ? "throughput blocking" : "throughput spin",
+           count * 1000.0 / elapsedNs,
+           (unsigned long long)stats.pushStalls, (unsigned long long)stats.popStalls,
+           (unsigned long long)sum);
+}
+
+static void benchSpscLatency(size_t count, bool blocking, uint64_t intervalNs) {
+    SpscQueue<uint64_t> queue(16);
+    std::vector<uint64_t> samples;
+    samples.reserve(count);
+
+    std::thread consumer([&] {
+        uint64_t sentNs = 0;
+        for (size_t i = 0; i < count; i++) {
+            if (blocking) {
+                queue.pop(sentNs);
+            } else {
+                while (!queue.tryPop(sentNs)) {}
+            }
+            samples.push_back(nowNs() - sentNs);
+        }
+    });
+
+    for (size_t i = 0; i < count; i++) {
+        uint64_t deadline = nowNs() + intervalNs;
+        while (nowNs() < deadline) {}
+        queue.push(nowNs());
+    }
+    consumer.join();
+
+    printLatency(blocking ? "spsc latency blocking" : "spsc latency spin", samples);
+}
+
+static void benchMpscThroughput(size_t count, int producers) {
+    MpscQueue<uint64_t> queue(256);
+    size_t perProducer = count / producers;
+
+    uint64_t startNs = nowNs();
+    std::vector<std::thread> threads;
+    for (int p = 0; p < producers; p++) {
+        threads.emplace_back([&queue, perProducer] {
+            for (uint64_t i = 0; i < perProducer; i++) {
+                while (!queue.tryPush(i)) {
+                    std::this_thread::yield();
+                }
+            }
+        });
+    }
+
+    uint64_t value = 0;
+    for (size_t i = 0; i < perProducer * producers; i++) {
+        queue.pop(value);
+    }
+    for (auto& thread : threads) {
+        thread.join();
+    }
+    uint64_t elapsedNs = nowNs() - startNs;
+
+    QueueStats stats = queue.getStats();
+    printf("mpsc throughput %d producers   %8.2f Mitems/s  (full rejects %llu, pop stalls %llu)\n",
+           producers, perProducer * producers * 1000.0 / elapsedNs,
+           (unsigned long long)stats.pushStalls, (unsigned long long)stats.popStalls);
+}
+
+static void benchMpscLatency(size_t count, int producers, uint64_t intervalNs) {
+    MpscQueue<uint64_t> queue(64);
+    size_t perProducer = count / producers;
+    std::vector<uint64_t> samples;
+    samples.reserve(perProducer * producers);
+
+    std::vector<std::thread> threads;
+    for (int p = 0; p < producers; p++) {
+        threads.emplace_back([&queue, perProducer, intervalNs] {
+            for (size_t i = 0; i < perProducer; i++) {
+                uint64_t deadline = nowNs() + intervalNs;
+                while (nowNs() < deadline) {}
+                while (!queue.tryPush(nowNs())) {}
+            }
+        });
+    }
+
+    uint64_t sentNs = 0;
+    for (size_t i = 0; i < perProducer * producers; i++) {
+        queue.pop(sentNs);
+        samples.push_back(nowNs() - sentNs);
+    }
+    for (auto& thread : threads) {
+        thread.join();
+    }
+
+    char name[64];
+    snprintf(name, sizeof(name), "mpsc latency %d producers", producers);
+    printLatency(name, samples);
+}
+
+int main(int argc, char *argv[]) {
+    size_t count = argc > 1 ? strtoull(argv[1], nullptr, 10) : 2000000;
+    size_t latencyCount = count / 20;
+    const uint64_t intervalNs = 20000;
+
+    printf("Queue benchmark: %zu items, %u hardware threads\n",
+           count, std::thread::hardware_concurrency());
+
+    benchSpscThroughput(count, false);
+    benchSpscThroughput(count, true);
+    benchSpscLatency(latencyCount, false, intervalNs);
+    benchSpscLatency(latencyCount, true, intervalNs);
+
+    benchMpscThroughput(count, 2);
+    benchMpscThroughput(count, 4);
+    benchMpscLatency(latencyCount, 2, intervalNs);
+
+    return 0;
+}
@@ -13,14 +13,18 @@
 
 #include "memory_pool.h"
 #include "frame_processor.h"
+#include "npu_scheduler.h"
 #include "rtsp_server.h"
 #include "video_encoder.h"
 #include "rknn_interface.h"
+#include "pipeline.h"
+#include "pipeline_config.h"
+#include "stage.h"
 
 class App
 {
 public:
-    App(uint16_t width, uint16_t height, uint16_t rtsp_port);
+    explicit App(const PipelineConfig& config);
     ~App();
 
     bool init();
@@ -31,23 +35,26 @@ public:
 
 private:
     bool _initComponents();
+    bool _initStream(const StreamSpec& spec);
+    bool _initModels();
     void _cleanupResources();
 
 private:
-    std::unique_ptr<MemoryPool> _mem_pool;
-    std::unique_ptr<FrameProcessor> _frame_processor;
+    // По одному на видеопоток, пул есть только у потоков, источник которых не отдает свои буферы
+    std::vector<std::shared_ptr<MemoryPool>> _mem_pools;
+    std::vector<std::unique_ptr<FrameProcessor>> _frame_processors;
+    std::vector<std::unique_ptr<VideoEncoder>> _vencs;
     std::unique_ptr<RtspServer> _rtsp_server;
-    std::unique_ptr<VideoEncoder> _venc;
-    std::unique_ptr<RKNNInference> _inferance;
 
-    uint16_t _width;
-    uint16_t _height;
-    uint16_t _rtsp_port;
-    bool _initialized;
+    // Контексты RKNN и их планировщики, модели потоков могут делить один контекст
+    std::vector<std::unique_ptr<RKNNInference>> _models;
+    std::vector<std::unique_ptr<NpuScheduler>> _npu_schedulers;
+    std::unique_ptr<Pipeline> _pipeline;
+
+    PipelineConfig _config;
+    StageContext _stage_context;
 
-    int _model_width;      // ← Добавить
-    int _model_height;     // ← Добавить
-    int _model_channel;    // ← Добавит
+    bool _initialized;
 };
 
 #endif // APP_H
@@ -0,0 +1,303 @@
+#ifndef BACKEND_H
+#define BACKEND_H
+
+#include <cstdint>
+#include <memory>
+#include <string>
+
+#include "mpi_types.h"
+#include "rknn_api.h"
+
+/**
+ * @file backend.h
+ * @brief Тонкие интерфейсы к железу RV1106: MB пул, VENC, VI, NPU и RTSP
+ *
+ * MemoryPool, VideoEncoder, RKNNInference и RtspServer обращаются к SDK
+ * только через эти интерфейсы. Реализация выбирается при сборке:
+ * rockchip_backend.cc на плате, host_backend.cc с HOST_BUILD на x86.
+ * Интерфейсы повторяют вызовы SDK и его коды возврата, без новой логики.
+ */
+
+/**
+ * @class MemoryBackend
+ * @brief Пулы блоков памяти (RK_MPI_MB_*)
+ */
+class MemoryBackend {
+public:
+    virtual ~MemoryBackend() = default;
+
+    /**
+     * @brief Создает пул из count блоков по size байт
+     * @return ID пула или MB_INVALID_POOLID
+     */
+    virtual MB_POOL createPool(uint64_t size, uint32_t count) = 0;
+    virtual int destroyPool(MB_POOL pool) = 0;
+
+    /**
+     * @brief Берет свободный блок
+     * @return nullptr если пул исчерпан
+     */
+    virtual MB_BLK getBlock(MB_POOL pool, uint64_t size, bool cached) = 0;
+    virtual int releaseBlock(MB_BLK block) = 0;
+
+    virtual void* getVirtualAddress(MB_BLK block) = 0;
+
+    /**
+     * @brief Файловый дескриптор DMA буфера блока
+     * @return -1 если у блока нет дескриптора
+     */
+    virtual int getFd(MB_BLK block) = 0;
+
+    /**
+     * @brief Согласует кэш CPU с участком [offset, offset + size) блока
+     * @param toDevice true - сбросить записи CPU перед чтением железом,
+     *        false - сделать кэш недействительным перед чтением CPU
+     * @return 0 при успехе
+     */
+    virtual int syncCache(MB_BLK block, uint64_t offset, uint64_t size, bool toDevice) = 0;
+};
+
+/**
+ * @struct EncoderParams
+ * @brief Параметры канала кодера
+ */
+struct EncoderParams {
+    RK_CODEC_ID_E codec = RK_VIDEO_ID_AVC;
+    PIXEL_FORMAT_E pixelFormat = RK_FMT_BGR888;
+    uint32_t width = 0;
+    uint32_t height = 0;
+    uint32_t bitrate = 0;           // кбит/с
+    uint32_t gop = 1;               // Период IDR кадров
+    uint32_t streamBufCount = 2;    // Потоков, которые можно удерживать одновременно
+    uint32_t bufSize = 0;           // Размер буфера потока
+};
+
+/**
+ * @class EncoderBackend
+ * @brief Канал аппаратного кодера (RK_MPI_VENC_*)
+ */
+class EncoderBackend {
+public:
+    virtual ~EncoderBackend() = default;
+
+    /**
+     * @brief Создает канал и запускает прием кадров
+     */
+    virtual int createChannel(int channelId, const EncoderParams& params) = 0;
+    virtual void destroyChannel(int channelId) = 0;
+
+    /**
+     * @brief Останавливает и возобновляет прием кадров каналом
+     */
+    virtual int stopReceiving(int channelId) = 0;
+    virtual int startReceiving(int channelId) = 0;
+
+    /**
+     * @brief Следующий кадр кодируется как IDR
+     */
+    virtual int requestIdr(int channelId) = 0;
+
+    /**
+     * @param timeoutMs -1 - ждать без ограничения
+     */
+    virtual int sendFrame(int channelId, const VIDEO_FRAME_INFO_S* frame, int timeoutMs) = 0;
+    virtual int getStream(int channelId, VENC_STREAM_S* stream, int timeoutMs) = 0;
+    virtual int releaseStream(int channelId, VENC_STREAM_S* stream) = 0;
+
+    /**
+     * @brief Адрес данных пакета потока
+     */
+    virtual const uint8_t* getPackData(const VENC_PACK_S& pack) = 0;
+};
+
+/**
+ * @struct ModelOutputParams
+ * @brief Вторая ветка VPSS: вход модели RGB888 с letterbox
+ *
+ * Кадр масштабируется в прямоугольник rect* внутри width x height,
+ * остальное заливается bgColor (0xRRGGBB).
+ */
+struct ModelOutputParams {
+    uint32_t width = 0;             // Размер входа модели, 0 - ветки нет
+    uint32_t height = 0;
+    uint32_t rectX = 0;
+    uint32_t rectY = 0;
+    uint32_t rectWidth = 0;
+    uint32_t rectHeight = 0;
+    uint32_t bgColor = 0x727272;
+    int fps = 0;                    // Частота ветки, 0 - каждый кадр
+    uint32_t bufCount = 2;
+};
+
+/**
+ * @struct CaptureParams
+ * @brief Параметры канала захвата VI
+ */
+struct CaptureParams {
+    int camera = 0;                 // VI устройство и ISP камеры
+    int channel = 0;                // Канал VI
+    uint32_t width = 0;
+    uint32_t height = 0;
+    uint32_t bufCount = 6;          // DMABUF буферов канала, кадры в обороте удерживают их
+    int fps = 30;                   // Частота сенсора, от нее прореживается ветка модели
+    std::string iqPath = "/etc/iqfiles";   // Файлы настройки ISP
+    std::string path;               // Только host: сырой NV12 файл вместо камеры, пусто - тестовая картинка
+    ModelOutputParams model;
+};
+
+/**
+ * @class CaptureBackend
+ * @brief Канал захвата камеры (RK_MPI_VI_*, RK_MPI_VPSS_*)
+ *
+ * Кадры NV12 (RK_FMT_YUV420SP) остаются в DMABUF буферах канала,
+ * пока их не вернут через releaseFrame. С веткой модели VI привязан
+ * к группе VPSS: канал 0 отдает кадры полного размера NV12, канал 1 -
+ * вход модели RGB888, масштабированный и вписанный аппаратно.
+ */
+class CaptureBackend {
+public:
+    virtual ~CaptureBackend() = default;
+
+    /**
+     * @brief Запускает ISP, устройство и канал VI
+     */
+    virtual int open(const CaptureParams& params) = 0;
+    virtual void close() = 0;
+
+    /**
+     * @brief Забирает следующий кадр канала
+     * @param timeoutMs -1 - ждать без ограничения
+     */
+    virtual int getFrame(VIDEO_FRAME_INFO_S& frame, int timeoutMs) = 0;
+
+    /**
+     * @brief Возвращает буфер кадра каналу, можно вызывать из любого потока
+     */
+    virtual int releaseFrame(const VIDEO_FRAME_INFO_S& frame) = 0;
+
+    /**
+     * @brief Забирает кадр ветки модели
+     * @param timeoutMs 0 - не ждать: ветка прорежена и кадра может не быть
+     * @return RK_SUCCESS если кадр получен
+     */
+    virtual int getModelFrame(VIDEO_FRAME_INFO_S& frame, int timeoutMs) = 0;
+    virtual int releaseModelFrame(const VIDEO_FRAME_INFO_S& frame) = 0;
+
+    virtual void* getVirtualAddress(MB_BLK block) = 0;
+};
+
+/**
+ * @struct NpuOptions
+ * @brief Настройки NPU бэкенда
+ */
+struct NpuOptions {
+    uint32_t delayUs = 0;           // Время Run() поддельного NPU (только host)
+};
+
+/**
+ * @class NpuBackend
+ * @brief Контекст модели на NPU (rknn_*)
+ *
+ * Память тензоров выделяется бэкендом, входы и выходы привязываются
+ * к ней до запуска, как в rknn_set_io_mem.
+ */
+class NpuBackend {
+public:
+    virtual ~NpuBackend() = default;
+
+    virtual int init(const std::string& modelPath) = 0;
+    virtual void destroy() = 0;
+
+    virtual int queryIoNum(rknn_input_output_num& ioNum) = 0;
+
+    /**
+     * @brief Нативный атрибут входа, attr.index задан вызывающим
+     */
+    virtual int queryInputAttr(rknn_tensor_attr& attr) = 0;
+
+    /**
+     * @brief Нативный NHWC атрибут выхода, attr.index задан вызывающим
+     */
+    virtual int queryOutputAttr(rknn_tensor_attr& attr) = 0;
+
+    virtual rknn_tensor_mem* createMem(uint32_t size) = 0;
+    virtual void destroyMem(rknn_tensor_mem* mem) = 0;
+
+    /**
+     * @brief Оборачивает чужой DMA буфер в память тензора, без копирования
+     * @param block Блок MPI (rknn_create_mem_from_mb_blk), nullptr - импорт по fd
+     * @param fd DMABUF дескриптор буфера, если блока нет
+     * @param virt Виртуальный адрес буфера
+     * @return nullptr при ошибке; destroyMem освобождает только описание,
+     *         буфер остается у владельца
+     */
+    virtual rknn_tensor_mem* importMem(MB_BLK block, int fd, void* virt, uint32_t size) = 0;
+
+    virtual int setInputMem(rknn_tensor_mem* mem, rknn_tensor_attr& attr) = 0;
+    virtual int setOutputMem(rknn_tensor_mem* mem, rknn_tensor_attr& attr) = 0;
+
+    /**
+     * @brief Согласует кэш CPU с памятью тензора (rknn_mem_sync)
+     * @param toDevice true - после записи CPU, false - перед чтением CPU
+     */
+    virtual int syncMem(rknn_tensor_mem* mem, bool toDevice) = 0;
+
+    virtual int run() = 0;
+};
+
+/**
+ * @class RtspBackend
+ * @brief RTSP сервер с видеосессиями на одном порту (librtsp)
+ */
+class RtspBackend {
+public:
+    virtual ~RtspBackend() = default;
+
+    virtual int create(int port) = 0;
+
+    /**
+     * @return Номер сессии, < 0 при ошибке
+     */
+    virtual int createSession(const char* path) = 0;
+    virtual int setVideo(int session, int codecId, const uint8_t* codecData, int dataLen) = 0;
+    virtual int sendVideo(int session, const uint8_t* frame, int len, uint64_t ts) = 0;
+    virtual int doEvent() = 0;
+    virtual int syncVideoTimestamp(int session, uint64_t ts, uint64_t ntpTime) = 0;
+    virtual void destroy() = 0;
+
+    /**
+     * @brief Время для меток кадров, мкс
+     */
+    virtual uint64_t getRelativeTime() = 0;
+    virtual uint64_t getNtpTime() = 0;
+
+    /**
+     * @brief Число подключенных клиентов всех сессий
+     * @return < 0 если узнать не удалось
+     */
+    virtual int getClientCount() = 0;
+};
+
+/**
+ * @brief Подготавливает платформу до создания компонентов
+ * @return 0 при успехе
+ */
+int initPlatform();
+
+/**
+ * @brief Освобождает платформу после уничтожения компонентов
+ */
+void exitPlatform();
+
+/**
+ * @brief Имя выбранной при сборке платформы
+ */
+const char* getPlatformName();
+
+std::unique_ptr<MemoryBackend> createMemoryBackend();
+std::unique_ptr<EncoderBackend> createEncoderBackend();
+std::unique_ptr<CaptureBackend> createCaptureBackend();
+std::unique_ptr<NpuBackend> createNpuBackend(const NpuOptions& options);
+std::unique_ptr<RtspBackend> createRtspBackend();
+
+#endif // BACKEND_H
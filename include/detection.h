@@ -0,0 +1,30 @@
+#ifndef DETECTION_H
+#define DETECTION_H
+
+#include <cstdint>
+
+/**
+ * @struct Detection
+ * @brief Результат детекции в координатах исходного кадра
+ */
+struct Detection {
+    int left;
+    int top;
+    int right;
+    int bottom;
+    float score;
+    int classId;
+};
+
+/**
+ * @struct Track
+ * @brief Сопровождаемый объект, связанный с детекцией
+ */
+struct Track {
+    int id;
+    Detection box;
+    uint32_t age;           // Кадров с момента появления
+    uint32_t missed;        // Кадров без подтверждения детекцией
+};
+
+#endif // DETECTION_H
@@ -1,9 +1,13 @@
 #ifndef FRAME_PROCESSOR_H
 #define FRAME_PROCESSOR_H
 
+#include "detection.h"
 #include "memory_pool.h"
-#include "rk_comm_video.h"
+#include "mpi_types.h"
+#include "nv12_canvas.h"
+#include "yolo_decoder.h"
 #include <cstdint>
+#include <vector>
 #include <opencv2/core/core.hpp>
 #include <opencv2/highgui/highgui.hpp>
 #include <opencv2/imgproc/imgproc.hpp>
@@ -18,35 +22,50 @@ public:
     ~FrameProcessor();
 
     /**
-     * @brief Инициализирует источник видео (камеру)
-     * @return Статус инициализации
+     * @brief Заполняет описание кадра для VENC поверх блока памяти
+     * @param info Описание кадра для кодера
+     * @param block Блок памяти из пула
+     * @param format RK_FMT_BGR888 или RK_FMT_YUV420SP
      */
-    int initVideoCapture();
-
-    void initFrame(const MemoryPool& mem_pool);
-
-    void updateTimeForFrame();
+    void initFrame(VIDEO_FRAME_INFO_S& info, MB_BLK block, PIXEL_FORMAT_E format = RK_FMT_BGR888) const;
 
     /**
-     * @brief Получает кадр с камеры
-     * @param frame Матрица для сохранения кадра
-     * @return True если кадр успешно захвачен
+     * @brief Переводит BGR кадр источника в NV12 блок пула
+     * @param bgr Кадр width x height
+     * @param nv12 Обертка над блоком: height * 3 / 2 строк
      */
-    bool captureFrame();
+    void convertToNv12(const cv::Mat& bgr, cv::Mat& nv12);
 
-    float getFps() const;
+    /**
+     * @brief Обновляет номер и временную метку кадра
+     * @param info Описание кадра для кодера
+     */
+    void updateTimeForFrame(VIDEO_FRAME_INFO_S& info);
 
     /**
      * @brief Добавляет текст FPS на кадр
      * @param frame Матрица кадра
      * @param fps Значение FPS
+     * @param drawn Если задан, сюда добавляются области кадра, в которых рисовали
      */
-    void drawFpsText(float fps);
+    void drawFpsText(cv::Mat& frame, float fps, std::vector<cv::Rect>* drawn = nullptr) const;
 
     /**
-     * @brief Закрывает источник видео
+     * @brief Рисует рамки и подписи детекций
+     * @param frame Матрица кадра
+     * @param detections Детекции в координатах кадра
+     * @param decoder Декодер с именами классов
+     * @param drawn Если задан, сюда добавляются области кадра, в которых рисовали
      */
-    void releaseCapture();
+    void drawDetections(cv::Mat& frame, const std::vector<Detection>& detections,
+                        const YoloDecoder& decoder, std::vector<cv::Rect>* drawn = nullptr) const;
+
+    /**
+     * @brief То же для NV12 кадра, без перевода в BGR
+     */
+    void drawFpsText(Nv12Canvas& canvas, float fps, std::vector<cv::Rect>* drawn = nullptr) const;
+    void drawDetections(Nv12Canvas& canvas, const std::vector<Detection>& detections,
+                        const YoloDecoder& decoder, std::vector<cv::Rect>* drawn = nullptr) const;
 
     /**
      * @brief Получает ширину кадра
@@ -58,22 +77,12 @@ public:
      */
     int getHeight() const { return height_; }
 
-    /**
-     * @brief Проверяет открытие камеры
-     */
-    bool isCaptureOpened() const { return capture_.isOpened(); }
-
-    const VIDEO_FRAME_INFO_S* getFrameForVenc() const;
-
 private:
     int width_;
     int height_;
-    cv::VideoCapture capture_;
+    cv::Mat planar_;            // I420 при переводе в NV12
 
-    VIDEO_FRAME_INFO_S h264_frame;
     RK_U32 H264_TimeRef = 0;
-
-    cv::Mat frame;
 };
 
 #endif // FRAME_PROCESSOR_H
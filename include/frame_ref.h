@@ -0,0 +1,217 @@
+#ifndef FRAME_REF_H
+#define FRAME_REF_H
+
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <vector>
+
+#include <opencv2/core/core.hpp>
+
+#include "detection.h"
+#include "frame_timeline.h"
+#include "memory_pool.h"
+
+struct ModelInput;
+struct MotionMask;
+class EncodedPacket;
+class FrameRef;
+class ModelContext;
+
+/**
+ * @struct FrameMeta
+ * @brief Метаданные, присоединенные к кадру стадиями конвейера
+ */
+struct FrameMeta {
+    std::vector<Detection> detections;
+    std::vector<Track> tracks;
+    std::vector<Detection> groundTruth;                     // Истинные рамки от источника
+    bool hasGroundTruth = false;
+    std::vector<std::shared_ptr<ModelInput>> modelInputs;  // Входы моделей для ветки детекции
+    std::shared_ptr<EncodedPacket> packet;                  // Закодированный кадр для приемников
+    std::shared_ptr<const MotionMask> motion;               // Маска движения, если в графе есть стадия motion
+    const ModelContext* sourceModel = nullptr;              // Модель, вход которой готовит источник (VPSS)
+    std::shared_ptr<FrameRef> modelFrame;                   // Ее вход RGB888 с letterbox, нет - ветка прорежена
+};
+
+/**
+ * @class FrameRef
+ * @brief Разделяемая ссылка на кадр в DMA буфере пула памяти или захвата
+ *
+ * Копирование ссылки только увеличивает атомарный счетчик, данные кадра
+ * не копируются. Когда последняя ссылка освобождается, блок возвращается
+ * в пул или владельцу буфера (например, каналу VI). Кодер, NPU и оверлей
+ * работают с одним и тем же буфером.
+ */
+class FrameRef {
+public:
+    FrameRef() : buffer_(nullptr) {}
+    ~FrameRef() { reset(); }
+
+    FrameRef(const FrameRef& other);
+    FrameRef(FrameRef&& other) noexcept : buffer_(other.buffer_) { other.buffer_ = nullptr; }
+    FrameRef& operator=(const FrameRef& other);
+    FrameRef& operator=(FrameRef&& other) noexcept;
+
+    /**
+     * @brief Создает кадр BGR888 или NV12 поверх нового блока из пула
+     * @param pool Пул памяти
+     * @param width Ширина кадра
+     * @param height Высота кадра
+     * @param format RK_FMT_BGR888 или RK_FMT_YUV420SP, блок должен вмещать кадр
+     * @param timeoutUs Сколько ждать свободного блока
+     * @return Пустая ссылка если в пуле нет свободных блоков
+     */
+    static FrameRef create(MemoryPool& pool, int width, int height,
+                           PIXEL_FORMAT_E format = RK_FMT_BGR888, uint64_t timeoutUs = 0);
+
+    /**
+     * @brief Создает кадр без пикселей, несущий только номер и метаданные
+     * @param width Ширина исходного кадра
+     * @param height Высота исходного кадра
+     */
+    static FrameRef createDetached(int width, int height);
+
+    /**
+     * @brief Оборачивает кадр, буфер которого принадлежит не пулу (VI, VPSS)
+     * @param info Описание кадра от источника, становится описанием для VENC
+     * @param data Виртуальный адрес буфера
+     * @param release Возвращает буфер владельцу, вызывается с последней ссылкой
+     *        из того потока, который ее освободил
+     */
+    static FrameRef wrap(const VIDEO_FRAME_INFO_S& info, void* data, std::function<void()> release);
+
+    /**
+     * @brief Освобождает ссылку
+     */
+    void reset();
+
+    explicit operator bool() const { return buffer_ != nullptr; }
+
+    /**
+     * @brief Получает количество живых ссылок на кадр
+     */
+    int useCount() const { return buffer_ ? buffer_->refs.load() : 0; }
+
+    MB_BLK block() const { return buffer_->block; }
+    void* data() const { return buffer_->data; }
+    int width() const { return buffer_->width; }
+    int height() const { return buffer_->height; }
+
+    /**
+     * @brief Формат пикселей: RK_FMT_BGR888 или RK_FMT_YUV420SP (NV12)
+     */
+    PIXEL_FORMAT_E pixelFormat() const { return buffer_->format; }
+    bool isNv12() const { return buffer_->format == RK_FMT_YUV420SP; }
+
+    /**
+     * @brief Обертка OpenCV над DMA буфером кадра
+     *
+     * У BGR888 - CV_8UC3 width x height. У NV12 - CV_8UC1 из virHeight * 3 / 2
+     * строк с шагом virWidth: плоскость Y, за ней чередующиеся UV.
+     */
+    cv::Mat& image() const { return buffer_->image; }
+
+    /**
+     * @brief Плоскость яркости NV12 кадра width x height
+     */
+    cv::Mat luma() const { return buffer_->image.rowRange(0, buffer_->height); }
+
+    /**
+     * @brief Описание кадра для VENC
+     */
+    VIDEO_FRAME_INFO_S& vencFrame() const { return buffer_->vencFrame; }
+
+    uint32_t seq() const { return buffer_->seq; }
+    void setSeq(uint32_t seq) const { buffer_->seq = seq; }
+
+    uint64_t captureTimeUs() const { return buffer_->captureTimeUs; }
+    void setCaptureTimeUs(uint64_t timeUs) const { buffer_->captureTimeUs = timeUs; }
+
+    /**
+     * @brief Метки времени кадра по точкам конвейера
+     */
+    FrameTimeline& timeline() const { return buffer_->timeline; }
+
+    FrameMeta& meta() const { return buffer_->meta; }
+
+    /**
+     * @brief Отмечает, какая часть конвейера держит блок пула (для отчетов пула)
+     */
+    void setPoolOwner(PoolOwner owner) const { buffer_->poolBlock.setOwner(owner); }
+
+    /**
+     * @brief Начало чтения CPU прямоугольника, записанного железом (ISP, VPSS)
+     *
+     * Кэш под прямоугольником становится недействительным; у NV12 вместе
+     * со строками цветности, если они читаются. Вызывается до записей CPU
+     * в кадр или после flushCpuWrites(): несброшенные строки пропали бы.
+     * @param chroma false - читается только яркость
+     * @return 0 при успехе
+     */
+    int beginCpuAccess(const cv::Rect& rect, bool chroma = true) const;
+
+    /**
+     * @brief Начало чтения CPU всего кадра
+     */
+    int beginCpuAccess() const { return beginCpuAccess(cv::Rect(0, 0, buffer_->width, buffer_->height)); }
+
+    /**
+     * @brief Отмечает прямоугольник, нарисованный CPU
+     *
+     * У NV12 отмечаются и строки яркости, и строки цветности под ним. У кадров
+     * пула участки ведет блок пула, у чужих буферов (VI, VPSS) - сам кадр.
+     */
+    void markDirty(const cv::Rect& rect) const;
+
+    /**
+     * @brief Отмечает весь кадр, записанный CPU
+     */
+    void markAllDirty() const { markDirty(cv::Rect(0, 0, buffer_->width, buffer_->height)); }
+
+    /**
+     * @brief Сбрасывает отмеченные участки из кэша CPU, до передачи кадра VENC
+     *
+     * Чужой буфер сбрасывается по своему MB_BLK через MemoryBackend.
+     * @return 0 при успехе
+     */
+    int flushCpuWrites() const;
+
+private:
+    struct Buffer {
+        std::atomic<int> refs;
+        MemoryBlock poolBlock;                  // Блок пула, пустой у чужих буферов
+        DirtyRanges dirty;                      // Записи CPU в чужой буфер, у кадров пула их ведет блок
+        MB_BLK block;
+        void* data;
+        int width;
+        int height;
+        PIXEL_FORMAT_E format;
+        std::function<void()> release;
+        cv::Mat image;
+        VIDEO_FRAME_INFO_S vencFrame;
+        uint32_t seq;
+        uint64_t captureTimeUs;
+        FrameTimeline timeline;
+        FrameMeta meta;
+    };
+
+    explicit FrameRef(Buffer* buffer) : buffer_(buffer) {}
+
+    /**
+     * @brief Вызывает fn(offset, size) для участков блока под прямоугольником, по участку на плоскость
+     * @param chroma false - только участок яркости NV12
+     */
+    template <typename Fn>
+    void forEachRange(const cv::Rect& rect, Fn fn, bool chroma = true) const;
+
+    /**
+     * @brief Байт в буфере кадра от data(), по описанию OpenCV
+     */
+    uint64_t getBufferBytes() const { return (uint64_t)buffer_->image.step * buffer_->image.rows; }
+
+    Buffer* buffer_;
+};
+
+#endif // FRAME_REF_H
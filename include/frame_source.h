@@ -0,0 +1,271 @@
+#ifndef FRAME_SOURCE_H
+#define FRAME_SOURCE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <opencv2/core/core.hpp>
+#include <opencv2/highgui/highgui.hpp>
+
+#include "backend.h"
+#include "detection.h"
+#include "frame_ref.h"
+#include "pipeline_config.h"
+
+/**
+ * @brief Результат чтения кадра из источника
+ */
+enum class SourceStatus {
+    Frame,      // Кадр записан в буфер
+    End,        // Источник исчерпан
+    Error
+};
+
+/**
+ * @class FrameSource
+ * @brief Источник кадров BGR888 для стадии source
+ *
+ * Кадр пишется прямо в буфер пула размером width x height,
+ * вызовы идут из одного потока. Источник с собственными DMA
+ * буферами (providesFrames) отдает кадры через acquire без пула.
+ */
+class FrameSource {
+public:
+    virtual ~FrameSource() = default;
+
+    /**
+     * @brief Открывает источник
+     * @return 0 при успехе, < 0 при ошибке
+     */
+    virtual int open() = 0;
+
+    /**
+     * @brief Читает следующий кадр
+     * @param frame Буфер кадра (обертка над блоком пула)
+     * @param groundTruth Истинные рамки объектов кадра, если источник их знает
+     */
+    virtual SourceStatus read(cv::Mat& frame, std::vector<Detection>& groundTruth) = 0;
+
+    /**
+     * @brief Источник сам выделяет буферы кадров, пул для него не нужен
+     */
+    virtual bool providesFrames() const { return false; }
+
+    /**
+     * @brief Забирает следующий кадр в буфере источника
+     * @param frame Сюда записывается ссылка на кадр с заполненным vencFrame();
+     *        буфер вернется источнику с последней ссылкой
+     */
+    virtual SourceStatus acquire(FrameRef& frame, std::vector<Detection>& groundTruth) {
+        return SourceStatus::Error;
+    }
+
+    /**
+     * @brief Просит источник готовить вход модели сам (вызывается до open)
+     *
+     * Кадр входа кладется в FrameMeta::modelFrame.
+     * @return 0 если источник это умеет
+     */
+    virtual int setModelOutput(const ModelOutputParams& params) { return -1; }
+
+    /**
+     * @brief Источник сообщает истинные рамки объектов
+     */
+    virtual bool hasGroundTruth() const { return false; }
+
+    virtual const char* getName() const = 0;
+};
+
+/**
+ * @class FramePacer
+ * @brief Выдерживает точную частоту кадров по абсолютным дедлайнам
+ *
+ * Ошибка сна не накапливается: кадр n ждет момента start + n * interval.
+ * При отставании больше чем на кадр расписание сдвигается, а не догоняется
+ * пачкой кадров.
+ */
+class FramePacer {
+public:
+    /**
+     * @param fps Частота, 0 - без ограничения
+     */
+    explicit FramePacer(float fps);
+
+    /**
+     * @brief Ждет момента следующего кадра
+     */
+    void wait();
+
+    /**
+     * @brief Кадров, к моменту которых источник опоздал больше чем на интервал
+     */
+    uint64_t getLateFrames() const { return lateFrames_; }
+
+private:
+    uint64_t intervalNs_;
+    uint64_t nextNs_;
+    uint64_t lateFrames_;
+};
+
+/**
+ * @class CameraSource
+ * @brief Камера через cv::VideoCapture (source = camera)
+ *
+ * Параметры: device (0).
+ */
+class CameraSource : public FrameSource {
+public:
+    CameraSource(int device, int width, int height);
+    ~CameraSource() override;
+
+    int open() override;
+    SourceStatus read(cv::Mat& frame, std::vector<Detection>& groundTruth) override;
+    const char* getName() const override { return "camera"; }
+
+private:
+    int device_;
+    int width_;
+    int height_;
+    cv::VideoCapture capture_;
+};
+
+/**
+ * @class ViFrameSource
+ * @brief Канал VI камеры без копирования кадров (source = vi)
+ *
+ * Кадр NV12 остается в DMABUF буфере VI: его MB_BLK уходит в VENC,
+ * а препроцессинг читает тот же буфер. Буфер возвращается каналу, когда
+ * кадр отпустит последняя стадия, поэтому buffers должно хватать на все
+ * кадры в обороте. В host сборке канал заменяет файл или тестовая картинка.
+ *
+ * С веткой модели (setModelOutput) кадры идут через VPSS: полный кадр
+ * NV12 для VENC и вход модели RGB888, который VPSS масштабирует
+ * и вписывает сам. Кадр ветки забирается без ожидания вместе со
+ * следующим полным кадром, поэтому может отставать от него на кадр.
+ *
+ * Параметры: camera (0), channel (0), buffers (6), iq_path (/etc/iqfiles),
+ * timeout_ms (1000), sensor_fps (30); только host: path - сырой NV12 файл
+ * размера конвейера.
+ */
+class ViFrameSource : public FrameSource {
+public:
+    ViFrameSource(const StageSpec& spec, int width, int height);
+
+    int open() override;
+    SourceStatus read(cv::Mat& frame, std::vector<Detection>& groundTruth) override;
+    bool providesFrames() const override { return true; }
+    SourceStatus acquire(FrameRef& frame, std::vector<Detection>& groundTruth) override;
+    int setModelOutput(const ModelOutputParams& params) override;
+    const char* getName() const override { return "vi"; }
+
+private:
+    std::shared_ptr<FrameRef> acquireModelFrame();
+
+    CaptureParams params_;
+    int timeoutMs_;
+
+    // Кадры в обороте держат бэкенд: канал закрывается после возврата последнего буфера
+    std::shared_ptr<CaptureBackend> backend_;
+};
+
+/**
+ * @class FileSource
+ * @brief Видео из Y4M или сырого файла, отображенного через mmap (source = file)
+ *
+ * Файл не читается в буфер: кадры конвертируются прямо из отображения
+ * в блок пула, страницы подгружает ядро с упреждением.
+ *
+ * Параметры: path; format - y4m | bgr | nv12 | i420, по умолчанию
+ * по расширению (.y4m, .bgr, .nv12, иначе i420); src_width, src_height -
+ * размер кадра сырого файла (по умолчанию размер конвейера); loop (1).
+ * Кадр другого размера масштабируется.
+ */
+class FileSource : public FrameSource {
+public:
+    FileSource(const StageSpec& spec, int width, int height);
+    ~FileSource() override;
+
+    int open() override;
+    SourceStatus read(cv::Mat& frame, std::vector<Detection>& groundTruth) override;
+    const char* getName() const override { return "file"; }
+
+private:
+    enum class Format { Bgr, Nv12, I420 };
+
+    int parseY4mHeader();
+    void unmap();
+
+    std::string path_;
+    std::string formatName_;
+    int width_;
+    int height_;
+    int srcWidth_;
+    int srcHeight_;
+    bool loop_;
+    bool y4m_;
+    Format format_;
+
+    int fd_;
+    const uint8_t* map_;
+    size_t mapSize_;
+    size_t firstFrame_;         // Смещение первого кадра
+    size_t frameSize_;          // Пиксели кадра без заголовка FRAME у Y4M
+    size_t position_;
+    cv::Mat converted_;
+};
+
+/**
+ * @class SyntheticSource
+ * @brief Движущиеся прямоугольники с известными рамками (source = synthetic)
+ *
+ * Движение задано в пикселях на кадр и зависит только от seed, поэтому
+ * последовательность кадров и рамок повторяется при любой частоте.
+ *
+ * Параметры: objects (3), seed (1), class_id (0).
+ */
+class SyntheticSource : public FrameSource {
+public:
+    SyntheticSource(const StageSpec& spec, int width, int height);
+
+    int open() override;
+    SourceStatus read(cv::Mat& frame, std::vector<Detection>& groundTruth) override;
+    bool hasGroundTruth() const override { return true; }
+    const char* getName() const override { return "synthetic"; }
+
+private:
+    struct Object {
+        float x, y;             // Левый верхний угол
+        float vx, vy;           // Пиксели за кадр
+        int width, height;
+        cv::Scalar color;
+    };
+
+    int width_;
+    int height_;
+    uint32_t objectCount_;
+    uint32_t seed_;
+    int classId_;
+    std::vector<Object> objects_;
+};
+
+/**
+ * @brief Создает источник по параметру source стадии
+ * @return nullptr если тип источника неизвестен
+ */
+std::unique_ptr<FrameSource> createFrameSource(const StageSpec& spec, int width, int height);
+
+/**
+ * @brief Формат кадров стадии source видеопотока
+ * @return RK_FMT_YUV420SP у source = vi и pixel_format = nv12, иначе RK_FMT_BGR888
+ */
+PIXEL_FORMAT_E getSourcePixelFormat(const PipelineConfig& config, const std::string& stream);
+
+/**
+ * @brief Кадрам стадии source видеопотока нужен пул: источник не отдает свои буферы
+ */
+bool sourceNeedsPool(const PipelineConfig& config, const std::string& stream);
+
+#endif // FRAME_SOURCE_H
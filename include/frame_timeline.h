@@ -0,0 +1,130 @@
+#ifndef FRAME_TIMELINE_H
+#define FRAME_TIMELINE_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+/**
+ * @brief Точки пути кадра, в которых стадии ставят метку времени
+ */
+enum class TimelinePoint : uint8_t {
+    Capture,            // Кадр получен от источника
+    PreprocessStart,
+    PreprocessEnd,
+    NpuStart,           // SetInput
+    NpuEnd,             // Run() вернул управление
+    Postprocess,        // Детекции декодированы
+    Overlay,            // Оверлей нарисован
+    EncodeSubmit,       // Кадр отправлен в VENC
+    BitstreamReady,     // Поток кадра получен из VENC
+    RtpSent,            // Кадр отправлен клиентам потоком событий RTSP
+    Count
+};
+
+/**
+ * @struct FrameTimeline
+ * @brief Метки времени кадра, мкс CLOCK_MONOTONIC, 0 - точка не пройдена
+ *
+ * Фиксированного размера и живет в буфере кадра. Точки пишутся стадиями
+ * по ходу кадра, передача между потоками через очереди упорядочивает записи.
+ */
+struct FrameTimeline {
+    uint64_t us[(size_t)TimelinePoint::Count];
+
+    FrameTimeline() { clear(); }
+
+    void clear() {
+        for (uint64_t& value : us) {
+            value = 0;
+        }
+    }
+
+    uint64_t get(TimelinePoint point) const { return us[(size_t)point]; }
+};
+
+/**
+ * @struct LatencyStats
+ * @brief Перцентили задержки, мкс
+ */
+struct LatencyStats {
+    uint64_t count;
+    uint64_t p50Us;
+    uint64_t p95Us;
+    uint64_t p99Us;
+    uint64_t maxUs;
+};
+
+/**
+ * @class LatencyHistogram
+ * @brief Лог-линейная гистограмма задержек без блокировок
+ *
+ * Значения до 16 мкс хранятся точно, дальше на каждую степень двойки
+ * приходится 16 корзин: ошибка перцентиля не больше 1/16 значения.
+ * Запись - один атомарный инкремент, писать и читать можно из любых потоков.
+ */
+class LatencyHistogram {
+public:
+    LatencyHistogram();
+
+    void record(uint64_t valueUs);
+
+    /**
+     * @brief Перцентили по всем записанным значениям
+     */
+    LatencyStats getStats() const;
+
+    void reset();
+
+private:
+    static constexpr int kSubBits = 4;
+    static constexpr int kSubBuckets = 1 << kSubBits;
+    static constexpr int kBucketCount = (64 - kSubBits + 1) * kSubBuckets;
+
+    static int bucketIndex(uint64_t value);
+    static uint64_t bucketMidpoint(int index);
+
+    std::atomic<uint64_t> buckets_[kBucketCount];
+    std::atomic<uint64_t> count_;
+    std::atomic<uint64_t> max_;
+};
+
+/**
+ * @class LatencyTracker
+ * @brief Гистограммы задержек между точками пути кадра
+ *
+ * Отрезок учитывается в момент, когда кадр проходит его конечную точку,
+ * если начальная уже пройдена. Поэтому каждый отрезок попадает
+ * в гистограмму один раз на кадр, сколько бы приемников ни было у графа.
+ */
+class LatencyTracker {
+public:
+    /**
+     * @brief Ставит метку точки и учитывает заканчивающиеся в ней отрезки
+     */
+    void mark(FrameTimeline& timeline, TimelinePoint point, uint64_t nowUs);
+
+    static size_t getSegmentCount();
+    static const char* getSegmentName(size_t index);
+
+    LatencyStats getStats(size_t index) const;
+
+    /**
+     * @brief Сбрасывает все гистограммы
+     */
+    void reset();
+
+private:
+    struct Segment {
+        const char* name;
+        TimelinePoint from;
+        TimelinePoint to;
+    };
+
+    static const Segment kSegments[];
+    static constexpr size_t kSegmentCount = 11;
+
+    LatencyHistogram histograms_[kSegmentCount];
+};
+
+#endif // FRAME_TIMELINE_H
@@ -0,0 +1,99 @@
+#ifndef HOST_MPI_TYPES_H
+#define HOST_MPI_TYPES_H
+
+/**
+ * @file host_mpi_types.h
+ * @brief Подмножество типов Rockchip MPI для сборки на x86 с host бэкендами
+ *
+ * Имена и поля совпадают с SDK, чтобы код конвейера собирался без изменений.
+ * Значения перечислений и раскладка структур с SDK не совместимы: они
+ * используются только внутри процесса вместе с host бэкендами.
+ */
+
+#include <cstdint>
+
+typedef uint8_t RK_U8;
+typedef uint16_t RK_U16;
+typedef uint32_t RK_U32;
+typedef uint64_t RK_U64;
+typedef int32_t RK_S32;
+typedef int64_t RK_S64;
+typedef char RK_CHAR;
+typedef void RK_VOID;
+
+typedef enum {
+    RK_FALSE = 0,
+    RK_TRUE = 1
+} RK_BOOL;
+
+#define RK_SUCCESS 0
+#define RK_FAILURE (-1)
+
+typedef void* MB_BLK;
+typedef RK_U32 MB_POOL;
+
+#define MB_INVALID_POOLID ((MB_POOL)-1)
+
+typedef enum {
+    RK_FMT_YUV420SP = 0,
+    RK_FMT_YUV422_YUYV,
+    RK_FMT_RGB888 = 0x10000,
+    RK_FMT_BGR888
+} PIXEL_FORMAT_E;
+
+typedef enum {
+    COMPRESS_MODE_NONE = 0
+} COMPRESS_MODE_E;
+
+typedef struct {
+    RK_U32 u32Width;
+    RK_U32 u32Height;
+    RK_U32 u32VirWidth;
+    RK_U32 u32VirHeight;
+    PIXEL_FORMAT_E enPixelFormat;
+    COMPRESS_MODE_E enCompressMode;
+    RK_U32 u32FrameFlag;
+    RK_U32 u32TimeRef;
+    RK_U64 u64PTS;
+    MB_BLK pMbBlk;
+} VIDEO_FRAME_S;
+
+typedef struct {
+    VIDEO_FRAME_S stVFrame;
+} VIDEO_FRAME_INFO_S;
+
+typedef enum {
+    RK_VIDEO_ID_Unused = 0,
+    RK_VIDEO_ID_AVC = 8,
+    RK_VIDEO_ID_HEVC = 12
+} RK_CODEC_ID_E;
+
+typedef enum {
+    H264E_NALU_PSLICE = 1,
+    H264E_NALU_ISLICE = 2,
+    H264E_NALU_IDRSLICE = 5,
+    H264E_NALU_SEI = 6,
+    H264E_NALU_SPS = 7,
+    H264E_NALU_PPS = 8
+} H264E_NALU_TYPE_E;
+
+typedef union {
+    H264E_NALU_TYPE_E enH264EType;
+} VENC_DATA_TYPE_U;
+
+typedef struct {
+    MB_BLK pMbBlk;
+    RK_U32 u32Len;
+    RK_U64 u64PTS;
+    RK_BOOL bFrameEnd;
+    RK_U32 u32Offset;
+    VENC_DATA_TYPE_U DataType;
+} VENC_PACK_S;
+
+typedef struct {
+    VENC_PACK_S* pstPack;
+    RK_U32 u32PackCount;
+    RK_U32 u32Seq;
+} VENC_STREAM_S;
+
+#endif // HOST_MPI_TYPES_H
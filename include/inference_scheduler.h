@@ -0,0 +1,120 @@
+#ifndef INFERENCE_SCHEDULER_H
+#define INFERENCE_SCHEDULER_H
+
+#include <atomic>
+#include <cstdint>
+
+/**
+ * @struct SchedulerConfig
+ * @brief Параметры планировщика инференса
+ */
+struct SchedulerConfig {
+    float targetFps = 30.0f;        // Целевая частота видеопотока
+    uint32_t maxStalenessMs = 200;  // Допустимое устаревание детекции на экране
+    uint32_t windowMs = 1000;       // Окно скользящей статистики времени инференса
+    uint32_t minStride = 1;
+    uint32_t maxStride = 30;
+};
+
+/**
+ * @struct SchedulerStats
+ * @brief Состояние планировщика инференса
+ */
+struct SchedulerStats {
+    uint32_t stride;                // Текущий шаг: инференс на каждом stride-м кадре
+    uint64_t p50Us;                 // Медиана времени инференса за окно
+    uint64_t p95Us;                 // 95-й перцентиль времени инференса за окно
+    uint64_t expectedStalenessUs;   // Худшее ожидаемое устаревание при текущем шаге
+    uint64_t runs;                  // Учтено запусков инференса
+    uint64_t strideChanges;         // Сколько раз менялся шаг
+    uint64_t checkedFrames;         // Кадров с проверенным устареванием
+    uint64_t budgetMisses;          // Из них превысили maxStalenessMs
+};
+
+/**
+ * @class InferenceScheduler
+ * @brief Выбирает шаг инференса по измеренному времени работы NPU
+ *
+ * Шаг - наименьший, при котором NPU успевает обработать вход до прихода
+ * следующего (по p95 за окно), но не больше шага, при котором устаревание
+ * детекции укладывается в maxStalenessMs. Окно ограничено по времени,
+ * так что изменение нагрузки на NPU (другие модели, троттлинг) учитывается
+ * не позже чем через windowMs.
+ *
+ * shouldRun() и markRun() вызываются из потока препроцессинга, recordRun() - из потока
+ * инференса, recordStaleness() - из потока оверлея.
+ */
+class InferenceScheduler {
+public:
+    explicit InferenceScheduler(const SchedulerConfig& config = SchedulerConfig());
+
+    /**
+     * @brief Решает, отправлять ли кадр на инференс
+     * @param frameSeq Номер кадра
+     */
+    bool shouldRun(uint32_t frameSeq) const;
+
+    /**
+     * @brief Отмечает кадр, вход которого действительно подготовлен
+     *
+     * Шаг отсчитывается от него: кадр без входа (нет свободного входа,
+     * ошибка подготовки) не сдвигает следующий запуск.
+     */
+    void markRun(uint32_t frameSeq);
+
+    /**
+     * @brief Учитывает время одного запуска и пересчитывает шаг
+     * @param durationUs Время SetInput + Run
+     * @param nowUs Текущее время
+     */
+    void recordRun(uint64_t durationUs, uint64_t nowUs);
+
+    /**
+     * @brief Учитывает устаревание детекции, наложенной на кадр
+     * @param stalenessUs Разница времени захвата кадра и кадра-источника детекции
+     */
+    void recordStaleness(uint64_t stalenessUs);
+
+    /**
+     * @brief Получает текущий шаг
+     */
+    uint32_t getStride() const { return stride_.load(std::memory_order_relaxed); }
+
+    /**
+     * @brief Получает состояние планировщика
+     */
+    SchedulerStats getStats() const;
+
+private:
+    static constexpr int kMaxSamples = 128;
+
+    struct Sample {
+        uint64_t timeUs;
+        uint64_t durationUs;
+    };
+
+    void updateStride(uint64_t p50Us, uint64_t p95Us);
+
+    SchedulerConfig config_;
+    uint64_t frameIntervalUs_;
+
+    // Кольцевой буфер замеров, используется только потоком инференса
+    Sample samples_[kMaxSamples];
+    int head_;
+    int count_;
+
+    // Только поток препроцессинга
+    bool started_;
+    uint32_t lastRunSeq_;
+
+    std::atomic<uint32_t> stride_;
+    std::atomic<uint64_t> p50Us_;
+    std::atomic<uint64_t> p95Us_;
+    std::atomic<uint64_t> expectedStalenessUs_;
+    std::atomic<uint64_t> runs_;
+    std::atomic<uint64_t> strideChanges_;
+    std::atomic<uint64_t> checkedFrames_;
+    std::atomic<uint64_t> budgetMisses_;
+};
+
+#endif // INFERENCE_SCHEDULER_H
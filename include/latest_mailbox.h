@@ -0,0 +1,140 @@
+#ifndef LATEST_MAILBOX_H
+#define LATEST_MAILBOX_H
+
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <utility>
+
+/**
+ * @struct MailboxStats
+ * @brief Счетчики почтового ящика
+ */
+struct MailboxStats {
+    uint64_t posted;        // Всего помещено
+    uint64_t taken;         // Забрано потребителем
+    uint64_t overwritten;   // Вытеснено более новым элементом до обработки
+};
+
+/**
+ * @class LatestMailbox
+ * @brief Почтовый ящик на один элемент: хранит только самый новый
+ *
+ * post() никогда не блокирует производителя: необработанный элемент
+ * вытесняется новым и возвращается вызывающему для переиспользования.
+ * Потребитель всегда получает самые свежие данные.
+ */
+template <typename T>
+class LatestMailbox {
+public:
+    LatestMailbox() : full_(false), closed_(false), posted_(0), taken_(0), overwritten_(0) {}
+
+    LatestMailbox(const LatestMailbox&) = delete;
+    LatestMailbox& operator=(const LatestMailbox&) = delete;
+
+    /**
+     * @brief Помещает элемент, вытесняя необработанный
+     * @param item Новый элемент
+     * @param evicted Сюда перемещается вытесненный элемент (может быть nullptr)
+     * @return True если предыдущий элемент был вытеснен
+     */
+    bool post(T item, T* evicted = nullptr) {
+        bool replaced;
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            if (closed_) {
+                if (evicted) {
+                    *evicted = std::move(item);
+                }
+                return false;
+            }
+
+            replaced = full_;
+            if (replaced) {
+                overwritten_++;
+                if (evicted) {
+                    *evicted = std::move(item_);
+                }
+            }
+            item_ = std::move(item);
+            full_ = true;
+            posted_++;
+        }
+        cond_.notify_one();
+        return replaced;
+    }
+
+    /**
+     * @brief Забирает элемент, ожидая его появления
+     * @param timeoutMs Таймаут в миллисекундах, -1 - без ограничения
+     * @return False если ящик закрыт или истек таймаут
+     */
+    bool take(T& item, int timeoutMs = -1) {
+        std::unique_lock<std::mutex> lock(mutex_);
+        auto ready = [this] { return full_ || closed_; };
+        if (timeoutMs < 0) {
+            cond_.wait(lock, ready);
+        } else if (!cond_.wait_for(lock, std::chrono::milliseconds(timeoutMs), ready)) {
+            return false;
+        }
+        if (!full_) {
+            return false;
+        }
+
+        item = std::move(item_);
+        full_ = false;
+        taken_++;
+        return true;
+    }
+
+    /**
+     * @brief Проверяет, ждет ли элемент обработки
+     */
+    bool hasPending() const {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return full_;
+    }
+
+    /**
+     * @brief Закрывает ящик и будит потребителя
+     */
+    void close() {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            closed_ = true;
+        }
+        cond_.notify_all();
+    }
+
+    /**
+     * @brief Забирает необработанный элемент без ожидания (при остановке)
+     */
+    bool drain(T& item) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (!full_) {
+            return false;
+        }
+        item = std::move(item_);
+        full_ = false;
+        return true;
+    }
+
+    MailboxStats getStats() const {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return MailboxStats{posted_, taken_, overwritten_};
+    }
+
+private:
+    mutable std::mutex mutex_;
+    std::condition_variable cond_;
+    T item_;
+    bool full_;
+    bool closed_;
+
+    uint64_t posted_;
+    uint64_t taken_;
+    uint64_t overwritten_;
+};
+
+#endif // LATEST_MAILBOX_H
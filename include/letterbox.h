@@ -0,0 +1,121 @@
+#ifndef LETTERBOX_H
+#define LETTERBOX_H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+/**
+ * @struct Letterbox
+ * @brief Параметры вписывания кадра во вход модели
+ */
+struct Letterbox {
+    float scale;        // Масштаб кадр -> вход модели
+    int offsetX;        // Отступ слева во входе модели
+    int offsetY;        // Отступ сверху во входе модели
+    int width;          // Размер кадра внутри входа модели
+    int height;
+};
+
+/**
+ * @brief Вписывает кадр в центр входа модели с сохранением пропорций
+ *
+ * Размер и отступы четные: так же кадр размещает VPSS.
+ */
+Letterbox computeLetterbox(int frameWidth, int frameHeight, int modelWidth, int modelHeight);
+
+/**
+ * @brief Раскладка YUV кадра
+ */
+enum class YuvLayout {
+    Nv12,       // Плоскость Y, за ней чередующиеся UV с половинным разрешением
+    Yuyv        // Упакованные Y0 U Y1 V, цвет с половинным разрешением по горизонтали
+};
+
+/**
+ * @struct YuvImage
+ * @brief Кадр YUV в чужом буфере
+ */
+struct YuvImage {
+    YuvLayout layout = YuvLayout::Nv12;
+    const uint8_t* data = nullptr;  // NV12 - плоскость Y, YUYV - кадр
+    const uint8_t* uv = nullptr;    // Только NV12: плоскость UV
+    int width = 0;
+    int height = 0;
+    size_t stride = 0;              // Байт в строке, у UV тот же шаг
+};
+
+/**
+ * @class YuvLetterbox
+ * @brief Перевод NV12/YUYV в RGB с билинейным масштабированием и letterbox за один проход
+ *
+ * Строка входа модели собирается из двух строк источника, уже сжатых
+ * по горизонтали (они кэшируются, соседние строки выхода их переиспользуют),
+ * вертикальная интерполяция и перевод BT.601 в RGB идут векторно:
+ * NEON на ARM, SSE2 на x86. Промежуточных кадров нет, поля letterbox
+ * заливаются тут же. Выход пишется с шагом строки тензора (size_with_stride / H).
+ *
+ * Вызывается из одного потока.
+ */
+class YuvLetterbox {
+public:
+    YuvLetterbox();
+
+    /**
+     * @brief Готовит таблицы выборки под размеры кадра и входа модели
+     * @param pitch Байт в строке выхода, не меньше modelWidth * 3
+     * @param fill Заливка полей
+     * @return 0 при успехе
+     */
+    int configure(YuvLayout layout, int frameWidth, int frameHeight,
+                  int modelWidth, int modelHeight, size_t pitch, uint8_t fill = 114);
+
+    /**
+     * @brief Пишет вход модели RGB888 в dst (modelHeight строк по pitch байт)
+     * @return 0 при успехе, -1 если кадр не совпадает с configure
+     */
+    int convert(const YuvImage& image, uint8_t* dst);
+
+    const Letterbox& getLetterbox() const { return box_; }
+
+private:
+    struct Tap {
+        int offset0;            // Смещение левого/верхнего отсчета
+        int offset1;
+        int weight;             // Вес второго отсчета, Q7
+    };
+
+    struct LumaRow {
+        int index;
+        std::vector<uint8_t> y;
+    };
+
+    struct ChromaRow {
+        int index;
+        std::vector<uint8_t> u;
+        std::vector<uint8_t> v;
+    };
+
+    static void buildTaps(std::vector<Tap>& taps, int count, int frameSize, int subsample, int step);
+    const uint8_t* getLumaRow(const YuvImage& image, int row, int keep);
+    const ChromaRow& getChromaRow(const YuvImage& image, int row, int keep);
+
+    YuvLayout layout_;
+    int frameWidth_;
+    int frameHeight_;
+    int modelWidth_;
+    int modelHeight_;
+    size_t pitch_;
+    uint8_t fill_;
+    Letterbox box_;
+
+    std::vector<Tap> lumaX_;    // По столбцам кадра внутри letterbox
+    std::vector<Tap> chromaX_;
+    std::vector<Tap> lumaY_;    // По строкам кадра внутри letterbox
+    std::vector<Tap> chromaY_;
+
+    LumaRow luma_[2];
+    ChromaRow chroma_[2];
+};
+
+#endif // LETTERBOX_H
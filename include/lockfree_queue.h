@@ -0,0 +1,541 @@
+#ifndef LOCKFREE_QUEUE_H
+#define LOCKFREE_QUEUE_H
+
+#include <atomic>
+#include <cerrno>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <utility>
+
+#include <poll.h>
+#include <sys/eventfd.h>
+#include <unistd.h>
+
+/**
+ * Lock-free очереди для передачи данных между стадиями конвейера.
+ *
+ * SpscQueue - один производитель, один потребитель (линейный конвейер).
+ * MpscQueue - несколько производителей, один потребитель (сведение потоков
+ * нескольких камер в одну стадию).
+ *
+ * Обе очереди ограничены, емкость округляется вверх до степени двойки.
+ * Тип T должен быть default-constructible и перемещаемым.
+ */
+
+#ifndef CACHE_LINE_SIZE
+#define CACHE_LINE_SIZE 64
+#endif
+
+/**
+ * @struct QueueStats
+ * @brief Снимок состояния очереди между стадиями конвейера
+ */
+struct QueueStats {
+    size_t depth;           // Текущее количество элементов
+    size_t capacity;        // Максимальная глубина
+    uint64_t pushed;        // Всего помещено элементов
+    uint64_t pushStalls;    // Сколько раз производитель ждал свободного места
+    uint64_t popStalls;     // Сколько раз потребитель ждал данных
+};
+
+/**
+ * @class EventNotifier
+ * @brief Пробуждение ожидающей стороны очереди через eventfd
+ *
+ * Системный вызов делается только если ожидающая сторона взвела
+ * уведомление через arm(), поэтому в установившемся режиме передача
+ * элемента обходится без обращений к ядру. Дескриптор можно добавить
+ * в epoll.
+ */
+class EventNotifier {
+public:
+    EventNotifier() : fd_(eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK)), armed_(false) {}
+    ~EventNotifier() {
+        if (fd_ >= 0) {
+            ::close(fd_);
+        }
+    }
+
+    EventNotifier(const EventNotifier&) = delete;
+    EventNotifier& operator=(const EventNotifier&) = delete;
+
+    int fd() const { return fd_; }
+
+    /**
+     * @brief Взводит уведомление. После вызова ожидающая сторона обязана
+     * еще раз проверить состояние очереди перед сном
+     */
+    void arm() {
+        armed_.store(true, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+    }
+
+    void disarm() { armed_.store(false, std::memory_order_relaxed); }
+
+    /**
+     * @brief Будит ожидающую сторону, если она взвела уведомление
+     */
+    void notifyIfArmed() {
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if (armed_.load(std::memory_order_relaxed) &&
+            armed_.exchange(false, std::memory_order_relaxed)) {
+            notify();
+        }
+    }
+
+    void notify() {
+        uint64_t one = 1;
+        ssize_t ret = ::write(fd_, &one, sizeof(one));
+        (void)ret;
+    }
+
+    /**
+     * @brief Ждет уведомления
+     * @param timeoutMs Таймаут в миллисекундах, -1 - без ограничения
+     * @return False по таймауту
+     */
+    bool wait(int timeoutMs) {
+        struct pollfd pfd = {fd_, POLLIN, 0};
+        int ret = ::poll(&pfd, 1, timeoutMs);
+        if (ret < 0) {
+            return errno == EINTR;
+        }
+        if (ret == 0) {
+            return false;
+        }
+
+        drain();
+        return true;
+    }
+
+    void drain() {
+        uint64_t value;
+        ssize_t ret = ::read(fd_, &value, sizeof(value));
+        (void)ret;
+    }
+
+private:
+    int fd_;
+    std::atomic<bool> armed_;
+};
+
+namespace lockfree_detail {
+
+inline size_t roundUpPow2(size_t value) {
+    size_t result = 1;
+    while (result < value) {
+        result <<= 1;
+    }
+    return result;
+}
+
+} // namespace lockfree_detail
+
+/**
+ * @class SpscQueue
+ * @brief Ограниченная lock-free очередь: один производитель, один потребитель
+ *
+ * Индексы производителя и потребителя лежат в разных кэш-линиях, каждая
+ * сторона кэширует индекс другой и перечитывает его только когда очередь
+ * выглядит полной (пустой).
+ */
+template <typename T>
+class SpscQueue {
+public:
+    explicit SpscQueue(size_t capacity)
+        : capacity_(lockfree_detail::roundUpPow2(capacity ? capacity : 1)),
+          mask_(capacity_ - 1), buffer_(new T[capacity_]),
+          closed_(false), head_(0), cachedTail_(0), popStalls_(0),
+          tail_(0), cachedHead_(0), pushed_(0), pushStalls_(0) {
+    }
+
+    SpscQueue(const SpscQueue&) = delete;
+    SpscQueue& operator=(const SpscQueue&) = delete;
+
+    /**
+     * @brief Помещает элемент без ожидания (только поток производителя)
+     * @return False если очередь заполнена или закрыта; элемент не перемещается
+     */
+    bool tryPush(T&& item) { return emplace(std::move(item)); }
+    bool tryPush(const T& item) { return emplace(item); }
+
+    /**
+     * @brief Помещает элемент, ожидая свободного места
+     * @return False если очередь закрыта
+     */
+    bool push(T&& item) { return pushWait(std::move(item)); }
+    bool push(const T& item) { return pushWait(item); }
+
+    /**
+     * @brief Извлекает элемент без ожидания (только поток потребителя)
+     * @return False если очередь пуста
+     */
+    bool tryPop(T& item) {
+        size_t head = head_.load(std::memory_order_relaxed);
+        if (head == cachedTail_) {
+            cachedTail_ = tail_.load(std::memory_order_acquire);
+            if (head == cachedTail_) {
+                return false;
+            }
+        }
+
+        item = std::move(buffer_[head & mask_]);
+        head_.store(head + 1, std::memory_order_release);
+        notFull_.notifyIfArmed();
+        return true;
+    }
+
+    /**
+     * @brief Извлекает элемент, ожидая его появления
+     * @param timeoutMs Таймаут в миллисекундах, -1 - без ограничения
+     * @return False если очередь закрыта и пуста или истек таймаут
+     */
+    bool pop(T& item, int timeoutMs = -1) {
+        bool stalled = false;
+        while (true) {
+            if (tryPop(item)) {
+                return true;
+            }
+            if (closed_.load(std::memory_order_acquire)) {
+                return tryPop(item);
+            }
+
+            notEmpty_.arm();
+            if (tryPop(item)) {
+                notEmpty_.disarm();
+                return true;
+            }
+            if (closed_.load(std::memory_order_acquire)) {
+                notEmpty_.disarm();
+                return tryPop(item);
+            }
+
+            if (!stalled) {
+                popStalls_.store(popStalls_.load(std::memory_order_relaxed) + 1,
+                                 std::memory_order_relaxed);
+                stalled = true;
+            }
+            if (!notEmpty_.wait(timeoutMs)) {
+                notEmpty_.disarm();
+                return tryPop(item);
+            }
+        }
+    }
+
+    /**
+     * @brief Взводит уведомление через eventFd() для ожидания в epoll
+     * @return False если в очереди уже есть данные (ждать не нужно)
+     */
+    bool armWakeup() {
+        notEmpty_.arm();
+        if (!empty() || closed_.load(std::memory_order_acquire)) {
+            notEmpty_.disarm();
+            return false;
+        }
+        return true;
+    }
+
+    /**
+     * @brief Сбрасывает сработавшее уведомление после пробуждения из epoll
+     */
+    void drainWakeup() { notEmpty_.drain(); }
+
+    /**
+     * @brief Дескриптор eventfd, становится читаемым при появлении данных
+     */
+    int eventFd() const { return notEmpty_.fd(); }
+
+    /**
+     * @brief Закрывает очередь и будит ожидающие стороны
+     */
+    void close() {
+        closed_.store(true, std::memory_order_release);
+        notEmpty_.notify();
+        notFull_.notify();
+    }
+
+    bool isClosed() const { return closed_.load(std::memory_order_acquire); }
+
+    size_t size() const {
+        size_t tail = tail_.load(std::memory_order_acquire);
+        size_t head = head_.load(std::memory_order_acquire);
+        return tail - head;
+    }
+
+    bool empty() const { return size() == 0; }
+
+    size_t capacity() const { return capacity_; }
+
+    QueueStats getStats() const {
+        return QueueStats{size(), capacity_,
+                          pushed_.load(std::memory_order_relaxed),
+                          pushStalls_.load(std::memory_order_relaxed),
+                          popStalls_.load(std::memory_order_relaxed)};
+    }
+
+private:
+    template <typename U>
+    bool emplace(U&& item) {
+        if (closed_.load(std::memory_order_relaxed)) {
+            return false;
+        }
+
+        size_t tail = tail_.load(std::memory_order_relaxed);
+        if (tail - cachedHead_ >= capacity_) {
+            cachedHead_ = head_.load(std::memory_order_acquire);
+            if (tail - cachedHead_ >= capacity_) {
+                return false;
+            }
+        }
+
+        buffer_[tail & mask_] = std::forward<U>(item);
+        tail_.store(tail + 1, std::memory_order_release);
+        pushed_.store(pushed_.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+        notEmpty_.notifyIfArmed();
+        return true;
+    }
+
+    template <typename U>
+    bool pushWait(U&& item) {
+        bool stalled = false;
+        while (true) {
+            if (emplace(std::forward<U>(item))) {
+                return true;
+            }
+            if (closed_.load(std::memory_order_acquire)) {
+                return false;
+            }
+
+            notFull_.arm();
+            if (emplace(std::forward<U>(item))) {
+                notFull_.disarm();
+                return true;
+            }
+            if (closed_.load(std::memory_order_acquire)) {
+                notFull_.disarm();
+                return false;
+            }
+
+            if (!stalled) {
+                pushStalls_.store(pushStalls_.load(std::memory_order_relaxed) + 1,
+                                  std::memory_order_relaxed);
+                stalled = true;
+            }
+            notFull_.wait(-1);
+        }
+    }
+
+    const size_t capacity_;
+    const size_t mask_;
+    std::unique_ptr<T[]> buffer_;
+    std::atomic<bool> closed_;
+
+    EventNotifier notEmpty_;
+    EventNotifier notFull_;
+
+    // Сторона потребителя
+    alignas(CACHE_LINE_SIZE) std::atomic<size_t> head_;
+    size_t cachedTail_;
+    std::atomic<uint64_t> popStalls_;
+
+    // Сторона производителя
+    alignas(CACHE_LINE_SIZE) std::atomic<size_t> tail_;
+    size_t cachedHead_;
+    std::atomic<uint64_t> pushed_;
+    std::atomic<uint64_t> pushStalls_;
+};
+
+/**
+ * @class MpscQueue
+ * @brief Ограниченная lock-free очередь: несколько производителей, один потребитель
+ *
+ * Кольцо ячеек с порядковыми номерами (схема Д. Вьюкова). Производители
+ * резервируют ячейку через CAS на хвосте, потребитель читает без атомарных
+ * RMW операций. Запись только неблокирующая: источник реального времени
+ * при переполнении должен отбросить кадр, а не ждать.
+ */
+template <typename T>
+class MpscQueue {
+public:
+    explicit MpscQueue(size_t capacity)
+        : capacity_(lockfree_detail::roundUpPow2(capacity ? capacity : 1)),
+          mask_(capacity_ - 1), cells_(new Cell[capacity_]),
+          closed_(false), head_(0), popStalls_(0),
+          tail_(0), pushed_(0), pushFailures_(0) {
+        for (size_t i = 0; i < capacity_; i++) {
+            cells_[i].sequence.store(i, std::memory_order_relaxed);
+        }
+    }
+
+    MpscQueue(const MpscQueue&) = delete;
+    MpscQueue& operator=(const MpscQueue&) = delete;
+
+    /**
+     * @brief Помещает элемент без ожидания (из любого потока)
+     * @return False если очередь заполнена или закрыта; элемент не перемещается
+     */
+    bool tryPush(T&& item) { return emplace(std::move(item)); }
+    bool tryPush(const T& item) { return emplace(item); }
+
+    /**
+     * @brief Извлекает элемент без ожидания (только поток потребителя)
+     * @return False если очередь пуста
+     */
+    bool tryPop(T& item) {
+        size_t head = head_.load(std::memory_order_relaxed);
+        Cell& cell = cells_[head & mask_];
+        size_t sequence = cell.sequence.load(std::memory_order_acquire);
+        if ((intptr_t)sequence - (intptr_t)(head + 1) < 0) {
+            return false;
+        }
+
+        item = std::move(cell.value);
+        cell.sequence.store(head + capacity_, std::memory_order_release);
+        head_.store(head + 1, std::memory_order_relaxed);
+        return true;
+    }
+
+    /**
+     * @brief Извлекает элемент, ожидая его появления
+     * @param timeoutMs Таймаут в миллисекундах, -1 - без ограничения
+     * @return False если очередь закрыта и пуста или истек таймаут
+     */
+    bool pop(T& item, int timeoutMs = -1) {
+        bool stalled = false;
+        while (true) {
+            if (tryPop(item)) {
+                return true;
+            }
+            if (closed_.load(std::memory_order_acquire)) {
+                return tryPop(item);
+            }
+
+            notEmpty_.arm();
+            if (tryPop(item)) {
+                notEmpty_.disarm();
+                return true;
+            }
+            if (closed_.load(std::memory_order_acquire)) {
+                notEmpty_.disarm();
+                return tryPop(item);
+            }
+
+            if (!stalled) {
+                popStalls_.store(popStalls_.load(std::memory_order_relaxed) + 1,
+                                 std::memory_order_relaxed);
+                stalled = true;
+            }
+            if (!notEmpty_.wait(timeoutMs)) {
+                notEmpty_.disarm();
+                return tryPop(item);
+            }
+        }
+    }
+
+    /**
+     * @brief Взводит уведомление через eventFd() для ожидания в epoll
+     * @return False если в очереди уже есть данные (ждать не нужно)
+     */
+    bool armWakeup() {
+        notEmpty_.arm();
+        if (!empty() || closed_.load(std::memory_order_acquire)) {
+            notEmpty_.disarm();
+            return false;
+        }
+        return true;
+    }
+
+    void drainWakeup() { notEmpty_.drain(); }
+
+    int eventFd() const { return notEmpty_.fd(); }
+
+    void close() {
+        closed_.store(true, std::memory_order_release);
+        notEmpty_.notify();
+    }
+
+    bool isClosed() const { return closed_.load(std::memory_order_acquire); }
+
+    /**
+     * @brief Оценка глубины (точна только в отсутствие конкурентных записей)
+     */
+    size_t size() const {
+        size_t tail = tail_.load(std::memory_order_acquire);
+        size_t head = head_.load(std::memory_order_acquire);
+        return tail > head ? tail - head : 0;
+    }
+
+    bool empty() const {
+        size_t head = head_.load(std::memory_order_relaxed);
+        const Cell& cell = cells_[head & mask_];
+        return (intptr_t)cell.sequence.load(std::memory_order_acquire) - (intptr_t)(head + 1) < 0;
+    }
+
+    size_t capacity() const { return capacity_; }
+
+    /**
+     * @brief Статистика; pushStalls - число отказов записи при переполнении
+     */
+    QueueStats getStats() const {
+        return QueueStats{size(), capacity_,
+                          pushed_.load(std::memory_order_relaxed),
+                          pushFailures_.load(std::memory_order_relaxed),
+                          popStalls_.load(std::memory_order_relaxed)};
+    }
+
+private:
+    struct Cell {
+        std::atomic<size_t> sequence;
+        T value;
+    };
+
+    template <typename U>
+    bool emplace(U&& item) {
+        if (closed_.load(std::memory_order_relaxed)) {
+            return false;
+        }
+
+        size_t tail = tail_.load(std::memory_order_relaxed);
+        Cell *cell;
+        while (true) {
+            cell = &cells_[tail & mask_];
+            size_t sequence = cell->sequence.load(std::memory_order_acquire);
+            intptr_t diff = (intptr_t)sequence - (intptr_t)tail;
+            if (diff == 0) {
+                if (tail_.compare_exchange_weak(tail, tail + 1, std::memory_order_relaxed)) {
+                    break;
+                }
+            } else if (diff < 0) {
+                pushFailures_.fetch_add(1, std::memory_order_relaxed);
+                return false;
+            } else {
+                tail = tail_.load(std::memory_order_relaxed);
+            }
+        }
+
+        cell->value = std::forward<U>(item);
+        cell->sequence.store(tail + 1, std::memory_order_release);
+        pushed_.fetch_add(1, std::memory_order_relaxed);
+        notEmpty_.notifyIfArmed();
+        return true;
+    }
+
+    const size_t capacity_;
+    const size_t mask_;
+    std::unique_ptr<Cell[]> cells_;
+    std::atomic<bool> closed_;
+
+    EventNotifier notEmpty_;
+
+    // Сторона потребителя
+    alignas(CACHE_LINE_SIZE) std::atomic<size_t> head_;
+    std::atomic<uint64_t> popStalls_;
+
+    // Сторона производителей
+    alignas(CACHE_LINE_SIZE) std::atomic<size_t> tail_;
+    std::atomic<uint64_t> pushed_;
+    std::atomic<uint64_t> pushFailures_;
+};
+
+#endif // LOCKFREE_QUEUE_H
@@ -1,16 +1,189 @@
 #ifndef MEMORY_POOL_H
 #define MEMORY_POOL_H
 
+#include <atomic>
 #include <cstdint>
-#include "sample_comm.h"
+#include <memory>
+#include <string>
+#include "backend.h"
+#include "mpi_types.h"
+
+class MemoryPool;
+
+/**
+ * @brief Кто держит блок: метка ставится при выдаче и при передаче кадра
+ */
+enum class PoolOwner : uint8_t {
+    None,           // Блок свободен
+    Capture,
+    Npu,
+    Encoder,
+    Recorder,
+    Count
+};
+
+const char* getPoolOwnerName(PoolOwner owner);
+
+/**
+ * @struct MemoryPoolStats
+ * @brief Снимок занятости пула
+ */
+struct MemoryPoolStats {
+    uint32_t capacity;      // Блоков в пуле
+    uint32_t free;          // Свободно сейчас
+    uint32_t peak;          // Наибольшее число занятых блоков
+    uint64_t acquired;      // Всего выдано блоков
+    uint64_t exhausted;     // Запросов, получивших отказ: все блоки заняты
+    uint64_t waits;         // Запросов, ждавших свободного блока
+    uint64_t waitUsSum;
+    uint64_t waitUsMax;
+    uint32_t owners[(size_t)PoolOwner::Count];  // Занятые блоки по меткам
+    uint64_t oldestAgeUs;   // Сколько держится самый старый занятый блок
+    uint64_t flushedBytes;  // Сброшено из кэша CPU перед чтением железом
+    uint64_t invalidatedBytes;
+    uint64_t cacheSyncs;    // Операций с кэшем, по одной на участок
+};
+
+/**
+ * @class DirtyRanges
+ * @brief Участки буфера, записанные CPU, по возрастанию
+ *
+ * Участки выравниваются на строки кэша; соседние и пересекающиеся
+ * сливаются, сверх предела сливаются два ближайших. Отметки ведет тот,
+ * кто сейчас пишет в буфер, из одного потока.
+ */
+class DirtyRanges {
+public:
+    static constexpr uint32_t kMaxRanges = 16;
+
+    struct Range {
+        uint64_t begin;
+        uint64_t end;
+    };
+
+    DirtyRanges() : count_(0) {}
+
+    /**
+     * @param limit Размер буфера, участок обрезается по нему
+     */
+    void add(uint64_t offset, uint64_t size, uint64_t limit);
+    void clear() { count_ = 0; }
+
+    uint32_t count() const { return count_; }
+    const Range& operator[](uint32_t index) const { return ranges_[index]; }
+
+private:
+    Range ranges_[kMaxRanges];
+    uint32_t count_;
+};
+
+/**
+ * @class MemoryBlock
+ * @brief Блок пула во владении, возвращается в пул деструктором
+ *
+ * Только перемещается: у блока всегда один владелец, забытый блок
+ * вернется в пул вместе с ним. Блок держит ссылку на пул, поэтому пул
+ * не исчезнет раньше блока.
+ */
+class MemoryBlock {
+public:
+    MemoryBlock() : index_(0) {}
+    ~MemoryBlock() { reset(); }
+
+    MemoryBlock(MemoryBlock&& other) noexcept : pool_(std::move(other.pool_)), index_(other.index_) {}
+    MemoryBlock& operator=(MemoryBlock&& other) noexcept;
+    MemoryBlock(const MemoryBlock&) = delete;
+    MemoryBlock& operator=(const MemoryBlock&) = delete;
+
+    explicit operator bool() const { return pool_ != nullptr; }
+
+    /**
+     * @brief Возвращает блок в пул
+     */
+    void reset();
+
+    /**
+     * @brief Блок MPI для VENC и RKNN
+     */
+    MB_BLK get() const;
+
+    /**
+     * @brief Виртуальный адрес, получен при создании пула
+     */
+    void* data() const;
+
+    /**
+     * @brief DMABUF дескриптор блока, -1 если бэкенд его не дает
+     */
+    int fd() const;
+
+    uint64_t size() const;
+    uint32_t index() const { return index_; }
+
+    /**
+     * @brief Переставляет метку владельца для отчетов пула
+     */
+    void setOwner(PoolOwner owner) const;
+
+    /**
+     * @brief Начало чтения CPU данных, записанных железом
+     *
+     * Кэш участка становится недействительным, CPU читает память, а не
+     * строки, оставшиеся от прошлого оборота блока.
+     * @param size 0 - до конца блока
+     * @return 0 при успехе
+     */
+    int beginCpuAccess(uint64_t offset = 0, uint64_t size = 0) const;
+
+    /**
+     * @brief Отмечает участок, записанный CPU
+     *
+     * Соседние и пересекающиеся участки сливаются; отметки ведет тот,
+     * кто сейчас пишет в блок, из одного потока.
+     */
+    void markDirty(uint64_t offset, uint64_t size) const;
+
+    /**
+     * @brief Конец записи CPU: сбрасывает отмеченные участки
+     *
+     * Вызывается до передачи блока железу (VENC, RGA, NPU).
+     * @return 0 при успехе
+     */
+    int endCpuAccess() const;
+
+private:
+    friend class MemoryPool;
+
+    MemoryBlock(std::shared_ptr<MemoryPool> pool, uint32_t index) : pool_(std::move(pool)), index_(index) {}
+
+    std::shared_ptr<MemoryPool> pool_;
+    uint32_t index_;
+};
 
 /**
  * @class MemoryPool
  * @brief Управляет пулом памяти для видео буферов
+ *
+ * Все блоки берутся из MB пула при инициализации, их адреса и дескрипторы
+ * запоминаются. Свободные блоки лежат в lock-free стеке (стек Трейбера по
+ * индексам со счетчиком версий против ABA), поэтому выдача и возврат блока
+ * не обращаются к MPI и не берут мьютекс.
+ *
+ * У каждого занятого блока хранится метка владельца и время выдачи: по ним
+ * строится отчет о том, кто и как долго держит блоки, а пиковая занятость,
+ * отказы и ожидание показывают, хватает ли пулу блоков.
+ *
+ * Блоки кэшируемые. Записи CPU отмечаются участками и сбрасываются перед
+ * передачей блока железу только по отмеченным строкам кэша; весь блок
+ * сбрасывается, лишь если ядро не умеет частичную синхронизацию.
+ *
+ * Пул создается через std::make_shared: выданные блоки держат ссылку на
+ * него, и если при уничтожении владельца блоки еще в обороте, пул и блоки
+ * MPI освобождаются, когда вернется последний из них.
  */
-class MemoryPool {
+class MemoryPool : public std::enable_shared_from_this<MemoryPool> {
 public:
-    MemoryPool(uint64_t bufferSize, uint32_t bufferCount);
+    MemoryPool(uint64_t bufferSize, uint32_t bufferCount, const std::string& name = "pool");
     ~MemoryPool();
 
     /**
@@ -20,45 +193,82 @@ public:
     int init();
 
     /**
-     * @brief Получает блок памяти из пула
-     * @param cached True для использования кэша
-     * @return Блок памяти (MB_BLK)
+     * @brief Берет свободный блок
+     * @param owner Метка владельца
+     * @param timeoutUs Сколько ждать освобождения блока, 0 - не ждать
+     * @return Пустой блок если все блоки заняты, отказ учитывается в статистике
      */
-    MB_BLK getMemoryBlock(bool cached = true) const;
+    MemoryBlock acquire(PoolOwner owner = PoolOwner::Capture, uint64_t timeoutUs = 0);
 
     /**
-     * @brief Получает виртуальный адрес блока памяти
-     * @param block Блок памяти
-     * @return Виртуальный адрес
+     * @brief Уничтожает пул памяти
+     *
+     * Печатает итоговый отчет. Пока есть выданные блоки, пул не уничтожается:
+     * это сделает деструктор после возврата последнего блока.
      */
-    void* getVirtualAddress(MB_BLK block) const;
+    void destroy();
 
-    /**
-     * @brief Освобождает блок памяти
-     * @param block Блок памяти
-     */
-    void releaseMemoryBlock(MB_BLK block);
+    MemoryPoolStats getStats() const;
 
     /**
-     * @brief Уничтожает пул памяти
+     * @brief Печатает занятость пула и занятые блоки
+     * @param minAgeUs Перечислять только блоки, которые держатся дольше
      */
-    void destroy();
+    void printReport(uint64_t minAgeUs = 0) const;
+
+    const std::string& getName() const { return name_; }
 
     /**
      * @brief Получает ID пула
      */
     MB_POOL getPoolId() const { return poolId_; }
 
+    uint64_t getBufferSize() const { return bufferSize_; }
+
     /**
      * @brief Проверяет инициализацию
      */
     bool isInitialized() const { return initialized_; }
 
 private:
+    friend class MemoryBlock;
+
+    static constexpr uint32_t kNoBlock = UINT32_MAX;
+
+    struct Block {
+        MB_BLK handle;
+        void* data;
+        int fd;
+        std::atomic<uint32_t> next;     // Следующий свободный блок
+        std::atomic<uint8_t> owner;     // PoolOwner
+        std::atomic<uint64_t> acquiredUs;
+        DirtyRanges dirty;              // Участки, записанные CPU
+    };
+
+    MemoryBlock tryAcquire(PoolOwner owner);
+    int syncCache(uint32_t index, uint64_t offset, uint64_t size, bool toDevice);
+    void release(uint32_t index);
+    void releaseBlocks(uint32_t count);
+
+    std::string name_;
+    std::unique_ptr<MemoryBackend> backend_;
     MB_POOL poolId_;
     uint64_t bufferSize_;
     uint32_t bufferCount_;
     bool initialized_;
+
+    std::unique_ptr<Block[]> blocks_;
+    std::atomic<uint64_t> head_;        // Версия в старших 32 битах, индекс вершины в младших
+    std::atomic<uint32_t> inUse_;
+    std::atomic<uint32_t> peak_;
+    std::atomic<uint64_t> acquired_;
+    std::atomic<uint64_t> exhausted_;
+    std::atomic<uint64_t> waits_;
+    std::atomic<uint64_t> waitUsSum_;
+    std::atomic<uint64_t> waitUsMax_;
+    std::atomic<uint64_t> flushedBytes_;
+    std::atomic<uint64_t> invalidatedBytes_;
+    std::atomic<uint64_t> cacheSyncs_;
 };
 
 #endif // MEMORY_POOL_H
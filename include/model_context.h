@@ -0,0 +1,252 @@
+#ifndef MODEL_CONTEXT_H
+#define MODEL_CONTEXT_H
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "detection.h"
+#include "inference_scheduler.h"
+#include "lockfree_queue.h"
+#include "npu_recording.h"
+#include "npu_scheduler.h"
+#include "pipeline_config.h"
+#include "rknn_interface.h"
+#include "tiling.h"
+#include "yolo_decoder.h"
+
+class FrameRef;
+
+/**
+ * @struct DetectionResult
+ * @brief Результат инференса, привязанный к кадру-источнику
+ */
+struct DetectionResult {
+    uint32_t frameSeq;          // Номер кадра, на котором выполнен инференс
+    uint64_t captureTimeUs;     // Время захвата этого кадра
+    uint64_t inferenceStartUs;
+    uint64_t completeTimeUs;
+    std::vector<Detection> detections;
+    std::vector<Track> tracks;
+    bool hasGroundTruth;        // Источник знает истинные рамки кадра
+    std::vector<Detection> groundTruth;
+};
+
+class ModelContext;
+
+/**
+ * @struct ModelTile
+ * @brief Плитка кадра во входе модели и ее детекции
+ */
+struct ModelTile {
+    uint32_t index;             // Номер в раскладке computeTiles
+    TileRegion region;          // Область кадра
+    InputTensorView tensor;     // Область, вписанная во вход модели
+    Letterbox letterbox;
+    uint64_t npuUs;             // Время Run() и декодирования плитки
+    std::vector<Detection> detections;  // В координатах кадра
+};
+
+/**
+ * @struct ModelInput
+ * @brief Подготовленный вход модели и результат, заполняемый веткой детекции
+ *
+ * Принадлежит ветке детекции: видеотракт не читает и не пишет его,
+ * поэтому кадр может одновременно обрабатываться обеими ветками.
+ * Пиксели лежат сразу в памяти NPU: InferStage только привязывает ее к входу.
+ * Если вход готов в буфере VPSS подходящей раскладки, NPU читает его оттуда
+ * (sourceFrame), tensor не заполняется. С плитками вход модели готовится
+ * для каждой плитки, tensor не используется.
+ */
+struct ModelInput {
+    ModelContext* model;        // Модель, для которой подготовлен вход
+    InputTensorView tensor;     // RGB letterbox в нативной раскладке входа
+    Letterbox letterbox;
+    int frameWidth;
+    int frameHeight;
+    DetectionResult result;
+    std::vector<ModelTile> tiles;   // Входы плиток, tiling.getTilesPerFrame() штук
+    uint32_t tileCount;             // Плиток подготовлено для кадра, 0 - вход без плиток
+    NpuGrant npuGrant;          // Очередь на контексте RKNN от InferStage до конца декодирования
+    std::shared_ptr<FrameRef> sourceFrame;  // Буфер VPSS, импортируемый как вход; держится до Run
+};
+
+/**
+ * @struct DetectionStats
+ * @brief Задержка и устаревание результатов детекции
+ */
+struct DetectionStats {
+    uint64_t results;           // Опубликовано результатов
+    uint64_t latencyUsSum;      // Сумма (готовность результата - захват кадра)
+    uint64_t latencyUsMax;
+    uint64_t overlaidFrames;    // Кадров с наложенным результатом
+    uint64_t staleFramesSum;    // Сумма отставания результата в кадрах
+    uint64_t staleFramesMax;
+    uint64_t staleUsSum;        // Сумма отставания результата по времени захвата
+    uint64_t gtFrames;          // Результатов, сверенных с истинными рамками
+    uint64_t truePositives;     // Детекций с IoU >= 0.5 к еще не сопоставленной рамке
+    uint64_t falsePositives;
+    uint64_t falseNegatives;    // Рамок без детекции
+    uint64_t motionSkips;       // Кадров без инференса из-за неподвижной сцены
+};
+
+/**
+ * @struct TileStats
+ * @brief Цена и отдача одной плитки
+ */
+struct TileStats {
+    uint64_t runs;
+    uint64_t npuUsSum;          // Run() и декодирование
+    uint64_t npuUsMax;
+    uint64_t detections;        // Детекций плитки до сведения через швы
+};
+
+/**
+ * @class ModelContext
+ * @brief Модель детекции и состояние, общее для стадий ее ветки
+ *
+ * Хранит декодер, планировщик шага инференса, пул входов модели
+ * и последний опубликованный результат, который читает оверлей.
+ * Модель обслуживает один видеопоток; контекст RKNN может быть общим
+ * с моделями других потоков, очередь на нем выдает NpuScheduler.
+ */
+class ModelContext {
+public:
+    /**
+     * @param npu Планировщик контекста inference
+     * @param npuClient Номер модели в планировщике
+     */
+    ModelContext(const ModelSpec& spec, RKNNInference& inference, NpuScheduler& npu, int npuClient);
+    ~ModelContext();
+
+    ModelContext(const ModelContext&) = delete;
+    ModelContext& operator=(const ModelContext&) = delete;
+
+    /**
+     * @brief Загружает якоря и метки, выделяет входы модели в памяти NPU
+     * @return 0 при успехе, < 0 при ошибке
+     */
+    int init();
+
+    /**
+     * @brief Берет свободный вход модели
+     *
+     * Вход возвращается в пул, когда отпущена последняя ссылка.
+     * Вызывается только из потока препроцессинга.
+     *
+     * @return nullptr если все входы заняты
+     */
+    std::shared_ptr<ModelInput> acquireInput();
+
+    /**
+     * @brief Дописывает выходы последнего запуска в файл record_outputs
+     *
+     * Вызывается из потока инференса сразу после Run().
+     */
+    void recordOutputs();
+
+    /**
+     * @brief Публикует результат для оверлея
+     *
+     * Если у кадра есть истинные рамки, детекции сверяются с ними
+     * без учета класса: так одна модель проверяется на синтетике.
+     */
+    void publish(std::shared_ptr<const DetectionResult> result);
+
+    /**
+     * @brief Получает последний опубликованный результат
+     */
+    std::shared_ptr<const DetectionResult> getLatestResult() const;
+
+    /**
+     * @brief Учитывает устаревание результата, наложенного на кадр
+     */
+    void recordOverlay(uint64_t staleFrames, uint64_t staleUs);
+
+    /**
+     * @brief Учитывает кадр, пропущенный гейтом движения
+     */
+    void recordMotionSkip() { motionSkips_.fetch_add(1, std::memory_order_relaxed); }
+
+    /**
+     * @brief Учитывает запуск плитки, вызывается из потока инференса
+     */
+    void recordTile(const ModelTile& tile);
+
+    /**
+     * @brief Получает статистику плитки с номером index < tiling.getTileCount()
+     */
+    TileStats getTileStats(uint32_t index) const;
+
+    const TilingConfig& getTiling() const { return spec_.tiling; }
+
+    DetectionStats getDetectionStats() const;
+
+    /**
+     * @brief Ждет очереди на контексте RKNN
+     * @return Пустая очередь если модель опережает infer_fps своего потока
+     */
+    NpuGrant acquireNpu() { return npu_.acquire(npuClient_); }
+
+    /**
+     * @brief Можно ли готовить вход: модель не опережает infer_fps
+     */
+    bool isNpuDue(uint64_t nowUs) const { return npu_.isDue(npuClient_, nowUs); }
+
+    NpuClientStats getNpuStats() const { return npu_.getStats(npuClient_); }
+    const NpuScheduler& getNpuScheduler() const { return npu_; }
+
+    const std::string& getName() const { return spec_.name; }
+    const std::string& getStreamName() const { return spec_.stream; }
+    RKNNInference& getInference() { return inference_; }
+    const RKNNInference& getInference() const { return inference_; }
+    const YoloDecoder& getDecoder() const { return decoder_; }
+    InferenceScheduler& getScheduler() { return scheduler_; }
+    const InferenceScheduler& getScheduler() const { return scheduler_; }
+
+private:
+    // Заполняется, ждет в ящике, обрабатывается NPU
+    static const uint32_t kInputCount = 3;
+
+    struct TileCounters {
+        std::atomic<uint64_t> runs{0};
+        std::atomic<uint64_t> npuUsSum{0};
+        std::atomic<uint64_t> npuUsMax{0};
+        std::atomic<uint64_t> detections{0};
+    };
+
+    void matchGroundTruth(const DetectionResult& result);
+
+    ModelSpec spec_;
+    RKNNInference& inference_;
+    NpuScheduler& npu_;
+    int npuClient_;
+    YoloDecoder decoder_;
+    InferenceScheduler scheduler_;
+    NpuRecordingWriter recorder_;
+
+    std::vector<std::unique_ptr<ModelInput>> inputs_;
+    MpscQueue<ModelInput*> freeInputs_;
+    std::unique_ptr<TileCounters[]> tileCounters_;
+
+    mutable std::mutex resultMutex_;
+    std::shared_ptr<const DetectionResult> latestResult_;
+
+    std::atomic<uint64_t> results_;
+    std::atomic<uint64_t> latencyUsSum_;
+    std::atomic<uint64_t> latencyUsMax_;
+    std::atomic<uint64_t> overlaidFrames_;
+    std::atomic<uint64_t> staleFramesSum_;
+    std::atomic<uint64_t> staleFramesMax_;
+    std::atomic<uint64_t> staleUsSum_;
+    std::atomic<uint64_t> gtFrames_;
+    std::atomic<uint64_t> truePositives_;
+    std::atomic<uint64_t> falsePositives_;
+    std::atomic<uint64_t> falseNegatives_;
+    std::atomic<uint64_t> motionSkips_;
+};
+
+#endif // MODEL_CONTEXT_H
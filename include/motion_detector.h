@@ -0,0 +1,93 @@
+#ifndef MOTION_DETECTOR_H
+#define MOTION_DETECTOR_H
+
+#include <cstdint>
+#include <vector>
+
+#include <opencv2/core/core.hpp>
+
+/**
+ * @struct MotionMask
+ * @brief Грубая маска движения кадра по блокам уменьшенной копии
+ *
+ * Блок (col, row) покрывает в кадре прямоугольник
+ * [col * W / cols, (col + 1) * W / cols) x [row * H / rows, (row + 1) * H / rows).
+ */
+struct MotionMask {
+    uint32_t frameSeq = 0;
+    int cols = 0;
+    int rows = 0;
+    float score = 0.0f;             // Доля блоков с движением
+    bool active = false;            // Движение есть или еще удерживается: детекцию нужно запускать
+    std::vector<uint8_t> blocks;    // cols * rows, 1 - в блоке есть движение
+
+    bool isMoving(int col, int row) const { return blocks[row * cols + col] != 0; }
+};
+
+/**
+ * @struct MotionConfig
+ * @brief Параметры детектора движения
+ */
+struct MotionConfig {
+    int pixelThreshold = 12;    // Средняя разница яркости в блоке, с которой блок считается движущимся
+    int minBlocks = 1;          // Сколько блоков должно двигаться, чтобы в кадре было движение
+    int learnShift = 4;         // Фон догоняет кадр на 1/2^learnShift разницы за кадр
+    int holdFrames = 15;        // Сколько кадров после движения маска остается активной
+};
+
+/**
+ * @class MotionDetector
+ * @brief Детектор движения по разнице яркости с фоном
+ *
+ * Кадр сводится к яркостной копии 80x60, которая сравнивается с фоном
+ * суммой модулей разностей (SAD) по блокам 8x6: SSE2 на x86, NEON на ARM.
+ * Фон - скользящее среднее кадров, поэтому остановившийся объект
+ * и медленная смена освещения со временем становятся фоном.
+ *
+ * Вызывается из одного потока.
+ */
+class MotionDetector {
+public:
+    static const int kThumbWidth = 80;
+    static const int kThumbHeight = 60;
+    static const int kBlockWidth = 8;
+    static const int kBlockHeight = 6;
+    static const int kCols = kThumbWidth / kBlockWidth;
+    static const int kRows = kThumbHeight / kBlockHeight;
+
+    explicit MotionDetector(const MotionConfig& config = MotionConfig());
+
+    /**
+     * @brief Сравнивает кадр с фоном и обновляет фон
+     * @param image Кадр BGR888 или плоскость яркости (Y кадра NV12)
+     * @param mask Сюда записывается маска кадра; первый кадр только задает фон
+     *        и считается кадром с движением
+     */
+    void update(const cv::Mat& image, MotionMask& mask);
+
+    /**
+     * @brief Уменьшенная яркостная копия последнего кадра
+     */
+    const uint8_t* getThumbnail() const { return thumb_; }
+
+private:
+    void buildThumbnail(const cv::Mat& image);
+    void updateBackground();
+
+    MotionConfig config_;
+    bool hasBackground_;
+    uint32_t framesSinceMotion_;
+
+    // Отсчеты кадра для каждого пикселя копии, пересчитываются при смене размера
+    int frameWidth_;
+    int frameHeight_;
+    int frameChannels_;
+    std::vector<int> sampleX_;
+    std::vector<int> sampleY_;
+
+    alignas(16) uint8_t thumb_[kThumbWidth * kThumbHeight];
+    alignas(16) uint8_t background_[kThumbWidth * kThumbHeight];
+    uint16_t backgroundFixed_[kThumbWidth * kThumbHeight];     // Фон с 8 дробными битами
+};
+
+#endif // MOTION_DETECTOR_H
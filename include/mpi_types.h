@@ -0,0 +1,18 @@
+#ifndef MPI_TYPES_H
+#define MPI_TYPES_H
+
+/**
+ * @file mpi_types.h
+ * @brief Типы Rockchip MPI, используемые вне бэкендов
+ *
+ * На плате это заголовки SDK, в host сборке (HOST_BUILD) - их минимальное
+ * подмножество, достаточное для кадров, пулов и потоков кодера.
+ */
+
+#ifdef HOST_BUILD
+#include "host_mpi_types.h"
+#else
+#include "sample_comm.h"
+#endif
+
+#endif // MPI_TYPES_H
@@ -0,0 +1,95 @@
+#ifndef NPU_RECORDING_H
+#define NPU_RECORDING_H
+
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+#include "rknn_api.h"
+
+/**
+ * @file npu_recording.h
+ * @brief Файл с выходами модели, записанными на плате, для host NPU
+ *
+ * Формат: заголовок NpuRecordingHeader, атрибуты входов и выходов
+ * (rknn_tensor_attr как есть - в структуре нет указателей), затем запуски:
+ * выходы подряд, каждый размером size_with_stride.
+ */
+
+struct NpuRecordingHeader {
+    char magic[4];              // "NPUR"
+    uint32_t version;
+    uint32_t inputCount;
+    uint32_t outputCount;
+};
+
+/**
+ * @class NpuRecordingWriter
+ * @brief Дописывает выходы модели после каждого запуска
+ */
+class NpuRecordingWriter {
+public:
+    NpuRecordingWriter();
+    ~NpuRecordingWriter();
+
+    NpuRecordingWriter(const NpuRecordingWriter&) = delete;
+    NpuRecordingWriter& operator=(const NpuRecordingWriter&) = delete;
+
+    /**
+     * @brief Создает файл и записывает заголовок с атрибутами тензоров
+     * @return 0 при успехе
+     */
+    int open(const std::string& path, const std::vector<rknn_tensor_attr>& inputAttrs,
+             const std::vector<rknn_tensor_attr>& outputAttrs);
+
+    /**
+     * @brief Записывает выходы одного запуска
+     * @param outputs Адреса выходов в порядке атрибутов
+     * @return 0 при успехе
+     */
+    int append(const std::vector<const void*>& outputs);
+
+    void close();
+
+    bool isOpen() const { return file_ != nullptr; }
+    uint32_t getFrameCount() const { return frames_; }
+
+private:
+    FILE* file_;
+    std::vector<uint32_t> outputSizes_;
+    uint32_t frames_;
+};
+
+/**
+ * @class NpuRecording
+ * @brief Записанные выходы модели, загруженные в память
+ */
+class NpuRecording {
+public:
+    /**
+     * @brief Загружает файл записи
+     * @return 0 при успехе, < 0 если файл не найден или поврежден
+     */
+    int load(const std::string& path);
+
+    const std::vector<rknn_tensor_attr>& getInputAttrs() const { return inputAttrs_; }
+    const std::vector<rknn_tensor_attr>& getOutputAttrs() const { return outputAttrs_; }
+
+    uint32_t getFrameCount() const { return frameCount_; }
+
+    /**
+     * @brief Выход output запуска frame
+     */
+    const uint8_t* getOutput(uint32_t frame, uint32_t output) const;
+
+private:
+    std::vector<rknn_tensor_attr> inputAttrs_;
+    std::vector<rknn_tensor_attr> outputAttrs_;
+    std::vector<size_t> outputOffsets_;     // Смещения выходов внутри запуска
+    size_t frameSize_ = 0;
+    uint32_t frameCount_ = 0;
+    std::vector<uint8_t> data_;
+};
+
+#endif // NPU_RECORDING_H
@@ -0,0 +1,128 @@
+#ifndef NPU_SCHEDULER_H
+#define NPU_SCHEDULER_H
+
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <vector>
+
+class NpuScheduler;
+
+/**
+ * @struct NpuClientStats
+ * @brief Доля NPU одного клиента
+ */
+struct NpuClientStats {
+    uint32_t priority;
+    uint64_t runs;              // Получено очередей
+    uint64_t busyUs;            // Время NPU (Run + постобработка) за все очереди
+    uint64_t waitUsSum;         // Ожидание очереди
+    uint64_t waitUsMax;
+    uint64_t throttled;         // Отказано: клиент опережает свой infer_fps
+};
+
+/**
+ * @class NpuGrant
+ * @brief Очередь на контексте RKNN, отпускается явно или деструктором
+ *
+ * Выходы модели живут в памяти контекста до следующего Run(), поэтому
+ * очередь держится до конца декодирования.
+ */
+class NpuGrant {
+public:
+    NpuGrant() : scheduler_(nullptr), client_(-1), startUs_(0) {}
+    NpuGrant(NpuScheduler* scheduler, int client, uint64_t startUs)
+        : scheduler_(scheduler), client_(client), startUs_(startUs) {}
+    ~NpuGrant() { release(); }
+
+    NpuGrant(NpuGrant&& other);
+    NpuGrant& operator=(NpuGrant&& other);
+    NpuGrant(const NpuGrant&) = delete;
+    NpuGrant& operator=(const NpuGrant&) = delete;
+
+    explicit operator bool() const { return scheduler_ != nullptr; }
+
+    /**
+     * @brief Возвращает контекст следующему клиенту
+     */
+    void release();
+
+private:
+    NpuScheduler* scheduler_;
+    int client_;
+    uint64_t startUs_;
+};
+
+/**
+ * @class NpuScheduler
+ * @brief Делит один контекст RKNN между моделями нескольких видеопотоков
+ *
+ * Взвешенная справедливая очередь: каждому клиенту ведется виртуальное время,
+ * которое растет на занятое им время NPU, деленное на приоритет. Из ждущих
+ * очередь получает клиент с наименьшим виртуальным временем, так что при
+ * нехватке NPU время делится пропорционально приоритетам, а тяжелая модель
+ * не отнимает очередь у легкой частыми запусками. Простоявший клиент
+ * начинает с текущего виртуального времени и не копит кредит.
+ *
+ * Предел infer_fps проверяется до ожидания: кадр, пришедший раньше своего
+ * слота, сразу получает отказ, и поток инференса берет следующий.
+ *
+ * Клиенты добавляются до запуска конвейера; acquire() и release()
+ * вызываются из потоков инференса.
+ */
+class NpuScheduler {
+public:
+    explicit NpuScheduler(const std::string& name);
+
+    /**
+     * @brief Регистрирует клиента
+     * @param priority Вес при дележе времени NPU, не меньше 1
+     * @param maxFps Предел очередей в секунду, 0 - без предела
+     * @return Номер клиента
+     */
+    int addClient(const std::string& name, uint32_t priority, float maxFps);
+
+    /**
+     * @brief Проверяет, не опережает ли клиент свой infer_fps
+     *
+     * Не занимает слот: препроцессинг не готовит вход, который получит отказ.
+     */
+    bool isDue(int client, uint64_t nowUs) const;
+
+    /**
+     * @brief Ждет очереди клиента
+     * @return Пустая очередь если клиент опережает свой infer_fps
+     */
+    NpuGrant acquire(int client);
+
+    NpuClientStats getStats(int client) const;
+
+    const std::string& getName() const { return name_; }
+    size_t getClientCount() const { return clients_.size(); }
+
+private:
+    friend class NpuGrant;
+
+    struct Client {
+        std::string name;
+        uint32_t priority;
+        uint64_t intervalUs;    // Минимальный шаг между очередями, 0 - без предела
+        uint64_t nextUs;        // Начало следующего слота
+        uint64_t pass;          // Виртуальное время, Q8 мкс
+        bool waiting;
+        NpuClientStats stats;
+    };
+
+    bool isNext(int client) const;
+    void release(int client, uint64_t startUs);
+
+    std::string name_;
+    mutable std::mutex mutex_;
+    std::condition_variable turn_;
+    std::vector<Client> clients_;
+    uint64_t virtualTime_;      // Виртуальное время последней выданной очереди
+    bool busy_;
+};
+
+#endif // NPU_SCHEDULER_H
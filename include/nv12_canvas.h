@@ -0,0 +1,71 @@
+#ifndef NV12_CANVAS_H
+#define NV12_CANVAS_H
+
+#include <cstdint>
+#include <string>
+
+#include <opencv2/core/core.hpp>
+
+/**
+ * @struct YuvColor
+ * @brief Цвет в YUV (BT.601, ограниченный диапазон, как у VENC)
+ */
+struct YuvColor {
+    uint8_t y;
+    uint8_t u;
+    uint8_t v;
+
+    static YuvColor fromBgr(const cv::Scalar& bgr);
+};
+
+/**
+ * @class Nv12Canvas
+ * @brief Отрисовка рамок и текста прямо в плоскостях NV12 кадра
+ *
+ * Один отсчет UV приходится на блок 2x2 яркости. Прямоугольники
+ * выравниваются на четные границы, поэтому каждый блок либо целиком
+ * закрашен, либо не тронут. Текст растеризуется в маску, яркость
+ * пишется попиксельно, а цвет - в блоки, которые задела маска:
+ * буква не оставляет серого или чужого цвета по краям.
+ */
+class Nv12Canvas {
+public:
+    /**
+     * @param image Кадр NV12 (FrameRef::image): Y, за ним UV с тем же шагом
+     * @param width Видимый размер кадра
+     * @param height
+     */
+    Nv12Canvas(const cv::Mat& image, int width, int height);
+
+    /**
+     * @brief Закрашивает прямоугольник [left, right) x [top, bottom)
+     */
+    void fillRect(int left, int top, int right, int bottom, const YuvColor& color);
+
+    /**
+     * @brief Рамка с внутренним краем по заданным координатам, толщина четная
+     */
+    void drawRect(int left, int top, int right, int bottom, const YuvColor& color, int thickness);
+
+    /**
+     * @brief Текст шрифтом FONT_HERSHEY_SIMPLEX, origin - левый нижний угол как у putText
+     */
+    void drawText(const std::string& text, cv::Point origin, double scale, int thickness,
+                  const YuvColor& color);
+
+    int width() const { return width_; }
+    int height() const { return height_; }
+
+private:
+    uint8_t* lumaRow(int y) const { return data_ + (size_t)y * stride_; }
+    uint8_t* chromaRow(int y) const { return uv_ + (size_t)(y / 2) * stride_; }
+
+    uint8_t* data_;
+    uint8_t* uv_;
+    size_t stride_;
+    int width_;
+    int height_;
+    cv::Mat mask_;              // Маска текста, переиспользуется между вызовами
+};
+
+#endif // NV12_CANVAS_H
@@ -0,0 +1,164 @@
+#ifndef PIPELINE_H
+#define PIPELINE_H
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "frame_ref.h"
+#include "latest_mailbox.h"
+#include "lockfree_queue.h"
+#include "pipeline_config.h"
+#include "stage.h"
+
+/**
+ * @struct StageStats
+ * @brief Статистика одной стадии конвейера
+ */
+struct StageStats {
+    const char* name;
+    const char* thread;
+    QueueStats input;           // Входная очередь стадии (нули, если стадия в потоке input)
+    uint64_t processed;         // Вызовов process()
+    uint64_t dropped;           // Из них кадр не пошел дальше
+    uint64_t busyUs;            // Суммарное время process()
+};
+
+/**
+ * @class StageInput
+ * @brief Вход стадии, принимающей кадры из другого потока
+ */
+class StageInput {
+public:
+    virtual ~StageInput() = default;
+
+    /**
+     * @brief Ставит кадр во вход
+     * @return False если вход закрыт
+     */
+    virtual bool push(FrameRef&& frame) = 0;
+
+    /**
+     * @brief Забирает кадр, ожидая его появления
+     * @return False если вход закрыт и пуст
+     */
+    virtual bool pop(FrameRef& frame) = 0;
+
+    virtual void close() = 0;
+
+    /**
+     * @brief Освобождает кадры, оставшиеся во входе
+     */
+    virtual void drain() = 0;
+
+    virtual QueueStats getStats() const = 0;
+};
+
+/**
+ * @class Pipeline
+ * @brief Граф стадий, собранный из конфигурации
+ *
+ * Стадии одного потока вызываются цепочкой, между потоками кадры передаются
+ * через lock-free SPSC очередь с обратным давлением или через почтовый ящик,
+ * где необработанный кадр вытесняется более новым. Кадр передается как
+ * FrameRef: блок пула возвращается, когда последняя стадия отпускает ссылку.
+ */
+class Pipeline {
+public:
+    Pipeline(const PipelineConfig& config, StageContext& context);
+    ~Pipeline();
+
+    Pipeline(const Pipeline&) = delete;
+    Pipeline& operator=(const Pipeline&) = delete;
+
+    /**
+     * @brief Создает стадии, проверяет и связывает граф, инициализирует стадии
+     * @return 0 при успехе, < 0 при ошибке в описании графа или инициализации
+     */
+    int build();
+
+    /**
+     * @brief Запускает потоки стадий
+     * @return Статус запуска
+     */
+    int start();
+
+    /**
+     * @brief Останавливает потоки, освобождает кадры во входах и сбрасывает стадии
+     */
+    void stop();
+
+    /**
+     * @brief Проверяет, работает ли конвейер
+     *
+     * Конвейер останавливается сам, когда источники исчерпаны и все потоки
+     * доработали свои очереди.
+     */
+    bool isRunning() const { return running_.load(); }
+
+    /**
+     * @brief Проверяет, остановился ли конвейер из-за ошибки
+     */
+    bool hasFailed() const { return failed_.load(); }
+
+    /**
+     * @brief Количество стадий
+     */
+    size_t getStageCount() const { return nodes_.size(); }
+
+    /**
+     * @brief Получает статистику стадии по порядковому номеру
+     */
+    StageStats getStageStats(size_t index) const;
+
+    /**
+     * @brief Гистограммы задержек между точками пути кадра, читаются на ходу
+     */
+    const LatencyTracker& getLatency() const { return context_.latency; }
+
+    /**
+     * @brief Ищет стадию по имени
+     * @return nullptr если стадии нет
+     */
+    Stage* findStage(const std::string& name) const;
+
+    /**
+     * @brief Печатает счетчики по стадиям и моделям
+     */
+    void printStats() const;
+
+private:
+    struct Node {
+        std::unique_ptr<Stage> stage;
+        std::unique_ptr<StageInput> input;  // Только у стадий, получающих кадры из другого потока
+        Node* direct = nullptr;             // Следующая стадия в том же потоке
+        std::vector<Node*> remote;          // Стадии других потоков, получающие кадр
+        std::vector<FrameRef> outgoing;     // Кадры для remote, используется потоком стадии
+        std::atomic<uint64_t> processed{0};
+        std::atomic<uint64_t> dropped{0};
+        std::atomic<uint64_t> busyUs{0};
+    };
+
+    void runThread(Node* head);
+    int runChain(Node* node, FrameRef& frame);
+    void fail(const Node* node);
+    void closeInputs();
+    Node* findNode(const std::string& name) const;
+
+private:
+    PipelineConfig config_;
+    StageContext& context_;
+
+    std::vector<std::unique_ptr<Node>> nodes_;
+    std::vector<Node*> heads_;              // Первая стадия каждого потока
+
+    std::vector<std::thread> threads_;
+    std::atomic<bool> running_;
+    std::atomic<bool> failed_;
+    std::atomic<size_t> activeThreads_;
+};
+
+#endif // PIPELINE_H
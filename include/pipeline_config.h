@@ -0,0 +1,132 @@
+#ifndef PIPELINE_CONFIG_H
+#define PIPELINE_CONFIG_H
+
+#include <cstdint>
+#include <map>
+#include <string>
+#include <vector>
+
+#include "backend.h"
+#include "inference_scheduler.h"
+#include "thread_policy.h"
+#include "tiling.h"
+
+/**
+ * @struct StageSpec
+ * @brief Описание стадии графа
+ *
+ * Стадии с одинаковым thread выполняются одним потоком друг за другом,
+ * между потоками кадры передаются через очередь (link = queue) или через
+ * почтовый ящик, хранящий только последний кадр (link = latest).
+ */
+struct StageSpec {
+    std::string name;
+    std::string type;
+    std::string input;              // Имя стадии-источника кадров, пусто у источника
+    std::string thread;             // Поток стадии, по умолчанию совпадает с name
+    std::string link = "queue";     // Связь с input из другого потока: queue | latest
+    std::string stream;             // Видеопоток стадии, пусто - первый
+    uint32_t queueDepth = 2;
+    std::map<std::string, std::string> params;
+
+    std::string getParam(const std::string& key, const std::string& defaultValue = "") const;
+    int getInt(const std::string& key, int defaultValue) const;
+    float getFloat(const std::string& key, float defaultValue) const;
+};
+
+/**
+ * @struct ModelSpec
+ * @brief Описание модели детекции
+ */
+struct ModelSpec {
+    std::string name = "default";
+    std::string path = "yolov5nu.rknn";
+    std::string anchorsPath = "anchors_yolov5.txt";
+    std::string labelsPath = "coco_80_labels_list.txt";
+    std::string stream;             // Видеопоток, кадры которого обрабатывает модель, пусто - первый
+    std::string npuContext;         // Контекст RKNN, общий для моделей с тем же именем; пусто - свой
+    SchedulerConfig scheduler;
+    TilingConfig tiling;
+    NpuOptions npu;
+    std::string recordPath;         // Запись выходов для host NPU, пусто - не писать
+    uint32_t recordFrames = 100;    // Сколько запусков записать
+};
+
+/**
+ * @struct StreamSpec
+ * @brief Видеопоток: свой размер кадра, пул, канал VENC и путь RTSP
+ *
+ * Модели потока делят NPU с моделями других потоков: priority - вес
+ * потока при дележе времени NPU, infer_fps - предел запусков в секунду.
+ */
+struct StreamSpec {
+    std::string name = "main";
+    int width = 720;
+    int height = 480;
+    uint32_t frameCount = 6;        // Блоков пула потока
+    std::string rtspPath = "/live/0";
+    int vencChannel = 0;
+    int bitrate = 3072;
+    uint32_t priority = 1;
+    float inferFps = 0.0f;          // 0 - без предела
+};
+
+/**
+ * @struct PipelineConfig
+ * @brief Конфигурация приложения и графа стадий
+ */
+struct PipelineConfig {
+    int width = 720;
+    int height = 480;
+    uint32_t frameCount = 6;        // Максимум кадров в обороте (блоков пула)
+
+    int rtspPort = 554;
+    std::string rtspPath = "/live/0";
+
+    int vencChannel = 0;
+    int bitrate = 3072;
+
+    std::string tracePath;          // Файл трассы Chrome/Perfetto, пусто - трассировка выключена
+    uint32_t traceSeconds = 0;      // Выгрузить через столько секунд, 0 - только по SIGUSR1
+    uint32_t traceEvents = 16384;   // Событий в кольце каждого потока
+
+    std::vector<StreamSpec> streams;
+    std::vector<ModelSpec> models;
+    std::vector<StageSpec> stages;
+    std::vector<ThreadPolicy> threads;
+
+    /**
+     * @brief Граф по умолчанию: захват -> препроцессинг -> оверлей -> кодер -> RTSP,
+     *        ветка детекции инференс -> постобработка -> трекинг -> публикация
+     *
+     * Захват и кодер получают SCHED_FIFO, остальные потоки - SCHED_OTHER.
+     */
+    static PipelineConfig makeDefault();
+
+    /**
+     * @brief Видеопотоки приложения
+     *
+     * Без секций stream - один поток "main" с параметрами из [app].
+     */
+    std::vector<StreamSpec> getStreams() const;
+
+    /**
+     * @brief Имя видеопотока стадии или модели: заданное или первого потока
+     */
+    std::string resolveStream(const std::string& stream) const;
+
+    /**
+     * @brief Загружает конфигурацию из INI файла
+     *
+     * Секции: [app], [stream <имя>], [model <имя>], [stage <имя>], [thread <имя>].
+     * Если в файле есть хотя бы одна секция stream, stage, model или thread,
+     * она заменяет потоки, граф, список моделей или политики потоков
+     * по умолчанию целиком.
+     *
+     * @param path Путь к файлу
+     * @return 0 при успехе, < 0 при ошибке
+     */
+    int load(const std::string& path);
+};
+
+#endif // PIPELINE_CONFIG_H
@@ -1,10 +1,13 @@
 #pragma once
 
+#include <atomic>
 #include <cstdint>
 #include <cstddef>
 #include <vector>
 #include <map>
 #include <string>
+#include <memory>
+#include "backend.h"
 #include "rknn_api.h"
 
 /**
@@ -74,15 +77,66 @@ struct TensorData {
     bool is_owned;           // Владеем ли мы памятью
 };
 
+/**
+ * Записываемое окно в память нативного входа модели
+ *
+ * Препроцессинг пишет кадр прямо сюда, без промежуточного буфера:
+ * строки NHWC идут с шагом pitch (size_with_stride / H). Каждое окно -
+ * отдельная память NPU, поэтому пока NPU читает одно, можно заполнять другое.
+ */
+struct InputTensorView {
+    int index;               // Индекс входа модели
+    rknn_tensor_mem* mem;    // Память NPU, к которой привязывается вход перед Run
+    uint8_t* data;           // Виртуальный адрес mem
+    size_t size;             // size_with_stride
+    int height;
+    int width;
+    int channels;
+    size_t pitch;            // Байт в строке
+    TensorType type;
+    QuantizationType qnt_type;
+    int32_t zp;
+    float scale;
+};
+
+/**
+ * Чужой DMA буфер (блок пула, выход VPSS), который NPU читает как вход
+ */
+struct DmaBuffer {
+    MB_BLK block;            // Блок MPI, nullptr - буфер известен только по fd
+    int fd;                  // DMABUF дескриптор, -1 если есть block
+    void* data;              // Виртуальный адрес
+    size_t size;             // Байт, доступных с data
+    size_t pitch;            // Байт в строке
+};
+
+/**
+ * Импортированный внешний буфер входа, запоминается по буферу
+ */
+struct ImportedInput {
+    int index;               // Индекс входа модели
+    MB_BLK block;
+    int fd;
+    void* data;
+    rknn_tensor_mem* mem;
+    uint64_t lastUse;        // Для вытеснения самого давнего
+};
+
+/**
+ * Счетчики импорта внешних буферов входа
+ */
+struct InputImportStats {
+    uint64_t imports;        // Вызовов rknn_create_mem_from_*
+    uint64_t hits;           // Окон, выданных из кэша
+};
+
 /**
  * Контекст для работы с RKNN моделью
  */
 struct RKNNContext {
-    rknn_context ctx;
-
     // Информация о модели
-    int n_inputs;
-    int n_outputs;
+    int n_inputs = 0;
+    int n_outputs = 0;
     std::vector<TensorInfo> input_infos;
     std::vector<TensorInfo> output_infos;
 
@@ -94,9 +148,19 @@ struct RKNNContext {
     std::vector<rknn_tensor_mem*> input_mems;
     std::vector<rknn_tensor_mem*> output_mems;
 
+    // Память, привязанная к входам сейчас (input_mems или окно InputTensorView)
+    std::vector<rknn_tensor_mem*> bound_inputs;
+
+    // Импортированные внешние буферы: VPSS и пул крутят одни и те же блоки
+    std::vector<ImportedInput> imported_inputs;
+    uint64_t import_clock = 0;
+    // Пишет поток инференса, читает печать статистики
+    std::atomic<uint64_t> import_count{0};   // Вызовов rknn_create_mem_from_*
+    std::atomic<uint64_t> import_hits{0};    // Окон, выданных из кэша
+
     // Кэшированные данные
-    bool is_quantized;
-    bool initialized;
+    bool is_quantized = false;
+    bool initialized = false;
 };
 
 // ============ Основной класс интерфейса ============
@@ -106,7 +170,10 @@ struct RKNNContext {
  */
 class RKNNInference {
 public:
-    RKNNInference();
+    /**
+     * @param options Настройки NPU бэкенда
+     */
+    explicit RKNNInference(const NpuOptions& options = NpuOptions());
     ~RKNNInference();
 
     /**
@@ -138,8 +205,68 @@ public:
         return SetInput(0, input_data, size);
     }
 
+    /**
+     * Создание окна для записи входа прямо в память NPU
+     * @param input_index Индекс входа
+     * @param view Заполняется размерами, шагом и квантизацией из TensorInfo
+     * @return 0 при успехе, < 0 при ошибке; окно освобождается DestroyInputView
+     */
+    int CreateInputView(int input_index, InputTensorView& view);
+    void DestroyInputView(InputTensorView& view);
+
+    /**
+     * Проверка, может ли NPU читать вход прямо из внешнего буфера
+     *
+     * Буфер должен вмещать size_with_stride входа с его шагом строки,
+     * а вход - принимать пиксели uint8 без квантизации на CPU.
+     */
+    bool CanImportInput(int input_index, const DmaBuffer& buffer) const;
+
+    /**
+     * Окно входа поверх внешнего DMA буфера, без копирования
+     *
+     * Импорт запоминается по буферу (до kMaxImportedInputs, вытесняется
+     * самый давний), повторный кадр в том же блоке обходится без
+     * rknn_create_mem_from_*. Окно не владеет памятью и не освобождается
+     * DestroyInputView: буфер держит вызывающий до конца Run. Вызывается
+     * под очередью NPU, как BindInput и Run.
+     * @return 0 при успехе, < 0 если буфер не подходит или импорт не удался
+     */
+    int ImportInputView(int input_index, const DmaBuffer& buffer, InputTensorView& view);
+
+    /**
+     * Освобождение всех импортов, пока буферы, из которых они сделаны, живы
+     *
+     * Вызывается до закрытия источника (VPSS, пул), когда Run не идет.
+     */
+    void ReleaseImports();
+
+    /**
+     * Счетчики импорта, можно читать из любого потока
+     */
+    InputImportStats GetImportStats() const;
+
+    /**
+     * Сброс кэша CPU после записи окна, до Run
+     */
+    int SyncInput(const InputTensorView& view);
+
+    /**
+     * Привязка окна к входу модели для следующих Run, без копирования
+     */
+    int BindInput(const InputTensorView& view);
+
+    /**
+     * Перевод окна, заполненного пикселями uint8, в int8 по zp и scale входа
+     *
+     * Нужен только моделям с нативным входом INT8; для UINT8 ничего не делает.
+     */
+    static void QuantizeInput(InputTensorView& view);
+
     /**
      * Выполнение инференса
+     *
+     * После возврата кэш CPU по выходам согласован, их можно читать.
      * @return 0 при успехе, < 0 при ошибке
      */
     int Run();
@@ -243,6 +370,7 @@ public:
     const RKNNContext& GetContext() const { return m_ctx; }
 
 private:
+    std::unique_ptr<NpuBackend> m_backend;
     RKNNContext m_ctx;
 
     /**
@@ -251,6 +379,16 @@ private:
     int QueryModelInfo();
     int SetupIOMemory();
     int CleanupIOMemory();
+
+    /**
+     * Кэш импортированных буферов: блоков VPSS и пула обычно 2-6 на канал
+     */
+    static const size_t kMaxImportedInputs = 8;
+
+    /**
+     * Освобождение импорта; если он привязан, вход возвращается к своей памяти
+     */
+    void ReleaseImport(ImportedInput& entry);
     TensorInfo QueryTensorInfo(const rknn_tensor_attr* attr, bool is_input);
 
     /**
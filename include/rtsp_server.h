@@ -1,13 +1,39 @@
 #ifndef RTSP_SERVER_H
 #define RTSP_SERVER_H
 
+#include <atomic>
 #include <cstdint>
+#include <functional>
 #include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+#include "backend.h"
+#include "frame_timeline.h"
+#include "lockfree_queue.h"
 #include "rtsp_demo.h"
 
+/**
+ * @struct RtspStats
+ * @brief Счетчики потока отправки RTSP
+ */
+struct RtspStats {
+    uint64_t sent;          // Кадров передано librtsp
+    uint64_t dropped;       // Отброшено: поток отправки не успевал
+    uint64_t events;        // Вызовов rtsp_do_event
+    size_t pending;         // Кадров в очереди на отправку
+};
+
 /**
  * @class RtspServer
  * @brief Управляет RTSP сервером для потокового вещания видео
+ *
+ * На одном порту может быть несколько сессий, по одной на видеопоток.
+ * После start() вся работа с librtsp идет в отдельном потоке событий:
+ * epoll ждет кадры из очередей сессий и тики timerfd, на которых
+ * обрабатываются подключения, RTSP запросы и RTCP. Поэтому медленный
+ * клиент не тормозит кодеры, а остановка кодера не останавливает
+ * обработку клиентов.
  */
 class RtspServer {
 public:
@@ -23,41 +49,101 @@ public:
     /**
      * @brief Создает новую RTSP сессию
      * @param path Путь потока (например, "/live/0")
-     * @return Статус создания
+     * @return Номер сессии, < 0 при ошибке
      */
     int createSession(const char *path);
 
     /**
      * @brief Настраивает видео кодек для сессии
+     * @param session Номер сессии
      * @param codecId ID кодека
      * @param codecData Данные кодека (SPS+PPS для H264)
      * @param dataLen Длина данных кодека
      * @return Статус настройки
      */
-    int setVideoCodec(int codecId, const uint8_t *codecData, int dataLen);
+    int setVideoCodec(int session, int codecId, const uint8_t *codecData, int dataLen);
+
+    /**
+     * @brief Вызывается в потоке событий после отправки кадра
+     * @param timeline Метки времени кадра
+     * @param sentUs Время окончания отправки
+     */
+    using SentCallback = std::function<void(FrameTimeline& timeline, uint64_t sentUs)>;
+
+    /**
+     * @brief Создает очередь отправки сессии, вызывается до start()
+     * @param session Номер сессии
+     * @param queueDepth Кадров в очереди на отправку; при переполнении новые кадры отбрасываются
+     * @param eventIntervalMs Период обработки событий librtsp, у сервера - наименьший из заданных
+     * @param onSent Обработчик отправленного кадра, может быть пустым
+     * @return 0 при успехе, < 0 при ошибке
+     */
+    int attachSink(int session, size_t queueDepth, int eventIntervalMs, SentCallback onSent);
 
     /**
-     * @brief Отправляет видео кадр в RTSP сессию
+     * @brief Запускает поток событий, если к сессиям подключена хотя бы одна очередь
+     * @return 0 при успехе, < 0 при ошибке
+     */
+    int start();
+
+    /**
+     * @brief Останавливает поток событий, неотправленные кадры отбрасываются
+     */
+    void stop();
+
+    /**
+     * @brief Ставит кадр в очередь сессии на отправку
+     *
+     * Данные копируются, так что буфер кодера можно сразу вернуть.
+     * Для каждой сессии вызывается из одного потока.
+     *
+     * @param session Номер сессии
      * @param frame Указатель на данные кадра
      * @param len Размер кадра
      * @param ts Временная метка
-     * @return Статус отправки
+     * @param timeline Метки времени кадра
+     * @return False если кадр отброшен
      */
-    int sendVideoFrame(const uint8_t *frame, int len, uint64_t ts);
+    bool submitVideoFrame(int session, const uint8_t *frame, int len, uint64_t ts,
+                          const FrameTimeline& timeline);
 
     /**
-     * @brief Обрабатывает события RTSP
-     * @return Статус обработки
+     * @brief Счетчики сессии; events - общий для сервера
      */
-    int processEvents();
+    RtspStats getStats(int session) const;
+
+    size_t getSessionCount() const { return sessions_.size(); }
+    const std::string& getSessionPath(int session) const { return sessions_[session]->path; }
 
     /**
      * @brief Синхронизирует временные метки видео
+     * @param session Номер сессии
      * @param ts Временная метка
      * @param ntpTime NTP время
      * @return Статус синхронизации
      */
-    int syncVideoTimestamp(uint64_t ts, uint64_t ntpTime);
+    int syncVideoTimestamp(int session, uint64_t ts, uint64_t ntpTime);
+
+    /**
+     * @brief Получает относительное время сервера для меток кадров
+     */
+    uint64_t getRelativeTime() const;
+
+    /**
+     * @brief Получает NTP время сервера
+     */
+    uint64_t getNtpTime() const;
+
+    /**
+     * @brief Опрашивает число подключенных клиентов всех сессий
+     * @return Число клиентов, < 0 если сервер не может его определить
+     */
+    int updateClientCount();
+
+    /**
+     * @brief Число клиентов по последнему опросу
+     */
+    int getClientCount() const { return clients_.load(std::memory_order_relaxed); }
 
     /**
      * @brief Выключает сервер
@@ -75,10 +161,48 @@ public:
     bool isInitialized() const { return initialized_; }
 
 private:
+    /**
+     * @brief Кадр на отправку; буферы переиспользуются и не перевыделяются
+     */
+    struct OutgoingFrame {
+        std::vector<uint8_t> data;
+        uint64_t pts;
+        FrameTimeline timeline;
+    };
+
+    /**
+     * @brief Сессия и ее очередь отправки
+     */
+    struct Session {
+        int id;
+        std::string path;
+
+        // Кадр ходит по кругу: free -> кодер -> pending -> поток событий -> free
+        std::vector<std::unique_ptr<OutgoingFrame>> frames;
+        std::unique_ptr<SpscQueue<OutgoingFrame*>> pending;
+        std::unique_ptr<SpscQueue<OutgoingFrame*>> free;
+        SentCallback onSent;
+
+        std::atomic<uint64_t> sent{0};
+        std::atomic<uint64_t> dropped{0};
+    };
+
+    bool isValidSession(int session) const;
+    void runEventLoop(int eventIntervalMs);
+    void sendPending(Session& session);
+    int sendVideoFrame(int session, const uint8_t *frame, int len, uint64_t ts);
+
+    std::unique_ptr<RtspBackend> backend_;
     int port_;
-    rtsp_demo_handle handle_;
-    rtsp_session_handle session_;
     bool initialized_;
+    std::atomic<int> clients_;
+
+    std::vector<std::unique_ptr<Session>> sessions_;
+    std::vector<Session*> attached_;    // Сессии с очередью отправки
+    int eventIntervalMs_;
+    std::thread thread_;
+
+    std::atomic<uint64_t> events_;
 };
 
 #endif // RTSP_SERVER_H
@@ -0,0 +1,193 @@
+#ifndef STAGE_H
+#define STAGE_H
+
+#include <atomic>
+#include <functional>
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "frame_processor.h"
+#include "frame_ref.h"
+#include "memory_pool.h"
+#include "model_context.h"
+#include "pipeline_config.h"
+#include "rtsp_server.h"
+#include "video_encoder.h"
+
+/**
+ * @struct StreamContext
+ * @brief Компоненты одного видеопотока
+ */
+struct StreamContext {
+    StreamSpec spec;
+    FrameProcessor* frameProcessor = nullptr;
+    MemoryPool* memPool = nullptr;
+    VideoEncoder* venc = nullptr;
+    int rtspSession = -1;
+
+    std::atomic<float> fps{0.0f};       // Частота отправки потока, обновляет приемник
+    std::atomic<int> recorders{0};      // Стадии записи, которым нужен закодированный поток
+};
+
+/**
+ * @struct StageContext
+ * @brief Компоненты, доступные стадиям при инициализации
+ *
+ * Стадия работает с видеопотоком из своего параметра stream
+ * (по умолчанию первым); модели и RTSP сервер общие.
+ */
+struct StageContext {
+    std::vector<std::unique_ptr<StreamContext>> streams;
+    RtspServer* rtspServer = nullptr;
+    std::map<std::string, std::unique_ptr<ModelContext>> models;
+
+    LatencyTracker latency;         // Задержки между точками пути кадра
+
+    std::atomic<int> rtspClients{0};    // Клиенты RTSP всех потоков, < 0 - число неизвестно; обновляет App
+
+    /**
+     * @brief Нужен ли кому-то закодированный поток
+     *
+     * librtsp не различает клиентов по сессиям, поэтому при любом клиенте
+     * кодируются все потоки. Если число клиентов неизвестно, кодирование
+     * не останавливается.
+     */
+    bool isEncodeNeeded(const StreamContext& stream) const {
+        return rtspClients.load(std::memory_order_relaxed) != 0 ||
+               stream.recorders.load(std::memory_order_relaxed) > 0;
+    }
+
+    /**
+     * @brief Ищет видеопоток по имени, пустое имя - первый поток
+     * @return nullptr если потока нет
+     */
+    StreamContext* findStream(const std::string& name) const;
+
+    /**
+     * @brief Ищет модель по имени
+     * @return nullptr если модели нет
+     */
+    ModelContext* findModel(const std::string& name) const;
+};
+
+/**
+ * @brief Результат обработки кадра стадией
+ */
+enum class StageStatus {
+    Forward,    // Передать кадр следующим стадиям
+    Drop,       // Кадр дальше не идет
+    Error,      // Фатальная ошибка, конвейер останавливается
+    End         // Источник исчерпан: поток завершается, остальные дорабатывают очереди
+};
+
+/**
+ * @class Stage
+ * @brief Стадия графа обработки кадров
+ *
+ * Время process() замеряется конвейером. Стадия вызывается всегда
+ * из одного потока, поэтому внутреннее состояние не требует синхронизации.
+ */
+class Stage {
+public:
+    explicit Stage(const StageSpec& spec) : spec_(spec) {}
+    virtual ~Stage() = default;
+
+    Stage(const Stage&) = delete;
+    Stage& operator=(const Stage&) = delete;
+
+    /**
+     * @brief Захватывает ресурсы стадии до запуска потоков
+     * @return 0 при успехе, < 0 при ошибке
+     */
+    virtual int init(StageContext& context) = 0;
+
+    /**
+     * @brief Обрабатывает кадр
+     * @param frame Кадр; у источника на входе пустая ссылка, которую он заполняет
+     */
+    virtual StageStatus process(FrameRef& frame) = 0;
+
+    /**
+     * @brief Освобождает удерживаемые ресурсы после остановки потоков
+     */
+    virtual void flush() {}
+
+    /**
+     * @brief Решает, что поставить во вход стадии из другого потока
+     *
+     * Вызывается в потоке производителя до постановки кадра в какие-либо
+     * очереди, чтобы ненужный кадр не вытеснил нужный из почтового ящика.
+     * Стадия может взять не сам кадр, а легкую ссылку, и забрать из кадра
+     * предназначенные ей метаданные.
+     *
+     * @param frame Кадр производителя
+     * @param admitted Что будет поставлено во вход стадии
+     * @return False если кадр стадии не нужен
+     */
+    virtual bool admit(FrameRef& frame, FrameRef& admitted) {
+        admitted = frame;
+        return true;
+    }
+
+    /**
+     * @brief Стадия порождает кадры и не имеет входа
+     */
+    virtual bool isSource() const { return false; }
+
+    /**
+     * @brief Стадия должна выполняться в потоке своего input
+     */
+    virtual bool requiresDirectInput() const { return false; }
+
+    const std::string& getName() const { return spec_.name; }
+    const StageSpec& getSpec() const { return spec_; }
+
+    /**
+     * @brief Подключает гистограммы задержек, вызывается конвейером до init()
+     */
+    void setLatencyTracker(LatencyTracker* latency) { latency_ = latency; }
+
+protected:
+    /**
+     * @brief Ставит метку точки на пути кадра
+     */
+    void mark(const FrameRef& frame, TimelinePoint point, uint64_t nowUs) const {
+        if (latency_) {
+            latency_->mark(frame.timeline(), point, nowUs);
+        }
+    }
+
+    StageSpec spec_;
+    LatencyTracker* latency_ = nullptr;
+};
+
+/**
+ * @class StageFactory
+ * @brief Реестр типов стадий
+ */
+class StageFactory {
+public:
+    using Creator = std::function<std::unique_ptr<Stage>(const StageSpec&)>;
+
+    /**
+     * @brief Реестр со встроенными типами стадий
+     */
+    static StageFactory& instance();
+
+    void registerType(const std::string& type, Creator creator);
+
+    /**
+     * @brief Создает стадию по spec.type
+     * @return nullptr если тип неизвестен
+     */
+    std::unique_ptr<Stage> create(const StageSpec& spec) const;
+
+private:
+    StageFactory();
+
+    std::map<std::string, Creator> creators_;
+};
+
+#endif // STAGE_H
@@ -0,0 +1,309 @@
+#ifndef STAGES_H
+#define STAGES_H
+
+#include <cstdio>
+#include <string>
+#include <vector>
+
+#include "frame_source.h"
+#include "letterbox.h"
+#include "motion_detector.h"
+#include "stage.h"
+#include "tracker.h"
+
+/**
+ * @class SourceStage
+ * @brief Чтение кадра из источника в новый блок пула или буфер источника (тип source)
+ *
+ * Параметры: source - camera | vi | file | synthetic (параметры источников
+ * описаны в frame_source.h); fps - частота выдачи кадров, 0 - как отдает
+ * источник; frames - остановиться после стольких кадров, 0 - без ограничения.
+ * model - вход этой модели готовит сам источник (VPSS у vi), его частота
+ * model_fps, 0 - каждый кадр; preprocess этой модели тогда только копирует его.
+ * pixel_format - bgr | nv12, формат кадров пула для VENC и оверлея у источников
+ * с пулом (у vi всегда nv12): BGR кадр источника переводится в NV12 один раз.
+ * Размер кадра и пул берутся у видеопотока стадии (stream).
+ */
+class SourceStage : public Stage {
+public:
+    explicit SourceStage(const StageSpec& spec);
+
+    int init(StageContext& context) override;
+    StageStatus process(FrameRef& frame) override;
+    bool isSource() const override { return true; }
+
+private:
+    StageStatus finish();
+    int initModelOutput(StageContext& context);
+
+    FrameProcessor* frameProcessor_;
+    MemoryPool* memPool_;
+    const ModelContext* sourceModel_;
+    PIXEL_FORMAT_E pixelFormat_;
+    cv::Mat bgr_;               // Кадр источника до перевода в NV12
+    std::unique_ptr<FrameSource> source_;
+    FramePacer pacer_;
+    bool paced_;                // Момент текущего кадра уже выдержан, ждем блок пула
+    uint32_t frameLimit_;
+    uint32_t seq_;
+};
+
+/**
+ * @class MotionStage
+ * @brief Маска движения кадра для гейта детекции и других потребителей (тип motion)
+ *
+ * Маска кладется в метаданные кадра (FrameMeta::motion) и видна всем
+ * стадиям ниже по графу. Параметры: threshold - средняя разница яркости
+ * блока (12), min_blocks (1), learn_shift (4), hold_frames (15),
+ * см. MotionConfig.
+ */
+class MotionStage : public Stage {
+public:
+    explicit MotionStage(const StageSpec& spec);
+
+    int init(StageContext& context) override;
+    StageStatus process(FrameRef& frame) override;
+
+private:
+    MotionDetector detector_;
+};
+
+/**
+ * @class PreprocessStage
+ * @brief Letterbox кадра во вход модели для кадров, выбранных планировщиком (тип preprocess)
+ *
+ * Если у кадра есть маска движения и сцена неподвижна, вход модели
+ * не готовится и Run() не вызывается: оверлей рисует прежние детекции.
+ * Раз в refresh_ms детекция все равно запускается, чтобы подтвердить их.
+ * Если вход модели готовит источник, он только копируется в тензор,
+ * а кадры, для которых ветка модели прорежена, идут без детекции.
+ * Вход не готовится и раньше слота infer_fps потока модели.
+ *
+ * У модели с плитками (tiles в секции model) каждая плитка кадра вписывается
+ * во вход модели отдельно: при обходе - все плитки, при чередовании - одна
+ * следующая по кругу. Вход от источника тогда не используется.
+ *
+ * Параметры: model - имя модели; refresh_ms (2000), 0 - без подтверждения.
+ */
+class PreprocessStage : public Stage {
+public:
+    explicit PreprocessStage(const StageSpec& spec);
+
+    int init(StageContext& context) override;
+    StageStatus process(FrameRef& frame) override;
+
+private:
+    struct YuvLetterboxEntry {
+        int width;
+        int height;
+        YuvLetterbox letterbox;
+    };
+
+    int prepareModelInput(const FrameRef& frame, ModelInput& input);
+    int prepareTiles(const FrameRef& frame, ModelInput& input);
+    int prepareRegion(const FrameRef& frame, const TileRegion& region,
+                      const InputTensorView& tensor, Letterbox& letterbox);
+    int copyModelFrame(FrameRef& frame, ModelInput& input);
+    void fillModelInput(const FrameRef& frame, ModelInput& input);
+    YuvLetterbox* getYuvLetterbox(int width, int height, const InputTensorView& tensor);
+
+    ModelContext* model_;
+    std::vector<YuvLetterboxEntry> yuvLetterboxes_; // Вход модели из NV12 за один проход, по размеру области
+    std::vector<TileRegion> tileRegions_;
+    cv::Size tileFrameSize_;    // Размер кадра, под который посчитаны tileRegions_
+    uint32_t nextTile_;         // Следующая плитка при чередовании
+    uint64_t refreshUs_;
+    uint64_t lastInputUs_;      // Время захвата последнего кадра, отправленного в модель
+};
+
+/**
+ * @class InferStage
+ * @brief Запуск модели на подготовленном входе (тип infer)
+ *
+ * Ветка детекции получает кадр без пикселей: только номер, время захвата
+ * и вход модели, который забирается из метаданных кадра. Так она
+ * не удерживает блок пула и поток VENC, пока NPU занят, видеотракт
+ * не удерживает входы модели, а метаданные у веток не общие.
+ *
+ * Перед Run() стадия ждет очереди на контексте RKNN у NpuScheduler:
+ * контекст может быть общим с моделями других видеопотоков.
+ * Плитки кадра запускаются подряд в одной очереди, каждая декодируется
+ * сразу после своего Run(). Импорты кадров VPSS освобождаются в flush(),
+ * до того как источник закроет каналы.
+ *
+ * Параметры: model - имя модели.
+ */
+class InferStage : public Stage {
+public:
+    explicit InferStage(const StageSpec& spec);
+
+    int init(StageContext& context) override;
+    StageStatus process(FrameRef& frame) override;
+    bool admit(FrameRef& frame, FrameRef& admitted) override;
+    void flush() override;
+
+private:
+    int runTiles(ModelInput& input);
+
+    ModelContext* model_;
+};
+
+/**
+ * @class PostprocessStage
+ * @brief Декодирование выходов модели в детекции (тип postprocess)
+ *
+ * Выходы живут в памяти контекста RKNN до следующего Run(),
+ * поэтому стадия выполняется в потоке инференса и после декодирования
+ * отпускает очередь на контексте. Рамки плиток, уже декодированные
+ * InferStage, сводятся через швы (mergeTileDetections).
+ */
+class PostprocessStage : public Stage {
+public:
+    explicit PostprocessStage(const StageSpec& spec);
+
+    int init(StageContext& context) override;
+    StageStatus process(FrameRef& frame) override;
+    bool requiresDirectInput() const override { return true; }
+
+private:
+    void mergeTiles(ModelInput& input);
+
+    ModelContext* model_;
+    std::vector<std::vector<Detection>> tileDetections_;    // Последние рамки каждой плитки
+};
+
+/**
+ * @class TrackStage
+ * @brief Сопровождение детекций между запусками (тип track)
+ *
+ * Параметры: model, iou (0.3), max_missed (5).
+ */
+class TrackStage : public Stage {
+public:
+    explicit TrackStage(const StageSpec& spec);
+
+    int init(StageContext& context) override;
+    StageStatus process(FrameRef& frame) override;
+
+private:
+    ModelContext* model_;
+    IouTracker tracker_;
+};
+
+/**
+ * @class PublishStage
+ * @brief Публикация результата детекции для оверлея (тип publish)
+ */
+class PublishStage : public Stage {
+public:
+    explicit PublishStage(const StageSpec& spec);
+
+    int init(StageContext& context) override;
+    StageStatus process(FrameRef& frame) override;
+
+private:
+    ModelContext* model_;
+};
+
+/**
+ * @class OverlayStage
+ * @brief Отрисовка последних результатов детекции и FPS (тип overlay)
+ *
+ * Параметры: models - имена моделей через запятую, по умолчанию все модели
+ * видеопотока стадии. Пока закодированный поток никому не нужен, кадр
+ * проходит без отрисовки. Нарисованные области отмечаются в кадре, и перед
+ * кодированием из кэша CPU сбрасываются только они.
+ */
+class OverlayStage : public Stage {
+public:
+    explicit OverlayStage(const StageSpec& spec);
+
+    int init(StageContext& context) override;
+    StageStatus process(FrameRef& frame) override;
+
+private:
+    FrameProcessor* frameProcessor_;
+    const StreamContext* stream_;
+    const StageContext* context_;
+    std::vector<ModelContext*> models_;
+    std::vector<cv::Rect> drawn_;       // Области, нарисованные на текущем кадре
+};
+
+/**
+ * @class EncodeStage
+ * @brief Кодирование кадра в VENC (тип encode)
+ *
+ * Без клиентов RTSP и записи канал VENC останавливается, кадры отбрасываются.
+ * При появлении клиента кодирование возобновляется с IDR кадра.
+ */
+class EncodeStage : public Stage {
+public:
+    explicit EncodeStage(const StageSpec& spec);
+
+    int init(StageContext& context) override;
+    StageStatus process(FrameRef& frame) override;
+
+private:
+    /**
+     * @brief Останавливает или возобновляет кодер по числу потребителей
+     * @return true если кадр нужно кодировать
+     */
+    bool updateDemand();
+
+    VideoEncoder* venc_;
+    const StreamContext* stream_;
+    const StageContext* context_;
+    int lastClients_;
+    uint64_t skippedFrames_;
+};
+
+/**
+ * @class RtspSinkStage
+ * @brief Передача закодированного кадра потоку событий RTSP (тип rtsp)
+ *
+ * Стадия только копирует поток кадра в очередь сессии своего видеопотока
+ * и сразу возвращает буфер кодеру; отправка идет в потоке событий RtspServer.
+ * Если очередь полна, кадр отбрасывается и у кодера запрашивается IDR.
+ *
+ * Параметры: queue - глубина очереди отправки (4), event_ms - период
+ * обработки событий librtsp (10).
+ */
+class RtspSinkStage : public Stage {
+public:
+    explicit RtspSinkStage(const StageSpec& spec);
+
+    int init(StageContext& context) override;
+    StageStatus process(FrameRef& frame) override;
+    void flush() override;
+
+private:
+    // Вызывается в потоке событий RTSP
+    void onSent(FrameTimeline& timeline, uint64_t sentUs);
+
+    RtspServer* rtspServer_;
+    VideoEncoder* venc_;
+    std::atomic<float>* fps_;
+    int session_;
+    uint64_t prevFrameTimeUs_;
+};
+
+/**
+ * @class RecorderSinkStage
+ * @brief Запись закодированного потока в файл Annex-B (тип recorder)
+ *
+ * Параметры: path - путь к файлу (record.h264).
+ */
+class RecorderSinkStage : public Stage {
+public:
+    explicit RecorderSinkStage(const StageSpec& spec);
+    ~RecorderSinkStage() override;
+
+    int init(StageContext& context) override;
+    StageStatus process(FrameRef& frame) override;
+    void flush() override;
+
+private:
+    FILE* file_;
+};
+
+#endif // STAGES_H
@@ -0,0 +1,107 @@
+#ifndef THREAD_POLICY_H
+#define THREAD_POLICY_H
+
+#include <cstdint>
+#include <map>
+#include <mutex>
+#include <string>
+#include <vector>
+
+/**
+ * @struct ThreadPolicy
+ * @brief Политика планирования именованного потока
+ *
+ * Задается секцией [thread <имя>]; имя - поле thread стадий
+ * или rtsp для потока событий RTSP сервера.
+ */
+struct ThreadPolicy {
+    std::string name;
+    std::string policy = "other";   // fifo | rr | other
+    int priority = 0;               // 1..99 для fifo и rr
+    int nice = 0;                   // -20..19 для other
+    std::vector<int> cpus;          // Разрешенные ядра, пусто - без ограничения
+
+    /**
+     * @brief Разбирает список ядер вида "0,2-3"
+     * @return 0 при успехе, < 0 при ошибке
+     */
+    int parseCpus(const std::string& text);
+
+    /**
+     * @brief Описание политики для журнала, например "fifo:60 cpus=0"
+     */
+    std::string describe() const;
+};
+
+/**
+ * @struct ThreadStats
+ * @brief Переключения контекста потока из /proc/self/task/<tid>/status
+ */
+struct ThreadStats {
+    std::string name;
+    std::string policy;             // Фактически примененная политика
+    int tid;
+    bool alive;                     // Поток еще существует
+    uint64_t voluntary;             // Поток сам уступил процессор (ожидание)
+    uint64_t involuntary;           // Поток вытеснен планировщиком
+    uint64_t voluntaryDelta;        // Приращения с прошлого getStats()
+    uint64_t involuntaryDelta;
+};
+
+/**
+ * @class ThreadRegistry
+ * @brief Применяет политики планирования и следит за переключениями контекста
+ *
+ * Поток регистрируется сам при старте: получает политику по имени
+ * и попадает в отчет о переключениях контекста.
+ */
+class ThreadRegistry {
+public:
+    static ThreadRegistry& instance();
+
+    /**
+     * @brief Задает политики, вызывается до запуска потоков
+     */
+    void setPolicies(const std::vector<ThreadPolicy>& policies);
+
+    /**
+     * @brief Регистрирует вызывающий поток и применяет его политику
+     *
+     * Ошибка применения (например, нет CAP_SYS_NICE для fifo) не фатальна:
+     * поток продолжает работать с политикой по умолчанию.
+     *
+     * @param name Имя потока из конфигурации
+     */
+    void registerCurrentThread(const std::string& name);
+
+    /**
+     * @brief Снимок переключений контекста всех зарегистрированных потоков
+     *
+     * Приращения считаются от предыдущего вызова.
+     */
+    std::vector<ThreadStats> getStats();
+
+    /**
+     * @brief Печатает переключения контекста потоков
+     */
+    void printStats();
+
+private:
+    struct Entry {
+        std::string name;
+        std::string policy;         // Фактически примененная политика
+        int tid;
+        uint64_t lastVoluntary;
+        uint64_t lastInvoluntary;
+    };
+
+    ThreadRegistry() = default;
+
+    static int applyPolicy(const ThreadPolicy& policy, int tid);
+
+    std::mutex mutex_;
+    std::map<std::string, ThreadPolicy> policies_;
+    std::vector<Entry> threads_;
+};
+
+#endif // THREAD_POLICY_H
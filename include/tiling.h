@@ -0,0 +1,77 @@
+#ifndef TILING_H
+#define TILING_H
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "detection.h"
+
+/**
+ * @struct TilingConfig
+ * @brief Разбиение кадра на перекрывающиеся плитки для мелких объектов
+ *
+ * Каждая плитка вписывается во вход модели отдельно, поэтому объект
+ * в ней крупнее, чем при вписывании всего кадра. Цена - запуск NPU
+ * на каждую плитку.
+ */
+struct TilingConfig {
+    uint32_t cols = 1;              // Сетка плиток, 1x1 - без разбиения
+    uint32_t rows = 1;
+    float overlap = 0.2f;           // Доля перекрытия соседних плиток
+    bool sweep = true;              // true - все плитки на кадр, false - по одной плитке на кадр по кругу
+    bool fullFrame = true;          // Плитка 0 - весь кадр: крупные объекты не режутся швами
+    float nmsIou = 0.45f;           // IoU подавления одинаковых рамок из разных плиток
+    float mergeIos = 0.6f;          // Доля меньшей рамки в пересечении, при которой части объекта со шва сливаются
+
+    bool isEnabled() const { return cols * rows > 1; }
+
+    /**
+     * @brief Плиток в раскладке, включая весь кадр
+     */
+    uint32_t getTileCount() const { return cols * rows + (fullFrame ? 1 : 0); }
+
+    /**
+     * @brief Плиток, которые готовятся и запускаются на одном кадре
+     */
+    uint32_t getTilesPerFrame() const { return sweep ? getTileCount() : 1; }
+
+    /**
+     * @brief Разбирает сетку вида "3x2"
+     * @return 0 при успехе
+     */
+    int parseGrid(const std::string& value);
+};
+
+/**
+ * @struct TileRegion
+ * @brief Область кадра, углы и размер четные (так ее можно вырезать из NV12)
+ */
+struct TileRegion {
+    int x;
+    int y;
+    int width;
+    int height;
+};
+
+/**
+ * @brief Раскладка плиток кадра: весь кадр (если fullFrame), затем сетка по строкам
+ */
+std::vector<TileRegion> computeTiles(const TilingConfig& config, int frameWidth, int frameHeight);
+
+/**
+ * @brief Сводит детекции плиток в детекции кадра (NMS через швы)
+ *
+ * Рамки обходятся по убыванию уверенности. Часть объекта, разрезанного
+ * швом, почти целиком лежит в рамке того же объекта из соседней плитки
+ * или из плитки всего кадра, хотя IoU у них мал: если пересечение
+ * покрывает mergeIos меньшей рамки, рамки разных плиток объединяются.
+ * Остальные рамки одного класса с IoU выше nmsIou подавляются.
+ *
+ * @param tiles Детекции каждой плитки в координатах кадра
+ * @param detections Результат, отсортирован по убыванию уверенности
+ */
+void mergeTileDetections(const std::vector<std::vector<Detection>>& tiles, const TilingConfig& config,
+                         std::vector<Detection>& detections);
+
+#endif // TILING_H
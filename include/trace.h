@@ -0,0 +1,136 @@
+#ifndef TRACE_H
+#define TRACE_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+/**
+ * @file trace.h
+ * @brief Трассировка работы конвейера в формате Chrome trace event
+ *
+ * Каждый поток пишет события начала и конца участков в свое кольцо без
+ * блокировок, время - счетчик процессора (TSC на x86, CNTVCT на ARM64,
+ * на ARMv7 - монотонные часы через vDSO). Файл открывается в Perfetto
+ * (ui.perfetto.dev) или chrome://tracing.
+ *
+ * Выключенная трассировка стоит одного атомарного чтения на участок.
+ */
+
+/**
+ * @class Tracer
+ * @brief Реестр колец событий потоков
+ */
+class Tracer {
+public:
+    static const uint32_t kNoArg = 0xffffffffu;
+
+    static Tracer& instance();
+
+    /**
+     * @brief Включает запись
+     * @param eventsPerThread Емкость кольца потока, округляется до степени двойки;
+     *        при переполнении затираются самые старые события
+     */
+    void enable(size_t eventsPerThread);
+
+    void disable();
+
+    bool isEnabled() const { return enabled_.load(std::memory_order_relaxed); }
+
+    /**
+     * @brief Начало участка
+     * @param name Имя, строка должна жить до выгрузки трассы
+     * @param arg Номер кадра или kNoArg
+     */
+    void begin(const char* name, uint32_t arg = kNoArg);
+
+    /**
+     * @brief Конец последнего начатого в этом потоке участка
+     */
+    void end();
+
+    /**
+     * @brief Выгружает события всех потоков в JSON
+     *
+     * Можно вызывать во время записи: события, которые потоки успели
+     * затереть во время копирования, отбрасываются.
+     *
+     * @return 0 при успехе, < 0 при ошибке
+     */
+    int dump(const std::string& path);
+
+    /**
+     * @brief Просит выгрузить трассу, безопасно вызывать из обработчика сигнала
+     */
+    void requestDump() { dumpRequested_.store(true, std::memory_order_relaxed); }
+
+    /**
+     * @brief Забирает запрос на выгрузку
+     */
+    bool takeDumpRequest() { return dumpRequested_.exchange(false, std::memory_order_relaxed); }
+
+private:
+    struct Event {
+        uint64_t ticks;
+        const char* name;
+        uint32_t arg;
+        char phase;             // 'B' или 'E'
+    };
+
+    struct Ring {
+        std::vector<Event> events;
+        size_t mask;
+        std::atomic<uint64_t> head{0};  // Всего записано событий, пишет только поток-владелец
+        int tid;
+        std::string threadName;
+    };
+
+    Tracer();
+
+    Ring* getThreadRing();
+    void append(char phase, const char* name, uint32_t arg);
+
+    std::atomic<bool> enabled_;
+    std::atomic<bool> dumpRequested_;
+    size_t ringSize_;
+
+    // Начало записи для пересчета тиков в микросекунды
+    uint64_t startTicks_;
+    uint64_t startNs_;
+
+    std::mutex ringsMutex_;     // Только регистрация кольца и выгрузка
+    std::vector<std::unique_ptr<Ring>> rings_;
+};
+
+/**
+ * @class TraceScope
+ * @brief Участок трассы на время жизни объекта
+ */
+class TraceScope {
+public:
+    explicit TraceScope(const char* name, uint32_t arg = Tracer::kNoArg)
+        : active_(Tracer::instance().isEnabled()) {
+        if (active_) {
+            Tracer::instance().begin(name, arg);
+        }
+    }
+
+    ~TraceScope() {
+        if (active_) {
+            Tracer::instance().end();
+        }
+    }
+
+    TraceScope(const TraceScope&) = delete;
+    TraceScope& operator=(const TraceScope&) = delete;
+
+private:
+    bool active_;
+};
+
+#endif // TRACE_H
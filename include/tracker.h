@@ -0,0 +1,39 @@
+#ifndef TRACKER_H
+#define TRACKER_H
+
+#include <vector>
+
+#include "detection.h"
+
+/**
+ * @class IouTracker
+ * @brief Сопровождение объектов по перекрытию рамок между запусками детектора
+ *
+ * Детекция продолжает трек того же класса с наибольшим IoU выше порога,
+ * остальные детекции открывают новые треки. Трек удаляется после
+ * maxMissed запусков без подтверждения.
+ */
+class IouTracker {
+public:
+    IouTracker(float iouThreshold = 0.3f, uint32_t maxMissed = 5);
+
+    /**
+     * @brief Обновляет треки детекциями очередного запуска
+     * @param detections Детекции в координатах кадра
+     * @param tracks Подтвержденные на этом запуске треки
+     */
+    void update(const std::vector<Detection>& detections, std::vector<Track>& tracks);
+
+    /**
+     * @brief Сбрасывает все треки
+     */
+    void reset();
+
+private:
+    float iouThreshold_;
+    uint32_t maxMissed_;
+    int nextId_;
+    std::vector<Track> tracks_;
+};
+
+#endif // TRACKER_H
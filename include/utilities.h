@@ -31,13 +31,13 @@ public:
 class SystemUtils {
 public:
     /**
-     * @brief Инициализирует Rockchip MPI систему
+     * @brief Инициализирует Rockchip MPI систему (или host платформу)
      * @return Статус инициализации
      */
     static int initMpiSystem();
 
     /**
-     * @brief Завершает работу Rockchip MPI системы
+     * @brief Завершает работу Rockchip MPI системы (или host платформы)
      */
     static void exitMpiSystem();
 
@@ -1,8 +1,11 @@
 #ifndef VIDEO_ENCODER_H
 #define VIDEO_ENCODER_H
 
+#include <atomic>
 #include <cstdint>
-#include "sample_comm.h"
+#include <memory>
+#include "backend.h"
+#include "mpi_types.h"
 
 /**
  * @class VideoEncoder
@@ -17,9 +20,10 @@ public:
      * @brief Инициализирует видео кодер
      * @param channelId ID канала кодирования
      * @param codecType Тип кодека (RK_VIDEO_ID_AVC, RK_VIDEO_ID_HEVC и т.д.)
+     * @param pixelFormat Формат входных кадров: RK_FMT_BGR888 или RK_FMT_YUV420SP
      * @return Статус инициализации
      */
-    int init(int channelId, RK_CODEC_ID_E codecType);
+    int init(int channelId, RK_CODEC_ID_E codecType, PIXEL_FORMAT_E pixelFormat = RK_FMT_BGR888);
 
     /**
      * @brief Отправляет кадр на кодирование
@@ -42,6 +46,36 @@ public:
      */
     int releaseStream(VENC_STREAM_S *stream);
 
+    /**
+     * @brief Получает адрес данных пакета потока
+     * @param pack Пакет из VENC_STREAM_S
+     * @return nullptr при ошибке
+     */
+    const uint8_t* getPackData(const VENC_PACK_S& pack) const;
+
+    /**
+     * @brief Приостанавливает прием кадров каналом, пока поток никому не нужен
+     * @return Статус остановки
+     */
+    int suspend();
+
+    /**
+     * @brief Возобновляет прием кадров, первым кадром будет IDR
+     * @return Статус запуска
+     */
+    int resume();
+
+    /**
+     * @brief Просит закодировать следующий кадр как IDR
+     * @return Статус запроса
+     */
+    int requestIdr();
+
+    /**
+     * @brief Проверяет, приостановлен ли кодер
+     */
+    bool isSuspended() const { return suspended_.load(std::memory_order_relaxed); }
+
     /**
      * @brief Останавливает кодер
      */
@@ -58,14 +92,47 @@ public:
     int getChannelId() const { return channelId_; }
 
 private:
+    std::unique_ptr<EncoderBackend> backend_;
     int width_;
     int height_;
     int bitrate_;
     int channelId_;
     bool initialized_;
+    std::atomic<bool> suspended_;   // Читается главным потоком
+};
+
+/**
+ * @class EncodedPacket
+ * @brief Закодированный кадр, полученный из VENC
+ *
+ * Поток возвращается кодеру в деструкторе, поэтому пакет можно раздать
+ * нескольким приемникам через shared_ptr: буфер VENC освобождается,
+ * когда его отпустит последний.
+ */
+class EncodedPacket {
+public:
+    explicit EncodedPacket(VideoEncoder& venc);
+    ~EncodedPacket();
+
+    EncodedPacket(const EncodedPacket&) = delete;
+    EncodedPacket& operator=(const EncodedPacket&) = delete;
 
-    int configureEncoder(RK_CODEC_ID_E codecType);
-    int startReceivingFrames();
+    /**
+     * @brief Получает следующий поток из кодера
+     * @return Статус получения
+     */
+    int receive();
+
+    const uint8_t* data() const { return data_; }
+    uint32_t size() const { return pack_.u32Len; }
+    uint64_t pts() const { return pack_.u64PTS; }
+
+private:
+    VideoEncoder& venc_;
+    VENC_STREAM_S stream_;
+    VENC_PACK_S pack_;
+    const uint8_t* data_;
+    bool received_;
 };
 
 #endif // VIDEO_ENCODER_H
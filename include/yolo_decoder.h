@@ -0,0 +1,73 @@
+#ifndef YOLO_DECODER_H
+#define YOLO_DECODER_H
+
+#include <string>
+#include <vector>
+
+#include "detection.h"
+#include "letterbox.h"
+#include "rknn_interface.h"
+
+/**
+ * @class YoloDecoder
+ * @brief Декодирует выходы YOLOv5 (3 головы NHWC, int8) в детекции
+ */
+class YoloDecoder {
+public:
+    YoloDecoder(float confThreshold = 0.25f, float nmsThreshold = 0.45f);
+
+    /**
+     * @brief Загружает якоря (18 чисел: 3 головы x 3 якоря x (w, h))
+     * @param path Путь к файлу якорей
+     * @return Статус загрузки; при ошибке остаются якоря по умолчанию
+     */
+    int loadAnchors(const std::string& path);
+
+    /**
+     * @brief Загружает имена классов (по одному на строку)
+     * @param path Путь к файлу меток
+     * @return Количество загруженных меток, < 0 при ошибке
+     */
+    int loadLabels(const std::string& path);
+
+    /**
+     * @brief Получает имя класса
+     */
+    const char* getLabel(int classId) const;
+
+    /**
+     * @brief Декодирует выходы модели после Run()
+     * @param inference Модель с готовыми выходами
+     * @param letterbox Параметры вписывания кадра
+     * @param frameWidth Ширина исходного кадра
+     * @param frameHeight Высота исходного кадра
+     * @param detections Результат в координатах исходного кадра
+     * @return 0 при успехе, < 0 при ошибке
+     */
+    int decode(RKNNInference& inference, const Letterbox& letterbox,
+               int frameWidth, int frameHeight,
+               std::vector<Detection>& detections) const;
+
+    /**
+     * @brief Подавление немаксимумов внутри каждого класса
+     * @param detections Детекции, на выходе отсортированы по убыванию уверенности
+     * @param nmsThreshold Порог IoU
+     */
+    static void applyNms(std::vector<Detection>& detections, float nmsThreshold);
+
+    /**
+     * @brief IoU двух прямоугольников
+     */
+    static float computeIou(const Detection& a, const Detection& b);
+
+    float getConfThreshold() const { return confThreshold_; }
+    float getNmsThreshold() const { return nmsThreshold_; }
+
+private:
+    float confThreshold_;
+    float nmsThreshold_;
+    float anchors_[3][6];
+    std::vector<std::string> labels_;
+};
+
+#endif // YOLO_DECODER_H
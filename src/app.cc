@@ -1,9 +1,23 @@
 #include "app.h"
+#include <csignal>
+#include <map>
+#include "frame_source.h"
+#include "thread_policy.h"
+#include "trace.h"
 #include "utilities.h"
 
-App::App(uint16_t width, uint16_t height, uint16_t rtsp_port)
-    :_width(width), _height(height), _rtsp_port(rtsp_port),
-    _initialized(false)
+static volatile sig_atomic_t poolReportRequested = 0;
+
+static void onTraceSignal(int) {
+    Tracer::instance().requestDump();
+}
+
+static void onPoolReportSignal(int) {
+    poolReportRequested = 1;
+}
+
+App::App(const PipelineConfig& config)
+    :_config(config), _initialized(false)
 {}
 
 App::~App() {
@@ -12,14 +26,24 @@ App::~App() {
 
 bool App::init() {
     printf("Initializing RTSP Video Streaming Application...\n");
-    printf("Resolution: %dx%d, RTSP Port: %d\n", _width, _height, _rtsp_port);
+    for (const StreamSpec& stream : _config.getStreams()) {
+        printf("Stream '%s': %dx%d, rtsp://:%d%s, venc channel %d\n", stream.name.c_str(),
+               stream.width, stream.height, _config.rtspPort, stream.rtspPath.c_str(),
+               stream.vencChannel);
+    }
 
-    if (SystemUtils::executeSystemCommand("RkLunch-stop.sh") != 0) {
-        printf("ERROR: cant stop default rtsp\n");
-        return -1;
+    if (!_config.tracePath.empty()) {
+        Tracer::instance().enable(_config.traceEvents);
+        signal(SIGUSR1, onTraceSignal);
     }
+    // Отчет о занятых блоках пулов по запросу: kill -USR2
+    signal(SIGUSR2, onPoolReportSignal);
+
+    // Потоки конвейера и RTSP применяют свои политики сами при старте
+    ThreadRegistry::instance().setPolicies(_config.threads);
+    ThreadRegistry::instance().registerCurrentThread("main");
 
-    if (SystemUtils::initMpiSystem() != RK_SUCCESS) {
+    if (SystemUtils::initMpiSystem() != 0) {
         printf("ERROR: Failed to initialize MPI system\n");
         return false;
     }
@@ -38,71 +62,140 @@ bool App::init() {
 
 bool App::_initComponents() {
 
-    _frame_processor = std::make_unique<FrameProcessor>(_width, _height);
-    if (_frame_processor->initVideoCapture() != 0) {
-        printf("ERROR: Video capture initialization failed\n");
+    // 1. RTSP init: один сервер, по сессии на видеопоток
+    _rtsp_server = std::make_unique<RtspServer>(_config.rtspPort);
+    if (_rtsp_server->init() != 0) {
+        printf("ERROR: RTSP server initialization failed\n");
         return false;
     }
+    _stage_context.rtspServer = _rtsp_server.get();
 
-    // 1. Mem init
-    _mem_pool = std::make_unique<MemoryPool>(_width * _height * 3, 1);
-    if (_mem_pool->init() != 0) {
-        printf("ERROR: Memory pool initialization failed\n");
-        return false;
+    // 2. Видеопотоки: кадр, пул, кодер и сессия RTSP
+    for (const StreamSpec& spec : _config.getStreams()) {
+        if (!_initStream(spec)) {
+            return false;
+        }
     }
 
-    // 3. Frame processor init
+    // 3. Inferance init
+    if (!_initModels()) {
+        return false;
+    }
 
-    _frame_processor->initFrame(*_mem_pool);
+    // 4. Stage graph
+    _pipeline = std::make_unique<Pipeline>(_config, _stage_context);
+    if (_pipeline->build() != 0) {
+        printf("ERROR: Failed to build pipeline\n");
+        return false;
+    }
 
-    // 4. RTSP init
-    _rtsp_server = std::make_unique<RtspServer>(_rtsp_port);
-    if (_rtsp_server->init() != 0) {
-        printf("ERROR: RTSP server initialization failed\n");
+    // Стадии rtsp подключили очереди своих сессий
+    if (_rtsp_server->start() != 0) {
+        printf("ERROR: Failed to start RTSP event thread\n");
         return false;
     }
 
-    if (_rtsp_server->createSession("/live/0") != 0) {
+    printf("Succsessfull initialization\n");
+    return true;
+}
+
+bool App::_initStream(const StreamSpec& spec) {
+    std::unique_ptr<StreamContext> stream(new StreamContext());
+    stream->spec = spec;
+
+    // Источник кадров открывает стадия source
+    _frame_processors.push_back(std::make_unique<FrameProcessor>(spec.width, spec.height));
+    stream->frameProcessor = _frame_processors.back().get();
+
+    // Mem init: кадры VI живут в буферах канала, пул нужен остальным источникам.
+    // NV12 кадр вдвое меньше BGR888: 1.5 байта на пиксель
+    PIXEL_FORMAT_E pixelFormat = getSourcePixelFormat(_config, spec.name);
+    if (sourceNeedsPool(_config, spec.name)) {
+        uint64_t frameSize = (uint64_t)spec.width * spec.height;
+        frameSize = pixelFormat == RK_FMT_YUV420SP ? frameSize * 3 / 2 : frameSize * 3;
+        _mem_pools.push_back(std::make_shared<MemoryPool>(frameSize, spec.frameCount, spec.name));
+        if (_mem_pools.back()->init() != 0) {
+            printf("ERROR: Memory pool initialization failed\n");
+            return false;
+        }
+        stream->memPool = _mem_pools.back().get();
+    }
+
+    stream->rtspSession = _rtsp_server->createSession(spec.rtspPath.c_str());
+    if (stream->rtspSession < 0) {
         printf("ERROR: RTSP session creation failed\n");
         return false;
     }
 
-    if (_rtsp_server->setVideoCodec(RTSP_CODEC_ID_VIDEO_H264, nullptr, 0) != 0) {
+    if (_rtsp_server->setVideoCodec(stream->rtspSession, RTSP_CODEC_ID_VIDEO_H264, nullptr, 0) != 0) {
         printf("ERROR: Failed to set video codec\n");
         return false;
     }
 
-    if (_rtsp_server->syncVideoTimestamp(rtsp_get_reltime(), rtsp_get_ntptime()) != 0) {
+    if (_rtsp_server->syncVideoTimestamp(stream->rtspSession, _rtsp_server->getRelativeTime(),
+                                         _rtsp_server->getNtpTime()) != 0) {
         printf("ERROR: Failed to sync video timestamp\n");
         return false;
     }
 
-    // 2. VENC init
-    _venc = std::make_unique<VideoEncoder>(_width, _height);
-    if (_venc->init(0, RK_VIDEO_ID_AVC) != 0) {
+    // VENC init
+    _vencs.push_back(std::make_unique<VideoEncoder>(spec.width, spec.height, spec.bitrate));
+    if (_vencs.back()->init(spec.vencChannel, RK_VIDEO_ID_AVC, pixelFormat) != 0) {
         printf("ERROR: Video encoder initialization failed\n");
         return false;
     }
+    stream->venc = _vencs.back().get();
 
-    // 4. Inferance init
-    _inferance = std::make_unique<RKNNInference>();
-
-    if (_inferance->Init("yolov5nu.rknn") != 0) {
-        printf("Failed to initialize model\n");
-        return -1;
-    }
-
-    printf("Inputs: %d, Outputs: %d\n", _inferance->GetInputCount(), _inferance->GetOutputCount());
+    _stage_context.streams.push_back(std::move(stream));
+    return true;
+}
 
-    const TensorInfo& input_info = _inferance->GetInputInfo();
-    _model_width = input_info.dims[1];   // или dims[2] в зависимости от формата
-    _model_height = input_info.dims[2];  // или dims[1] в зависимости от формата
-    _model_channel = input_info.dims[3]; // или dims[3] в зависимости от формата
+bool App::_initModels() {
+    // Модели с одним context делят контекст RKNN и его очередь
+    std::map<std::string, size_t> contexts;
+
+    for (const ModelSpec& config : _config.models) {
+        ModelSpec spec = config;
+        spec.stream = _config.resolveStream(spec.stream);
+        StreamContext *stream = _stage_context.findStream(spec.stream);
+        if (!stream) {
+            printf("ERROR: Model '%s': unknown stream '%s'\n", spec.name.c_str(), spec.stream.c_str());
+            return false;
+        }
 
+        std::string contextName = spec.npuContext.empty() ? spec.name : spec.npuContext;
+        auto it = contexts.find(contextName);
+        if (it == contexts.end()) {
+            _models.push_back(std::make_unique<RKNNInference>(spec.npu));
+            RKNNInference& inference = *_models.back();
+
+            if (inference.Init(spec.path) != 0) {
+                printf("ERROR: Failed to initialize model %s\n", spec.path.c_str());
+                return false;
+            }
+
+            const TensorInfo& input_info = inference.GetInputInfo();
+            printf("NPU context '%s' (%s): inputs %d, outputs %d, input %dx%d (channels: %d)\n",
+                   contextName.c_str(), spec.path.c_str(),
+                   inference.GetInputCount(), inference.GetOutputCount(),
+                   input_info.dims[2], input_info.dims[1], input_info.dims[3]);
+
+            _npu_schedulers.push_back(std::make_unique<NpuScheduler>(contextName));
+            it = contexts.emplace(contextName, _models.size() - 1).first;
+        }
 
-    printf("Model input size: %dx%d (channels: %d)\n", _model_width, _model_height, _model_channel);
+        RKNNInference& inference = *_models[it->second];
+        NpuScheduler& npu = *_npu_schedulers[it->second];
+        int client = npu.addClient(spec.name, stream->spec.priority, stream->spec.inferFps);
 
-    printf("Succsessfull initialization\n");
+        std::unique_ptr<ModelContext> model(new ModelContext(spec, inference, npu, client));
+        if (model->init() != 0) {
+            return false;
+        }
+        printf("Model '%s': stream '%s', NPU context '%s'\n",
+               spec.name.c_str(), spec.stream.c_str(), contextName.c_str());
+        _stage_context.models[spec.name] = std::move(model);
+    }
     return true;
 }
 
@@ -112,58 +205,56 @@ int App::run() {
         return -1;
     }
 
-    uint64_t startTimeUs = TimerUtils::getCurrentTimeUs();
-    uint64_t prevFrameTimeUs = startTimeUs;
+    _stage_context.rtspClients = _rtsp_server->updateClientCount();
 
-    uint32_t frameCount = 0;
-    float fps = 0.0f;
+    if (_pipeline->start() != 0) {
+        printf("ERROR: Failed to start pipeline\n");
+        return -1;
+    }
 
-    VENC_STREAM_S stFrame;
-    stFrame.pstPack = (VENC_PACK_S *)malloc(sizeof(VENC_PACK_S));
+    const uint64_t statsIntervalUs = 5 * 1000000;
+    uint64_t lastStatsUs = TimerUtils::getCurrentTimeUs();
 
+    bool tracing = !_config.tracePath.empty();
+    uint64_t traceDeadlineUs = _config.traceSeconds ?
+        lastStatsUs + (uint64_t)_config.traceSeconds * 1000000 : 0;
 
-    RK_S32 s32Ret = 0;
+    while (_pipeline->isRunning()) {
+        usleep(100 * 1000);
 
-    while(true) {
-        uint64_t currentTimeUs = TimerUtils::getCurrentTimeUs();
+        _stage_context.rtspClients = _rtsp_server->updateClientCount();
 
-        if (!_frame_processor->captureFrame()) {
-            printf("Cant capture frame, Breaking...\n");
-            return -1;
+        uint64_t currentTimeUs = TimerUtils::getCurrentTimeUs();
+        if (currentTimeUs - lastStatsUs >= statsIntervalUs) {
+            _pipeline->printStats();
+            ThreadRegistry::instance().printStats();
+            lastStatsUs = currentTimeUs;
         }
 
-        _frame_processor->drawFpsText(fps);
-
-            // send stream
-            // encode H264
-        _venc->sendFrame(_frame_processor->getFrameForVenc());
-
-        s32Ret = _venc->getStream(&stFrame);
-
-        if(s32Ret == RK_SUCCESS)
-        {
-            // printf("len = %d PTS = %d \n",stFrame.pstPack->u32Len, stFrame.pstPack->u64PTS);
-            void *pData = _mem_pool->getVirtualAddress(stFrame.pstPack->pMbBlk);
-
-
-
-            _rtsp_server->sendVideoFrame(
-                reinterpret_cast<uint8_t*>(pData),
-                stFrame.pstPack->u32Len,
-                stFrame.pstPack->u64PTS);
-            _rtsp_server->processEvents();
-
-            fps = TimerUtils::calculateFps(prevFrameTimeUs, currentTimeUs);
-            prevFrameTimeUs = currentTimeUs;
+        if (poolReportRequested) {
+            poolReportRequested = 0;
+            for (auto& pool : _mem_pools) {
+                pool->printReport();
+            }
         }
 
-        s32Ret = _venc->releaseStream(&stFrame);
-        if (s32Ret != RK_SUCCESS) {
-            RK_LOGE("RK_MPI_VENC_ReleaseStream fail %x", s32Ret);
+        bool traceDue = traceDeadlineUs && currentTimeUs >= traceDeadlineUs;
+        if (tracing && (Tracer::instance().takeDumpRequest() || traceDue)) {
+            Tracer::instance().dump(_config.tracePath);
+            traceDeadlineUs = 0;
         }
     }
 
-    return 0;
+    int ret = _pipeline->hasFailed() ? -1 : 0;
+    _pipeline->stop();
+    _pipeline->printStats();
+    ThreadRegistry::instance().printStats();
+
+    if (tracing) {
+        Tracer::instance().dump(_config.tracePath);
+    }
+
+    return ret;
 }
 
 void App::shutdown() {
@@ -179,49 +270,32 @@ void App::shutdown() {
 }
 
 void App::_cleanupResources() {
-    if (_frame_processor) {
-        _frame_processor->releaseCapture();
-        _frame_processor.reset();
+    if (_pipeline) {
+        _pipeline->stop();
+        _pipeline.reset();
     }
 
+    // Входы моделей и результаты освобождены вместе с кадрами конвейера
+    _stage_context.models.clear();
+    _npu_schedulers.clear();
+    _models.clear();
+
+    _stage_context.streams.clear();
+    _frame_processors.clear();
+
     if (_rtsp_server) {
         _rtsp_server->shutdown();
         _rtsp_server.reset();
     }
 
-    if (_venc) {
-        _venc->shutdown();
-        _venc.reset();
+    for (auto& venc : _vencs) {
+        venc->shutdown();
     }
+    _vencs.clear();
 
-    if (_mem_pool) {
-        _mem_pool->destroy();
-        _mem_pool.reset();
+    for (auto& pool : _mem_pools) {
+        pool->destroy();
     }
+    _mem_pools.clear();
 
 }
-
-
-
-
-
-
-
-
-
-
-
-
-
-
-
-
-
-
-
-
-
-
-
-
-
@@ -1,5 +1,7 @@
 #include "frame_processor.h"
+#include <algorithm>
 #include <cstdio>
+#include <cstring>
 #include "utilities.h"
 
 FrameProcessor::FrameProcessor(int width, int height)
@@ -7,73 +9,60 @@ FrameProcessor::FrameProcessor(int width, int height)
 }
 
 FrameProcessor::~FrameProcessor() {
-    releaseCapture();
 }
 
-int FrameProcessor::initVideoCapture() {
-    printf("%s: %dx%d\n", __func__, width_, height_);
-
-    capture_.set(cv::CAP_PROP_FRAME_WIDTH, width_);
-    capture_.set(cv::CAP_PROP_FRAME_HEIGHT, height_);
-
-    if (!capture_.open(0)) {
-        printf("ERROR: Failed to open video capture device\n");
-        return -1;
-    }
-
-    printf("Video capture initialized successfully\n");
-    return 0;
-}
-
-void FrameProcessor::updateTimeForFrame() {
-    h264_frame.stVFrame.u32TimeRef = H264_TimeRef++;
-    h264_frame.stVFrame.u64PTS = TimerUtils::getCurrentTimeUs();
+void FrameProcessor::updateTimeForFrame(VIDEO_FRAME_INFO_S& info) {
+    info.stVFrame.u32TimeRef = H264_TimeRef++;
+    info.stVFrame.u64PTS = TimerUtils::getCurrentTimeUs();
 }
 
-void FrameProcessor::initFrame(const MemoryPool& mem_pool) {
+static const cv::Scalar kFpsColor(0, 255, 0);
+static const cv::Scalar kBoxColor(255, 0, 0);
 
-    MB_BLK src_Blk = mem_pool.getMemoryBlock();
+void FrameProcessor::initFrame(VIDEO_FRAME_INFO_S& info, MB_BLK block, PIXEL_FORMAT_E format) const {
+    memset(&info, 0, sizeof(VIDEO_FRAME_INFO_S));
 
-    h264_frame.stVFrame.u32Width = width_;
-    h264_frame.stVFrame.u32Height = height_;
-    h264_frame.stVFrame.u32VirWidth = width_;
-    h264_frame.stVFrame.u32VirHeight = height_;
-    h264_frame.stVFrame.enPixelFormat =  RK_FMT_BGR888;
-    h264_frame.stVFrame.u32FrameFlag = 160;
-    h264_frame.stVFrame.pMbBlk = src_Blk;
-
-    void *data = mem_pool.getVirtualAddress(src_Blk);
-
-    frame = cv::Mat(
-        cv::Size(width_, height_),
-        CV_8UC3,
-        data
-    );
+    info.stVFrame.u32Width = width_;
+    info.stVFrame.u32Height = height_;
+    info.stVFrame.u32VirWidth = width_;
+    info.stVFrame.u32VirHeight = height_;
+    info.stVFrame.enPixelFormat = format;
+    info.stVFrame.u32FrameFlag = 160;
+    info.stVFrame.pMbBlk = block;
 }
 
-bool FrameProcessor::captureFrame() {
-    if (!capture_.isOpened()) {
-        printf("ERROR: Video capture not opened\n");
-        return false;
-    }
-    updateTimeForFrame();
+void FrameProcessor::convertToNv12(const cv::Mat& bgr, cv::Mat& nv12) {
+    cv::cvtColor(bgr, planar_, cv::COLOR_BGR2YUV_I420);
 
-    capture_ >> frame;
+    // I420: Y, U и V плоскостями; у NV12 после Y идут пары UV
+    size_t lumaSize = (size_t)width_ * height_;
+    size_t chromaSize = lumaSize / 4;
+    memcpy(nv12.data, planar_.data, lumaSize);
 
-    if (frame.empty()) {
-        printf("ERROR: Failed to capture frame\n");
-        return false;
+    const uint8_t *u = planar_.data + lumaSize;
+    const uint8_t *v = u + chromaSize;
+    uint8_t *uv = nv12.data + lumaSize;
+    for (size_t i = 0; i < chromaSize; i++) {
+        uv[2 * i] = u[i];
+        uv[2 * i + 1] = v[i];
     }
+}
 
-    return true;
+// Область подписи с запасом на толщину штриха
+static cv::Rect getTextArea(const char *text, cv::Point origin, double scale, int thickness) {
+    int baseline = 0;
+    cv::Size size = cv::getTextSize(text, cv::FONT_HERSHEY_SIMPLEX, scale, thickness, &baseline);
+    return cv::Rect(origin.x - thickness - 1, origin.y - size.height - thickness - 1,
+                    size.width + 2 * thickness + 2, size.height + baseline + 2 * thickness + 2);
 }
 
-float FrameProcessor::getFps() const {
-    RK_U64 nowUs = TimerUtils::getCurrentTimeUs();
-    return  (float) 1000000 / (float)(nowUs - h264_frame.stVFrame.u64PTS);
+// Рамка вместе с линией, линия может лечь по обе стороны координат
+static cv::Rect getBoxArea(const Detection& det, int thickness) {
+    return cv::Rect(det.left - thickness - 1, det.top - thickness - 1,
+                    det.right - det.left + 2 * thickness + 3, det.bottom - det.top + 2 * thickness + 3);
 }
 
-void FrameProcessor::drawFpsText(float fps) {
+void FrameProcessor::drawFpsText(cv::Mat& frame, float fps, std::vector<cv::Rect>* drawn) const {
     if (frame.empty()) {
         return;
     }
@@ -84,16 +73,59 @@ void FrameProcessor::drawFpsText(float fps) {
     cv::putText(frame, fpsText,
                 cv::Point(40, 40),
                 cv::FONT_HERSHEY_SIMPLEX, 1,
-                cv::Scalar(0, 255, 0), 2);
+                kFpsColor, 2);
+    if (drawn) {
+        drawn->push_back(getTextArea(fpsText, cv::Point(40, 40), 1, 2));
+    }
 }
 
-const VIDEO_FRAME_INFO_S* FrameProcessor::getFrameForVenc() const {
-    return &h264_frame;
+void FrameProcessor::drawDetections(cv::Mat& frame, const std::vector<Detection>& detections,
+                                    const YoloDecoder& decoder, std::vector<cv::Rect>* drawn) const {
+    if (frame.empty()) {
+        return;
+    }
+
+    char label[64];
+    for (const Detection& det : detections) {
+        cv::rectangle(frame, cv::Point(det.left, det.top), cv::Point(det.right, det.bottom),
+                      kBoxColor, 2);
+
+        snprintf(label, sizeof(label), "%s %.0f%%", decoder.getLabel(det.classId), det.score * 100);
+        cv::Point origin(det.left, std::max(det.top - 6, 12));
+        cv::putText(frame, label,
+                    origin,
+                    cv::FONT_HERSHEY_SIMPLEX, 0.5,
+                    kBoxColor, 1);
+        if (drawn) {
+            drawn->push_back(getBoxArea(det, 2));
+            drawn->push_back(getTextArea(label, origin, 0.5, 1));
+        }
+    }
 }
 
+void FrameProcessor::drawFpsText(Nv12Canvas& canvas, float fps, std::vector<cv::Rect>* drawn) const {
+    char fpsText[16];
+    snprintf(fpsText, sizeof(fpsText), "fps = %.2f", fps);
+    canvas.drawText(fpsText, cv::Point(40, 40), 1, 2, YuvColor::fromBgr(kFpsColor));
+    if (drawn) {
+        drawn->push_back(getTextArea(fpsText, cv::Point(40, 40), 1, 2));
+    }
+}
 
-void FrameProcessor::releaseCapture() {
-    if (capture_.isOpened()) {
-        capture_.release();
+void FrameProcessor::drawDetections(Nv12Canvas& canvas, const std::vector<Detection>& detections,
+                                    const YoloDecoder& decoder, std::vector<cv::Rect>* drawn) const {
+    const YuvColor color = YuvColor::fromBgr(kBoxColor);
+
+    char label[64];
+    for (const Detection& det : detections) {
+        canvas.drawRect(det.left, det.top, det.right, det.bottom, color, 2);
+
+        snprintf(label, sizeof(label), "%s %.0f%%", decoder.getLabel(det.classId), det.score * 100);
+        cv::Point origin(det.left, std::max(det.top - 6, 12));
+        canvas.drawText(label, origin, 0.5, 1, color);
+        if (drawn) {
+            drawn->push_back(getBoxArea(det, 2));
+            drawn->push_back(getTextArea(label, origin, 0.5, 1));
+        }
     }
 }
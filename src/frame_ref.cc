@@ -0,0 +1,203 @@
+#include "frame_ref.h"
+#include <cstdio>
+#include <cstring>
+#include "backend.h"
+
+// Согласование кэша чужих буферов: бэкенд без состояния, один на процесс
+static MemoryBackend& getCacheBackend() {
+    static std::unique_ptr<MemoryBackend> backend = createMemoryBackend();
+    return *backend;
+}
+
+FrameRef::FrameRef(const FrameRef& other) : buffer_(other.buffer_) {
+    if (buffer_) {
+        buffer_->refs.fetch_add(1, std::memory_order_relaxed);
+    }
+}
+
+FrameRef& FrameRef::operator=(const FrameRef& other) {
+    if (buffer_ != other.buffer_) {
+        if (other.buffer_) {
+            other.buffer_->refs.fetch_add(1, std::memory_order_relaxed);
+        }
+        reset();
+        buffer_ = other.buffer_;
+    }
+    return *this;
+}
+
+FrameRef& FrameRef::operator=(FrameRef&& other) noexcept {
+    if (this != &other) {
+        reset();
+        buffer_ = other.buffer_;
+        other.buffer_ = nullptr;
+    }
+    return *this;
+}
+
+FrameRef FrameRef::create(MemoryPool& pool, int width, int height, PIXEL_FORMAT_E format,
+                          uint64_t timeoutUs) {
+    MemoryBlock block = pool.acquire(PoolOwner::Capture, timeoutUs);
+    if (!block) {
+        return FrameRef();
+    }
+    void *data = block.data();
+
+    Buffer *buffer = new Buffer();
+    buffer->refs.store(1, std::memory_order_relaxed);
+    buffer->block = block.get();
+    buffer->poolBlock = std::move(block);
+    buffer->data = data;
+    buffer->width = width;
+    buffer->height = height;
+    buffer->format = format;
+    if (format == RK_FMT_YUV420SP) {
+        buffer->image = cv::Mat(height * 3 / 2, width, CV_8UC1, data);
+    } else {
+        buffer->image = cv::Mat(cv::Size(width, height), CV_8UC3, data);
+    }
+    memset(&buffer->vencFrame, 0, sizeof(VIDEO_FRAME_INFO_S));
+    buffer->seq = 0;
+    buffer->captureTimeUs = 0;
+
+    return FrameRef(buffer);
+}
+
+FrameRef FrameRef::createDetached(int width, int height) {
+    Buffer *buffer = new Buffer();
+    buffer->refs.store(1, std::memory_order_relaxed);
+    buffer->block = nullptr;
+    buffer->data = nullptr;
+    buffer->width = width;
+    buffer->height = height;
+    buffer->format = RK_FMT_BGR888;
+    memset(&buffer->vencFrame, 0, sizeof(VIDEO_FRAME_INFO_S));
+    buffer->seq = 0;
+    buffer->captureTimeUs = 0;
+
+    return FrameRef(buffer);
+}
+
+FrameRef FrameRef::wrap(const VIDEO_FRAME_INFO_S& info, void* data, std::function<void()> release) {
+    const VIDEO_FRAME_S& frame = info.stVFrame;
+    int stride = frame.u32VirWidth ? (int)frame.u32VirWidth : (int)frame.u32Width;
+    int virHeight = frame.u32VirHeight ? (int)frame.u32VirHeight : (int)frame.u32Height;
+
+    Buffer *buffer = new Buffer();
+    buffer->refs.store(1, std::memory_order_relaxed);
+    buffer->block = frame.pMbBlk;
+    buffer->data = data;
+    buffer->width = (int)frame.u32Width;
+    buffer->height = (int)frame.u32Height;
+    buffer->format = frame.enPixelFormat;
+    buffer->release = std::move(release);
+    if (frame.enPixelFormat == RK_FMT_YUV420SP) {
+        buffer->image = cv::Mat(virHeight * 3 / 2, buffer->width, CV_8UC1, data, stride);
+    } else {
+        buffer->image = cv::Mat(buffer->height, buffer->width, CV_8UC3, data, stride * 3);
+    }
+    buffer->vencFrame = info;
+    buffer->seq = 0;
+    buffer->captureTimeUs = 0;
+
+    return FrameRef(buffer);
+}
+
+template <typename Fn>
+void FrameRef::forEachRange(const cv::Rect& rect, Fn fn, bool chroma) const {
+    cv::Rect area = rect & cv::Rect(0, 0, buffer_->width, buffer_->height);
+    if (area.empty()) {
+        return;
+    }
+
+    // Строки прямоугольника лежат в блоке одним участком, от первого байта до последнего
+    const cv::Mat& image = buffer_->image;
+    const uint64_t step = image.step;
+    const uint64_t pixelBytes = image.elemSize();
+    uint64_t first = (uint64_t)area.y * step + (uint64_t)area.x * pixelBytes;
+    uint64_t last = (uint64_t)(area.y + area.height - 1) * step + (uint64_t)(area.x + area.width) * pixelBytes;
+    fn(first, last - first);
+
+    if (buffer_->format == RK_FMT_YUV420SP && chroma) {
+        // UV: строка на две строки яркости, пара байт на два столбца
+        uint64_t uvOffset = (uint64_t)(image.rows * 2 / 3) * step;
+        int left = area.x & ~1;
+        int right = (area.x + area.width + 1) & ~1;
+        int top = area.y / 2;
+        int bottom = (area.y + area.height + 1) / 2;
+        first = uvOffset + (uint64_t)top * step + (uint64_t)left;
+        last = uvOffset + (uint64_t)(bottom - 1) * step + (uint64_t)right;
+        fn(first, last - first);
+    }
+}
+
+int FrameRef::beginCpuAccess(const cv::Rect& rect, bool chroma) const {
+    int ret = 0;
+    const MemoryBlock& block = buffer_->poolBlock;
+    if (block) {
+        forEachRange(rect, [&block, &ret](uint64_t offset, uint64_t size) {
+            if (block.beginCpuAccess(offset, size) != 0) {
+                ret = -1;
+            }
+        }, chroma);
+    } else if (buffer_->block) {
+        MB_BLK handle = buffer_->block;
+        forEachRange(rect, [handle, &ret](uint64_t offset, uint64_t size) {
+            if (getCacheBackend().syncCache(handle, offset, size, false) != 0) {
+                ret = -1;
+            }
+        }, chroma);
+        if (ret != 0) {
+            printf("ERROR: Frame %u: cache invalidate failed\n", buffer_->seq);
+        }
+    }
+    return ret;
+}
+
+void FrameRef::markDirty(const cv::Rect& rect) const {
+    const MemoryBlock& block = buffer_->poolBlock;
+    if (block) {
+        forEachRange(rect, [&block](uint64_t offset, uint64_t size) { block.markDirty(offset, size); });
+    } else if (buffer_->block) {
+        DirtyRanges& dirty = buffer_->dirty;
+        uint64_t limit = getBufferBytes();
+        forEachRange(rect, [&dirty, limit](uint64_t offset, uint64_t size) { dirty.add(offset, size, limit); });
+    }
+}
+
+int FrameRef::flushCpuWrites() const {
+    if (buffer_->poolBlock) {
+        return buffer_->poolBlock.endCpuAccess();
+    }
+
+    // Буфер VI/VPSS: data() - начало блока, смещения участков те же
+    DirtyRanges& dirty = buffer_->dirty;
+    int ret = 0;
+    for (uint32_t i = 0; i < dirty.count(); i++) {
+        uint64_t size = dirty[i].end - dirty[i].begin;
+        if (getCacheBackend().syncCache(buffer_->block, dirty[i].begin, size, true) != 0) {
+            printf("ERROR: Frame %u: cache flush failed\n", buffer_->seq);
+            ret = -1;
+        }
+    }
+    dirty.clear();
+    return ret;
+}
+
+void FrameRef::reset() {
+    if (!buffer_) {
+        return;
+    }
+
+    if (buffer_->refs.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+        buffer_->image.release();
+        if (buffer_->poolBlock) {
+            buffer_->poolBlock.reset();
+        } else if (buffer_->release) {
+            buffer_->release();
+        }
+        delete buffer_;
+    }
+
+    buffer_ = nullptr;
+}
@@ -0,0 +1,500 @@
+#include "frame_source.h"
+#include <algorithm>
+#include <cerrno>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+#include <opencv2/imgproc/imgproc.hpp>
+
+static uint64_t getMonotonicNs() {
+    struct timespec time = {0, 0};
+    clock_gettime(CLOCK_MONOTONIC, &time);
+    return (uint64_t)time.tv_sec * 1000000000ull + (uint64_t)time.tv_nsec;
+}
+
+static bool endsWith(const std::string& value, const char *suffix) {
+    size_t length = strlen(suffix);
+    return value.size() >= length && value.compare(value.size() - length, length, suffix) == 0;
+}
+
+// ============ FramePacer ============
+
+FramePacer::FramePacer(float fps)
+    : intervalNs_(fps > 0.0f ? (uint64_t)(1e9 / fps) : 0), nextNs_(0), lateFrames_(0) {
+}
+
+void FramePacer::wait() {
+    if (intervalNs_ == 0) {
+        return;
+    }
+
+    uint64_t nowNs = getMonotonicNs();
+    if (nextNs_ == 0) {
+        nextNs_ = nowNs;
+    }
+
+    if (nowNs > nextNs_ + intervalNs_) {
+        // Отстали больше чем на кадр: новый отсчет вместо пачки кадров подряд
+        lateFrames_++;
+        nextNs_ = nowNs;
+    } else if (nowNs < nextNs_) {
+        struct timespec deadline;
+        deadline.tv_sec = (time_t)(nextNs_ / 1000000000ull);
+        deadline.tv_nsec = (long)(nextNs_ % 1000000000ull);
+        while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &deadline, nullptr) == EINTR) {
+        }
+    }
+
+    nextNs_ += intervalNs_;
+}
+
+// ============ Камера ============
+
+CameraSource::CameraSource(int device, int width, int height)
+    : device_(device), width_(width), height_(height) {
+}
+
+CameraSource::~CameraSource() {
+    if (capture_.isOpened()) {
+        capture_.release();
+    }
+}
+
+int CameraSource::open() {
+    printf("Camera source: device %d, %dx%d\n", device_, width_, height_);
+
+    capture_.set(cv::CAP_PROP_FRAME_WIDTH, width_);
+    capture_.set(cv::CAP_PROP_FRAME_HEIGHT, height_);
+
+    if (!capture_.open(device_)) {
+        printf("ERROR: Failed to open video capture device\n");
+        return -1;
+    }
+
+    printf("Video capture initialized successfully\n");
+    return 0;
+}
+
+SourceStatus CameraSource::read(cv::Mat& frame, std::vector<Detection>& groundTruth) {
+    // Кадр того же размера пишется в буфер пула, другой размер OpenCV выделит заново
+    cv::Mat captured = frame;
+    capture_ >> captured;
+
+    if (captured.empty()) {
+        printf("ERROR: Failed to capture frame\n");
+        return SourceStatus::Error;
+    }
+    if (captured.data != frame.data) {
+        cv::resize(captured, frame, frame.size());
+    }
+
+    return SourceStatus::Frame;
+}
+
+// ============ VI ============
+
+ViFrameSource::ViFrameSource(const StageSpec& spec, int width, int height)
+    : timeoutMs_(spec.getInt("timeout_ms", 1000)) {
+    params_.camera = spec.getInt("camera", 0);
+    params_.channel = spec.getInt("channel", 0);
+    params_.width = (uint32_t)width;
+    params_.height = (uint32_t)height;
+    params_.bufCount = (uint32_t)spec.getInt("buffers", (int)params_.bufCount);
+    params_.fps = spec.getInt("sensor_fps", params_.fps);
+    params_.iqPath = spec.getParam("iq_path", params_.iqPath);
+    params_.path = spec.getParam("path");
+}
+
+int ViFrameSource::open() {
+    printf("VI source: camera %d, channel %d, %ux%u NV12, %u buffers\n",
+           params_.camera, params_.channel, params_.width, params_.height, params_.bufCount);
+
+    backend_ = createCaptureBackend();
+    if (backend_->open(params_) != RK_SUCCESS) {
+        printf("ERROR: Failed to open VI channel\n");
+        backend_.reset();
+        return -1;
+    }
+    return 0;
+}
+
+SourceStatus ViFrameSource::acquire(FrameRef& frame, std::vector<Detection>& groundTruth) {
+    if (!backend_) {
+        return SourceStatus::Error;
+    }
+
+    VIDEO_FRAME_INFO_S info;
+    if (backend_->getFrame(info, timeoutMs_) != RK_SUCCESS) {
+        printf("ERROR: Failed to get VI frame\n");
+        return SourceStatus::Error;
+    }
+
+    std::shared_ptr<CaptureBackend> backend = backend_;
+    const VIDEO_FRAME_S& vframe = info.stVFrame;
+    void *data = backend->getVirtualAddress(vframe.pMbBlk);
+    if (!data || vframe.u32Width != params_.width || vframe.u32Height != params_.height ||
+        vframe.enPixelFormat != RK_FMT_YUV420SP) {
+        printf("ERROR: VI frame %ux%u format %d, expected %ux%u NV12\n",
+               vframe.u32Width, vframe.u32Height, (int)vframe.enPixelFormat,
+               params_.width, params_.height);
+        backend->releaseFrame(info);
+        return SourceStatus::Error;
+    }
+
+    frame = FrameRef::wrap(info, data, [backend, info]() { backend->releaseFrame(info); });
+    if (params_.model.width > 0) {
+        frame.meta().modelFrame = acquireModelFrame();
+    }
+    return SourceStatus::Frame;
+}
+
+std::shared_ptr<FrameRef> ViFrameSource::acquireModelFrame() {
+    VIDEO_FRAME_INFO_S info;
+    if (backend_->getModelFrame(info, 0) != RK_SUCCESS) {
+        return nullptr;
+    }
+
+    std::shared_ptr<CaptureBackend> backend = backend_;
+    void *data = backend->getVirtualAddress(info.stVFrame.pMbBlk);
+    if (!data) {
+        backend->releaseModelFrame(info);
+        return nullptr;
+    }
+    return std::make_shared<FrameRef>(
+        FrameRef::wrap(info, data, [backend, info]() { backend->releaseModelFrame(info); }));
+}
+
+int ViFrameSource::setModelOutput(const ModelOutputParams& params) {
+    if (backend_) {
+        printf("ERROR: VI source: model branch must be set before open\n");
+        return -1;
+    }
+    params_.model = params;
+    return 0;
+}
+
+SourceStatus ViFrameSource::read(cv::Mat& frame, std::vector<Detection>& groundTruth) {
+    // Путь с копией для потребителей BGR888, стадия source использует acquire
+    FrameRef captured;
+    SourceStatus status = acquire(captured, groundTruth);
+    if (status != SourceStatus::Frame) {
+        return status;
+    }
+
+    cv::Mat converted;
+    cv::cvtColor(captured.image(), converted, cv::COLOR_YUV2BGR_NV12);
+    if (converted.rows == frame.rows && converted.cols == frame.cols) {
+        converted.copyTo(frame);
+    } else {
+        cv::resize(converted.rowRange(0, captured.height()), frame, frame.size());
+    }
+    return SourceStatus::Frame;
+}
+
+// ============ Файл ============
+
+FileSource::FileSource(const StageSpec& spec, int width, int height)
+    : path_(spec.getParam("path")), formatName_(spec.getParam("format")),
+      width_(width), height_(height),
+      srcWidth_(spec.getInt("src_width", width)), srcHeight_(spec.getInt("src_height", height)),
+      loop_(spec.getInt("loop", 1) != 0), y4m_(false), format_(Format::I420),
+      fd_(-1), map_(nullptr), mapSize_(0), firstFrame_(0), frameSize_(0), position_(0) {
+}
+
+FileSource::~FileSource() {
+    unmap();
+}
+
+int FileSource::open() {
+    if (path_.empty()) {
+        printf("ERROR: File source needs path\n");
+        return -1;
+    }
+
+    if (formatName_.empty()) {
+        if (endsWith(path_, ".y4m")) formatName_ = "y4m";
+        else if (endsWith(path_, ".bgr")) formatName_ = "bgr";
+        else if (endsWith(path_, ".nv12")) formatName_ = "nv12";
+        else formatName_ = "i420";
+    }
+
+    if (formatName_ == "y4m") y4m_ = true;
+    else if (formatName_ == "bgr") format_ = Format::Bgr;
+    else if (formatName_ == "nv12") format_ = Format::Nv12;
+    else if (formatName_ == "i420") format_ = Format::I420;
+    else {
+        printf("ERROR: File source: unknown format '%s'\n", formatName_.c_str());
+        return -1;
+    }
+
+    fd_ = ::open(path_.c_str(), O_RDONLY);
+    if (fd_ < 0) {
+        printf("ERROR: Cannot open %s: %s\n", path_.c_str(), strerror(errno));
+        return -1;
+    }
+
+    struct stat st;
+    if (fstat(fd_, &st) != 0 || st.st_size == 0) {
+        printf("ERROR: File %s is empty\n", path_.c_str());
+        unmap();
+        return -1;
+    }
+
+    mapSize_ = (size_t)st.st_size;
+    void *map = mmap(nullptr, mapSize_, PROT_READ, MAP_PRIVATE, fd_, 0);
+    if (map == MAP_FAILED) {
+        printf("ERROR: mmap %s failed: %s\n", path_.c_str(), strerror(errno));
+        map_ = nullptr;
+        unmap();
+        return -1;
+    }
+    map_ = (const uint8_t*)map;
+    madvise(map, mapSize_, MADV_SEQUENTIAL);
+
+    if (y4m_ && parseY4mHeader() != 0) {
+        unmap();
+        return -1;
+    }
+
+    if (srcWidth_ <= 0 || srcHeight_ <= 0 || (format_ != Format::Bgr && (srcWidth_ % 2 || srcHeight_ % 2))) {
+        printf("ERROR: File source: bad frame size %dx%d\n", srcWidth_, srcHeight_);
+        unmap();
+        return -1;
+    }
+
+    size_t pixels = (size_t)srcWidth_ * srcHeight_;
+    frameSize_ = format_ == Format::Bgr ? pixels * 3 : pixels * 3 / 2;
+    position_ = firstFrame_;
+
+    printf("File source: %s, %s %dx%d, %zu bytes%s\n", path_.c_str(), formatName_.c_str(),
+           srcWidth_, srcHeight_, mapSize_, loop_ ? ", loop" : "");
+    return 0;
+}
+
+int FileSource::parseY4mHeader() {
+    static const char kSignature[] = "YUV4MPEG2 ";
+
+    const uint8_t *end = (const uint8_t*)memchr(map_, '\n', mapSize_);
+    if (mapSize_ < sizeof(kSignature) - 1 || memcmp(map_, kSignature, sizeof(kSignature) - 1) != 0 || !end) {
+        printf("ERROR: %s is not a Y4M file\n", path_.c_str());
+        return -1;
+    }
+
+    // Параметры заголовка: W<ширина> H<высота> F I A C<цветовое пространство> X
+    std::string header((const char*)map_, end - map_);
+    size_t pos = sizeof(kSignature) - 1;
+    while (pos < header.size()) {
+        size_t next = header.find(' ', pos);
+        if (next == std::string::npos) {
+            next = header.size();
+        }
+
+        std::string token = header.substr(pos, next - pos);
+        if (!token.empty()) {
+            if (token[0] == 'W') {
+                srcWidth_ = atoi(token.c_str() + 1);
+            } else if (token[0] == 'H') {
+                srcHeight_ = atoi(token.c_str() + 1);
+            } else if (token[0] == 'C' && token != "C420" && token != "C420jpeg" &&
+                       token != "C420paldv" && token != "C420mpeg2") {
+                printf("ERROR: Y4M colorspace %s is not supported, only 8-bit 4:2:0\n", token.c_str() + 1);
+                return -1;
+            }
+        }
+        pos = next + 1;
+    }
+
+    format_ = Format::I420;
+    firstFrame_ = (end - map_) + 1;
+    return 0;
+}
+
+void FileSource::unmap() {
+    if (map_) {
+        munmap((void*)map_, mapSize_);
+        map_ = nullptr;
+    }
+    if (fd_ >= 0) {
+        ::close(fd_);
+        fd_ = -1;
+    }
+}
+
+SourceStatus FileSource::read(cv::Mat& frame, std::vector<Detection>& groundTruth) {
+    if (!map_) {
+        return SourceStatus::Error;
+    }
+
+    for (int attempt = 0; attempt < 2; attempt++) {
+        size_t offset = position_;
+
+        // Заголовок кадра Y4M: FRAME с необязательными параметрами до '\n'
+        if (y4m_ && offset < mapSize_) {
+            const uint8_t *line = map_ + offset;
+            const uint8_t *eol = (const uint8_t*)memchr(line, '\n', mapSize_ - offset);
+            if (!eol || eol - line < 5 || memcmp(line, "FRAME", 5) != 0) {
+                offset = mapSize_;
+            } else {
+                offset = (eol - map_) + 1;
+            }
+        }
+
+        if (offset + frameSize_ <= mapSize_) {
+            position_ = offset + frameSize_;
+
+            const cv::Mat src(format_ == Format::Bgr ? srcHeight_ : srcHeight_ * 3 / 2, srcWidth_,
+                              format_ == Format::Bgr ? CV_8UC3 : CV_8UC1, (void*)(map_ + offset));
+            bool sameSize = srcWidth_ == frame.cols && srcHeight_ == frame.rows;
+
+            if (format_ == Format::Bgr) {
+                if (sameSize) {
+                    src.copyTo(frame);
+                } else {
+                    cv::resize(src, frame, frame.size());
+                }
+            } else {
+                int code = format_ == Format::Nv12 ? cv::COLOR_YUV2BGR_NV12 : cv::COLOR_YUV2BGR_I420;
+                if (sameSize) {
+                    cv::cvtColor(src, frame, code);
+                } else {
+                    cv::cvtColor(src, converted_, code);
+                    cv::resize(converted_, frame, frame.size());
+                }
+            }
+            return SourceStatus::Frame;
+        }
+
+        // Конец файла или обрезанный последний кадр
+        if (!loop_ || position_ == firstFrame_) {
+            break;
+        }
+        position_ = firstFrame_;
+    }
+
+    return position_ == firstFrame_ ? SourceStatus::Error : SourceStatus::End;
+}
+
+// ============ Синтетика ============
+
+// Линейный конгруэнтный генератор: одна и та же последовательность на любой платформе
+static uint32_t nextRandom(uint32_t& state) {
+    state = state * 1664525u + 1013904223u;
+    return state >> 8;
+}
+
+static int randomRange(uint32_t& state, int low, int high) {
+    return low + (int)(nextRandom(state) % (uint32_t)(high - low + 1));
+}
+
+SyntheticSource::SyntheticSource(const StageSpec& spec, int width, int height)
+    : width_(width), height_(height),
+      objectCount_((uint32_t)spec.getInt("objects", 3)),
+      seed_((uint32_t)spec.getInt("seed", 1)),
+      classId_(spec.getInt("class_id", 0)) {
+}
+
+int SyntheticSource::open() {
+    if (width_ < 16 || height_ < 16) {
+        printf("ERROR: Synthetic source: frame %dx%d is too small\n", width_, height_);
+        return -1;
+    }
+
+    uint32_t state = seed_;
+    objects_.clear();
+    for (uint32_t i = 0; i < objectCount_; i++) {
+        Object object;
+        object.width = randomRange(state, width_ / 10, width_ / 4);
+        object.height = randomRange(state, height_ / 10, height_ / 4);
+        object.x = (float)randomRange(state, 0, width_ - object.width);
+        object.y = (float)randomRange(state, 0, height_ - object.height);
+        object.vx = (float)randomRange(state, 1, 4) * (nextRandom(state) & 1 ? 1.0f : -1.0f);
+        object.vy = (float)randomRange(state, 1, 4) * (nextRandom(state) & 1 ? 1.0f : -1.0f);
+        object.color = cv::Scalar(randomRange(state, 64, 255), randomRange(state, 64, 255),
+                                  randomRange(state, 64, 255));
+        objects_.push_back(object);
+    }
+
+    printf("Synthetic source: %dx%d, %u objects, seed %u\n", width_, height_, objectCount_, seed_);
+    return 0;
+}
+
+SourceStatus SyntheticSource::read(cv::Mat& frame, std::vector<Detection>& groundTruth) {
+    frame.setTo(cv::Scalar(32, 32, 32));
+    groundTruth.clear();
+
+    for (Object& object : objects_) {
+        int left = (int)object.x;
+        int top = (int)object.y;
+        cv::rectangle(frame, cv::Rect(left, top, object.width, object.height), object.color, cv::FILLED);
+
+        Detection box;
+        box.left = left;
+        box.top = top;
+        box.right = left + object.width;
+        box.bottom = top + object.height;
+        box.score = 1.0f;
+        box.classId = classId_;
+        groundTruth.push_back(box);
+
+        // Отражение от краев кадра
+        object.x += object.vx;
+        object.y += object.vy;
+        if (object.x < 0 || object.x + object.width > width_) {
+            object.vx = -object.vx;
+            object.x = std::min(std::max(object.x, 0.0f), (float)(width_ - object.width));
+        }
+        if (object.y < 0 || object.y + object.height > height_) {
+            object.vy = -object.vy;
+            object.y = std::min(std::max(object.y, 0.0f), (float)(height_ - object.height));
+        }
+    }
+
+    return SourceStatus::Frame;
+}
+
+// ============ Фабрика ============
+
+std::unique_ptr<FrameSource> createFrameSource(const StageSpec& spec, int width, int height) {
+    std::string type = spec.getParam("source", "camera");
+
+    if (type == "camera") {
+        return std::unique_ptr<FrameSource>(new CameraSource(spec.getInt("device", 0), width, height));
+    }
+    if (type == "vi") {
+        return std::unique_ptr<FrameSource>(new ViFrameSource(spec, width, height));
+    }
+    if (type == "file") {
+        return std::unique_ptr<FrameSource>(new FileSource(spec, width, height));
+    }
+    if (type == "synthetic") {
+        return std::unique_ptr<FrameSource>(new SyntheticSource(spec, width, height));
+    }
+    return nullptr;
+}
+
+PIXEL_FORMAT_E getSourcePixelFormat(const PipelineConfig& config, const std::string& stream) {
+    for (const StageSpec& spec : config.stages) {
+        if (spec.type != "source" || config.resolveStream(spec.stream) != stream) {
+            continue;
+        }
+        if (spec.getParam("source", "camera") == "vi" || spec.getParam("pixel_format", "bgr") == "nv12") {
+            return RK_FMT_YUV420SP;
+        }
+    }
+    return RK_FMT_BGR888;
+}
+
+bool sourceNeedsPool(const PipelineConfig& config, const std::string& stream) {
+    for (const StageSpec& spec : config.stages) {
+        if (spec.type == "source" && config.resolveStream(spec.stream) == stream &&
+            spec.getParam("source", "camera") == "vi") {
+            return false;
+        }
+    }
+    return true;
+}
@@ -0,0 +1,126 @@
+#include "frame_timeline.h"
+
+const LatencyTracker::Segment LatencyTracker::kSegments[] = {
+    {"source>pre",  TimelinePoint::Capture,         TimelinePoint::PreprocessStart},
+    {"preprocess",  TimelinePoint::PreprocessStart, TimelinePoint::PreprocessEnd},
+    {"npu_wait",    TimelinePoint::PreprocessEnd,   TimelinePoint::NpuStart},
+    {"npu",         TimelinePoint::NpuStart,        TimelinePoint::NpuEnd},
+    {"postprocess", TimelinePoint::NpuEnd,          TimelinePoint::Postprocess},
+    {"detection",   TimelinePoint::Capture,         TimelinePoint::Postprocess},
+    {"pre>overlay", TimelinePoint::PreprocessEnd,   TimelinePoint::Overlay},
+    {"overlay>enc", TimelinePoint::Overlay,         TimelinePoint::EncodeSubmit},
+    {"encode",      TimelinePoint::EncodeSubmit,    TimelinePoint::BitstreamReady},
+    {"send",        TimelinePoint::BitstreamReady,  TimelinePoint::RtpSent},
+    {"glass2glass", TimelinePoint::Capture,         TimelinePoint::RtpSent},
+};
+
+// ============ LatencyHistogram ============
+
+LatencyHistogram::LatencyHistogram() {
+    reset();
+}
+
+int LatencyHistogram::bucketIndex(uint64_t value) {
+    if (value < (uint64_t)kSubBuckets) {
+        return (int)value;
+    }
+
+    // Старший бит выбирает степень двойки, следующие kSubBits - корзину внутри нее
+    int msb = 63 - __builtin_clzll(value);
+    int sub = (int)((value >> (msb - kSubBits)) & (kSubBuckets - 1));
+    return (msb - kSubBits + 1) * kSubBuckets + sub;
+}
+
+uint64_t LatencyHistogram::bucketMidpoint(int index) {
+    if (index < kSubBuckets) {
+        return (uint64_t)index;
+    }
+
+    int shift = index / kSubBuckets - 1;
+    uint64_t low = (uint64_t)(kSubBuckets + index % kSubBuckets) << shift;
+    return low + ((1ull << shift) >> 1);
+}
+
+void LatencyHistogram::record(uint64_t valueUs) {
+    buckets_[bucketIndex(valueUs)].fetch_add(1, std::memory_order_relaxed);
+    count_.fetch_add(1, std::memory_order_relaxed);
+
+    uint64_t current = max_.load(std::memory_order_relaxed);
+    while (valueUs > current &&
+           !max_.compare_exchange_weak(current, valueUs, std::memory_order_relaxed)) {
+    }
+}
+
+LatencyStats LatencyHistogram::getStats() const {
+    LatencyStats stats = {0, 0, 0, 0, 0};
+
+    // Снимок корзин: при конкурентной записи сумма может разойтись с count_
+    uint64_t counts[kBucketCount];
+    for (int i = 0; i < kBucketCount; i++) {
+        counts[i] = buckets_[i].load(std::memory_order_relaxed);
+        stats.count += counts[i];
+    }
+    stats.maxUs = max_.load(std::memory_order_relaxed);
+    if (stats.count == 0) {
+        return stats;
+    }
+
+    const uint64_t ranks[3] = {
+        (stats.count * 50 + 99) / 100,
+        (stats.count * 95 + 99) / 100,
+        (stats.count * 99 + 99) / 100,
+    };
+    uint64_t *values[3] = {&stats.p50Us, &stats.p95Us, &stats.p99Us};
+
+    uint64_t seen = 0;
+    int next = 0;
+    for (int i = 0; i < kBucketCount && next < 3; i++) {
+        seen += counts[i];
+        while (next < 3 && seen >= ranks[next]) {
+            uint64_t value = bucketMidpoint(i);
+            *values[next++] = value < stats.maxUs ? value : stats.maxUs;
+        }
+    }
+    return stats;
+}
+
+void LatencyHistogram::reset() {
+    for (auto& bucket : buckets_) {
+        bucket.store(0, std::memory_order_relaxed);
+    }
+    count_.store(0, std::memory_order_relaxed);
+    max_.store(0, std::memory_order_relaxed);
+}
+
+// ============ LatencyTracker ============
+
+void LatencyTracker::mark(FrameTimeline& timeline, TimelinePoint point, uint64_t nowUs) {
+    timeline.us[(size_t)point] = nowUs;
+
+    for (size_t i = 0; i < kSegmentCount; i++) {
+        const Segment& segment = kSegments[i];
+        uint64_t fromUs = timeline.get(segment.from);
+        if (segment.to == point && fromUs != 0 && nowUs >= fromUs) {
+            histograms_[i].record(nowUs - fromUs);
+        }
+    }
+}
+
+size_t LatencyTracker::getSegmentCount() {
+    static_assert(sizeof(kSegments) / sizeof(kSegments[0]) == kSegmentCount, "segment table size");
+    return kSegmentCount;
+}
+
+const char* LatencyTracker::getSegmentName(size_t index) {
+    return index < kSegmentCount ? kSegments[index].name : "";
+}
+
+LatencyStats LatencyTracker::getStats(size_t index) const {
+    return histograms_[index].getStats();
+}
+
+void LatencyTracker::reset() {
+    for (LatencyHistogram& histogram : histograms_) {
+        histogram.reset();
+    }
+}
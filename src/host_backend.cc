@@ -0,0 +1,1209 @@
+#include "backend.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <map>
+#include <mutex>
+#include <thread>
+#include <time.h>
+#include <unistd.h>
+#include <vector>
+#include "npu_recording.h"
+#include "utilities.h"
+
+/**
+ * @file host_backend.cc
+ * @brief Бэкенды для x86 Linux: пул на malloc, поддельные VENC, VI, NPU и RTSP
+ *
+ * MB_BLK в host сборке - указатель на HostBlock, поэтому блоки пула
+ * и буферы потока кодера читаются без обращения к бэкенду-владельцу.
+ */
+
+namespace {
+
+struct HostPool;
+
+struct HostBlock {
+    uint8_t* data = nullptr;
+    uint64_t size = 0;
+    HostPool* pool = nullptr;       // nullptr у буферов кодера и VI
+};
+
+// ============ MB пул ============
+
+struct HostPool {
+    MB_POOL id;
+    uint64_t blockSize;
+    std::vector<HostBlock> blocks;
+    std::vector<HostBlock*> freeBlocks;
+    std::mutex mutex;
+};
+
+class HostMemoryBackend : public MemoryBackend {
+public:
+    ~HostMemoryBackend() override {
+        for (auto& entry : pools_) {
+            freePool(*entry.second);
+        }
+    }
+
+    MB_POOL createPool(uint64_t size, uint32_t count) override {
+        std::unique_ptr<HostPool> pool(new HostPool());
+        pool->id = nextPoolId_.fetch_add(1);
+        pool->blockSize = size;
+        pool->blocks.resize(count);
+
+        for (HostBlock& block : pool->blocks) {
+            void *data = nullptr;
+            if (posix_memalign(&data, 64, size) != 0) {
+                printf("ERROR: Host pool allocation of %llu bytes failed\n", (unsigned long long)size);
+                freePool(*pool);
+                return MB_INVALID_POOLID;
+            }
+            block.data = static_cast<uint8_t*>(data);
+            block.size = size;
+            block.pool = pool.get();
+            pool->freeBlocks.push_back(&block);
+        }
+
+        MB_POOL id = pool->id;
+        pools_[id] = std::move(pool);
+        return id;
+    }
+
+    int destroyPool(MB_POOL id) override {
+        auto it = pools_.find(id);
+        if (it == pools_.end()) {
+            return -1;
+        }
+
+        HostPool& pool = *it->second;
+        {
+            std::lock_guard<std::mutex> lock(pool.mutex);
+            if (pool.freeBlocks.size() != pool.blocks.size()) {
+                printf("ERROR: Host pool %u destroyed with %zu blocks in use\n",
+                       id, pool.blocks.size() - pool.freeBlocks.size());
+                return -1;
+            }
+        }
+
+        freePool(pool);
+        pools_.erase(it);
+        return 0;
+    }
+
+    MB_BLK getBlock(MB_POOL id, uint64_t size, bool cached) override {
+        auto it = pools_.find(id);
+        if (it == pools_.end() || size > it->second->blockSize) {
+            return nullptr;
+        }
+
+        HostPool& pool = *it->second;
+        std::lock_guard<std::mutex> lock(pool.mutex);
+        if (pool.freeBlocks.empty()) {
+            return nullptr;
+        }
+        HostBlock *block = pool.freeBlocks.back();
+        pool.freeBlocks.pop_back();
+        return block;
+    }
+
+    int releaseBlock(MB_BLK handle) override {
+        HostBlock *block = static_cast<HostBlock*>(handle);
+        if (!block->pool) {
+            return -1;
+        }
+
+        std::lock_guard<std::mutex> lock(block->pool->mutex);
+        block->pool->freeBlocks.push_back(block);
+        return 0;
+    }
+
+    void* getVirtualAddress(MB_BLK handle) override {
+        return static_cast<HostBlock*>(handle)->data;
+    }
+
+    int getFd(MB_BLK handle) override {
+        return -1;
+    }
+
+    int syncCache(MB_BLK handle, uint64_t offset, uint64_t size, bool toDevice) override {
+        // malloc память когерентна, согласовывать нечего
+        return 0;
+    }
+
+private:
+    static void freePool(HostPool& pool) {
+        for (HostBlock& block : pool.blocks) {
+            free(block.data);
+            block.data = nullptr;
+        }
+    }
+
+    static std::atomic<MB_POOL> nextPoolId_;
+
+    // Пулы создаются и уничтожаются из одного потока, блоки - из любых
+    std::map<MB_POOL, std::unique_ptr<HostPool>> pools_;
+};
+
+std::atomic<MB_POOL> HostMemoryBackend::nextPoolId_(1);
+
+// ============ H.264 битовый поток ============
+
+/**
+ * @brief Запись RBSP: биты, коды Exp-Golomb и завершающие биты
+ */
+class BitWriter {
+public:
+    explicit BitWriter(std::vector<uint8_t>& out) : out_(out), acc_(0), bits_(0) {}
+
+    void putBits(uint32_t value, int count) {
+        for (int i = count - 1; i >= 0; i--) {
+            acc_ = (uint8_t)((acc_ << 1) | ((value >> i) & 1));
+            if (++bits_ == 8) {
+                out_.push_back(acc_);
+                acc_ = 0;
+                bits_ = 0;
+            }
+        }
+    }
+
+    void putUe(uint32_t value) {
+        uint32_t code = value + 1;
+        int length = 0;
+        while ((code >> length) > 1) {
+            length++;
+        }
+        putBits(0, length);
+        putBits(code, length + 1);
+    }
+
+    void putSe(int32_t value) {
+        putUe(value > 0 ? (uint32_t)(2 * value - 1) : (uint32_t)(-2 * value));
+    }
+
+    void alignZero() {
+        if (bits_) {
+            putBits(0, 8 - bits_);
+        }
+    }
+
+    /**
+     * @brief Байты без выравнивания, писать можно только с границы байта
+     */
+    void putBytes(const uint8_t* data, size_t size) {
+        out_.insert(out_.end(), data, data + size);
+    }
+
+    void trailingBits() {
+        putBits(1, 1);
+        alignZero();
+    }
+
+private:
+    std::vector<uint8_t>& out_;
+    uint8_t acc_;
+    int bits_;
+};
+
+/**
+ * @brief Дописывает NAL со стартовым кодом, вставляя emulation prevention байты
+ */
+void appendNal(std::vector<uint8_t>& out, int refIdc, int type, const std::vector<uint8_t>& rbsp) {
+    static const uint8_t kStartCode[4] = {0, 0, 0, 1};
+    out.insert(out.end(), kStartCode, kStartCode + 4);
+    out.push_back((uint8_t)((refIdc << 5) | type));
+
+    int zeros = 0;
+    for (uint8_t byte : rbsp) {
+        if (zeros == 2 && byte <= 3) {
+            out.push_back(3);
+            zeros = 0;
+        }
+        out.push_back(byte);
+        zeros = byte == 0 ? zeros + 1 : 0;
+    }
+}
+
+// ============ VENC ============
+
+/**
+ * @brief Канал поддельного кодера
+ *
+ * Выдает корректный H.264 Baseline: IDR кадры из I_PCM макроблоков,
+ * то есть несжатое изображение входа, остальные кадры GOP - P кадры
+ * из одних пропущенных макроблоков. Поток декодируется любым плеером,
+ * а число буферов потока ограничено как у VENC.
+ */
+class HostEncoderChannel {
+public:
+    explicit HostEncoderChannel(const EncoderParams& params)
+        : params_(params), frameIndex_(0), frameNum_(0), idrPicId_(0),
+          receiving_(true), forceIdr_(false), seq_(0) {
+        mbWidth_ = (params.width + 15) / 16;
+        mbHeight_ = (params.height + 15) / 16;
+        buffers_.resize(params.streamBufCount ? params.streamBufCount : 1);
+        for (Buffer& buffer : buffers_) {
+            buffer.data.reserve(mbWidth_ * mbHeight_ * 400);
+        }
+        writeParameterSets();
+    }
+
+    void setReceiving(bool receiving) { receiving_ = receiving; }
+    void requestIdr() { forceIdr_ = true; }
+
+    int sendFrame(const VIDEO_FRAME_INFO_S* frame, int timeoutMs) {
+        if (!receiving_) {
+            printf("ERROR: Host VENC: channel is not receiving frames\n");
+            return -1;
+        }
+
+        const VIDEO_FRAME_S& vframe = frame->stVFrame;
+        const HostBlock *block = static_cast<const HostBlock*>(vframe.pMbBlk);
+        if (!block || !block->data) {
+            printf("ERROR: Host VENC: frame without memory block\n");
+            return -1;
+        }
+        if (vframe.enPixelFormat != RK_FMT_BGR888 && vframe.enPixelFormat != RK_FMT_YUV420SP) {
+            printf("ERROR: Host VENC: unsupported pixel format %d\n", vframe.enPixelFormat);
+            return -1;
+        }
+
+        Buffer *buffer = nullptr;
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+            auto hasFree = [this, &buffer]() {
+                for (Buffer& candidate : buffers_) {
+                    if (candidate.state == BufferState::Free) {
+                        buffer = &candidate;
+                        return true;
+                    }
+                }
+                return false;
+            };
+            if (!waitFor(lock, timeoutMs, hasFree)) {
+                return -1;
+            }
+            buffer->state = BufferState::Encoding;
+        }
+
+        // Буфер принадлежит этому потоку до постановки в очередь готовых
+        if (forceIdr_.exchange(false)) {
+            frameIndex_ = 0;
+        }
+        bool idr = frameIndex_ % (params_.gop ? params_.gop : 1) == 0;
+        buffer->data.clear();
+        if (idr) {
+            buffer->data.insert(buffer->data.end(), parameterSets_.begin(), parameterSets_.end());
+            writeIdrSlice(buffer->data, vframe, block->data);
+            frameNum_ = 0;
+        } else {
+            frameNum_ = (frameNum_ + 1) % kMaxFrameNum;
+            writeSkipSlice(buffer->data);
+        }
+        frameIndex_++;
+
+        buffer->block.data = buffer->data.data();
+        buffer->block.size = buffer->data.size();
+        buffer->pts = vframe.u64PTS;
+        buffer->type = idr ? H264E_NALU_IDRSLICE : H264E_NALU_PSLICE;
+
+        std::lock_guard<std::mutex> lock(mutex_);
+        buffer->state = BufferState::Ready;
+        ready_.push_back(buffer);
+        cond_.notify_all();
+        return RK_SUCCESS;
+    }
+
+    int getStream(VENC_STREAM_S* stream, int timeoutMs) {
+        if (!stream->pstPack) {
+            return -1;
+        }
+
+        std::unique_lock<std::mutex> lock(mutex_);
+        if (!waitFor(lock, timeoutMs, [this]() { return !ready_.empty(); })) {
+            return -1;
+        }
+
+        Buffer *buffer = ready_.front();
+        ready_.erase(ready_.begin());
+        buffer->state = BufferState::Out;
+
+        VENC_PACK_S& pack = stream->pstPack[0];
+        memset(&pack, 0, sizeof(VENC_PACK_S));
+        pack.pMbBlk = &buffer->block;
+        pack.u32Len = (RK_U32)buffer->data.size();
+        pack.u64PTS = buffer->pts;
+        pack.bFrameEnd = RK_TRUE;
+        pack.DataType.enH264EType = buffer->type;
+
+        stream->u32PackCount = 1;
+        stream->u32Seq = seq_++;
+        return RK_SUCCESS;
+    }
+
+    int releaseStream(VENC_STREAM_S* stream) {
+        if (!stream->pstPack || stream->u32PackCount == 0) {
+            return -1;
+        }
+
+        std::lock_guard<std::mutex> lock(mutex_);
+        for (Buffer& buffer : buffers_) {
+            if (&buffer.block == stream->pstPack[0].pMbBlk && buffer.state == BufferState::Out) {
+                buffer.state = BufferState::Free;
+                cond_.notify_all();
+                return RK_SUCCESS;
+            }
+        }
+        return -1;
+    }
+
+private:
+    enum class BufferState { Free, Encoding, Ready, Out };
+
+    struct Buffer {
+        std::vector<uint8_t> data;
+        HostBlock block;
+        uint64_t pts = 0;
+        H264E_NALU_TYPE_E type = H264E_NALU_IDRSLICE;
+        BufferState state = BufferState::Free;
+    };
+
+    // log2_max_frame_num = 4
+    static const uint32_t kMaxFrameNum = 16;
+
+    template <typename Predicate>
+    bool waitFor(std::unique_lock<std::mutex>& lock, int timeoutMs, Predicate predicate) {
+        if (timeoutMs < 0) {
+            cond_.wait(lock, predicate);
+            return true;
+        }
+        return cond_.wait_for(lock, std::chrono::milliseconds(timeoutMs), predicate);
+    }
+
+    void writeParameterSets() {
+        std::vector<uint8_t> rbsp;
+        BitWriter sps(rbsp);
+        sps.putBits(66, 8);                 // profile_idc: Baseline
+        sps.putBits(0, 8);                  // constraint flags
+        sps.putBits(40, 8);                 // level_idc
+        sps.putUe(0);                       // seq_parameter_set_id
+        sps.putUe(0);                       // log2_max_frame_num_minus4
+        sps.putUe(2);                       // pic_order_cnt_type: порядок вывода = порядок декодирования
+        sps.putUe(1);                       // max_num_ref_frames
+        sps.putBits(0, 1);                  // gaps_in_frame_num_value_allowed_flag
+        sps.putUe(mbWidth_ - 1);
+        sps.putUe(mbHeight_ - 1);
+        sps.putBits(1, 1);                  // frame_mbs_only_flag
+        sps.putBits(1, 1);                  // direct_8x8_inference_flag
+
+        uint32_t cropRight = (mbWidth_ * 16 - params_.width) / 2;
+        uint32_t cropBottom = (mbHeight_ * 16 - params_.height) / 2;
+        if (cropRight || cropBottom) {
+            sps.putBits(1, 1);
+            sps.putUe(0);
+            sps.putUe(cropRight);
+            sps.putUe(0);
+            sps.putUe(cropBottom);
+        } else {
+            sps.putBits(0, 1);
+        }
+        sps.putBits(0, 1);                  // vui_parameters_present_flag
+        sps.trailingBits();
+        appendNal(parameterSets_, 3, H264E_NALU_SPS, rbsp);
+
+        rbsp.clear();
+        BitWriter pps(rbsp);
+        pps.putUe(0);                       // pic_parameter_set_id
+        pps.putUe(0);                       // seq_parameter_set_id
+        pps.putBits(0, 1);                  // entropy_coding_mode_flag: CAVLC
+        pps.putBits(0, 1);                  // bottom_field_pic_order_in_frame_present_flag
+        pps.putUe(0);                       // num_slice_groups_minus1
+        pps.putUe(0);                       // num_ref_idx_l0_default_active_minus1
+        pps.putUe(0);                       // num_ref_idx_l1_default_active_minus1
+        pps.putBits(0, 1);                  // weighted_pred_flag
+        pps.putBits(0, 2);                  // weighted_bipred_idc
+        pps.putSe(0);                       // pic_init_qp_minus26
+        pps.putSe(0);                       // pic_init_qs_minus26
+        pps.putSe(0);                       // chroma_qp_index_offset
+        pps.putBits(1, 1);                  // deblocking_filter_control_present_flag
+        pps.putBits(0, 1);                  // constrained_intra_pred_flag
+        pps.putBits(0, 1);                  // redundant_pic_cnt_present_flag
+        pps.trailingBits();
+        appendNal(parameterSets_, 3, H264E_NALU_PPS, rbsp);
+    }
+
+    void writeIdrSlice(std::vector<uint8_t>& out, const VIDEO_FRAME_S& frame, const uint8_t* pixels) {
+        rbsp_.clear();
+        BitWriter slice(rbsp_);
+        slice.putUe(0);                     // first_mb_in_slice
+        slice.putUe(7);                     // slice_type: I
+        slice.putUe(0);                     // pic_parameter_set_id
+        slice.putBits(0, 4);                // frame_num
+        slice.putUe(idrPicId_);
+        idrPicId_ ^= 1;                     // Соседние IDR должны различаться
+        slice.putBits(0, 1);                // no_output_of_prior_pics_flag
+        slice.putBits(0, 1);                // long_term_reference_flag
+        slice.putSe(0);                     // slice_qp_delta
+        slice.putUe(1);                     // disable_deblocking_filter_idc
+
+        uint8_t mb[384];
+        for (uint32_t mbY = 0; mbY < mbHeight_; mbY++) {
+            for (uint32_t mbX = 0; mbX < mbWidth_; mbX++) {
+                slice.putUe(25);            // mb_type: I_PCM
+                slice.alignZero();          // pcm_alignment_zero_bit
+                fillMacroblock(mb, frame, pixels, mbX, mbY);
+                slice.putBytes(mb, sizeof(mb));
+            }
+        }
+        slice.trailingBits();
+        appendNal(out, 3, H264E_NALU_IDRSLICE, rbsp_);
+    }
+
+    void writeSkipSlice(std::vector<uint8_t>& out) {
+        rbsp_.clear();
+        BitWriter slice(rbsp_);
+        slice.putUe(0);                     // first_mb_in_slice
+        slice.putUe(5);                     // slice_type: P
+        slice.putUe(0);                     // pic_parameter_set_id
+        slice.putBits(frameNum_, 4);
+        slice.putBits(0, 1);                // num_ref_idx_active_override_flag
+        slice.putBits(0, 1);                // ref_pic_list_modification_flag_l0
+        slice.putBits(0, 1);                // adaptive_ref_pic_marking_mode_flag
+        slice.putSe(0);                     // slice_qp_delta
+        slice.putUe(1);                     // disable_deblocking_filter_idc
+        slice.putUe(mbWidth_ * mbHeight_);  // mb_skip_run: весь кадр
+        slice.trailingBits();
+        appendNal(out, 2, H264E_NALU_PSLICE, rbsp_);
+    }
+
+    /**
+     * @brief Собирает 16x16 Y и 8x8 Cb, Cr макроблока, за краем кадра повторяет край
+     */
+    void fillMacroblock(uint8_t* mb, const VIDEO_FRAME_S& frame, const uint8_t* pixels,
+                        uint32_t mbX, uint32_t mbY) const {
+        const uint32_t width = params_.width;
+        const uint32_t height = params_.height;
+        const uint32_t stride = frame.u32VirWidth ? frame.u32VirWidth : width;
+        const uint32_t virHeight = frame.u32VirHeight ? frame.u32VirHeight : height;
+        const bool nv12 = frame.enPixelFormat == RK_FMT_YUV420SP;
+
+        uint8_t *y = mb;
+        uint8_t *cb = mb + 256;
+        uint8_t *cr = mb + 320;
+
+        for (uint32_t j = 0; j < 8; j++) {
+            for (uint32_t i = 0; i < 8; i++) {
+                int cbSum = 0;
+                int crSum = 0;
+                for (uint32_t k = 0; k < 4; k++) {
+                    uint32_t dx = i * 2 + (k & 1);
+                    uint32_t dy = j * 2 + (k >> 1);
+                    uint32_t px = std::min(mbX * 16 + dx, width - 1);
+                    uint32_t py = std::min(mbY * 16 + dy, height - 1);
+
+                    int Y, U, V;
+                    if (nv12) {
+                        const uint8_t *uv = pixels + stride * virHeight + (py / 2) * stride + (px & ~1u);
+                        Y = pixels[py * stride + px];
+                        U = uv[0];
+                        V = uv[1];
+                    } else {
+                        const uint8_t *bgr = pixels + (py * stride + px) * 3;
+                        int B = bgr[0], G = bgr[1], R = bgr[2];
+                        Y = ((66 * R + 129 * G + 25 * B + 128) >> 8) + 16;
+                        U = ((-38 * R - 74 * G + 112 * B + 128) >> 8) + 128;
+                        V = ((112 * R - 94 * G - 18 * B + 128) >> 8) + 128;
+                    }
+
+                    // Нулевые PCM отсчеты запрещены в ранних редакциях стандарта
+                    y[dy * 16 + dx] = (uint8_t)std::max(Y, 1);
+                    cbSum += U;
+                    crSum += V;
+                }
+                cb[j * 8 + i] = (uint8_t)std::max((cbSum + 2) / 4, 1);
+                cr[j * 8 + i] = (uint8_t)std::max((crSum + 2) / 4, 1);
+            }
+        }
+    }
+
+    EncoderParams params_;
+    uint32_t mbWidth_;
+    uint32_t mbHeight_;
+    std::vector<uint8_t> parameterSets_;
+    std::vector<uint8_t> rbsp_;
+
+    // Используются только потоком sendFrame
+    uint64_t frameIndex_;
+    uint32_t frameNum_;
+    uint32_t idrPicId_;
+
+    std::atomic<bool> receiving_;
+    std::atomic<bool> forceIdr_;
+
+    std::mutex mutex_;
+    std::condition_variable cond_;
+    std::vector<Buffer> buffers_;
+    std::vector<Buffer*> ready_;
+    uint32_t seq_;
+};
+
+class HostEncoderBackend : public EncoderBackend {
+public:
+    int createChannel(int channelId, const EncoderParams& params) override {
+        if (params.codec != RK_VIDEO_ID_AVC) {
+            printf("ERROR: Host VENC supports only H.264\n");
+            return -1;
+        }
+        if (params.width == 0 || params.height == 0 || (params.width | params.height) & 1) {
+            printf("ERROR: Host VENC: bad frame size %ux%u\n", params.width, params.height);
+            return -1;
+        }
+
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (channels_.count(channelId)) {
+            printf("ERROR: Host VENC channel %d already exists\n", channelId);
+            return -1;
+        }
+        channels_[channelId].reset(new HostEncoderChannel(params));
+        return RK_SUCCESS;
+    }
+
+    void destroyChannel(int channelId) override {
+        std::lock_guard<std::mutex> lock(mutex_);
+        channels_.erase(channelId);
+    }
+
+    int stopReceiving(int channelId) override {
+        HostEncoderChannel *channel = findChannel(channelId);
+        if (!channel) {
+            return -1;
+        }
+        channel->setReceiving(false);
+        return RK_SUCCESS;
+    }
+
+    int startReceiving(int channelId) override {
+        HostEncoderChannel *channel = findChannel(channelId);
+        if (!channel) {
+            return -1;
+        }
+        channel->setReceiving(true);
+        return RK_SUCCESS;
+    }
+
+    int requestIdr(int channelId) override {
+        HostEncoderChannel *channel = findChannel(channelId);
+        if (!channel) {
+            return -1;
+        }
+        channel->requestIdr();
+        return RK_SUCCESS;
+    }
+
+    int sendFrame(int channelId, const VIDEO_FRAME_INFO_S* frame, int timeoutMs) override {
+        HostEncoderChannel *channel = findChannel(channelId);
+        return channel ? channel->sendFrame(frame, timeoutMs) : -1;
+    }
+
+    int getStream(int channelId, VENC_STREAM_S* stream, int timeoutMs) override {
+        HostEncoderChannel *channel = findChannel(channelId);
+        return channel ? channel->getStream(stream, timeoutMs) : -1;
+    }
+
+    int releaseStream(int channelId, VENC_STREAM_S* stream) override {
+        HostEncoderChannel *channel = findChannel(channelId);
+        return channel ? channel->releaseStream(stream) : -1;
+    }
+
+    const uint8_t* getPackData(const VENC_PACK_S& pack) override {
+        const HostBlock *block = static_cast<const HostBlock*>(pack.pMbBlk);
+        return block ? block->data : nullptr;
+    }
+
+private:
+    HostEncoderChannel* findChannel(int channelId) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        auto it = channels_.find(channelId);
+        return it != channels_.end() ? it->second.get() : nullptr;
+    }
+
+    std::mutex mutex_;
+    std::map<int, std::unique_ptr<HostEncoderChannel>> channels_;
+};
+
+// ============ VI и VPSS ============
+
+/**
+ * @brief Захват без камеры: кадры NV12 из сырого файла по кругу или тестовая картинка
+ *
+ * Как у VI, буферов канала столько, сколько задано, и пока все они
+ * удерживаются, getFrame ждет возврата буфера. Ветка модели VPSS
+ * повторяется на CPU: ближайший отсчет, BT.601 и заливка полей letterbox.
+ */
+class HostCaptureBackend : public CaptureBackend {
+public:
+    HostCaptureBackend()
+        : file_(nullptr), frameSize_(0), seq_(0), modelCredit_(0),
+          hasReadyModel_(false), opened_(false) {}
+    ~HostCaptureBackend() override { close(); }
+
+    int open(const CaptureParams& params) override {
+        params_ = params;
+        if (params.width == 0 || params.height == 0 || params.width % 2 || params.height % 2) {
+            printf("ERROR: Host VI: bad frame size %ux%u\n", params.width, params.height);
+            return -1;
+        }
+        frameSize_ = (uint64_t)params.width * params.height * 3 / 2;
+
+        const ModelOutputParams& model = params.model;
+        if (model.width > 0 && (model.rectX + model.rectWidth > model.width ||
+                                model.rectY + model.rectHeight > model.height)) {
+            printf("ERROR: Host VPSS: letterbox rect is outside %ux%u\n", model.width, model.height);
+            return -1;
+        }
+
+        if (!params.path.empty()) {
+            file_ = fopen(params.path.c_str(), "rb");
+            if (!file_) {
+                printf("ERROR: Host VI: cannot open %s\n", params.path.c_str());
+                return -1;
+            }
+        }
+
+        if (frames_.allocate(params.bufCount, frameSize_) != 0 ||
+            (model.width > 0 &&
+             modelFrames_.allocate(model.bufCount, (uint64_t)model.width * model.height * 3) != 0)) {
+            printf("ERROR: Host VI: buffer allocation failed\n");
+            close();
+            return -1;
+        }
+
+        opened_ = true;
+        printf("Host VI: %ux%u NV12, %zu buffers, %s\n", params.width, params.height,
+               frames_.blocks.size(), file_ ? params.path.c_str() : "test pattern");
+        if (model.width > 0) {
+            printf("Host VPSS: model branch %ux%u RGB888, image %ux%u at (%u, %u), %d fps\n",
+                   model.width, model.height, model.rectWidth, model.rectHeight,
+                   model.rectX, model.rectY, model.fps);
+        }
+        return 0;
+    }
+
+    void close() override {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (hasReadyModel_) {
+            modelFrames_.release(static_cast<HostBlock*>(readyModel_.stVFrame.pMbBlk));
+            hasReadyModel_ = false;
+        }
+        size_t held = frames_.held() + modelFrames_.held();
+        if (held) {
+            printf("ERROR: Host VI closed with %zu frames not released\n", held);
+        }
+        frames_.clear();
+        modelFrames_.clear();
+        if (file_) {
+            fclose(file_);
+            file_ = nullptr;
+        }
+        opened_ = false;
+        cond_.notify_all();
+    }
+
+    int getFrame(VIDEO_FRAME_INFO_S& frame, int timeoutMs) override {
+        HostBlock *block = nullptr;
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+            auto hasFree = [this]() { return !frames_.freeBlocks.empty() || !opened_; };
+            if (!waitFor(lock, timeoutMs, hasFree)) {
+                printf("ERROR: Host VI: all %zu buffers are held\n", frames_.blocks.size());
+                return -1;
+            }
+            if (!opened_) {
+                return -1;
+            }
+            block = frames_.take();
+        }
+
+        if (!file_) {
+            drawPattern(block->data);
+        } else if (readFrame(block->data) != 0) {
+            releaseBlock(frames_, block);
+            return -1;
+        }
+
+        memset(&frame, 0, sizeof(VIDEO_FRAME_INFO_S));
+        frame.stVFrame.u32Width = params_.width;
+        frame.stVFrame.u32Height = params_.height;
+        frame.stVFrame.u32VirWidth = params_.width;
+        frame.stVFrame.u32VirHeight = params_.height;
+        frame.stVFrame.enPixelFormat = RK_FMT_YUV420SP;
+        frame.stVFrame.pMbBlk = block;
+        frame.stVFrame.u32TimeRef = seq_++;
+        frame.stVFrame.u64PTS = TimerUtils::getCurrentTimeUs();
+
+        if (params_.model.width > 0 && isModelFrameDue()) {
+            produceModelFrame(frame.stVFrame);
+        }
+        return RK_SUCCESS;
+    }
+
+    int releaseFrame(const VIDEO_FRAME_INFO_S& frame) override {
+        HostBlock *block = static_cast<HostBlock*>(frame.stVFrame.pMbBlk);
+        if (!block) {
+            return -1;
+        }
+        releaseBlock(frames_, block);
+        return RK_SUCCESS;
+    }
+
+    int getModelFrame(VIDEO_FRAME_INFO_S& frame, int timeoutMs) override {
+        std::unique_lock<std::mutex> lock(mutex_);
+        if (!waitFor(lock, timeoutMs, [this]() { return hasReadyModel_ || !opened_; }) ||
+            !hasReadyModel_) {
+            return -1;
+        }
+        frame = readyModel_;
+        hasReadyModel_ = false;
+        return RK_SUCCESS;
+    }
+
+    int releaseModelFrame(const VIDEO_FRAME_INFO_S& frame) override {
+        HostBlock *block = static_cast<HostBlock*>(frame.stVFrame.pMbBlk);
+        if (!block) {
+            return -1;
+        }
+        releaseBlock(modelFrames_, block);
+        return RK_SUCCESS;
+    }
+
+    void* getVirtualAddress(MB_BLK handle) override {
+        return static_cast<HostBlock*>(handle)->data;
+    }
+
+private:
+    struct BufferSet {
+        std::vector<HostBlock> blocks;
+        std::vector<HostBlock*> freeBlocks;
+
+        int allocate(uint32_t count, uint64_t size) {
+            blocks.resize(count ? count : 1);
+            for (HostBlock& block : blocks) {
+                void *data = nullptr;
+                if (posix_memalign(&data, 64, size) != 0) {
+                    return -1;
+                }
+                block.data = static_cast<uint8_t*>(data);
+                block.size = size;
+                freeBlocks.push_back(&block);
+            }
+            return 0;
+        }
+
+        void clear() {
+            for (HostBlock& block : blocks) {
+                free(block.data);
+            }
+            blocks.clear();
+            freeBlocks.clear();
+        }
+
+        HostBlock* take() {
+            HostBlock *block = freeBlocks.back();
+            freeBlocks.pop_back();
+            return block;
+        }
+
+        void release(HostBlock* block) { freeBlocks.push_back(block); }
+        size_t held() const { return blocks.size() - freeBlocks.size(); }
+    };
+
+    template <typename Predicate>
+    bool waitFor(std::unique_lock<std::mutex>& lock, int timeoutMs, Predicate predicate) {
+        if (timeoutMs < 0) {
+            cond_.wait(lock, predicate);
+            return true;
+        }
+        return cond_.wait_for(lock, std::chrono::milliseconds(timeoutMs), predicate);
+    }
+
+    void releaseBlock(BufferSet& set, HostBlock* block) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        set.release(block);
+        cond_.notify_all();
+    }
+
+    // Прореживание как у VPSS: fps ветки из fps сенсора
+    bool isModelFrameDue() {
+        if (params_.model.fps <= 0 || params_.model.fps >= params_.fps) {
+            return true;
+        }
+        modelCredit_ += params_.model.fps;
+        if (modelCredit_ < params_.fps) {
+            return false;
+        }
+        modelCredit_ -= params_.fps;
+        return true;
+    }
+
+    void produceModelFrame(const VIDEO_FRAME_S& source) {
+        HostBlock *block = nullptr;
+        {
+            // Все буферы ветки у потребителя: VPSS тоже пропустил бы кадр
+            std::lock_guard<std::mutex> lock(mutex_);
+            if (modelFrames_.freeBlocks.empty()) {
+                return;
+            }
+            block = modelFrames_.take();
+        }
+
+        renderModelFrame(static_cast<const HostBlock*>(source.pMbBlk)->data, block->data);
+
+        VIDEO_FRAME_INFO_S frame;
+        memset(&frame, 0, sizeof(VIDEO_FRAME_INFO_S));
+        frame.stVFrame.u32Width = params_.model.width;
+        frame.stVFrame.u32Height = params_.model.height;
+        frame.stVFrame.u32VirWidth = params_.model.width;
+        frame.stVFrame.u32VirHeight = params_.model.height;
+        frame.stVFrame.enPixelFormat = RK_FMT_RGB888;
+        frame.stVFrame.pMbBlk = block;
+        frame.stVFrame.u32TimeRef = source.u32TimeRef;
+        frame.stVFrame.u64PTS = source.u64PTS;
+
+        // Незабранный кадр вытесняется новым, как в очереди глубины 1
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (hasReadyModel_) {
+            modelFrames_.release(static_cast<HostBlock*>(readyModel_.stVFrame.pMbBlk));
+        }
+        readyModel_ = frame;
+        hasReadyModel_ = true;
+        cond_.notify_all();
+    }
+
+    void renderModelFrame(const uint8_t* nv12, uint8_t* rgb) const {
+        const ModelOutputParams& model = params_.model;
+        const uint8_t bg[3] = {(uint8_t)(model.bgColor >> 16), (uint8_t)(model.bgColor >> 8),
+                               (uint8_t)model.bgColor};
+        const uint8_t *uvPlane = nv12 + params_.width * params_.height;
+
+        for (uint32_t y = 0; y < model.height; y++) {
+            uint8_t *dst = rgb + (size_t)y * model.width * 3;
+            bool inRows = y >= model.rectY && y < model.rectY + model.rectHeight;
+            uint32_t sy = inRows ? (y - model.rectY) * params_.height / model.rectHeight : 0;
+
+            for (uint32_t x = 0; x < model.width; x++, dst += 3) {
+                if (!inRows || x < model.rectX || x >= model.rectX + model.rectWidth) {
+                    dst[0] = bg[0];
+                    dst[1] = bg[1];
+                    dst[2] = bg[2];
+                    continue;
+                }
+
+                uint32_t sx = (x - model.rectX) * params_.width / model.rectWidth;
+                const uint8_t *uv = uvPlane + (sy / 2) * params_.width + (sx & ~1u);
+                int c = 298 * ((int)nv12[sy * params_.width + sx] - 16);
+                int d = (int)uv[0] - 128;
+                int e = (int)uv[1] - 128;
+                dst[0] = clampByte((c + 409 * e + 128) >> 8);
+                dst[1] = clampByte((c - 100 * d - 208 * e + 128) >> 8);
+                dst[2] = clampByte((c + 516 * d + 128) >> 8);
+            }
+        }
+    }
+
+    static uint8_t clampByte(int value) {
+        return (uint8_t)std::min(std::max(value, 0), 255);
+    }
+
+    int readFrame(uint8_t* data) {
+        // Файл читается по кругу, обрезанный последний кадр пропускается
+        for (int attempt = 0; attempt < 2; attempt++) {
+            if (fread(data, 1, frameSize_, file_) == frameSize_) {
+                return 0;
+            }
+            rewind(file_);
+        }
+        printf("ERROR: Host VI: %s is shorter than one frame\n", params_.path.c_str());
+        return -1;
+    }
+
+    // Серый фон и светлый квадрат, пересекающий кадр: есть и движение, и покой
+    void drawPattern(uint8_t* data) const {
+        const uint32_t width = params_.width;
+        const uint32_t height = params_.height;
+        const uint32_t side = std::max(height / 4, 2u) & ~1u;
+        const uint32_t span = width > side ? width - side : 1;
+        const uint32_t period = span * 2;
+        uint32_t phase = (seq_ * 4) % period;
+        uint32_t left = (phase < span ? phase : period - phase) & ~1u;
+        uint32_t top = (height - side) / 2 & ~1u;
+
+        memset(data, 64, width * height);
+        memset(data + width * height, 128, width * height / 2);
+        for (uint32_t y = top; y < top + side; y++) {
+            memset(data + y * width + left, 200, std::min(side, width - left));
+        }
+    }
+
+    CaptureParams params_;
+    FILE* file_;
+    uint64_t frameSize_;
+
+    // Только поток getFrame
+    uint32_t seq_;
+    int modelCredit_;
+
+    std::mutex mutex_;
+    std::condition_variable cond_;
+    BufferSet frames_;
+    BufferSet modelFrames_;
+    VIDEO_FRAME_INFO_S readyModel_;
+    bool hasReadyModel_;
+    bool opened_;
+};
+
+// ============ NPU ============
+
+/**
+ * @brief Поддельный NPU: отдает записанные на плате выходы по кругу
+ *
+ * Путь модели - файл записи (record_outputs) или модель, рядом с которой
+ * лежит запись <path>.npurec. Run() занимает не меньше delayUs.
+ */
+class HostNpuBackend : public NpuBackend {
+public:
+    explicit HostNpuBackend(const NpuOptions& options)
+        : options_(options), nextFrame_(0) {}
+
+    int init(const std::string& modelPath) override {
+        std::string path = modelPath + ".npurec";
+        if (access(path.c_str(), R_OK) != 0) {
+            path = modelPath;
+        }
+        if (recording_.load(path) != 0) {
+            return -1;
+        }
+
+        inputMems_.assign(recording_.getInputAttrs().size(), nullptr);
+        outputMems_.assign(recording_.getOutputAttrs().size(), nullptr);
+        nextFrame_ = 0;
+        return 0;
+    }
+
+    void destroy() override {
+        inputMems_.clear();
+        outputMems_.clear();
+    }
+
+    int queryIoNum(rknn_input_output_num& ioNum) override {
+        ioNum.n_input = (uint32_t)recording_.getInputAttrs().size();
+        ioNum.n_output = (uint32_t)recording_.getOutputAttrs().size();
+        return RKNN_SUCC;
+    }
+
+    int queryInputAttr(rknn_tensor_attr& attr) override {
+        return copyAttr(recording_.getInputAttrs(), attr);
+    }
+
+    int queryOutputAttr(rknn_tensor_attr& attr) override {
+        return copyAttr(recording_.getOutputAttrs(), attr);
+    }
+
+    rknn_tensor_mem* createMem(uint32_t size) override {
+        void *data = nullptr;
+        if (posix_memalign(&data, 64, size) != 0) {
+            return nullptr;
+        }
+        memset(data, 0, size);
+
+        rknn_tensor_mem *mem = new rknn_tensor_mem();
+        memset(mem, 0, sizeof(rknn_tensor_mem));
+        mem->virt_addr = data;
+        mem->fd = -1;
+        mem->size = size;
+        return mem;
+    }
+
+    void destroyMem(rknn_tensor_mem* mem) override {
+        if (mem) {
+            // Импортированный буфер принадлежит пулу или захвату
+            if (mem->flags != RKNN_TENSOR_MEMORY_FLAGS_FROM_FD) {
+                free(mem->virt_addr);
+            }
+            delete mem;
+        }
+    }
+
+    rknn_tensor_mem* importMem(MB_BLK block, int fd, void* virt, uint32_t size) override {
+        if (!virt) {
+            return nullptr;
+        }
+
+        rknn_tensor_mem *mem = new rknn_tensor_mem();
+        memset(mem, 0, sizeof(rknn_tensor_mem));
+        mem->virt_addr = virt;
+        mem->fd = fd;
+        mem->size = size;
+        mem->flags = RKNN_TENSOR_MEMORY_FLAGS_FROM_FD;
+        return mem;
+    }
+
+    int setInputMem(rknn_tensor_mem* mem, rknn_tensor_attr& attr) override {
+        return bindMem(inputMems_, mem, attr);
+    }
+
+    int setOutputMem(rknn_tensor_mem* mem, rknn_tensor_attr& attr) override {
+        return bindMem(outputMems_, mem, attr);
+    }
+
+    // Память поддельного NPU - обычная память процесса, кэш согласован
+    int syncMem(rknn_tensor_mem* mem, bool toDevice) override {
+        return mem ? RKNN_SUCC : RKNN_ERR_PARAM_INVALID;
+    }
+
+    int run() override {
+        auto deadline = std::chrono::steady_clock::now() + std::chrono::microseconds(options_.delayUs);
+
+        const std::vector<rknn_tensor_attr>& attrs = recording_.getOutputAttrs();
+        for (uint32_t i = 0; i < outputMems_.size(); i++) {
+            rknn_tensor_mem *mem = outputMems_[i];
+            if (!mem) {
+                return RKNN_ERR_INPUT_INVALID;
+            }
+            uint32_t size = std::min(attrs[i].size_with_stride, mem->size);
+            memcpy(mem->virt_addr, recording_.getOutput(nextFrame_, i), size);
+        }
+        nextFrame_ = (nextFrame_ + 1) % recording_.getFrameCount();
+
+        std::this_thread::sleep_until(deadline);
+        return RKNN_SUCC;
+    }
+
+private:
+    static int copyAttr(const std::vector<rknn_tensor_attr>& attrs, rknn_tensor_attr& attr) {
+        if (attr.index >= attrs.size()) {
+            return RKNN_ERR_PARAM_INVALID;
+        }
+        attr = attrs[attr.index];
+        return RKNN_SUCC;
+    }
+
+    static int bindMem(std::vector<rknn_tensor_mem*>& mems, rknn_tensor_mem* mem,
+                       const rknn_tensor_attr& attr) {
+        if (!mem || attr.index >= mems.size() || mem->size < attr.size_with_stride) {
+            return RKNN_ERR_PARAM_INVALID;
+        }
+        mems[attr.index] = mem;
+        return RKNN_SUCC;
+    }
+
+    NpuOptions options_;
+    NpuRecording recording_;
+    std::vector<rknn_tensor_mem*> inputMems_;
+    std::vector<rknn_tensor_mem*> outputMems_;
+    uint32_t nextFrame_;
+};
+
+// ============ RTSP ============
+
+/**
+ * @brief RTSP без сети: принимает кадры и проверяет стартовые коды Annex-B
+ */
+class HostRtspBackend : public RtspBackend {
+public:
+    HostRtspBackend() : port_(0), sessions_(0), frames_(0), bytes_(0), created_(false) {}
+    ~HostRtspBackend() override { destroy(); }
+
+    int create(int port) override {
+        port_ = port;
+        created_ = true;
+        printf("Host RTSP: port %d is not opened, frames are only counted\n", port);
+        return 0;
+    }
+
+    int createSession(const char* path) override { return created_ ? sessions_++ : -1; }
+    int setVideo(int session, int codecId, const uint8_t* codecData, int dataLen) override { return 0; }
+    int doEvent() override { return 0; }
+    int syncVideoTimestamp(int session, uint64_t ts, uint64_t ntpTime) override { return 0; }
+
+    int sendVideo(int session, const uint8_t* frame, int len, uint64_t ts) override {
+        bool startCode = len > 4 && frame[0] == 0 && frame[1] == 0 &&
+                         (frame[2] == 1 || (frame[2] == 0 && frame[3] == 1));
+        if (!startCode) {
+            printf("ERROR: Host RTSP: frame is not Annex-B\n");
+            return -1;
+        }
+        frames_++;
+        bytes_ += len;
+        return len;
+    }
+
+    void destroy() override {
+        if (created_) {
+            printf("Host RTSP: %d sessions, %llu frames, %llu bytes\n",
+                   sessions_, (unsigned long long)frames_, (unsigned long long)bytes_);
+            sessions_ = 0;
+            created_ = false;
+        }
+    }
+
+    uint64_t getRelativeTime() override {
+        return TimerUtils::getCurrentTimeUs();
+    }
+
+    uint64_t getNtpTime() override {
+        struct timespec time = {0, 0};
+        clock_gettime(CLOCK_REALTIME, &time);
+        return (uint64_t)time.tv_sec * 1000000 + (uint64_t)time.tv_nsec / 1000;
+    }
+
+    // Сервер не слушает порт: считаем, что поток всегда смотрит один клиент,
+    // иначе на host кодер был бы выключен
+    int getClientCount() override { return created_ ? 1 : 0; }
+
+private:
+    int port_;
+    int sessions_;
+    uint64_t frames_;
+    uint64_t bytes_;
+    bool created_;
+};
+
+} // namespace
+
+// ============ Платформа ============
+
+int initPlatform() {
+    return 0;
+}
+
+void exitPlatform() {
+}
+
+const char* getPlatformName() {
+    return "host";
+}
+
+std::unique_ptr<MemoryBackend> createMemoryBackend() {
+    return std::unique_ptr<MemoryBackend>(new HostMemoryBackend());
+}
+
+std::unique_ptr<EncoderBackend> createEncoderBackend() {
+    return std::unique_ptr<EncoderBackend>(new HostEncoderBackend());
+}
+
+std::unique_ptr<CaptureBackend> createCaptureBackend() {
+    return std::unique_ptr<CaptureBackend>(new HostCaptureBackend());
+}
+
+std::unique_ptr<NpuBackend> createNpuBackend(const NpuOptions& options) {
+    return std::unique_ptr<NpuBackend>(new HostNpuBackend(options));
+}
+
+std::unique_ptr<RtspBackend> createRtspBackend() {
+    return std::unique_ptr<RtspBackend>(new HostRtspBackend());
+}
@@ -0,0 +1,107 @@
+#include "inference_scheduler.h"
+#include <algorithm>
+#include <cstdio>
+
+InferenceScheduler::InferenceScheduler(const SchedulerConfig& config)
+    : config_(config), head_(0), count_(0), started_(false), lastRunSeq_(0),
+      stride_(config.minStride), p50Us_(0), p95Us_(0), expectedStalenessUs_(0),
+      runs_(0), strideChanges_(0), checkedFrames_(0), budgetMisses_(0) {
+    if (config_.targetFps <= 0.0f) {
+        config_.targetFps = 30.0f;
+    }
+    if (config_.minStride == 0) {
+        config_.minStride = 1;
+    }
+    config_.maxStride = std::max(config_.maxStride, config_.minStride);
+    stride_ = config_.minStride;
+    frameIntervalUs_ = (uint64_t)(1000000.0f / config_.targetFps);
+}
+
+bool InferenceScheduler::shouldRun(uint32_t frameSeq) const {
+    return !started_ || frameSeq - lastRunSeq_ >= getStride();
+}
+
+void InferenceScheduler::markRun(uint32_t frameSeq) {
+    started_ = true;
+    lastRunSeq_ = frameSeq;
+}
+
+void InferenceScheduler::recordRun(uint64_t durationUs, uint64_t nowUs) {
+    samples_[head_] = Sample{nowUs, durationUs};
+    head_ = (head_ + 1) % kMaxSamples;
+    count_ = std::min(count_ + 1, kMaxSamples);
+    runs_++;
+
+    // Замеры старше окна выбрасываются, чтобы быстро реагировать на смену нагрузки
+    uint64_t windowUs = (uint64_t)config_.windowMs * 1000;
+    uint64_t durations[kMaxSamples];
+    int n = 0;
+    for (int i = 0; i < count_; i++) {
+        const Sample& sample = samples_[(head_ - 1 - i + kMaxSamples) % kMaxSamples];
+        if (nowUs - sample.timeUs > windowUs) {
+            break;
+        }
+        durations[n++] = sample.durationUs;
+    }
+    count_ = n;
+
+    std::nth_element(durations, durations + n / 2, durations + n);
+    uint64_t p50Us = durations[n / 2];
+    int p95Index = std::min(n - 1, (n * 95) / 100);
+    std::nth_element(durations, durations + p95Index, durations + n);
+    uint64_t p95Us = durations[p95Index];
+
+    p50Us_ = p50Us;
+    p95Us_ = p95Us;
+    updateStride(p50Us, p95Us);
+}
+
+void InferenceScheduler::updateStride(uint64_t p50Us, uint64_t p95Us) {
+    uint64_t budgetUs = (uint64_t)config_.maxStalenessMs * 1000;
+
+    // Наименьший шаг, при котором NPU успевает до прихода следующего входа
+    uint64_t minStride = (p95Us + frameIntervalUs_ - 1) / frameIntervalUs_;
+
+    // Детекция держится на экране stride кадров после готовности, поэтому
+    // худшее устаревание = stride * интервал кадра + время инференса
+    uint64_t budgetStride = budgetUs > p95Us ? (budgetUs - p95Us) / frameIntervalUs_ : 0;
+
+    // Чаще NPU не успеет; реже - без нужды растет устаревание. Если бюджет
+    // меньше успеваемого шага, побеждает бюджет: лишние кадры уйдут без входа
+    uint64_t stride = minStride;
+    if (budgetStride > 0) {
+        stride = std::min(stride, budgetStride);
+    }
+    stride = std::max<uint64_t>(stride, config_.minStride);
+    stride = std::min<uint64_t>(stride, config_.maxStride);
+
+    expectedStalenessUs_ = stride * frameIntervalUs_ + p95Us;
+
+    uint32_t previous = stride_.exchange((uint32_t)stride, std::memory_order_relaxed);
+    if (previous != stride) {
+        strideChanges_++;
+        printf("Inference stride %u -> %u (p50 %llu us, p95 %llu us)\n",
+               previous, (uint32_t)stride,
+               (unsigned long long)p50Us, (unsigned long long)p95Us);
+    }
+}
+
+void InferenceScheduler::recordStaleness(uint64_t stalenessUs) {
+    checkedFrames_++;
+    if (stalenessUs > (uint64_t)config_.maxStalenessMs * 1000) {
+        budgetMisses_++;
+    }
+}
+
+SchedulerStats InferenceScheduler::getStats() const {
+    SchedulerStats stats;
+    stats.stride = stride_.load();
+    stats.p50Us = p50Us_.load();
+    stats.p95Us = p95Us_.load();
+    stats.expectedStalenessUs = expectedStalenessUs_.load();
+    stats.runs = runs_.load();
+    stats.strideChanges = strideChanges_.load();
+    stats.checkedFrames = checkedFrames_.load();
+    stats.budgetMisses = budgetMisses_.load();
+    return stats;
+}
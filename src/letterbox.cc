@@ -0,0 +1,273 @@
+#include "letterbox.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#elif defined(__ARM_NEON)
+#include <arm_neon.h>
+#endif
+
+Letterbox computeLetterbox(int frameWidth, int frameHeight, int modelWidth, int modelHeight) {
+    Letterbox box;
+    box.scale = std::min((float)modelWidth / frameWidth, (float)modelHeight / frameHeight);
+    box.width = std::max((int)(frameWidth * box.scale) & ~1, 2);
+    box.height = std::max((int)(frameHeight * box.scale) & ~1, 2);
+    box.offsetX = ((modelWidth - box.width) / 2) & ~1;
+    box.offsetY = ((modelHeight - box.height) / 2) & ~1;
+    return box;
+}
+
+// Веса интерполяции Q7: 8-битные множители для vmull_u8, сумма весов 128
+static const int kWeightBits = 7;
+static const int kWeightOne = 1 << kWeightBits;
+
+// BT.601 ограниченного диапазона в RGB, коэффициенты Q6 (как COLOR_YUV2RGB_NV12)
+static const int kYScale = 75;      // 1.164
+static const int kVToR = 102;       // 1.596
+static const int kVToG = 52;        // 0.813
+static const int kUToG = 25;        // 0.391
+static const int kUToB = 129;       // 2.018
+
+static inline uint8_t lerp(int a, int b, int weight) {
+    return (uint8_t)((a * (kWeightOne - weight) + b * weight + kWeightOne / 2) >> kWeightBits);
+}
+
+static inline uint8_t clampPixel(int value) {
+    return (uint8_t)std::min(std::max(value >> 6, 0), 255);
+}
+
+static inline void yuvToRgb(int y, int u, int v, uint8_t *dst) {
+    int luma = (y - 16) * kYScale + 32;
+    u -= 128;
+    v -= 128;
+    dst[0] = clampPixel(luma + kVToR * v);
+    dst[1] = clampPixel(luma - kVToG * v - kUToG * u);
+    dst[2] = clampPixel(luma + kUToB * u);
+}
+
+// Строка выхода: вертикальная интерполяция двух сжатых строк и перевод в RGB
+static void convertRow(const uint8_t *y0, const uint8_t *y1, int lumaWeight,
+                       const uint8_t *u0, const uint8_t *u1, const uint8_t *v0, const uint8_t *v1,
+                       int chromaWeight, uint8_t *dst, int width) {
+    int x = 0;
+#if defined(__SSE2__)
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i lumaA = _mm_set1_epi16((short)(kWeightOne - lumaWeight));
+    const __m128i lumaB = _mm_set1_epi16((short)lumaWeight);
+    const __m128i chromaA = _mm_set1_epi16((short)(kWeightOne - chromaWeight));
+    const __m128i chromaB = _mm_set1_epi16((short)chromaWeight);
+    const __m128i round = _mm_set1_epi16(kWeightOne / 2);
+    const __m128i lumaBias = _mm_set1_epi16(16);
+    const __m128i chromaBias = _mm_set1_epi16(128);
+    const __m128i lumaRound = _mm_set1_epi16(32);
+
+    auto blend = [&](const uint8_t *a, const uint8_t *b, __m128i wa, __m128i wb) {
+        __m128i pa = _mm_unpacklo_epi8(_mm_loadl_epi64((const __m128i*)a), zero);
+        __m128i pb = _mm_unpacklo_epi8(_mm_loadl_epi64((const __m128i*)b), zero);
+        __m128i sum = _mm_add_epi16(_mm_mullo_epi16(pa, wa), _mm_mullo_epi16(pb, wb));
+        return _mm_srli_epi16(_mm_add_epi16(sum, round), kWeightBits);
+    };
+
+    alignas(16) uint8_t planes[3][16];
+    for (; x + 8 <= width; x += 8) {
+        __m128i y = _mm_sub_epi16(blend(y0 + x, y1 + x, lumaA, lumaB), lumaBias);
+        __m128i u = _mm_sub_epi16(blend(u0 + x, u1 + x, chromaA, chromaB), chromaBias);
+        __m128i v = _mm_sub_epi16(blend(v0 + x, v1 + x, chromaA, chromaB), chromaBias);
+
+        __m128i luma = _mm_add_epi16(_mm_mullo_epi16(y, _mm_set1_epi16(kYScale)), lumaRound);
+        __m128i r = _mm_adds_epi16(luma, _mm_mullo_epi16(v, _mm_set1_epi16(kVToR)));
+        __m128i g = _mm_subs_epi16(_mm_subs_epi16(luma, _mm_mullo_epi16(v, _mm_set1_epi16(kVToG))),
+                                   _mm_mullo_epi16(u, _mm_set1_epi16(kUToG)));
+        __m128i b = _mm_adds_epi16(luma, _mm_mullo_epi16(u, _mm_set1_epi16(kUToB)));
+
+        _mm_storel_epi64((__m128i*)planes[0], _mm_packus_epi16(_mm_srai_epi16(r, 6), zero));
+        _mm_storel_epi64((__m128i*)planes[1], _mm_packus_epi16(_mm_srai_epi16(g, 6), zero));
+        _mm_storel_epi64((__m128i*)planes[2], _mm_packus_epi16(_mm_srai_epi16(b, 6), zero));
+
+        // У SSE2 нет чередующей записи, как vst3 у NEON
+        uint8_t *out = dst + x * 3;
+        for (int i = 0; i < 8; i++) {
+            out[0] = planes[0][i];
+            out[1] = planes[1][i];
+            out[2] = planes[2][i];
+            out += 3;
+        }
+    }
+#elif defined(__ARM_NEON)
+    const uint8x8_t lumaA = vdup_n_u8((uint8_t)(kWeightOne - lumaWeight));
+    const uint8x8_t lumaB = vdup_n_u8((uint8_t)lumaWeight);
+    const uint8x8_t chromaA = vdup_n_u8((uint8_t)(kWeightOne - chromaWeight));
+    const uint8x8_t chromaB = vdup_n_u8((uint8_t)chromaWeight);
+    const int16x8_t lumaRound = vdupq_n_s16(32);
+
+    auto blend = [](const uint8_t *a, const uint8_t *b, uint8x8_t wa, uint8x8_t wb) {
+        uint16x8_t sum = vmlal_u8(vmull_u8(vld1_u8(a), wa), vld1_u8(b), wb);
+        return vreinterpretq_s16_u16(vrshrq_n_u16(sum, kWeightBits));
+    };
+
+    for (; x + 8 <= width; x += 8) {
+        int16x8_t y = vsubq_s16(blend(y0 + x, y1 + x, lumaA, lumaB), vdupq_n_s16(16));
+        int16x8_t u = vsubq_s16(blend(u0 + x, u1 + x, chromaA, chromaB), vdupq_n_s16(128));
+        int16x8_t v = vsubq_s16(blend(v0 + x, v1 + x, chromaA, chromaB), vdupq_n_s16(128));
+
+        int16x8_t luma = vmlaq_n_s16(lumaRound, y, kYScale);
+        int16x8_t r = vqaddq_s16(luma, vmulq_n_s16(v, kVToR));
+        int16x8_t g = vqsubq_s16(vqsubq_s16(luma, vmulq_n_s16(v, kVToG)), vmulq_n_s16(u, kUToG));
+        int16x8_t b = vqaddq_s16(luma, vmulq_n_s16(u, kUToB));
+
+        uint8x8x3_t rgb;
+        rgb.val[0] = vqshrun_n_s16(r, 6);
+        rgb.val[1] = vqshrun_n_s16(g, 6);
+        rgb.val[2] = vqshrun_n_s16(b, 6);
+        vst3_u8(dst + x * 3, rgb);
+    }
+#endif
+    for (; x < width; x++) {
+        yuvToRgb(lerp(y0[x], y1[x], lumaWeight),
+                 lerp(u0[x], u1[x], chromaWeight),
+                 lerp(v0[x], v1[x], chromaWeight), dst + x * 3);
+    }
+}
+
+// Отсчеты для выхода [0, count): центры пикселей выхода в координатах источника.
+// subsample - во сколько раз цвет реже яркости, step - байт между отсчетами
+void YuvLetterbox::buildTaps(std::vector<Tap>& taps, int count, int frameSize,
+                             int subsample, int step) {
+    int size = (frameSize + subsample - 1) / subsample;
+    double ratio = (double)frameSize / count;
+
+    taps.resize(count);
+    for (int i = 0; i < count; i++) {
+        double source = ((i + 0.5) * ratio) / subsample - 0.5;
+        source = std::min(std::max(source, 0.0), (double)(size - 1));
+        int first = (int)source;
+        Tap& tap = taps[i];
+        tap.offset0 = first * step;
+        tap.offset1 = std::min(first + 1, size - 1) * step;
+        tap.weight = (int)lround((source - first) * kWeightOne);
+    }
+}
+
+YuvLetterbox::YuvLetterbox()
+    : layout_(YuvLayout::Nv12), frameWidth_(0), frameHeight_(0),
+      modelWidth_(0), modelHeight_(0), pitch_(0), fill_(114) {
+    memset(&box_, 0, sizeof(box_));
+}
+
+int YuvLetterbox::configure(YuvLayout layout, int frameWidth, int frameHeight,
+                            int modelWidth, int modelHeight, size_t pitch, uint8_t fill) {
+    if (frameWidth < 2 || frameHeight < 2 || modelWidth <= 0 || modelHeight <= 0 ||
+        pitch < (size_t)modelWidth * 3) {
+        printf("ERROR: YUV letterbox: invalid sizes %dx%d -> %dx%d\n",
+               frameWidth, frameHeight, modelWidth, modelHeight);
+        return -1;
+    }
+
+    layout_ = layout;
+    frameWidth_ = frameWidth;
+    frameHeight_ = frameHeight;
+    modelWidth_ = modelWidth;
+    modelHeight_ = modelHeight;
+    pitch_ = pitch;
+    fill_ = fill;
+    box_ = computeLetterbox(frameWidth, frameHeight, modelWidth, modelHeight);
+
+    // Смещения в байтах строки: NV12 - Y подряд, пары UV; YUYV - Y через байт, U V в четверке
+    bool packed = layout == YuvLayout::Yuyv;
+    buildTaps(lumaX_, box_.width, frameWidth, 1, packed ? 2 : 1);
+    buildTaps(chromaX_, box_.width, frameWidth, 2, packed ? 4 : 2);
+    buildTaps(lumaY_, box_.height, frameHeight, 1, 1);
+    buildTaps(chromaY_, box_.height, frameHeight, packed ? 1 : 2, 1);
+
+    for (int i = 0; i < 2; i++) {
+        luma_[i].index = -1;
+        luma_[i].y.resize(box_.width);
+        chroma_[i].index = -1;
+        chroma_[i].u.resize(box_.width);
+        chroma_[i].v.resize(box_.width);
+    }
+    return 0;
+}
+
+const uint8_t* YuvLetterbox::getLumaRow(const YuvImage& image, int row, int keep) {
+    for (LumaRow& cached : luma_) {
+        if (cached.index == row) {
+            return cached.y.data();
+        }
+    }
+
+    // Вытесняется строка, которая не нужна для текущей строки выхода
+    LumaRow& slot = luma_[0].index == keep ? luma_[1] : luma_[0];
+    const uint8_t *src = image.data + (size_t)row * image.stride;
+    for (int x = 0; x < box_.width; x++) {
+        const Tap& tap = lumaX_[x];
+        slot.y[x] = lerp(src[tap.offset0], src[tap.offset1], tap.weight);
+    }
+    slot.index = row;
+    return slot.y.data();
+}
+
+const YuvLetterbox::ChromaRow& YuvLetterbox::getChromaRow(const YuvImage& image, int row, int keep) {
+    for (ChromaRow& cached : chroma_) {
+        if (cached.index == row) {
+            return cached;
+        }
+    }
+
+    ChromaRow& slot = chroma_[0].index == keep ? chroma_[1] : chroma_[0];
+    const bool packed = image.layout == YuvLayout::Yuyv;
+    const uint8_t *src = (packed ? image.data : image.uv) + (size_t)row * image.stride;
+    const uint8_t *u = src + (packed ? 1 : 0);
+    const uint8_t *v = src + (packed ? 3 : 1);
+    for (int x = 0; x < box_.width; x++) {
+        const Tap& tap = chromaX_[x];
+        slot.u[x] = lerp(u[tap.offset0], u[tap.offset1], tap.weight);
+        slot.v[x] = lerp(v[tap.offset0], v[tap.offset1], tap.weight);
+    }
+    slot.index = row;
+    return slot;
+}
+
+int YuvLetterbox::convert(const YuvImage& image, uint8_t* dst) {
+    if (image.layout != layout_ || image.width != frameWidth_ || image.height != frameHeight_ ||
+        !image.data || (layout_ == YuvLayout::Nv12 && !image.uv)) {
+        printf("ERROR: YUV letterbox: frame %dx%d does not match configured %dx%d\n",
+               image.width, image.height, frameWidth_, frameHeight_);
+        return -1;
+    }
+
+    // Кэш строк действителен только в пределах кадра
+    for (int i = 0; i < 2; i++) {
+        luma_[i].index = -1;
+        chroma_[i].index = -1;
+    }
+
+    const size_t rowBytes = (size_t)modelWidth_ * 3;
+    const size_t leftBytes = (size_t)box_.offsetX * 3;
+    const size_t boxBytes = (size_t)box_.width * 3;
+    for (int y = 0; y < modelHeight_; y++) {
+        uint8_t *row = dst + (size_t)y * pitch_;
+        int boxRow = y - box_.offsetY;
+        if (boxRow < 0 || boxRow >= box_.height) {
+            memset(row, fill_, rowBytes);
+            continue;
+        }
+
+        memset(row, fill_, leftBytes);
+        memset(row + leftBytes + boxBytes, fill_, rowBytes - leftBytes - boxBytes);
+
+        const Tap& lumaTap = lumaY_[boxRow];
+        const Tap& chromaTap = chromaY_[boxRow];
+        const uint8_t *luma0 = getLumaRow(image, lumaTap.offset0, lumaTap.offset1);
+        const uint8_t *luma1 = getLumaRow(image, lumaTap.offset1, lumaTap.offset0);
+        const ChromaRow& chroma0 = getChromaRow(image, chromaTap.offset0, chromaTap.offset1);
+        const ChromaRow& chroma1 = getChromaRow(image, chromaTap.offset1, chromaTap.offset0);
+
+        convertRow(luma0, luma1, lumaTap.weight,
+                   chroma0.u.data(), chroma1.u.data(), chroma0.v.data(), chroma1.v.data(),
+                   chromaTap.weight, row + leftBytes, box_.width);
+    }
+    return 0;
+}
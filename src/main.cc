@@ -3,7 +3,14 @@
 
 int main(int argc, char *argv[]) {
 
-    App app(720, 480, 554);
+    // Без файла конфигурации используется граф по умолчанию
+    PipelineConfig config = PipelineConfig::makeDefault();
+    if (argc > 1 && config.load(argv[1]) != 0) {
+        printf("ERROR: cant load config %s\n", argv[1]);
+        return -1;
+    }
+
+    App app(config);
 
     if (!app.init()) {
         printf("ERROR: cant initialize app\n");
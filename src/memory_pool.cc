@@ -1,10 +1,157 @@
 #include "memory_pool.h"
+#include <algorithm>
 #include <cstdio>
 #include <cstring>
+#include <unistd.h>
+#include "utilities.h"
 
-MemoryPool::MemoryPool(uint64_t bufferSize, uint32_t bufferCount)
-    : poolId_(0), bufferSize_(bufferSize), bufferCount_(bufferCount),
-      initialized_(false) {
+// Шаг опроса при ожидании блока: освобождение lock-free и никого не будит
+static const uint64_t kWaitStepUs = 200;
+
+// Кэш согласуется строками: участки выравниваются на их границы
+static const uint64_t kCacheLineBytes = 64;
+
+const char* getPoolOwnerName(PoolOwner owner) {
+    switch (owner) {
+        case PoolOwner::None: return "free";
+        case PoolOwner::Capture: return "capture";
+        case PoolOwner::Npu: return "npu";
+        case PoolOwner::Encoder: return "encoder";
+        case PoolOwner::Recorder: return "recorder";
+        default: return "unknown";
+    }
+}
+
+// Поднимает атомарный максимум до value
+template <typename T>
+static void updateMax(std::atomic<T>& max, T value) {
+    T current = max.load(std::memory_order_relaxed);
+    while (value > current && !max.compare_exchange_weak(current, value, std::memory_order_relaxed)) {
+    }
+}
+
+void DirtyRanges::add(uint64_t offset, uint64_t size, uint64_t limit) {
+    if (size == 0 || offset >= limit) {
+        return;
+    }
+    uint64_t begin = offset & ~(kCacheLineBytes - 1);
+    uint64_t end = std::min((offset + size + kCacheLineBytes - 1) & ~(kCacheLineBytes - 1), limit);
+
+    // Участок поглощает все, с чем пересекается или соприкасается
+    uint32_t count = 0;
+    uint32_t insert = 0;
+    Range merged[kMaxRanges + 1];
+    for (uint32_t i = 0; i < count_; i++) {
+        const Range& range = ranges_[i];
+        if (range.end < begin) {
+            merged[count++] = range;
+            insert = count;
+        } else if (range.begin > end) {
+            merged[count++] = range;
+        } else {
+            begin = std::min(begin, range.begin);
+            end = std::max(end, range.end);
+        }
+    }
+    for (uint32_t i = count; i > insert; i--) {
+        merged[i] = merged[i - 1];
+    }
+    merged[insert] = Range{begin, end};
+    count++;
+
+    // Участков больше предела: сливаются два соседних с наименьшим зазором
+    if (count > kMaxRanges) {
+        uint32_t closest = 0;
+        for (uint32_t i = 1; i + 1 < count; i++) {
+            if (merged[i + 1].begin - merged[i].end < merged[closest + 1].begin - merged[closest].end) {
+                closest = i;
+            }
+        }
+        merged[closest].end = merged[closest + 1].end;
+        for (uint32_t i = closest + 1; i + 1 < count; i++) {
+            merged[i] = merged[i + 1];
+        }
+        count--;
+    }
+
+    std::copy(merged, merged + count, ranges_);
+    count_ = count;
+}
+
+MemoryBlock& MemoryBlock::operator=(MemoryBlock&& other) noexcept {
+    if (this != &other) {
+        reset();
+        pool_ = std::move(other.pool_);
+        index_ = other.index_;
+    }
+    return *this;
+}
+
+void MemoryBlock::reset() {
+    if (pool_) {
+        // Ссылка отпускается после возврата: блок мог быть последним, что держит пул
+        std::shared_ptr<MemoryPool> pool = std::move(pool_);
+        pool->release(index_);
+    }
+}
+
+MB_BLK MemoryBlock::get() const {
+    return pool_ ? pool_->blocks_[index_].handle : nullptr;
+}
+
+void* MemoryBlock::data() const {
+    return pool_ ? pool_->blocks_[index_].data : nullptr;
+}
+
+int MemoryBlock::fd() const {
+    return pool_ ? pool_->blocks_[index_].fd : -1;
+}
+
+uint64_t MemoryBlock::size() const {
+    return pool_ ? pool_->bufferSize_ : 0;
+}
+
+void MemoryBlock::setOwner(PoolOwner owner) const {
+    if (pool_) {
+        pool_->blocks_[index_].owner.store((uint8_t)owner, std::memory_order_relaxed);
+    }
+}
+
+int MemoryBlock::beginCpuAccess(uint64_t offset, uint64_t size) const {
+    if (!pool_) {
+        return -1;
+    }
+    return pool_->syncCache(index_, offset, size ? size : pool_->bufferSize_ - offset, false);
+}
+
+void MemoryBlock::markDirty(uint64_t offset, uint64_t size) const {
+    if (pool_) {
+        pool_->blocks_[index_].dirty.add(offset, size, pool_->bufferSize_);
+    }
+}
+
+int MemoryBlock::endCpuAccess() const {
+    if (!pool_) {
+        return -1;
+    }
+
+    MemoryPool::Block& block = pool_->blocks_[index_];
+    int ret = 0;
+    for (uint32_t i = 0; i < block.dirty.count(); i++) {
+        const DirtyRanges::Range& range = block.dirty[i];
+        if (pool_->syncCache(index_, range.begin, range.end - range.begin, true) != 0) {
+            ret = -1;
+        }
+    }
+    block.dirty.clear();
+    return ret;
+}
+
+MemoryPool::MemoryPool(uint64_t bufferSize, uint32_t bufferCount, const std::string& name)
+    : name_(name), backend_(createMemoryBackend()), poolId_(MB_INVALID_POOLID), bufferSize_(bufferSize),
+      bufferCount_(bufferCount), initialized_(false), head_(kNoBlock), inUse_(0), peak_(0), acquired_(0),
+      exhausted_(0), waits_(0), waitUsSum_(0), waitUsMax_(0), flushedBytes_(0), invalidatedBytes_(0),
+      cacheSyncs_(0) {
 }
 
 MemoryPool::~MemoryPool() {
@@ -12,58 +159,200 @@ MemoryPool::~MemoryPool() {
 }
 
 int MemoryPool::init() {
-    printf("%s: size=%llu, count=%u\n", __func__, bufferSize_, bufferCount_);
-
-    MB_POOL_CONFIG_S PoolCfg;
-    memset(&PoolCfg, 0, sizeof(MB_POOL_CONFIG_S));
-    PoolCfg.u64MBSize = bufferSize_ ;
-    PoolCfg.u32MBCnt = bufferCount_;
-    PoolCfg.enAllocType = MB_ALLOC_TYPE_DMA;
+    printf("%s: pool '%s', size=%llu, count=%u\n", __func__, name_.c_str(),
+           (unsigned long long)bufferSize_, bufferCount_);
+    if (bufferCount_ == 0) {
+        printf("ERROR: Memory pool needs at least one block\n");
+        return -1;
+    }
 
-    poolId_ = RK_MPI_MB_CreatePool(&PoolCfg);
+    poolId_ = backend_->createPool(bufferSize_, bufferCount_);
+    if (poolId_ == MB_INVALID_POOLID) {
+        printf("ERROR: Failed to create memory pool\n");
+        return -1;
+    }
     printf("Pool id: %d\n", poolId_);
 
+    // Блоки держатся пулом до destroy(): MPI больше не участвует в обороте кадров
+    blocks_.reset(new Block[bufferCount_]);
+    for (uint32_t i = 0; i < bufferCount_; i++) {
+        Block& block = blocks_[i];
+        block.handle = backend_->getBlock(poolId_, bufferSize_, true);
+        block.data = block.handle ? backend_->getVirtualAddress(block.handle) : nullptr;
+        if (!block.data) {
+            printf("ERROR: Failed to map memory block %u\n", i);
+            if (block.handle) {
+                backend_->releaseBlock(block.handle);
+            }
+            releaseBlocks(i);
+            backend_->destroyPool(poolId_);
+            poolId_ = MB_INVALID_POOLID;
+            return -1;
+        }
+        block.fd = backend_->getFd(block.handle);
+        block.owner.store((uint8_t)PoolOwner::None, std::memory_order_relaxed);
+        block.acquiredUs.store(0, std::memory_order_relaxed);
+        block.dirty.clear();
+        block.next.store(i + 1 < bufferCount_ ? i + 1 : kNoBlock, std::memory_order_relaxed);
+    }
+    head_.store(0, std::memory_order_release);
+
     initialized_ = true;
     printf("Memory pool created successfully\n");
     return 0;
 }
 
-MB_BLK MemoryPool::getMemoryBlock(bool cached) const {
-    if (!initialized_) {
-        printf("ERROR: Memory pool not initialized\n");
-        return nullptr;
+MemoryBlock MemoryPool::acquire(PoolOwner owner, uint64_t timeoutUs) {
+    MemoryBlock block = tryAcquire(owner);
+    if (block || !timeoutUs) {
+        if (!block) {
+            exhausted_.fetch_add(1, std::memory_order_relaxed);
+        }
+        return block;
     }
 
-    MB_BLK block = RK_MPI_MB_GetMB(poolId_, bufferSize_, static_cast<RK_BOOL>(cached));
-    if (!block) {
-        printf("ERROR: Failed to get memory block from pool\n");
-        return nullptr;
+    // Все блоки заняты: ждем, пока кадр в обороте отпустят
+    uint64_t startUs = TimerUtils::getCurrentTimeUs();
+    uint64_t nowUs = startUs;
+    while (!block && nowUs - startUs < timeoutUs) {
+        usleep(kWaitStepUs);
+        block = tryAcquire(owner);
+        nowUs = TimerUtils::getCurrentTimeUs();
     }
 
+    uint64_t waitUs = nowUs - startUs;
+    waits_.fetch_add(1, std::memory_order_relaxed);
+    waitUsSum_.fetch_add(waitUs, std::memory_order_relaxed);
+    updateMax(waitUsMax_, waitUs);
+    if (!block) {
+        exhausted_.fetch_add(1, std::memory_order_relaxed);
+    }
     return block;
 }
 
-void* MemoryPool::getVirtualAddress(MB_BLK block) const {
-    if (!block) {
-        printf("ERROR: Block is null\n");
-        return nullptr;
+MemoryBlock MemoryPool::tryAcquire(PoolOwner owner) {
+    uint64_t head = head_.load(std::memory_order_acquire);
+    for (;;) {
+        uint32_t index = (uint32_t)head;
+        if (index == kNoBlock) {
+            return MemoryBlock();
+        }
+
+        // next мог устареть, если блок успели забрать и вернуть: тогда версия
+        // вершины уже другая и CAS не пройдет
+        uint32_t next = blocks_[index].next.load(std::memory_order_relaxed);
+        uint64_t newHead = (((head >> 32) + 1) << 32) | next;
+        if (head_.compare_exchange_weak(head, newHead, std::memory_order_acquire,
+                                        std::memory_order_acquire)) {
+            Block& block = blocks_[index];
+            block.dirty.clear();
+            // Время раньше метки: отчет не увидит новую метку со старым временем
+            block.acquiredUs.store(TimerUtils::getCurrentTimeUs(), std::memory_order_relaxed);
+            block.owner.store((uint8_t)owner, std::memory_order_release);
+            updateMax(peak_, inUse_.fetch_add(1, std::memory_order_relaxed) + 1);
+            acquired_.fetch_add(1, std::memory_order_relaxed);
+            return MemoryBlock(shared_from_this(), index);
+        }
     }
+}
 
-    void *addr = RK_MPI_MB_Handle2VirAddr(block);
-    if (!addr) {
-        printf("ERROR: Failed to get virtual address\n");
-        return nullptr;
+void MemoryPool::release(uint32_t index) {
+    blocks_[index].owner.store((uint8_t)PoolOwner::None, std::memory_order_relaxed);
+    inUse_.fetch_sub(1, std::memory_order_relaxed);
+
+    uint64_t head = head_.load(std::memory_order_relaxed);
+    uint64_t newHead;
+    do {
+        blocks_[index].next.store((uint32_t)head, std::memory_order_relaxed);
+        newHead = (((head >> 32) + 1) << 32) | index;
+    } while (!head_.compare_exchange_weak(head, newHead, std::memory_order_release,
+                                          std::memory_order_relaxed));
+}
+
+int MemoryPool::syncCache(uint32_t index, uint64_t offset, uint64_t size, bool toDevice) {
+    if (offset >= bufferSize_ || size == 0) {
+        return 0;
     }
+    size = std::min(size, bufferSize_ - offset);
 
-    return addr;
+    cacheSyncs_.fetch_add(1, std::memory_order_relaxed);
+    (toDevice ? flushedBytes_ : invalidatedBytes_).fetch_add(size, std::memory_order_relaxed);
+    if (backend_->syncCache(blocks_[index].handle, offset, size, toDevice) != 0) {
+        printf("ERROR: Pool '%s': cache %s of block %u failed\n", name_.c_str(),
+               toDevice ? "flush" : "invalidate", index);
+        return -1;
+    }
+    return 0;
 }
 
-void MemoryPool::releaseMemoryBlock(MB_BLK block) {
-    if (!block) {
+void MemoryPool::releaseBlocks(uint32_t count) {
+    for (uint32_t i = 0; i < count; i++) {
+        backend_->releaseBlock(blocks_[i].handle);
+    }
+    blocks_.reset();
+}
+
+MemoryPoolStats MemoryPool::getStats() const {
+    MemoryPoolStats stats;
+    memset(&stats, 0, sizeof(stats));
+    if (!initialized_) {
+        return stats;
+    }
+
+    stats.capacity = bufferCount_;
+    stats.free = stats.capacity - inUse_.load(std::memory_order_relaxed);
+    stats.peak = peak_.load(std::memory_order_relaxed);
+    stats.acquired = acquired_.load(std::memory_order_relaxed);
+    stats.exhausted = exhausted_.load(std::memory_order_relaxed);
+    stats.waits = waits_.load(std::memory_order_relaxed);
+    stats.waitUsSum = waitUsSum_.load(std::memory_order_relaxed);
+    stats.waitUsMax = waitUsMax_.load(std::memory_order_relaxed);
+    stats.flushedBytes = flushedBytes_.load(std::memory_order_relaxed);
+    stats.invalidatedBytes = invalidatedBytes_.load(std::memory_order_relaxed);
+    stats.cacheSyncs = cacheSyncs_.load(std::memory_order_relaxed);
+
+    // Блоков единицы-десятки: обход дешевле счетчиков по меткам на каждой выдаче
+    uint64_t nowUs = TimerUtils::getCurrentTimeUs();
+    for (uint32_t i = 0; i < bufferCount_; i++) {
+        uint8_t owner = blocks_[i].owner.load(std::memory_order_relaxed);
+        if (owner == (uint8_t)PoolOwner::None || owner >= (uint8_t)PoolOwner::Count) {
+            continue;
+        }
+        stats.owners[owner]++;
+        uint64_t acquiredUs = blocks_[i].acquiredUs.load(std::memory_order_relaxed);
+        if (nowUs > acquiredUs) {
+            stats.oldestAgeUs = std::max(stats.oldestAgeUs, nowUs - acquiredUs);
+        }
+    }
+    return stats;
+}
+
+void MemoryPool::printReport(uint64_t minAgeUs) const {
+    if (!initialized_) {
         return;
     }
 
-    RK_MPI_MB_ReleaseMB(block);
+    MemoryPoolStats stats = getStats();
+    printf("Pool '%s': %u blocks of %llu bytes, in use %u, peak %u, acquired %llu, exhausted %llu\n",
+           name_.c_str(), stats.capacity, (unsigned long long)bufferSize_, stats.capacity - stats.free,
+           stats.peak, (unsigned long long)stats.acquired, (unsigned long long)stats.exhausted);
+    printf("  waits %llu, avg %llu us, max %llu us\n", (unsigned long long)stats.waits,
+           (unsigned long long)(stats.waits ? stats.waitUsSum / stats.waits : 0),
+           (unsigned long long)stats.waitUsMax);
+
+    uint64_t nowUs = TimerUtils::getCurrentTimeUs();
+    for (uint32_t i = 0; i < bufferCount_; i++) {
+        PoolOwner owner = (PoolOwner)blocks_[i].owner.load(std::memory_order_relaxed);
+        if (owner == PoolOwner::None) {
+            continue;
+        }
+        uint64_t acquiredUs = blocks_[i].acquiredUs.load(std::memory_order_relaxed);
+        uint64_t ageUs = nowUs > acquiredUs ? nowUs - acquiredUs : 0;
+        if (ageUs >= minAgeUs) {
+            printf("  block %u: held by %s for %llu ms\n", i, getPoolOwnerName(owner),
+                   (unsigned long long)(ageUs / 1000));
+        }
+    }
 }
 
 void MemoryPool::destroy() {
@@ -71,11 +360,19 @@ void MemoryPool::destroy() {
         return;
     }
 
-    if (poolId_) {
-        releaseMemoryBlock(getMemoryBlock());
-        RK_MPI_MB_DestroyPool(poolId_);
-        poolId_ = 0;
+    // Итог для подбора frame_count: пик, отказы и блоки, которые так и не вернулись
+    printReport();
+    uint32_t inUse = inUse_.load(std::memory_order_acquire);
+    if (inUse != 0) {
+        printf("ERROR: Pool '%s' destroyed with %u blocks in use, freed after the last one returns\n",
+               name_.c_str(), inUse);
+        return;
     }
 
+    head_.store(kNoBlock, std::memory_order_relaxed);
+    releaseBlocks(bufferCount_);
+    backend_->destroyPool(poolId_);
+    poolId_ = MB_INVALID_POOLID;
+
     initialized_ = false;
 }
@@ -0,0 +1,216 @@
+#include "model_context.h"
+#include <algorithm>
+#include <cstdio>
+#include "frame_ref.h"
+
+static const float kGroundTruthIou = 0.5f;
+
+static void updateMax(std::atomic<uint64_t>& target, uint64_t value) {
+    uint64_t current = target.load(std::memory_order_relaxed);
+    while (value > current &&
+           !target.compare_exchange_weak(current, value, std::memory_order_relaxed)) {
+    }
+}
+
+ModelContext::ModelContext(const ModelSpec& spec, RKNNInference& inference, NpuScheduler& npu,
+                           int npuClient)
+    : spec_(spec), inference_(inference), npu_(npu), npuClient_(npuClient), scheduler_(spec.scheduler),
+      freeInputs_(kInputCount),
+      results_(0), latencyUsSum_(0), latencyUsMax_(0), overlaidFrames_(0),
+      staleFramesSum_(0), staleFramesMax_(0), staleUsSum_(0),
+      gtFrames_(0), truePositives_(0), falsePositives_(0), falseNegatives_(0),
+      motionSkips_(0) {
+}
+
+ModelContext::~ModelContext() {
+    for (auto& input : inputs_) {
+        inference_.DestroyInputView(input->tensor);
+        for (ModelTile& tile : input->tiles) {
+            inference_.DestroyInputView(tile.tensor);
+        }
+    }
+}
+
+int ModelContext::init() {
+    if (!inference_.IsInitialized()) {
+        printf("ERROR: Model '%s' is not initialized\n", spec_.name.c_str());
+        return -1;
+    }
+
+    decoder_.loadAnchors(spec_.anchorsPath);
+    decoder_.loadLabels(spec_.labelsPath);
+
+    // С плитками у входа по тензору на плитку кадра, общий тензор не нужен
+    const TilingConfig& tiling = spec_.tiling;
+    for (uint32_t i = 0; i < kInputCount; i++) {
+        inputs_.emplace_back(new ModelInput());
+        ModelInput& input = *inputs_.back();
+        input.model = this;
+
+        int ret = 0;
+        if (tiling.isEnabled()) {
+            input.tiles.resize(tiling.getTilesPerFrame());
+            for (ModelTile& tile : input.tiles) {
+                ret = ret != 0 ? ret : inference_.CreateInputView(0, tile.tensor);
+            }
+        } else {
+            ret = inference_.CreateInputView(0, input.tensor);
+        }
+        if (ret != 0) {
+            printf("ERROR: Model '%s': cannot allocate input %u\n", spec_.name.c_str(), i);
+            return -1;
+        }
+        freeInputs_.tryPush(inputs_.back().get());
+    }
+
+    if (tiling.isEnabled()) {
+        tileCounters_.reset(new TileCounters[tiling.getTileCount()]);
+        printf("Model '%s': %ux%u tiles, overlap %.2f, %s%s\n", spec_.name.c_str(),
+               tiling.cols, tiling.rows, tiling.overlap, tiling.sweep ? "sweep" : "interleave",
+               tiling.fullFrame ? ", plus full frame" : "");
+    }
+
+    if (!spec_.recordPath.empty()) {
+        const RKNNContext& ctx = inference_.GetContext();
+        if (recorder_.open(spec_.recordPath, ctx.input_attrs, ctx.output_attrs) != 0) {
+            return -1;
+        }
+    }
+
+    return 0;
+}
+
+void ModelContext::recordOutputs() {
+    if (!recorder_.isOpen()) {
+        return;
+    }
+
+    std::vector<const void*> outputs;
+    for (int i = 0; i < inference_.GetOutputCount(); i++) {
+        outputs.push_back(inference_.GetOutputPtr(i));
+    }
+
+    if (recorder_.append(outputs) == 0 && recorder_.getFrameCount() >= spec_.recordFrames) {
+        recorder_.close();
+    }
+}
+
+std::shared_ptr<ModelInput> ModelContext::acquireInput() {
+    ModelInput *input = nullptr;
+    if (!freeInputs_.tryPop(input)) {
+        return nullptr;
+    }
+
+    // Последнюю ссылку может отпустить любой поток, поэтому очередь MPSC
+    MpscQueue<ModelInput*> *freeInputs = &freeInputs_;
+    return std::shared_ptr<ModelInput>(input, [freeInputs](ModelInput *released) {
+        // Кадр отброшен между Run и декодированием: контекст не должен остаться занятым
+        released->npuGrant.release();
+        released->sourceFrame.reset();
+        freeInputs->tryPush(released);
+    });
+}
+
+void ModelContext::publish(std::shared_ptr<const DetectionResult> result) {
+    uint64_t latencyUs = result->completeTimeUs - result->captureTimeUs;
+    latencyUsSum_ += latencyUs;
+    updateMax(latencyUsMax_, latencyUs);
+    results_++;
+
+    if (result->hasGroundTruth) {
+        matchGroundTruth(*result);
+    }
+
+    std::lock_guard<std::mutex> lock(resultMutex_);
+    latestResult_ = std::move(result);
+}
+
+void ModelContext::matchGroundTruth(const DetectionResult& result) {
+    // Жадно, от самой уверенной детекции, как в VOC/COCO
+    std::vector<const Detection*> detections;
+    for (const Detection& det : result.detections) {
+        detections.push_back(&det);
+    }
+    std::sort(detections.begin(), detections.end(),
+              [](const Detection *a, const Detection *b) { return a->score > b->score; });
+
+    std::vector<bool> matched(result.groundTruth.size(), false);
+    uint64_t truePositives = 0;
+    for (const Detection *det : detections) {
+        int best = -1;
+        float bestIou = kGroundTruthIou;
+        for (size_t i = 0; i < result.groundTruth.size(); i++) {
+            float iou = YoloDecoder::computeIou(*det, result.groundTruth[i]);
+            if (!matched[i] && iou >= bestIou) {
+                best = (int)i;
+                bestIou = iou;
+            }
+        }
+        if (best >= 0) {
+            matched[best] = true;
+            truePositives++;
+        }
+    }
+
+    gtFrames_++;
+    truePositives_ += truePositives;
+    falsePositives_ += detections.size() - truePositives;
+    falseNegatives_ += result.groundTruth.size() - truePositives;
+}
+
+std::shared_ptr<const DetectionResult> ModelContext::getLatestResult() const {
+    std::lock_guard<std::mutex> lock(resultMutex_);
+    return latestResult_;
+}
+
+void ModelContext::recordOverlay(uint64_t staleFrames, uint64_t staleUs) {
+    staleFramesSum_ += staleFrames;
+    updateMax(staleFramesMax_, staleFrames);
+    staleUsSum_ += staleUs;
+    overlaidFrames_++;
+
+    scheduler_.recordStaleness(staleUs);
+}
+
+void ModelContext::recordTile(const ModelTile& tile) {
+    if (!tileCounters_ || tile.index >= spec_.tiling.getTileCount()) {
+        return;
+    }
+
+    TileCounters& counters = tileCounters_[tile.index];
+    counters.runs++;
+    counters.npuUsSum += tile.npuUs;
+    updateMax(counters.npuUsMax, tile.npuUs);
+    counters.detections += tile.detections.size();
+}
+
+TileStats ModelContext::getTileStats(uint32_t index) const {
+    TileStats stats = TileStats();
+    if (!tileCounters_ || index >= spec_.tiling.getTileCount()) {
+        return stats;
+    }
+
+    const TileCounters& counters = tileCounters_[index];
+    stats.runs = counters.runs.load();
+    stats.npuUsSum = counters.npuUsSum.load();
+    stats.npuUsMax = counters.npuUsMax.load();
+    stats.detections = counters.detections.load();
+    return stats;
+}
+
+DetectionStats ModelContext::getDetectionStats() const {
+    DetectionStats stats;
+    stats.results = results_.load();
+    stats.latencyUsSum = latencyUsSum_.load();
+    stats.latencyUsMax = latencyUsMax_.load();
+    stats.overlaidFrames = overlaidFrames_.load();
+    stats.staleFramesSum = staleFramesSum_.load();
+    stats.staleFramesMax = staleFramesMax_.load();
+    stats.staleUsSum = staleUsSum_.load();
+    stats.gtFrames = gtFrames_.load();
+    stats.truePositives = truePositives_.load();
+    stats.falsePositives = falsePositives_.load();
+    stats.falseNegatives = falseNegatives_.load();
+    stats.motionSkips = motionSkips_.load();
+    return stats;
+}
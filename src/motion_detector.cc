@@ -0,0 +1,149 @@
+#include "motion_detector.h"
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#elif defined(__ARM_NEON)
+#include <arm_neon.h>
+#endif
+
+// Суммы модулей разностей строки копии по блокам шириной kBlockWidth
+static void addRowSad(const uint8_t *a, const uint8_t *b, uint32_t *sums) {
+    static_assert(MotionDetector::kBlockWidth == 8 && MotionDetector::kThumbWidth % 16 == 0,
+                  "SAD works on pairs of 8-pixel blocks");
+
+#if defined(__SSE2__)
+    for (int x = 0; x < MotionDetector::kThumbWidth; x += 16) {
+        __m128i sad = _mm_sad_epu8(_mm_load_si128((const __m128i*)(a + x)),
+                                   _mm_load_si128((const __m128i*)(b + x)));
+        sums[x / 8] += (uint32_t)_mm_cvtsi128_si32(sad);
+        sums[x / 8 + 1] += (uint32_t)_mm_cvtsi128_si32(_mm_srli_si128(sad, 8));
+    }
+#elif defined(__ARM_NEON)
+    for (int x = 0; x < MotionDetector::kThumbWidth; x += 16) {
+        uint8x16_t diff = vabdq_u8(vld1q_u8(a + x), vld1q_u8(b + x));
+        uint64x2_t sad = vpaddlq_u32(vpaddlq_u16(vpaddlq_u8(diff)));
+        sums[x / 8] += (uint32_t)vgetq_lane_u64(sad, 0);
+        sums[x / 8 + 1] += (uint32_t)vgetq_lane_u64(sad, 1);
+    }
+#else
+    for (int x = 0; x < MotionDetector::kThumbWidth; x++) {
+        sums[x / 8] += (uint32_t)abs((int)a[x] - (int)b[x]);
+    }
+#endif
+}
+
+MotionDetector::MotionDetector(const MotionConfig& config)
+    : config_(config), hasBackground_(false), framesSinceMotion_(0),
+      frameWidth_(0), frameHeight_(0), frameChannels_(0) {
+    memset(thumb_, 0, sizeof(thumb_));
+    memset(background_, 0, sizeof(background_));
+    memset(backgroundFixed_, 0, sizeof(backgroundFixed_));
+}
+
+void MotionDetector::buildThumbnail(const cv::Mat& image) {
+    const int channels = image.channels();
+    if (image.cols != frameWidth_ || image.rows != frameHeight_ || channels != frameChannels_) {
+        frameWidth_ = image.cols;
+        frameHeight_ = image.rows;
+        frameChannels_ = channels;
+
+        // Левый верхний из 2x2 отсчетов в центре ячейки
+        sampleX_.resize(kThumbWidth);
+        for (int x = 0; x < kThumbWidth; x++) {
+            int center = (2 * x + 1) * frameWidth_ / (2 * kThumbWidth);
+            sampleX_[x] = std::min(std::max(center - 1, 0), frameWidth_ - 2) * channels;
+        }
+        sampleY_.resize(kThumbHeight);
+        for (int y = 0; y < kThumbHeight; y++) {
+            int center = (2 * y + 1) * frameHeight_ / (2 * kThumbHeight);
+            sampleY_[y] = std::min(std::max(center - 1, 0), frameHeight_ - 2);
+        }
+    }
+
+    // Плоскость Y кадра NV12 уже содержит яркость
+    if (channels == 1) {
+        for (int y = 0; y < kThumbHeight; y++) {
+            const uint8_t *row0 = image.ptr<uint8_t>(sampleY_[y]);
+            const uint8_t *row1 = image.ptr<uint8_t>(sampleY_[y] + 1);
+            uint8_t *dst = thumb_ + y * kThumbWidth;
+            for (int x = 0; x < kThumbWidth; x++) {
+                const uint8_t *p0 = row0 + sampleX_[x];
+                const uint8_t *p1 = row1 + sampleX_[x];
+                dst[x] = (uint8_t)((p0[0] + p0[1] + p1[0] + p1[1] + 2) >> 2);
+            }
+        }
+        return;
+    }
+
+    // Яркость BT.601 по среднему 2x2: шум сенсора почти не доходит до копии
+    for (int y = 0; y < kThumbHeight; y++) {
+        const uint8_t *row0 = image.ptr<uint8_t>(sampleY_[y]);
+        const uint8_t *row1 = image.ptr<uint8_t>(sampleY_[y] + 1);
+        uint8_t *dst = thumb_ + y * kThumbWidth;
+        for (int x = 0; x < kThumbWidth; x++) {
+            const uint8_t *p0 = row0 + sampleX_[x];
+            const uint8_t *p1 = row1 + sampleX_[x];
+            int b = p0[0] + p0[3] + p1[0] + p1[3];
+            int g = p0[1] + p0[4] + p1[1] + p1[4];
+            int r = p0[2] + p0[5] + p1[2] + p1[5];
+            dst[x] = (uint8_t)((29 * b + 150 * g + 77 * r) >> 10);
+        }
+    }
+}
+
+void MotionDetector::updateBackground() {
+    for (int i = 0; i < kThumbWidth * kThumbHeight; i++) {
+        int target = (int)thumb_[i] << 8;
+        int current = backgroundFixed_[i];
+        current += (target - current) >> config_.learnShift;
+        backgroundFixed_[i] = (uint16_t)current;
+        background_[i] = (uint8_t)((current + 128) >> 8);
+    }
+}
+
+void MotionDetector::update(const cv::Mat& image, MotionMask& mask) {
+    buildThumbnail(image);
+
+    mask.cols = kCols;
+    mask.rows = kRows;
+    mask.blocks.assign(kCols * kRows, 0);
+
+    if (!hasBackground_) {
+        for (int i = 0; i < kThumbWidth * kThumbHeight; i++) {
+            backgroundFixed_[i] = (uint16_t)(thumb_[i] << 8);
+            background_[i] = thumb_[i];
+        }
+        hasBackground_ = true;
+        framesSinceMotion_ = 0;
+        mask.score = 1.0f;
+        mask.active = true;
+        return;
+    }
+
+    const uint32_t threshold = (uint32_t)(config_.pixelThreshold * kBlockWidth * kBlockHeight);
+    int moving = 0;
+    for (int row = 0; row < kRows; row++) {
+        uint32_t sums[kCols] = {0};
+        for (int y = row * kBlockHeight; y < (row + 1) * kBlockHeight; y++) {
+            addRowSad(thumb_ + y * kThumbWidth, background_ + y * kThumbWidth, sums);
+        }
+        for (int col = 0; col < kCols; col++) {
+            if (sums[col] > threshold) {
+                mask.blocks[row * kCols + col] = 1;
+                moving++;
+            }
+        }
+    }
+
+    updateBackground();
+
+    mask.score = (float)moving / (kCols * kRows);
+    if (moving >= config_.minBlocks) {
+        framesSinceMotion_ = 0;
+    } else if (framesSinceMotion_ <= (uint32_t)config_.holdFrames) {
+        framesSinceMotion_++;
+    }
+    mask.active = framesSinceMotion_ <= (uint32_t)config_.holdFrames;
+}
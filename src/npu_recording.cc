@@ -0,0 +1,136 @@
+#include "npu_recording.h"
+#include <cstring>
+
+static const char kRecordingMagic[4] = {'N', 'P', 'U', 'R'};
+static const uint32_t kRecordingVersion = 1;
+
+NpuRecordingWriter::NpuRecordingWriter()
+    : file_(nullptr), frames_(0) {
+}
+
+NpuRecordingWriter::~NpuRecordingWriter() {
+    close();
+}
+
+int NpuRecordingWriter::open(const std::string& path, const std::vector<rknn_tensor_attr>& inputAttrs,
+                             const std::vector<rknn_tensor_attr>& outputAttrs) {
+    close();
+
+    file_ = fopen(path.c_str(), "wb");
+    if (!file_) {
+        printf("ERROR: Cannot create NPU recording %s\n", path.c_str());
+        return -1;
+    }
+
+    NpuRecordingHeader header;
+    memcpy(header.magic, kRecordingMagic, sizeof(header.magic));
+    header.version = kRecordingVersion;
+    header.inputCount = (uint32_t)inputAttrs.size();
+    header.outputCount = (uint32_t)outputAttrs.size();
+
+    bool ok = fwrite(&header, sizeof(header), 1, file_) == 1;
+    for (const rknn_tensor_attr& attr : inputAttrs) {
+        ok = ok && fwrite(&attr, sizeof(attr), 1, file_) == 1;
+    }
+    outputSizes_.clear();
+    for (const rknn_tensor_attr& attr : outputAttrs) {
+        ok = ok && fwrite(&attr, sizeof(attr), 1, file_) == 1;
+        outputSizes_.push_back(attr.size_with_stride);
+    }
+
+    if (!ok) {
+        printf("ERROR: Failed to write NPU recording header\n");
+        close();
+        return -1;
+    }
+
+    frames_ = 0;
+    printf("NPU recording started: %s\n", path.c_str());
+    return 0;
+}
+
+int NpuRecordingWriter::append(const std::vector<const void*>& outputs) {
+    if (!file_ || outputs.size() != outputSizes_.size()) {
+        return -1;
+    }
+
+    for (size_t i = 0; i < outputs.size(); i++) {
+        if (!outputs[i] || fwrite(outputs[i], outputSizes_[i], 1, file_) != 1) {
+            printf("ERROR: Failed to write NPU recording frame\n");
+            close();
+            return -1;
+        }
+    }
+
+    frames_++;
+    return 0;
+}
+
+void NpuRecordingWriter::close() {
+    if (file_) {
+        fclose(file_);
+        file_ = nullptr;
+        printf("NPU recording closed: %u frames\n", frames_);
+    }
+}
+
+int NpuRecording::load(const std::string& path) {
+    FILE *file = fopen(path.c_str(), "rb");
+    if (!file) {
+        printf("ERROR: Cannot open NPU recording %s\n", path.c_str());
+        return -1;
+    }
+
+    NpuRecordingHeader header;
+    bool ok = fread(&header, sizeof(header), 1, file) == 1 &&
+              memcmp(header.magic, kRecordingMagic, sizeof(header.magic)) == 0 &&
+              header.version == kRecordingVersion &&
+              header.outputCount > 0;
+
+    if (ok) {
+        inputAttrs_.resize(header.inputCount);
+        outputAttrs_.resize(header.outputCount);
+        for (rknn_tensor_attr& attr : inputAttrs_) {
+            ok = ok && fread(&attr, sizeof(attr), 1, file) == 1;
+        }
+        for (rknn_tensor_attr& attr : outputAttrs_) {
+            ok = ok && fread(&attr, sizeof(attr), 1, file) == 1;
+        }
+    }
+
+    if (ok) {
+        outputOffsets_.clear();
+        frameSize_ = 0;
+        for (const rknn_tensor_attr& attr : outputAttrs_) {
+            outputOffsets_.push_back(frameSize_);
+            frameSize_ += attr.size_with_stride;
+        }
+
+        long start = ftell(file);
+        fseek(file, 0, SEEK_END);
+        long end = ftell(file);
+        fseek(file, start, SEEK_SET);
+
+        frameCount_ = (uint32_t)((end - start) / frameSize_);
+        data_.resize(frameCount_ * frameSize_);
+        ok = frameCount_ > 0 && fread(data_.data(), frameSize_, frameCount_, file) == frameCount_;
+    }
+
+    fclose(file);
+
+    if (!ok) {
+        printf("ERROR: NPU recording %s is invalid or empty\n", path.c_str());
+        return -1;
+    }
+
+    printf("NPU recording loaded: %s, %u inputs, %u outputs, %u frames\n",
+           path.c_str(), header.inputCount, header.outputCount, frameCount_);
+    return 0;
+}
+
+const uint8_t* NpuRecording::getOutput(uint32_t frame, uint32_t output) const {
+    if (frame >= frameCount_ || output >= outputOffsets_.size()) {
+        return nullptr;
+    }
+    return data_.data() + frame * frameSize_ + outputOffsets_[output];
+}
@@ -0,0 +1,126 @@
+#include "npu_scheduler.h"
+#include <algorithm>
+#include <cstdio>
+#include "trace.h"
+#include "utilities.h"
+
+NpuGrant::NpuGrant(NpuGrant&& other)
+    : scheduler_(other.scheduler_), client_(other.client_), startUs_(other.startUs_) {
+    other.scheduler_ = nullptr;
+}
+
+NpuGrant& NpuGrant::operator=(NpuGrant&& other) {
+    if (this != &other) {
+        release();
+        scheduler_ = other.scheduler_;
+        client_ = other.client_;
+        startUs_ = other.startUs_;
+        other.scheduler_ = nullptr;
+    }
+    return *this;
+}
+
+void NpuGrant::release() {
+    if (scheduler_) {
+        scheduler_->release(client_, startUs_);
+        scheduler_ = nullptr;
+    }
+}
+
+NpuScheduler::NpuScheduler(const std::string& name)
+    : name_(name), virtualTime_(0), busy_(false) {
+}
+
+int NpuScheduler::addClient(const std::string& name, uint32_t priority, float maxFps) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    Client client;
+    client.name = name;
+    client.priority = std::max<uint32_t>(priority, 1);
+    client.intervalUs = maxFps > 0.0f ? (uint64_t)(1000000.0f / maxFps) : 0;
+    client.nextUs = 0;
+    client.pass = 0;
+    client.waiting = false;
+    client.stats = NpuClientStats();
+    client.stats.priority = client.priority;
+    clients_.push_back(client);
+
+    printf("NPU context '%s': client '%s', priority %u, max fps %.1f\n",
+           name_.c_str(), name.c_str(), client.priority, maxFps);
+    return (int)clients_.size() - 1;
+}
+
+bool NpuScheduler::isDue(int client, uint64_t nowUs) const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    const Client& entry = clients_[client];
+    return !entry.intervalUs || nowUs >= entry.nextUs;
+}
+
+bool NpuScheduler::isNext(int client) const {
+    // Наименьшее виртуальное время, при равенстве - больший приоритет
+    const Client& self = clients_[client];
+    for (size_t i = 0; i < clients_.size(); i++) {
+        const Client& other = clients_[i];
+        if ((int)i == client || !other.waiting) {
+            continue;
+        }
+        if (other.pass < self.pass ||
+            (other.pass == self.pass && other.priority > self.priority) ||
+            (other.pass == self.pass && other.priority == self.priority && (int)i < client)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+NpuGrant NpuScheduler::acquire(int client) {
+    uint64_t requestUs = TimerUtils::getCurrentTimeUs();
+
+    std::unique_lock<std::mutex> lock(mutex_);
+    Client& entry = clients_[client];
+    if (entry.intervalUs && requestUs < entry.nextUs) {
+        entry.stats.throttled++;
+        return NpuGrant();
+    }
+
+    // Простой не дает кредита: иначе вернувшийся клиент занял бы NPU надолго
+    entry.pass = std::max(entry.pass, virtualTime_);
+    entry.waiting = true;
+    {
+        TraceScope trace("npu.wait", (uint32_t)client);
+        turn_.wait(lock, [this, client]() { return !busy_ && isNext(client); });
+    }
+    entry.waiting = false;
+    busy_ = true;
+    virtualTime_ = entry.pass;
+
+    uint64_t startUs = TimerUtils::getCurrentTimeUs();
+    if (entry.intervalUs) {
+        // Слоты идут с шагом интервала, отказы не сдвигают сетку;
+        // после простоя дольше интервала отсчет идет от текущей очереди
+        entry.nextUs = entry.nextUs + entry.intervalUs > startUs ?
+            entry.nextUs + entry.intervalUs : startUs + entry.intervalUs;
+    }
+
+    uint64_t waitUs = startUs - requestUs;
+    entry.stats.waitUsSum += waitUs;
+    entry.stats.waitUsMax = std::max(entry.stats.waitUsMax, waitUs);
+    return NpuGrant(this, client, startUs);
+}
+
+void NpuScheduler::release(int client, uint64_t startUs) {
+    uint64_t busyUs = TimerUtils::getCurrentTimeUs() - startUs;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        Client& entry = clients_[client];
+        entry.pass += (busyUs << 8) / entry.priority;
+        entry.stats.runs++;
+        entry.stats.busyUs += busyUs;
+        busy_ = false;
+    }
+    turn_.notify_all();
+}
+
+NpuClientStats NpuScheduler::getStats(int client) const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return clients_[client].stats;
+}
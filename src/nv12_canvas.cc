@@ -0,0 +1,102 @@
+#include "nv12_canvas.h"
+#include <algorithm>
+#include <cstring>
+#include <opencv2/imgproc/imgproc.hpp>
+
+static uint8_t clampByte(double value) {
+    return (uint8_t)std::min(std::max(value + 0.5, 0.0), 255.0);
+}
+
+YuvColor YuvColor::fromBgr(const cv::Scalar& bgr) {
+    double b = bgr[0], g = bgr[1], r = bgr[2];
+    YuvColor color;
+    color.y = clampByte(16.0 + 0.257 * r + 0.504 * g + 0.098 * b);
+    color.u = clampByte(128.0 - 0.148 * r - 0.291 * g + 0.439 * b);
+    color.v = clampByte(128.0 + 0.439 * r - 0.368 * g - 0.071 * b);
+    return color;
+}
+
+Nv12Canvas::Nv12Canvas(const cv::Mat& image, int width, int height)
+    : data_(image.data), stride_(image.step), width_(width), height_(height) {
+    // Плоскость UV начинается после virHeight строк яркости
+    int virHeight = image.rows * 2 / 3;
+    uv_ = data_ + (size_t)virHeight * stride_;
+}
+
+void Nv12Canvas::fillRect(int left, int top, int right, int bottom, const YuvColor& color) {
+    // Границы наружу до четных: блок 2x2 закрашивается целиком
+    left = std::max(left, 0) & ~1;
+    top = std::max(top, 0) & ~1;
+    right = std::min((right + 1) & ~1, width_);
+    bottom = std::min((bottom + 1) & ~1, height_);
+    if (left >= right || top >= bottom) {
+        return;
+    }
+
+    for (int y = top; y < bottom; y++) {
+        memset(lumaRow(y) + left, color.y, right - left);
+    }
+    for (int y = top; y < bottom; y += 2) {
+        uint8_t *uv = chromaRow(y) + left;
+        for (int x = left; x < right; x += 2) {
+            uv[0] = color.u;
+            uv[1] = color.v;
+            uv += 2;
+        }
+    }
+}
+
+void Nv12Canvas::drawRect(int left, int top, int right, int bottom, const YuvColor& color,
+                          int thickness) {
+    thickness = std::max((thickness + 1) & ~1, 2);
+    fillRect(left - thickness / 2, top - thickness / 2, right + thickness / 2, top + thickness / 2, color);
+    fillRect(left - thickness / 2, bottom - thickness / 2, right + thickness / 2, bottom + thickness / 2, color);
+    fillRect(left - thickness / 2, top, left + thickness / 2, bottom, color);
+    fillRect(right - thickness / 2, top, right + thickness / 2, bottom, color);
+}
+
+void Nv12Canvas::drawText(const std::string& text, cv::Point origin, double scale, int thickness,
+                          const YuvColor& color) {
+    int baseline = 0;
+    cv::Size size = cv::getTextSize(text, cv::FONT_HERSHEY_SIMPLEX, scale, thickness, &baseline);
+
+    // Область текста с запасом на толщину штриха, углы на четных координатах
+    int left = (origin.x - thickness) & ~1;
+    int top = (origin.y - size.height - thickness) & ~1;
+    int right = (origin.x + size.width + thickness + 1) & ~1;
+    int bottom = (origin.y + baseline + thickness + 1) & ~1;
+    if (right <= 0 || bottom <= 0 || left >= width_ || top >= height_) {
+        return;
+    }
+
+    mask_.create(bottom - top, right - left, CV_8UC1);
+    mask_.setTo(cv::Scalar(0));
+    cv::putText(mask_, text, cv::Point(origin.x - left, origin.y - top),
+                cv::FONT_HERSHEY_SIMPLEX, scale, cv::Scalar(255), thickness);
+
+    int x0 = std::max(left, 0);
+    int y0 = std::max(top, 0);
+    int x1 = std::min(right, width_ & ~1);
+    int y1 = std::min(bottom, height_ & ~1);
+
+    for (int y = y0; y < y1; y += 2) {
+        const uint8_t *m0 = mask_.ptr<uint8_t>(y - top);
+        const uint8_t *m1 = mask_.ptr<uint8_t>(y + 1 - top);
+        uint8_t *y0Row = lumaRow(y);
+        uint8_t *y1Row = lumaRow(y + 1);
+        uint8_t *uv = chromaRow(y);
+
+        for (int x = x0; x < x1; x += 2) {
+            int mx = x - left;
+            bool hit = false;
+            if (m0[mx]) { y0Row[x] = color.y; hit = true; }
+            if (m0[mx + 1]) { y0Row[x + 1] = color.y; hit = true; }
+            if (m1[mx]) { y1Row[x] = color.y; hit = true; }
+            if (m1[mx + 1]) { y1Row[x + 1] = color.y; hit = true; }
+            if (hit) {
+                uv[x] = color.u;
+                uv[x + 1] = color.v;
+            }
+        }
+    }
+}
@@ -0,0 +1,475 @@
+#include "pipeline.h"
+#include <cstdio>
+#include <map>
+#include <pthread.h>
+#include "thread_policy.h"
+#include "trace.h"
+#include "utilities.h"
+
+// Блок пула, который держат дольше, попадает в отчет вместе со статистикой
+static const uint64_t kPoolHoldWarnUs = 1000000;
+
+static void setThreadName(const std::string& name) {
+    // Имя потока ограничено 15 символами
+    std::string threadName = ("pipe-" + name).substr(0, 15);
+    pthread_setname_np(pthread_self(), threadName.c_str());
+}
+
+/**
+ * @class QueueInput
+ * @brief Вход с обратным давлением: производитель ждет свободного места
+ */
+class QueueInput : public StageInput {
+public:
+    explicit QueueInput(size_t depth) : queue_(depth) {}
+
+    bool push(FrameRef&& frame) override { return queue_.push(std::move(frame)); }
+    bool pop(FrameRef& frame) override { return queue_.pop(frame); }
+    void close() override { queue_.close(); }
+
+    void drain() override {
+        FrameRef frame;
+        while (queue_.tryPop(frame)) {}
+    }
+
+    QueueStats getStats() const override { return queue_.getStats(); }
+
+private:
+    SpscQueue<FrameRef> queue_;
+};
+
+/**
+ * @class LatestInput
+ * @brief Вход, хранящий только последний кадр: производитель никогда не ждет
+ */
+class LatestInput : public StageInput {
+public:
+    bool push(FrameRef&& frame) override {
+        // Вытесненный кадр освобождается здесь, в потоке производителя
+        FrameRef evicted;
+        mailbox_.post(std::move(frame), &evicted);
+        return true;
+    }
+
+    bool pop(FrameRef& frame) override { return mailbox_.take(frame); }
+    void close() override { mailbox_.close(); }
+
+    void drain() override {
+        FrameRef frame;
+        mailbox_.drain(frame);
+    }
+
+    QueueStats getStats() const override {
+        // Вытесненные кадры учитываются как простои производителя
+        MailboxStats stats = mailbox_.getStats();
+        return QueueStats{(size_t)(mailbox_.hasPending() ? 1 : 0), 1,
+                          stats.posted, stats.overwritten, 0};
+    }
+
+private:
+    LatestMailbox<FrameRef> mailbox_;
+};
+
+Pipeline::Pipeline(const PipelineConfig& config, StageContext& context)
+    : config_(config), context_(context), running_(false), failed_(false), activeThreads_(0) {
+}
+
+Pipeline::~Pipeline() {
+    stop();
+}
+
+Pipeline::Node* Pipeline::findNode(const std::string& name) const {
+    for (const auto& node : nodes_) {
+        if (node->stage->getName() == name) {
+            return node.get();
+        }
+    }
+    return nullptr;
+}
+
+Stage* Pipeline::findStage(const std::string& name) const {
+    Node *node = findNode(name);
+    return node ? node->stage.get() : nullptr;
+}
+
+int Pipeline::build() {
+    if (!nodes_.empty()) {
+        printf("ERROR: Pipeline already built\n");
+        return -1;
+    }
+
+    // 1. Стадии
+    for (StageSpec spec : config_.stages) {
+        if (spec.thread.empty()) {
+            spec.thread = spec.name;
+        }
+        if (spec.name.empty() || findNode(spec.name)) {
+            printf("ERROR: Stage name '%s' is empty or duplicated\n", spec.name.c_str());
+            return -1;
+        }
+
+        std::unique_ptr<Stage> stage = StageFactory::instance().create(spec);
+        if (!stage) {
+            printf("ERROR: Stage '%s': unknown type '%s'\n", spec.name.c_str(), spec.type.c_str());
+            return -1;
+        }
+
+        nodes_.emplace_back(new Node());
+        nodes_.back()->stage = std::move(stage);
+    }
+
+    // 2. Связи: в своем потоке - прямой вызов, между потоками - очередь или ящик
+    for (const auto& node : nodes_) {
+        const StageSpec& spec = node->stage->getSpec();
+        const std::string& name = spec.name;
+        const std::string& thread = spec.thread;
+
+        if (node->stage->isSource()) {
+            if (!spec.input.empty()) {
+                printf("ERROR: Source stage '%s' cannot have an input\n", name.c_str());
+                return -1;
+            }
+            heads_.push_back(node.get());
+            continue;
+        }
+
+        Node *upstream = findNode(spec.input);
+        if (!upstream || upstream == node.get()) {
+            printf("ERROR: Stage '%s': bad input '%s'\n", name.c_str(), spec.input.c_str());
+            return -1;
+        }
+
+        if (upstream->stage->getSpec().thread == thread) {
+            if (upstream->direct) {
+                printf("ERROR: Stage '%s' already continues thread '%s' after '%s'\n",
+                       upstream->direct->stage->getName().c_str(), thread.c_str(),
+                       spec.input.c_str());
+                return -1;
+            }
+            upstream->direct = node.get();
+            continue;
+        }
+
+        if (node->stage->requiresDirectInput()) {
+            printf("ERROR: Stage '%s' must run in the thread of '%s'\n",
+                   name.c_str(), spec.input.c_str());
+            return -1;
+        }
+
+        if (spec.link == "queue") {
+            node->input.reset(new QueueInput(spec.queueDepth));
+        } else if (spec.link == "latest") {
+            node->input.reset(new LatestInput());
+        } else {
+            printf("ERROR: Stage '%s': unknown link '%s'\n", name.c_str(), spec.link.c_str());
+            return -1;
+        }
+        upstream->remote.push_back(node.get());
+        heads_.push_back(node.get());
+    }
+
+    // 3. У каждого потока одна первая стадия, все стадии достижимы из источников
+    std::map<std::string, int> headsPerThread;
+    for (Node *head : heads_) {
+        const std::string& thread = head->stage->getSpec().thread;
+        if (++headsPerThread[thread] > 1) {
+            printf("ERROR: Thread '%s' has more than one entry stage\n", thread.c_str());
+            return -1;
+        }
+    }
+    for (const auto& node : nodes_) {
+        const Node *upstream = node.get();
+        for (size_t steps = 0; upstream && !upstream->stage->isSource(); steps++) {
+            if (steps == nodes_.size()) {
+                printf("ERROR: Stage '%s' is in a cycle\n", node->stage->getName().c_str());
+                return -1;
+            }
+            upstream = findNode(upstream->stage->getSpec().input);
+        }
+    }
+    for (const auto& node : nodes_) {
+        node->outgoing.resize(node->remote.size());
+    }
+
+    // 4. Инициализация стадий
+    for (const auto& node : nodes_) {
+        node->stage->setLatencyTracker(&context_.latency);
+        if (node->stage->init(context_) != 0) {
+            printf("ERROR: Stage '%s' initialization failed\n", node->stage->getName().c_str());
+            return -1;
+        }
+    }
+
+    printf("Pipeline built: %zu stages, %zu threads\n", nodes_.size(), heads_.size());
+    return 0;
+}
+
+int Pipeline::start() {
+    if (running_.load()) {
+        return 0;
+    }
+    if (heads_.empty()) {
+        printf("ERROR: Pipeline is not built\n");
+        return -1;
+    }
+
+    running_ = true;
+    failed_ = false;
+    activeThreads_ = heads_.size();
+
+    for (Node *head : heads_) {
+        threads_.emplace_back(&Pipeline::runThread, this, head);
+    }
+
+    printf("Pipeline started\n");
+    return 0;
+}
+
+void Pipeline::stop() {
+    if (!running_.exchange(false) && threads_.empty()) {
+        return;
+    }
+
+    closeInputs();
+
+    for (auto& thread : threads_) {
+        if (thread.joinable()) {
+            thread.join();
+        }
+    }
+    threads_.clear();
+
+    // Кадры, оставшиеся во входах, возвращаются в пул при освобождении ссылок
+    for (const auto& node : nodes_) {
+        if (node->input) {
+            node->input->drain();
+        }
+    }
+    for (const auto& node : nodes_) {
+        node->stage->flush();
+    }
+
+    printf("Pipeline stopped\n");
+}
+
+void Pipeline::closeInputs() {
+    for (const auto& node : nodes_) {
+        if (node->input) {
+            node->input->close();
+        }
+    }
+}
+
+void Pipeline::fail(const Node* node) {
+    printf("ERROR: Pipeline stage '%s' failed, stopping\n", node->stage->getName().c_str());
+    failed_ = true;
+    running_ = false;
+    closeInputs();
+}
+
+void Pipeline::runThread(Node* head) {
+    setThreadName(head->stage->getSpec().thread);
+    ThreadRegistry::instance().registerCurrentThread(head->stage->getSpec().thread);
+
+    FrameRef frame;
+    while (running_.load()) {
+        if (head->input && !head->input->pop(frame)) {
+            break;
+        }
+        if (runChain(head, frame) != 0) {
+            break;
+        }
+    }
+    frame.reset();
+
+    // Потоки-получатели дорабатывают уже поставленные кадры и завершаются следом
+    for (Node *node = head; node; node = node->direct) {
+        for (Node *remote : node->remote) {
+            remote->input->close();
+        }
+    }
+
+    if (--activeThreads_ == 0) {
+        running_ = false;
+    }
+}
+
+int Pipeline::runChain(Node* node, FrameRef& frame) {
+    while (node) {
+        uint64_t startUs = TimerUtils::getCurrentTimeUs();
+        StageStatus status;
+        {
+            TraceScope trace(node->stage->getName().c_str(), frame ? frame.seq() : Tracer::kNoArg);
+            status = node->stage->process(frame);
+        }
+        node->busyUs += TimerUtils::getCurrentTimeUs() - startUs;
+        node->processed++;
+
+        if (status == StageStatus::Error) {
+            fail(node);
+            return -1;
+        }
+        if (status == StageStatus::End) {
+            return 1;
+        }
+        if (status == StageStatus::Drop) {
+            node->dropped++;
+            break;
+        }
+
+        // Сначала все получатели решают, что им нужно, затем кадр уходит в очереди
+        std::vector<FrameRef>& outgoing = node->outgoing;
+        for (size_t i = 0; i < node->remote.size(); i++) {
+            if (!node->remote[i]->stage->admit(frame, outgoing[i])) {
+                outgoing[i].reset();
+            }
+        }
+        for (size_t i = 0; i < node->remote.size(); i++) {
+            if (outgoing[i]) {
+                node->remote[i]->input->push(std::move(outgoing[i]));
+            }
+        }
+
+        node = node->direct;
+    }
+
+    frame.reset();
+    return 0;
+}
+
+StageStats Pipeline::getStageStats(size_t index) const {
+    const Node& node = *nodes_[index];
+
+    StageStats stats;
+    stats.name = node.stage->getName().c_str();
+    stats.thread = node.stage->getSpec().thread.c_str();
+    stats.input = node.input ? node.input->getStats() : QueueStats{};
+    stats.processed = node.processed.load();
+    stats.dropped = node.dropped.load();
+    stats.busyUs = node.busyUs.load();
+    return stats;
+}
+
+void Pipeline::printStats() const {
+    printf("Pipeline stats:\n");
+    for (const auto& stream : context_.streams) {
+        printf("  stream %s: fps %.2f\n", stream->spec.name.c_str(), stream->fps.load());
+        if (stream->memPool) {
+            MemoryPoolStats pool = stream->memPool->getStats();
+            printf("    pool: free %u/%u, peak %u, acquired %llu, exhausted %llu, wait avg %llu us max %llu us\n",
+                   pool.free, pool.capacity, pool.peak, (unsigned long long)pool.acquired,
+                   (unsigned long long)pool.exhausted,
+                   (unsigned long long)(pool.waits ? pool.waitUsSum / pool.waits : 0),
+                   (unsigned long long)pool.waitUsMax);
+            printf("    pool held:");
+            for (size_t owner = (size_t)PoolOwner::Capture; owner < (size_t)PoolOwner::Count; owner++) {
+                printf(" %s %u", getPoolOwnerName((PoolOwner)owner), pool.owners[owner]);
+            }
+            printf(", oldest %llu ms\n", (unsigned long long)(pool.oldestAgeUs / 1000));
+            printf("    pool cache: flushed %llu KB, invalidated %llu KB in %llu syncs\n",
+                   (unsigned long long)(pool.flushedBytes / 1024),
+                   (unsigned long long)(pool.invalidatedBytes / 1024), (unsigned long long)pool.cacheSyncs);
+
+            // Блок, который держат дольше секунды, скорее всего утек
+            if (pool.oldestAgeUs >= kPoolHoldWarnUs) {
+                stream->memPool->printReport(kPoolHoldWarnUs);
+            }
+        }
+    }
+    printf("  %-12s %-12s %8s %10s %8s %8s %10s %10s\n",
+           "stage", "thread", "queue", "processed", "dropped", "avg_us", "in_stalls", "in_full");
+
+    for (size_t i = 0; i < nodes_.size(); i++) {
+        StageStats stats = getStageStats(i);
+
+        uint64_t avgUs = stats.processed ? stats.busyUs / stats.processed : 0;
+        printf("  %-12s %-12s %4zu/%-3zu %10llu %8llu %8llu %10llu %10llu\n",
+               stats.name, stats.thread, stats.input.depth, stats.input.capacity,
+               (unsigned long long)stats.processed, (unsigned long long)stats.dropped,
+               (unsigned long long)avgUs,
+               (unsigned long long)stats.input.popStalls,
+               (unsigned long long)stats.input.pushStalls);
+    }
+
+    if (context_.rtspServer) {
+        for (size_t i = 0; i < context_.rtspServer->getSessionCount(); i++) {
+            RtspStats rtsp = context_.rtspServer->getStats((int)i);
+            printf("  rtsp %s: clients %d, sent %llu, dropped %llu, pending %zu, events %llu\n",
+                   context_.rtspServer->getSessionPath((int)i).c_str(),
+                   context_.rtspServer->getClientCount(), (unsigned long long)rtsp.sent,
+                   (unsigned long long)rtsp.dropped, rtsp.pending, (unsigned long long)rtsp.events);
+        }
+    }
+
+    const LatencyTracker& latency = context_.latency;
+    printf("  %-12s %8s %8s %8s %8s %8s\n", "latency", "count", "p50_us", "p95_us", "p99_us", "max_us");
+    for (size_t i = 0; i < LatencyTracker::getSegmentCount(); i++) {
+        LatencyStats stats = latency.getStats(i);
+        if (stats.count == 0) {
+            continue;
+        }
+        printf("  %-12s %8llu %8llu %8llu %8llu %8llu\n", LatencyTracker::getSegmentName(i),
+               (unsigned long long)stats.count, (unsigned long long)stats.p50Us,
+               (unsigned long long)stats.p95Us, (unsigned long long)stats.p99Us,
+               (unsigned long long)stats.maxUs);
+    }
+
+    for (const auto& entry : context_.models) {
+        const ModelContext& model = *entry.second;
+
+        DetectionStats det = model.getDetectionStats();
+        printf("  model %s (stream %s): results %llu, latency avg %llu us max %llu us\n",
+               model.getName().c_str(), model.getStreamName().c_str(), (unsigned long long)det.results,
+               (unsigned long long)(det.results ? det.latencyUsSum / det.results : 0),
+               (unsigned long long)det.latencyUsMax);
+        printf("    overlay staleness: avg %.2f frames (%llu us), max %llu frames\n",
+               det.overlaidFrames ? (double)det.staleFramesSum / det.overlaidFrames : 0.0,
+               (unsigned long long)(det.overlaidFrames ? det.staleUsSum / det.overlaidFrames : 0),
+               (unsigned long long)det.staleFramesMax);
+        if (det.gtFrames) {
+            uint64_t detected = det.truePositives + det.falsePositives;
+            uint64_t expected = det.truePositives + det.falseNegatives;
+            printf("    ground truth: %llu frames, precision %.3f, recall %.3f (tp %llu fp %llu fn %llu)\n",
+                   (unsigned long long)det.gtFrames,
+                   detected ? (double)det.truePositives / detected : 0.0,
+                   expected ? (double)det.truePositives / expected : 0.0,
+                   (unsigned long long)det.truePositives, (unsigned long long)det.falsePositives,
+                   (unsigned long long)det.falseNegatives);
+        }
+
+        if (det.motionSkips) {
+            printf("    motion gate: %llu frames without inference\n",
+                   (unsigned long long)det.motionSkips);
+        }
+
+        NpuClientStats npu = model.getNpuStats();
+        printf("    npu %s: priority %u, runs %llu, busy %llu us, wait avg %llu us max %llu us, "
+               "throttled %llu\n",
+               model.getNpuScheduler().getName().c_str(), npu.priority, (unsigned long long)npu.runs,
+               (unsigned long long)npu.busyUs,
+               (unsigned long long)(npu.runs ? npu.waitUsSum / npu.runs : 0),
+               (unsigned long long)npu.waitUsMax, (unsigned long long)npu.throttled);
+        InputImportStats imports = model.getInference().GetImportStats();
+        if (imports.imports) {
+            printf("    npu input imports %llu, hits %llu\n",
+                   (unsigned long long)imports.imports, (unsigned long long)imports.hits);
+        }
+
+        const TilingConfig& tiling = model.getTiling();
+        for (uint32_t i = 0; tiling.isEnabled() && i < tiling.getTileCount(); i++) {
+            TileStats tile = model.getTileStats(i);
+            printf("    tile %u%s: runs %llu, npu avg %llu us max %llu us, detections %.2f per run\n",
+                   i, tiling.fullFrame && i == 0 ? " (full)" : "", (unsigned long long)tile.runs,
+                   (unsigned long long)(tile.runs ? tile.npuUsSum / tile.runs : 0),
+                   (unsigned long long)tile.npuUsMax,
+                   tile.runs ? (double)tile.detections / tile.runs : 0.0);
+        }
+
+        SchedulerStats sched = model.getScheduler().getStats();
+        printf("    scheduler: stride %u, npu p50 %llu us p95 %llu us, expected staleness %llu us, "
+               "budget misses %llu/%llu\n",
+               sched.stride, (unsigned long long)sched.p50Us, (unsigned long long)sched.p95Us,
+               (unsigned long long)sched.expectedStalenessUs,
+               (unsigned long long)sched.budgetMisses, (unsigned long long)sched.checkedFrames);
+    }
+}
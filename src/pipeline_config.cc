@@ -0,0 +1,311 @@
+#include "pipeline_config.h"
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+
+static std::string trim(const std::string& value) {
+    size_t begin = value.find_first_not_of(" \t\r");
+    if (begin == std::string::npos) {
+        return "";
+    }
+    size_t end = value.find_last_not_of(" \t\r");
+    return value.substr(begin, end - begin + 1);
+}
+
+std::string StageSpec::getParam(const std::string& key, const std::string& defaultValue) const {
+    auto it = params.find(key);
+    return it != params.end() ? it->second : defaultValue;
+}
+
+int StageSpec::getInt(const std::string& key, int defaultValue) const {
+    auto it = params.find(key);
+    return it != params.end() ? atoi(it->second.c_str()) : defaultValue;
+}
+
+float StageSpec::getFloat(const std::string& key, float defaultValue) const {
+    auto it = params.find(key);
+    return it != params.end() ? (float)atof(it->second.c_str()) : defaultValue;
+}
+
+static StageSpec makeStage(const char *name, const char *type, const char *input,
+                           const char *thread, const char *link = "queue") {
+    StageSpec spec;
+    spec.name = name;
+    spec.type = type;
+    spec.input = input;
+    spec.thread = thread;
+    spec.link = link;
+    return spec;
+}
+
+PipelineConfig PipelineConfig::makeDefault() {
+    PipelineConfig config;
+    config.models.push_back(ModelSpec());
+
+    config.stages.push_back(makeStage("source", "source", "", "capture"));
+    config.stages.push_back(makeStage("motion", "motion", "source", "preprocess"));
+    config.stages.push_back(makeStage("preprocess", "preprocess", "motion", "preprocess"));
+
+    // Ветка детекции получает только последний подготовленный кадр
+    config.stages.push_back(makeStage("infer", "infer", "preprocess", "infer", "latest"));
+    config.stages.push_back(makeStage("postprocess", "postprocess", "infer", "infer"));
+    config.stages.push_back(makeStage("track", "track", "postprocess", "infer"));
+    config.stages.push_back(makeStage("publish", "publish", "track", "infer"));
+
+    config.stages.push_back(makeStage("overlay", "overlay", "preprocess", "overlay"));
+    config.stages.push_back(makeStage("encode", "encode", "overlay", "encode"));
+    // Отправка клиентам идет в потоке событий RTSP сервера
+    config.stages.push_back(makeStage("rtsp", "rtsp", "encode", "encode"));
+
+    // Камера и кодер не должны ждать аналитики и журнала
+    ThreadPolicy capture;
+    capture.name = "capture";
+    capture.policy = "fifo";
+    capture.priority = 60;
+    config.threads.push_back(capture);
+
+    ThreadPolicy encode;
+    encode.name = "encode";
+    encode.policy = "fifo";
+    encode.priority = 50;
+    config.threads.push_back(encode);
+
+    return config;
+}
+
+std::vector<StreamSpec> PipelineConfig::getStreams() const {
+    if (!streams.empty()) {
+        return streams;
+    }
+
+    StreamSpec stream;
+    stream.width = width;
+    stream.height = height;
+    stream.frameCount = frameCount;
+    stream.rtspPath = rtspPath;
+    stream.vencChannel = vencChannel;
+    stream.bitrate = bitrate;
+    return std::vector<StreamSpec>(1, stream);
+}
+
+std::string PipelineConfig::resolveStream(const std::string& stream) const {
+    if (!stream.empty()) {
+        return stream;
+    }
+    return streams.empty() ? StreamSpec().name : streams.front().name;
+}
+
+static int applyAppKey(PipelineConfig& config, const std::string& key, const std::string& value) {
+    if (key == "width") config.width = atoi(value.c_str());
+    else if (key == "height") config.height = atoi(value.c_str());
+    else if (key == "frame_count") config.frameCount = (uint32_t)atoi(value.c_str());
+    else if (key == "rtsp_port") config.rtspPort = atoi(value.c_str());
+    else if (key == "rtsp_path") config.rtspPath = value;
+    else if (key == "venc_channel") config.vencChannel = atoi(value.c_str());
+    else if (key == "bitrate") config.bitrate = atoi(value.c_str());
+    else if (key == "trace_path") config.tracePath = value;
+    else if (key == "trace_seconds") config.traceSeconds = (uint32_t)atoi(value.c_str());
+    else if (key == "trace_events") config.traceEvents = (uint32_t)atoi(value.c_str());
+    else return -1;
+    return 0;
+}
+
+static int applyStreamKey(StreamSpec& stream, const std::string& key, const std::string& value) {
+    if (key == "width") stream.width = atoi(value.c_str());
+    else if (key == "height") stream.height = atoi(value.c_str());
+    else if (key == "frame_count") stream.frameCount = (uint32_t)atoi(value.c_str());
+    else if (key == "rtsp_path") stream.rtspPath = value;
+    else if (key == "venc_channel") stream.vencChannel = atoi(value.c_str());
+    else if (key == "bitrate") stream.bitrate = atoi(value.c_str());
+    else if (key == "priority") {
+        int priority = atoi(value.c_str());
+        if (priority < 1) {
+            return -1;
+        }
+        stream.priority = (uint32_t)priority;
+    }
+    else if (key == "infer_fps") stream.inferFps = (float)atof(value.c_str());
+    else return -1;
+    return 0;
+}
+
+static int applyModelKey(ModelSpec& model, const std::string& key, const std::string& value) {
+    if (key == "path") model.path = value;
+    else if (key == "stream") model.stream = value;
+    else if (key == "context") model.npuContext = value;
+    else if (key == "anchors") model.anchorsPath = value;
+    else if (key == "labels") model.labelsPath = value;
+    else if (key == "target_fps") model.scheduler.targetFps = (float)atof(value.c_str());
+    else if (key == "max_staleness_ms") model.scheduler.maxStalenessMs = (uint32_t)atoi(value.c_str());
+    else if (key == "min_stride") model.scheduler.minStride = (uint32_t)atoi(value.c_str());
+    else if (key == "max_stride") model.scheduler.maxStride = (uint32_t)atoi(value.c_str());
+    else if (key == "tiles") return model.tiling.parseGrid(value);
+    else if (key == "tile_overlap") model.tiling.overlap = (float)atof(value.c_str());
+    else if (key == "tile_mode") {
+        if (value != "sweep" && value != "interleave") {
+            return -1;
+        }
+        model.tiling.sweep = value == "sweep";
+    }
+    else if (key == "tile_full") model.tiling.fullFrame = atoi(value.c_str()) != 0;
+    else if (key == "tile_nms") model.tiling.nmsIou = (float)atof(value.c_str());
+    else if (key == "tile_merge") model.tiling.mergeIos = (float)atof(value.c_str());
+    else if (key == "npu_delay_ms") model.npu.delayUs = (uint32_t)(atof(value.c_str()) * 1000);
+    else if (key == "record_outputs") model.recordPath = value;
+    else if (key == "record_frames") model.recordFrames = (uint32_t)atoi(value.c_str());
+    else return -1;
+    return 0;
+}
+
+static int applyThreadKey(ThreadPolicy& thread, const std::string& key, const std::string& value) {
+    if (key == "policy") {
+        if (value != "fifo" && value != "rr" && value != "other") {
+            return -1;
+        }
+        thread.policy = value;
+    }
+    else if (key == "priority") thread.priority = atoi(value.c_str());
+    else if (key == "nice") thread.nice = atoi(value.c_str());
+    else if (key == "cpus") return thread.parseCpus(value);
+    else return -1;
+    return 0;
+}
+
+static void applyStageKey(StageSpec& stage, const std::string& key, const std::string& value) {
+    if (key == "type") stage.type = value;
+    else if (key == "input") stage.input = value;
+    else if (key == "thread") stage.thread = value;
+    else if (key == "link") stage.link = value;
+    else if (key == "stream") stage.stream = value;
+    else if (key == "queue_depth") stage.queueDepth = (uint32_t)atoi(value.c_str());
+    else stage.params[key] = value;
+}
+
+int PipelineConfig::load(const std::string& path) {
+    std::ifstream file(path);
+    if (!file.is_open()) {
+        printf("ERROR: Cannot open config file %s\n", path.c_str());
+        return -1;
+    }
+
+    enum class Section { None, App, Stream, Model, Stage, Thread };
+    Section section = Section::None;
+
+    std::vector<StreamSpec> streams;
+    std::vector<ModelSpec> models;
+    std::vector<StageSpec> stages;
+    std::vector<ThreadPolicy> threads;
+
+    std::string line;
+    int lineNumber = 0;
+    while (std::getline(file, line)) {
+        lineNumber++;
+
+        size_t comment = line.find_first_of("#;");
+        if (comment != std::string::npos) {
+            line = line.substr(0, comment);
+        }
+        line = trim(line);
+        if (line.empty()) {
+            continue;
+        }
+
+        if (line.front() == '[') {
+            if (line.back() != ']') {
+                printf("ERROR: %s:%d: bad section header\n", path.c_str(), lineNumber);
+                return -1;
+            }
+            std::string header = trim(line.substr(1, line.size() - 2));
+            size_t space = header.find(' ');
+            std::string kind = header.substr(0, space);
+            std::string name = space == std::string::npos ? "" : trim(header.substr(space + 1));
+
+            if (kind == "app") {
+                section = Section::App;
+            } else if (kind == "stream" && !name.empty()) {
+                section = Section::Stream;
+                streams.push_back(StreamSpec());
+                streams.back().name = name;
+            } else if (kind == "model") {
+                section = Section::Model;
+                models.push_back(ModelSpec());
+                models.back().name = name.empty() ? "default" : name;
+            } else if (kind == "stage" && !name.empty()) {
+                section = Section::Stage;
+                stages.push_back(StageSpec());
+                stages.back().name = name;
+                stages.back().thread = name;
+            } else if (kind == "thread" && !name.empty()) {
+                section = Section::Thread;
+                threads.push_back(ThreadPolicy());
+                threads.back().name = name;
+            } else {
+                printf("ERROR: %s:%d: unknown section '%s'\n", path.c_str(), lineNumber, header.c_str());
+                return -1;
+            }
+            continue;
+        }
+
+        size_t eq = line.find('=');
+        if (eq == std::string::npos) {
+            printf("ERROR: %s:%d: expected key = value\n", path.c_str(), lineNumber);
+            return -1;
+        }
+        std::string key = trim(line.substr(0, eq));
+        std::string value = trim(line.substr(eq + 1));
+
+        int ret = 0;
+        switch (section) {
+        case Section::App: ret = applyAppKey(*this, key, value); break;
+        case Section::Stream: ret = applyStreamKey(streams.back(), key, value); break;
+        case Section::Model: ret = applyModelKey(models.back(), key, value); break;
+        case Section::Stage: applyStageKey(stages.back(), key, value); break;
+        case Section::Thread: ret = applyThreadKey(threads.back(), key, value); break;
+        default: ret = -1; break;
+        }
+        if (ret != 0) {
+            printf("ERROR: %s:%d: unknown key '%s' or bad value\n", path.c_str(), lineNumber, key.c_str());
+            return -1;
+        }
+    }
+
+    for (const ThreadPolicy& thread : threads) {
+        bool realtime = thread.policy != "other";
+        if ((realtime && (thread.priority < 1 || thread.priority > 99)) ||
+            (!realtime && (thread.nice < -20 || thread.nice > 19))) {
+            printf("ERROR: %s: thread '%s': priority must be 1..99 for %s, nice -20..19 for other\n",
+                   path.c_str(), thread.name.c_str(), thread.policy.c_str());
+            return -1;
+        }
+    }
+
+    // Потоки делят один RTSP сервер и кодер: пути и каналы VENC не должны совпадать
+    for (size_t i = 0; i < streams.size(); i++) {
+        for (size_t j = 0; j < i; j++) {
+            if (streams[i].name == streams[j].name || streams[i].rtspPath == streams[j].rtspPath ||
+                streams[i].vencChannel == streams[j].vencChannel) {
+                printf("ERROR: %s: streams '%s' and '%s' share name, rtsp_path or venc_channel\n",
+                       path.c_str(), streams[j].name.c_str(), streams[i].name.c_str());
+                return -1;
+            }
+        }
+    }
+
+    if (!streams.empty()) {
+        this->streams = streams;
+    }
+    if (!models.empty()) {
+        this->models = models;
+    }
+    if (!stages.empty()) {
+        this->stages = stages;
+    }
+    if (!threads.empty()) {
+        this->threads = threads;
+    }
+
+    printf("Loaded config %s: %zu streams, %zu models, %zu stages, %zu thread policies\n",
+           path.c_str(), getStreams().size(), this->models.size(), this->stages.size(),
+           this->threads.size());
+    return 0;
+}
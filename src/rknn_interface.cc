@@ -4,6 +4,7 @@
 #include <cmath>
 #include <algorithm>
 #include <numeric>
+#include "trace.h"
 
 // ============ Вспомогательные функции ============
 
@@ -40,8 +41,8 @@ std::string RKNNInference::GetQntTypeString(rknn_tensor_qnt_type qnt_type) {
 
 // ============ RKNNInference реализация ============
 
-RKNNInference::RKNNInference() {
-    memset(&m_ctx, 0, sizeof(RKNNContext));
+RKNNInference::RKNNInference(const NpuOptions& options)
+    : m_backend(createNpuBackend(options)) {
 }
 
 RKNNInference::~RKNNInference() {
@@ -59,9 +60,9 @@ int RKNNInference::Init(const std::string& model_path) {
     int ret = 0;
 
     // Инициализация контекста RKNN
-    ret = rknn_init(&m_ctx.ctx, (char*)model_path.c_str(), 0, 0, NULL);
+    ret = m_backend->init(model_path);
     if (ret < 0) {
-        printf("RKNN: rknn_init failed! ret=%d\n", ret);
+        printf("RKNN: init failed! ret=%d\n", ret);
         return -1;
     }
 
@@ -69,8 +70,7 @@ int RKNNInference::Init(const std::string& model_path) {
     ret = QueryModelInfo();
     if (ret < 0) {
         printf("RKNN: Failed to query model info\n");
-        rknn_destroy(m_ctx.ctx);
-        m_ctx.ctx = 0;
+        m_backend->destroy();
         return -1;
     }
 
@@ -78,8 +78,7 @@ int RKNNInference::Init(const std::string& model_path) {
     ret = SetupIOMemory();
     if (ret < 0) {
         printf("RKNN: Failed to setup IO memory\n");
-        rknn_destroy(m_ctx.ctx);
-        m_ctx.ctx = 0;
+        m_backend->destroy();
         return -1;
     }
 
@@ -97,9 +96,9 @@ int RKNNInference::QueryModelInfo() {
 
     // Получение количества входов/выходов
     rknn_input_output_num io_num;
-    ret = rknn_query(m_ctx.ctx, RKNN_QUERY_IN_OUT_NUM, &io_num, sizeof(io_num));
+    ret = m_backend->queryIoNum(io_num);
     if (ret != RKNN_SUCC) {
-        printf("RKNN: rknn_query IN_OUT_NUM failed! ret=%d\n", ret);
+        printf("RKNN: query IN_OUT_NUM failed! ret=%d\n", ret);
         return -1;
     }
 
@@ -112,7 +111,7 @@ int RKNNInference::QueryModelInfo() {
         memset(&m_ctx.input_attrs[i], 0, sizeof(rknn_tensor_attr));
         m_ctx.input_attrs[i].index = i;
 
-        ret = rknn_query(m_ctx.ctx, RKNN_QUERY_NATIVE_INPUT_ATTR, &m_ctx.input_attrs[i], sizeof(rknn_tensor_attr));
+        ret = m_backend->queryInputAttr(m_ctx.input_attrs[i]);
         if (ret != RKNN_SUCC) {
             printf("RKNN: Failed to query input %d\n", i);
             return -1;
@@ -133,7 +132,7 @@ int RKNNInference::QueryModelInfo() {
         memset(&m_ctx.output_attrs[i], 0, sizeof(rknn_tensor_attr));
         m_ctx.output_attrs[i].index = i;
 
-        ret = rknn_query(m_ctx.ctx, RKNN_QUERY_NATIVE_NHWC_OUTPUT_ATTR, &m_ctx.output_attrs[i], sizeof(rknn_tensor_attr));
+        ret = m_backend->queryOutputAttr(m_ctx.output_attrs[i]);
         if (ret != RKNN_SUCC) {
             printf("RKNN: Failed to query output %d\n", i);
             return -1;
@@ -184,31 +183,32 @@ int RKNNInference::SetupIOMemory() {
     // Выделение памяти для входов
     m_ctx.input_mems.resize(m_ctx.n_inputs);
     for (int i = 0; i < m_ctx.n_inputs; i++) {
-        m_ctx.input_mems[i] = rknn_create_mem(m_ctx.ctx, m_ctx.input_infos[i].size_with_stride);
+        m_ctx.input_mems[i] = m_backend->createMem(m_ctx.input_infos[i].size_with_stride);
         if (!m_ctx.input_mems[i]) {
             printf("RKNN: Failed to allocate input memory %d\n", i);
             return -1;
         }
 
         // ИСПРАВЛЕНИЕ: Передаём указатель на rknn_tensor_attr из input_attrs вектора
-        ret = rknn_set_io_mem(m_ctx.ctx, m_ctx.input_mems[i], &m_ctx.input_attrs[i]);
+        ret = m_backend->setInputMem(m_ctx.input_mems[i], m_ctx.input_attrs[i]);
         if (ret < 0) {
             printf("RKNN: Failed to set input memory %d\n", i);
             return -1;
         }
     }
+    m_ctx.bound_inputs = m_ctx.input_mems;
 
     // Выделение памяти для выходов
     m_ctx.output_mems.resize(m_ctx.n_outputs);
     for (int i = 0; i < m_ctx.n_outputs; i++) {
-        m_ctx.output_mems[i] = rknn_create_mem(m_ctx.ctx, m_ctx.output_infos[i].size_with_stride);
+        m_ctx.output_mems[i] = m_backend->createMem(m_ctx.output_infos[i].size_with_stride);
         if (!m_ctx.output_mems[i]) {
             printf("RKNN: Failed to allocate output memory %d\n", i);
             return -1;
         }
 
         // ИСПРАВЛЕНИЕ: Передаём указатель на rknn_tensor_attr из output_attrs вектора
-        ret = rknn_set_io_mem(m_ctx.ctx, m_ctx.output_mems[i], &m_ctx.output_attrs[i]);
+        ret = m_backend->setOutputMem(m_ctx.output_mems[i], m_ctx.output_attrs[i]);
         if (ret < 0) {
             printf("RKNN: Failed to set output memory %d\n", i);
             return -1;
@@ -219,16 +219,18 @@ int RKNNInference::SetupIOMemory() {
 }
 
 int RKNNInference::CleanupIOMemory() {
+    ReleaseImports();
+
     for (int i = 0; i < m_ctx.n_inputs; i++) {
         if (m_ctx.input_mems[i]) {
-            rknn_destroy_mem(m_ctx.ctx, m_ctx.input_mems[i]);
+            m_backend->destroyMem(m_ctx.input_mems[i]);
             m_ctx.input_mems[i] = nullptr;
         }
     }
 
     for (int i = 0; i < m_ctx.n_outputs; i++) {
         if (m_ctx.output_mems[i]) {
-            rknn_destroy_mem(m_ctx.ctx, m_ctx.output_mems[i]);
+            m_backend->destroyMem(m_ctx.output_mems[i]);
             m_ctx.output_mems[i] = nullptr;
         }
     }
@@ -242,6 +244,7 @@ int RKNNInference::Deinit() {
     }
 
     CleanupIOMemory();
+    m_ctx.bound_inputs.clear();
     m_ctx.input_mems.clear();
     m_ctx.output_mems.clear();
     m_ctx.input_infos.clear();
@@ -249,10 +252,7 @@ int RKNNInference::Deinit() {
     m_ctx.input_attrs.clear();
     m_ctx.output_attrs.clear();
 
-    if (m_ctx.ctx) {
-        rknn_destroy(m_ctx.ctx);
-        m_ctx.ctx = 0;
-    }
+    m_backend->destroy();
 
     m_ctx.initialized = false;
     printf("RKNN: Model deinitialized\n");
@@ -261,6 +261,8 @@ int RKNNInference::Deinit() {
 }
 
 int RKNNInference::SetInput(int input_index, const uint8_t* input_data, size_t size) {
+    TraceScope trace("rknn.SetInput");
+
     if (!m_ctx.initialized) {
         printf("RKNN: Model not initialized\n");
         return -1;
@@ -282,28 +284,258 @@ int RKNNInference::SetInput(int input_index, const uint8_t* input_data, size_t s
         return -1;
     }
 
+    // Вход мог быть привязан к окну: копия идет в собственную память входа
+    if (m_ctx.bound_inputs[input_index] != m_ctx.input_mems[input_index]) {
+        int ret = m_backend->setInputMem(m_ctx.input_mems[input_index], m_ctx.input_attrs[input_index]);
+        if (ret < 0) {
+            printf("RKNN: Failed to set input memory %d\n", input_index);
+            return -1;
+        }
+        m_ctx.bound_inputs[input_index] = m_ctx.input_mems[input_index];
+    }
+
     void* input_addr = m_ctx.input_mems[input_index]->virt_addr;
     memcpy(input_addr, input_data, size);
+    m_backend->syncMem(m_ctx.input_mems[input_index], true);
+
+    return 0;
+}
+
+int RKNNInference::CreateInputView(int input_index, InputTensorView& view) {
+    memset(&view, 0, sizeof(view));
+
+    if (!m_ctx.initialized || input_index < 0 || input_index >= m_ctx.n_inputs) {
+        printf("RKNN: Invalid input index: %d\n", input_index);
+        return -1;
+    }
+
+    const TensorInfo& info = m_ctx.input_infos[input_index];
+    if (info.fmt != TensorFormat::NHWC || info.dims[1] <= 0) {
+        printf("RKNN: Input %d is not NHWC, cannot create view\n", input_index);
+        return -1;
+    }
+
+    view.mem = m_backend->createMem(info.size_with_stride);
+    if (!view.mem) {
+        printf("RKNN: Failed to allocate input view %d\n", input_index);
+        return -1;
+    }
+
+    view.index = input_index;
+    view.data = (uint8_t*)view.mem->virt_addr;
+    view.size = info.size_with_stride;
+    view.height = info.dims[1];
+    view.width = info.dims[2];
+    view.channels = info.dims[3];
+    view.pitch = info.size_with_stride / info.dims[1];
+    view.type = info.type;
+    view.qnt_type = info.qnt_type;
+    view.zp = info.zp;
+    view.scale = info.scale;
+    return 0;
+}
+
+void RKNNInference::DestroyInputView(InputTensorView& view) {
+    if (!view.mem) {
+        return;
+    }
+
+    // Привязанная память освобождается: вход возвращается к своей
+    if (m_ctx.initialized && m_ctx.bound_inputs[view.index] == view.mem) {
+        m_backend->setInputMem(m_ctx.input_mems[view.index], m_ctx.input_attrs[view.index]);
+        m_ctx.bound_inputs[view.index] = m_ctx.input_mems[view.index];
+    }
+    m_backend->destroyMem(view.mem);
+    memset(&view, 0, sizeof(view));
+}
+
+bool RKNNInference::CanImportInput(int input_index, const DmaBuffer& buffer) const {
+    if (!m_ctx.initialized || input_index < 0 || input_index >= m_ctx.n_inputs) {
+        return false;
+    }
+
+    const TensorInfo& info = m_ctx.input_infos[input_index];
+    if (info.fmt != TensorFormat::NHWC || info.type != TensorType::UINT8 || info.dims[1] <= 0) {
+        return false;
+    }
+    if (!buffer.data || (!buffer.block && buffer.fd < 0)) {
+        return false;
+    }
+    return buffer.pitch == (size_t)(info.size_with_stride / info.dims[1]) &&
+           buffer.size >= (size_t)info.size_with_stride;
+}
 
+int RKNNInference::ImportInputView(int input_index, const DmaBuffer& buffer, InputTensorView& view) {
+    TraceScope trace("rknn.ImportInputView");
+
+    if (!CanImportInput(input_index, buffer)) {
+        printf("RKNN: Buffer cannot back input %d directly\n", input_index);
+        return -1;
+    }
+
+    ImportedInput *entry = nullptr;
+    for (ImportedInput& imported : m_ctx.imported_inputs) {
+        if (imported.index == input_index && imported.block == buffer.block &&
+            imported.fd == buffer.fd && imported.data == buffer.data) {
+            entry = &imported;
+            break;
+        }
+    }
+
+    const TensorInfo& info = m_ctx.input_infos[input_index];
+    if (entry) {
+        m_ctx.import_hits.fetch_add(1, std::memory_order_relaxed);
+    } else {
+        rknn_tensor_mem *mem = m_backend->importMem(buffer.block, buffer.fd, buffer.data,
+                                                    info.size_with_stride);
+        if (!mem) {
+            printf("RKNN: Failed to import input buffer for input %d\n", input_index);
+            return -1;
+        }
+        m_ctx.import_count.fetch_add(1, std::memory_order_relaxed);
+
+        // Кэш полон: вытесняется импорт, который дольше всех не использовался
+        if (m_ctx.imported_inputs.size() >= kMaxImportedInputs) {
+            auto oldest = std::min_element(m_ctx.imported_inputs.begin(), m_ctx.imported_inputs.end(),
+                                           [](const ImportedInput& a, const ImportedInput& b) {
+                                               return a.lastUse < b.lastUse;
+                                           });
+            ReleaseImport(*oldest);
+            m_ctx.imported_inputs.erase(oldest);
+        }
+        m_ctx.imported_inputs.push_back(ImportedInput{input_index, buffer.block, buffer.fd, buffer.data, mem, 0});
+        entry = &m_ctx.imported_inputs.back();
+    }
+    entry->lastUse = ++m_ctx.import_clock;
+
+    memset(&view, 0, sizeof(view));
+    view.index = input_index;
+    view.mem = entry->mem;
+    view.data = (uint8_t*)buffer.data;
+    view.size = info.size_with_stride;
+    view.height = info.dims[1];
+    view.width = info.dims[2];
+    view.channels = info.dims[3];
+    view.pitch = buffer.pitch;
+    view.type = info.type;
+    view.qnt_type = info.qnt_type;
+    view.zp = info.zp;
+    view.scale = info.scale;
     return 0;
 }
 
+void RKNNInference::ReleaseImports() {
+    for (ImportedInput& entry : m_ctx.imported_inputs) {
+        ReleaseImport(entry);
+    }
+    m_ctx.imported_inputs.clear();
+}
+
+InputImportStats RKNNInference::GetImportStats() const {
+    InputImportStats stats;
+    stats.imports = m_ctx.import_count.load(std::memory_order_relaxed);
+    stats.hits = m_ctx.import_hits.load(std::memory_order_relaxed);
+    return stats;
+}
+
+void RKNNInference::ReleaseImport(ImportedInput& entry) {
+    if (!entry.mem) {
+        return;
+    }
+    if (m_ctx.bound_inputs[entry.index] == entry.mem) {
+        m_backend->setInputMem(m_ctx.input_mems[entry.index], m_ctx.input_attrs[entry.index]);
+        m_ctx.bound_inputs[entry.index] = m_ctx.input_mems[entry.index];
+    }
+    m_backend->destroyMem(entry.mem);
+    entry.mem = nullptr;
+}
+
+int RKNNInference::SyncInput(const InputTensorView& view) {
+    TraceScope trace("rknn.SyncInput");
+
+    if (!view.mem || m_backend->syncMem(view.mem, true) < 0) {
+        printf("RKNN: Failed to sync input view %d\n", view.index);
+        return -1;
+    }
+    return 0;
+}
+
+int RKNNInference::BindInput(const InputTensorView& view) {
+    if (!m_ctx.initialized) {
+        printf("RKNN: Model not initialized\n");
+        return -1;
+    }
+    if (!view.mem || view.index < 0 || view.index >= m_ctx.n_inputs) {
+        printf("RKNN: Input view %d has no memory to bind\n", view.index);
+        return -1;
+    }
+
+    // rknn_set_io_mem только при смене окна: подряд идущие запуски его не повторяют
+    if (m_ctx.bound_inputs[view.index] == view.mem) {
+        return 0;
+    }
+
+    int ret = m_backend->setInputMem(view.mem, m_ctx.input_attrs[view.index]);
+    if (ret < 0) {
+        printf("RKNN: Failed to bind input view %d, ret=%d\n", view.index, ret);
+        return -1;
+    }
+    m_ctx.bound_inputs[view.index] = view.mem;
+    return 0;
+}
+
+void RKNNInference::QuantizeInput(InputTensorView& view) {
+    if (view.type != TensorType::INT8) {
+        return;
+    }
+
+    // Таблица на 256 значений пикселя вместо деления на каждый байт
+    int8_t table[256];
+    for (int i = 0; i < 256; i++) {
+        if (view.qnt_type == QuantizationType::AFFINE_ASYMMETRIC && view.scale > 0.0f) {
+            table[i] = Quantize((float)i, view.zp, view.scale);
+        } else {
+            table[i] = (int8_t)(i - 128);
+        }
+    }
+
+    size_t rowBytes = (size_t)view.width * view.channels;
+    for (int y = 0; y < view.height; y++) {
+        uint8_t *row = view.data + y * view.pitch;
+        for (size_t x = 0; x < rowBytes; x++) {
+            row[x] = (uint8_t)table[row[x]];
+        }
+    }
+}
+
 int RKNNInference::Run() {
+    TraceScope trace("rknn.Run");
+
     if (!m_ctx.initialized) {
         printf("RKNN: Model not initialized\n");
         return -1;
     }
 
-    int ret = rknn_run(m_ctx.ctx, nullptr);
+    int ret = m_backend->run();
     if (ret < 0) {
-        printf("RKNN: rknn_run failed! ret=%d\n", ret);
+        printf("RKNN: run failed! ret=%d\n", ret);
         return -1;
     }
 
+    // Выходы записал NPU: строки кэша CPU по ним устарели до чтения декодером
+    for (int i = 0; i < m_ctx.n_outputs; i++) {
+        if (m_backend->syncMem(m_ctx.output_mems[i], false) < 0) {
+            printf("RKNN: Failed to sync output %d\n", i);
+            return -1;
+        }
+    }
+
     return 0;
 }
 
 int RKNNInference::GetOutput(int output_index, uint8_t* output_data, size_t size) {
+    TraceScope trace("rknn.GetOutput");
+
     if (!m_ctx.initialized) {
         printf("RKNN: Model not initialized\n");
         return -1;
@@ -0,0 +1,694 @@
+#include "backend.h"
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+#include <linux/dma-buf.h>
+#include <sys/ioctl.h>
+#include "rtsp_demo.h"
+
+// Частичная синхронизация DMA-BUF ядра Rockchip (CONFIG_DMABUF_PARTIAL)
+#ifndef DMA_BUF_IOCTL_SYNC_PARTIAL
+struct dma_buf_sync_partial {
+    __u64 flags;
+    __u32 offset;
+    __u32 len;
+};
+#define DMA_BUF_IOCTL_SYNC_PARTIAL _IOW(DMA_BUF_BASE, 2, struct dma_buf_sync_partial)
+#endif
+
+static std::atomic<bool> partialSyncSupported(true);
+
+// Согласует кэш участка блока: частично через DMA-BUF, без поддержки в ядре - весь блок
+static int syncBlockCache(MB_BLK block, uint64_t offset, uint64_t size, bool toDevice) {
+    int fd = RK_MPI_MB_Handle2Fd(block);
+    if (fd >= 0 && partialSyncSupported.load(std::memory_order_relaxed)) {
+        // START и END парой: запись сбрасывается в END, чтение делает кэш недействительным в START
+        uint64_t access = toDevice ? DMA_BUF_SYNC_WRITE : DMA_BUF_SYNC_READ;
+        struct dma_buf_sync_partial sync;
+        sync.offset = (__u32)offset;
+        sync.len = (__u32)size;
+        sync.flags = DMA_BUF_SYNC_START | access;
+        if (ioctl(fd, DMA_BUF_IOCTL_SYNC_PARTIAL, &sync) == 0) {
+            sync.flags = DMA_BUF_SYNC_END | access;
+            return ioctl(fd, DMA_BUF_IOCTL_SYNC_PARTIAL, &sync) == 0 ? 0 : -1;
+        }
+        if (errno != ENOTTY && errno != EINVAL) {
+            return -1;
+        }
+        printf("WARNING: Partial DMA-BUF sync unsupported, flushing whole blocks\n");
+        partialSyncSupported.store(false, std::memory_order_relaxed);
+    }
+
+    return RK_MPI_SYS_MmzFlushCache(block, toDevice ? RK_FALSE : RK_TRUE) == RK_SUCCESS ? 0 : -1;
+}
+
+// ============ MB пул ============
+
+class RockchipMemoryBackend : public MemoryBackend {
+public:
+    MB_POOL createPool(uint64_t size, uint32_t count) override {
+        MB_POOL_CONFIG_S PoolCfg;
+        memset(&PoolCfg, 0, sizeof(MB_POOL_CONFIG_S));
+        PoolCfg.u64MBSize = size;
+        PoolCfg.u32MBCnt = count;
+        PoolCfg.enAllocType = MB_ALLOC_TYPE_DMA;
+
+        return RK_MPI_MB_CreatePool(&PoolCfg);
+    }
+
+    int destroyPool(MB_POOL pool) override {
+        return RK_MPI_MB_DestroyPool(pool);
+    }
+
+    MB_BLK getBlock(MB_POOL pool, uint64_t size, bool cached) override {
+        return RK_MPI_MB_GetMB(pool, size, cached ? RK_TRUE : RK_FALSE);
+    }
+
+    int releaseBlock(MB_BLK block) override {
+        return RK_MPI_MB_ReleaseMB(block);
+    }
+
+    void* getVirtualAddress(MB_BLK block) override {
+        return RK_MPI_MB_Handle2VirAddr(block);
+    }
+
+    int getFd(MB_BLK block) override {
+        return RK_MPI_MB_Handle2Fd(block);
+    }
+
+    int syncCache(MB_BLK block, uint64_t offset, uint64_t size, bool toDevice) override {
+        return syncBlockCache(block, offset, size, toDevice);
+    }
+};
+
+// ============ VENC ============
+
+class RockchipEncoderBackend : public EncoderBackend {
+public:
+    int createChannel(int channelId, const EncoderParams& params) override {
+        VENC_CHN_ATTR_S stAttr;
+        memset(&stAttr, 0, sizeof(VENC_CHN_ATTR_S));
+
+        stAttr.stVencAttr.enType = params.codec;
+        stAttr.stVencAttr.enPixelFormat = params.pixelFormat;
+        stAttr.stVencAttr.u32Profile = H264E_PROFILE_MAIN;
+        stAttr.stVencAttr.u32PicWidth = params.width;
+        stAttr.stVencAttr.u32PicHeight = params.height;
+        stAttr.stVencAttr.u32VirWidth = params.width;
+        stAttr.stVencAttr.u32VirHeight = params.height;
+        stAttr.stVencAttr.u32StreamBufCnt = params.streamBufCount;
+        stAttr.stVencAttr.u32BufSize = params.bufSize;
+        stAttr.stVencAttr.enMirror = MIRROR_NONE;
+
+        stAttr.stRcAttr.enRcMode = VENC_RC_MODE_H264CBR;
+        stAttr.stRcAttr.stH264Cbr.u32BitRate = params.bitrate;
+        stAttr.stRcAttr.stH264Cbr.u32Gop = params.gop;
+
+        int ret = RK_MPI_VENC_CreateChn(channelId, &stAttr);
+        if (ret != RK_SUCCESS) {
+            printf("RK_MPI_VENC_CreateChn failed: %x\n", ret);
+            return ret;
+        }
+
+        ret = startReceiving(channelId);
+        if (ret != RK_SUCCESS) {
+            RK_MPI_VENC_DestroyChn(channelId);
+            return ret;
+        }
+
+        return RK_SUCCESS;
+    }
+
+    void destroyChannel(int channelId) override {
+        RK_MPI_VENC_StopRecvFrame(channelId);
+        RK_MPI_VENC_DestroyChn(channelId);
+    }
+
+    int stopReceiving(int channelId) override {
+        int ret = RK_MPI_VENC_StopRecvFrame(channelId);
+        if (ret != RK_SUCCESS) {
+            printf("RK_MPI_VENC_StopRecvFrame failed: %x\n", ret);
+        }
+        return ret;
+    }
+
+    int startReceiving(int channelId) override {
+        VENC_RECV_PIC_PARAM_S stRecvParam;
+        memset(&stRecvParam, 0, sizeof(VENC_RECV_PIC_PARAM_S));
+        stRecvParam.s32RecvPicNum = -1;  // Continuous reception
+
+        int ret = RK_MPI_VENC_StartRecvFrame(channelId, &stRecvParam);
+        if (ret != RK_SUCCESS) {
+            printf("RK_MPI_VENC_StartRecvFrame failed: %x\n", ret);
+        }
+        return ret;
+    }
+
+    int requestIdr(int channelId) override {
+        int ret = RK_MPI_VENC_RequestIDR(channelId, RK_TRUE);
+        if (ret != RK_SUCCESS) {
+            printf("RK_MPI_VENC_RequestIDR failed: %x\n", ret);
+        }
+        return ret;
+    }
+
+    int sendFrame(int channelId, const VIDEO_FRAME_INFO_S* frame, int timeoutMs) override {
+        int ret = RK_MPI_VENC_SendFrame(channelId, frame, timeoutMs);
+        if (ret != RK_SUCCESS) {
+            printf("RK_MPI_VENC_SendFrame failed: %x\n", ret);
+        }
+        return ret;
+    }
+
+    int getStream(int channelId, VENC_STREAM_S* stream, int timeoutMs) override {
+        return RK_MPI_VENC_GetStream(channelId, stream, timeoutMs);
+    }
+
+    int releaseStream(int channelId, VENC_STREAM_S* stream) override {
+        int ret = RK_MPI_VENC_ReleaseStream(channelId, stream);
+        if (ret != RK_SUCCESS) {
+            printf("RK_MPI_VENC_ReleaseStream failed: %x\n", ret);
+        }
+        return ret;
+    }
+
+    const uint8_t* getPackData(const VENC_PACK_S& pack) override {
+        // Поток записал кодер: в кэше CPU могут лежать строки прошлого пакета
+        syncBlockCache(pack.pMbBlk, 0, (uint64_t)pack.u32Offset + pack.u32Len, false);
+        return reinterpret_cast<const uint8_t*>(RK_MPI_MB_Handle2VirAddr(pack.pMbBlk));
+    }
+};
+
+// ============ VI и VPSS ============
+
+class RockchipCaptureBackend : public CaptureBackend {
+public:
+    RockchipCaptureBackend()
+        : ispStarted_(false), devEnabled_(false), chnEnabled_(false),
+          vpssStarted_(false), vpssBound_(false) {}
+    ~RockchipCaptureBackend() override { close(); }
+
+    int open(const CaptureParams& params) override {
+        params_ = params;
+
+        // Без запущенного ISP сенсор не отдает кадры в VI
+        int ret = SAMPLE_COMM_ISP_Init(params.camera, RK_AIQ_WORKING_MODE_NORMAL, RK_FALSE,
+                                       params.iqPath.c_str());
+        if (ret != RK_SUCCESS) {
+            printf("SAMPLE_COMM_ISP_Init failed: %x\n", ret);
+            return ret;
+        }
+        ret = SAMPLE_COMM_ISP_Run(params.camera);
+        if (ret != RK_SUCCESS) {
+            printf("SAMPLE_COMM_ISP_Run failed: %x\n", ret);
+            SAMPLE_COMM_ISP_Stop(params.camera);
+            return ret;
+        }
+        ispStarted_ = true;
+
+        ret = initDevice();
+        if (ret == RK_SUCCESS) {
+            ret = initChannel();
+        }
+        if (ret == RK_SUCCESS && hasModelOutput()) {
+            ret = initVpss();
+        }
+        if (ret != RK_SUCCESS) {
+            close();
+        }
+        return ret;
+    }
+
+    void close() override {
+        if (vpssBound_) {
+            MPP_CHN_S src = viChn();
+            MPP_CHN_S dst = vpssChn(kVideoChn);
+            RK_MPI_SYS_UnBind(&src, &dst);
+            vpssBound_ = false;
+        }
+        if (vpssStarted_) {
+            RK_MPI_VPSS_StopGrp(kVpssGroup);
+            RK_MPI_VPSS_DisableChn(kVpssGroup, kVideoChn);
+            RK_MPI_VPSS_DisableChn(kVpssGroup, kModelChn);
+            RK_MPI_VPSS_DestroyGrp(kVpssGroup);
+            vpssStarted_ = false;
+        }
+        if (chnEnabled_) {
+            RK_MPI_VI_DisableChn(params_.camera, params_.channel);
+            chnEnabled_ = false;
+        }
+        if (devEnabled_) {
+            RK_MPI_VI_DisableDev(params_.camera);
+            devEnabled_ = false;
+        }
+        // ISP останавливается после отключения потока VI
+        if (ispStarted_) {
+            SAMPLE_COMM_ISP_Stop(params_.camera);
+            ispStarted_ = false;
+        }
+    }
+
+    int getFrame(VIDEO_FRAME_INFO_S& frame, int timeoutMs) override {
+        if (hasModelOutput()) {
+            int ret = RK_MPI_VPSS_GetChnFrame(kVpssGroup, kVideoChn, &frame, timeoutMs);
+            if (ret != RK_SUCCESS) {
+                printf("RK_MPI_VPSS_GetChnFrame failed: %x\n", ret);
+            }
+            return ret;
+        }
+
+        int ret = RK_MPI_VI_GetChnFrame(params_.camera, params_.channel, &frame, timeoutMs);
+        if (ret != RK_SUCCESS) {
+            printf("RK_MPI_VI_GetChnFrame failed: %x\n", ret);
+        }
+        return ret;
+    }
+
+    int releaseFrame(const VIDEO_FRAME_INFO_S& frame) override {
+        if (hasModelOutput()) {
+            int ret = RK_MPI_VPSS_ReleaseChnFrame(kVpssGroup, kVideoChn, &frame);
+            if (ret != RK_SUCCESS) {
+                printf("RK_MPI_VPSS_ReleaseChnFrame failed: %x\n", ret);
+            }
+            return ret;
+        }
+
+        int ret = RK_MPI_VI_ReleaseChnFrame(params_.camera, params_.channel, &frame);
+        if (ret != RK_SUCCESS) {
+            printf("RK_MPI_VI_ReleaseChnFrame failed: %x\n", ret);
+        }
+        return ret;
+    }
+
+    int getModelFrame(VIDEO_FRAME_INFO_S& frame, int timeoutMs) override {
+        if (!hasModelOutput()) {
+            return RK_FAILURE;
+        }
+        // Прореженная ветка часто пуста: отсутствие кадра не ошибка
+        return RK_MPI_VPSS_GetChnFrame(kVpssGroup, kModelChn, &frame, timeoutMs);
+    }
+
+    int releaseModelFrame(const VIDEO_FRAME_INFO_S& frame) override {
+        int ret = RK_MPI_VPSS_ReleaseChnFrame(kVpssGroup, kModelChn, &frame);
+        if (ret != RK_SUCCESS) {
+            printf("RK_MPI_VPSS_ReleaseChnFrame failed: %x\n", ret);
+        }
+        return ret;
+    }
+
+    void* getVirtualAddress(MB_BLK block) override {
+        return RK_MPI_MB_Handle2VirAddr(block);
+    }
+
+private:
+    int initDevice() {
+        int devId = params_.camera;
+
+        VI_DEV_ATTR_S stDevAttr;
+        memset(&stDevAttr, 0, sizeof(VI_DEV_ATTR_S));
+        int ret = RK_MPI_VI_GetDevAttr(devId, &stDevAttr);
+        if (ret == RK_ERR_VI_NOT_CONFIG) {
+            ret = RK_MPI_VI_SetDevAttr(devId, &stDevAttr);
+            if (ret != RK_SUCCESS) {
+                printf("RK_MPI_VI_SetDevAttr failed: %x\n", ret);
+                return ret;
+            }
+        }
+
+        if (RK_MPI_VI_GetDevIsEnable(devId) != RK_SUCCESS) {
+            ret = RK_MPI_VI_EnableDev(devId);
+            if (ret != RK_SUCCESS) {
+                printf("RK_MPI_VI_EnableDev failed: %x\n", ret);
+                return ret;
+            }
+            devEnabled_ = true;
+
+            VI_DEV_BIND_PIPE_S stBindPipe;
+            memset(&stBindPipe, 0, sizeof(VI_DEV_BIND_PIPE_S));
+            stBindPipe.u32Num = 1;
+            stBindPipe.PipeId[0] = devId;
+            ret = RK_MPI_VI_SetDevBindPipe(devId, &stBindPipe);
+            if (ret != RK_SUCCESS) {
+                printf("RK_MPI_VI_SetDevBindPipe failed: %x\n", ret);
+                return ret;
+            }
+        }
+        return RK_SUCCESS;
+    }
+
+    int initChannel() {
+        VI_CHN_ATTR_S stChnAttr;
+        memset(&stChnAttr, 0, sizeof(VI_CHN_ATTR_S));
+        stChnAttr.stIspOpt.u32BufCount = params_.bufCount;
+        stChnAttr.stIspOpt.enMemoryType = VI_V4L2_MEMORY_TYPE_DMABUF;
+        stChnAttr.stSize.u32Width = params_.width;
+        stChnAttr.stSize.u32Height = params_.height;
+        stChnAttr.enPixelFormat = RK_FMT_YUV420SP;
+        stChnAttr.enCompressMode = COMPRESS_MODE_NONE;
+        // Глубина > 0 разрешает забирать кадры через RK_MPI_VI_GetChnFrame,
+        // с VPSS кадры канала забирает только привязка
+        stChnAttr.u32Depth = hasModelOutput() ? 0 : 2;
+
+        int ret = RK_MPI_VI_SetChnAttr(params_.camera, params_.channel, &stChnAttr);
+        if (ret != RK_SUCCESS) {
+            printf("RK_MPI_VI_SetChnAttr failed: %x\n", ret);
+            return ret;
+        }
+
+        ret = RK_MPI_VI_EnableChn(params_.camera, params_.channel);
+        if (ret != RK_SUCCESS) {
+            printf("RK_MPI_VI_EnableChn failed: %x\n", ret);
+            return ret;
+        }
+        chnEnabled_ = true;
+        return RK_SUCCESS;
+    }
+
+    int initVpss() {
+        const ModelOutputParams& model = params_.model;
+
+        VPSS_GRP_ATTR_S stGrpAttr;
+        memset(&stGrpAttr, 0, sizeof(VPSS_GRP_ATTR_S));
+        stGrpAttr.u32MaxW = params_.width;
+        stGrpAttr.u32MaxH = params_.height;
+        stGrpAttr.enPixelFormat = RK_FMT_YUV420SP;
+        stGrpAttr.stFrameRate.s32SrcFrameRate = -1;
+        stGrpAttr.stFrameRate.s32DstFrameRate = -1;
+        stGrpAttr.enCompressMode = COMPRESS_MODE_NONE;
+
+        int ret = RK_MPI_VPSS_CreateGrp(kVpssGroup, &stGrpAttr);
+        if (ret != RK_SUCCESS) {
+            printf("RK_MPI_VPSS_CreateGrp failed: %x\n", ret);
+            return ret;
+        }
+        vpssStarted_ = true;
+
+        // Канал 0: кадр полного размера для VENC
+        VPSS_CHN_ATTR_S stChnAttr;
+        memset(&stChnAttr, 0, sizeof(VPSS_CHN_ATTR_S));
+        stChnAttr.enChnMode = VPSS_CHN_MODE_USER;
+        stChnAttr.enDynamicRange = DYNAMIC_RANGE_SDR8;
+        stChnAttr.enPixelFormat = RK_FMT_YUV420SP;
+        stChnAttr.stFrameRate.s32SrcFrameRate = -1;
+        stChnAttr.stFrameRate.s32DstFrameRate = -1;
+        stChnAttr.u32Width = params_.width;
+        stChnAttr.u32Height = params_.height;
+        stChnAttr.enCompressMode = COMPRESS_MODE_NONE;
+        stChnAttr.u32Depth = 2;
+        stChnAttr.u32FrameBufCnt = params_.bufCount;
+        ret = enableVpssChn(kVideoChn, stChnAttr);
+        if (ret != RK_SUCCESS) {
+            return ret;
+        }
+
+        // Канал 1: вход модели, масштаб и letterbox делает VPSS
+        memset(&stChnAttr, 0, sizeof(VPSS_CHN_ATTR_S));
+        stChnAttr.enChnMode = VPSS_CHN_MODE_USER;
+        stChnAttr.enDynamicRange = DYNAMIC_RANGE_SDR8;
+        stChnAttr.enPixelFormat = RK_FMT_RGB888;
+        stChnAttr.stFrameRate.s32SrcFrameRate = model.fps > 0 ? params_.fps : -1;
+        stChnAttr.stFrameRate.s32DstFrameRate = model.fps > 0 ? model.fps : -1;
+        stChnAttr.u32Width = model.width;
+        stChnAttr.u32Height = model.height;
+        stChnAttr.enCompressMode = COMPRESS_MODE_NONE;
+        stChnAttr.u32Depth = 1;
+        stChnAttr.u32FrameBufCnt = model.bufCount;
+        stChnAttr.stAspectRatio.enMode = ASPECT_RATIO_MANUAL;
+        stChnAttr.stAspectRatio.u32BgColor = model.bgColor;
+        stChnAttr.stAspectRatio.stVideoRect.s32X = (RK_S32)model.rectX;
+        stChnAttr.stAspectRatio.stVideoRect.s32Y = (RK_S32)model.rectY;
+        stChnAttr.stAspectRatio.stVideoRect.u32Width = model.rectWidth;
+        stChnAttr.stAspectRatio.stVideoRect.u32Height = model.rectHeight;
+        ret = enableVpssChn(kModelChn, stChnAttr);
+        if (ret != RK_SUCCESS) {
+            return ret;
+        }
+
+        ret = RK_MPI_VPSS_StartGrp(kVpssGroup);
+        if (ret != RK_SUCCESS) {
+            printf("RK_MPI_VPSS_StartGrp failed: %x\n", ret);
+            return ret;
+        }
+
+        MPP_CHN_S src = viChn();
+        MPP_CHN_S dst = vpssChn(kVideoChn);
+        ret = RK_MPI_SYS_Bind(&src, &dst);
+        if (ret != RK_SUCCESS) {
+            printf("RK_MPI_SYS_Bind VI -> VPSS failed: %x\n", ret);
+            return ret;
+        }
+        vpssBound_ = true;
+        return RK_SUCCESS;
+    }
+
+    int enableVpssChn(int chn, const VPSS_CHN_ATTR_S& attr) {
+        int ret = RK_MPI_VPSS_SetChnAttr(kVpssGroup, chn, &attr);
+        if (ret != RK_SUCCESS) {
+            printf("RK_MPI_VPSS_SetChnAttr %d failed: %x\n", chn, ret);
+            return ret;
+        }
+        ret = RK_MPI_VPSS_EnableChn(kVpssGroup, chn);
+        if (ret != RK_SUCCESS) {
+            printf("RK_MPI_VPSS_EnableChn %d failed: %x\n", chn, ret);
+        }
+        return ret;
+    }
+
+    bool hasModelOutput() const { return params_.model.width > 0 && params_.model.height > 0; }
+
+    MPP_CHN_S viChn() const {
+        MPP_CHN_S chn;
+        chn.enModId = RK_ID_VI;
+        chn.s32DevId = params_.camera;
+        chn.s32ChnId = params_.channel;
+        return chn;
+    }
+
+    static MPP_CHN_S vpssChn(int chnId) {
+        MPP_CHN_S chn;
+        chn.enModId = RK_ID_VPSS;
+        chn.s32DevId = kVpssGroup;
+        chn.s32ChnId = chnId;
+        return chn;
+    }
+
+    static const int kVpssGroup = 0;
+    static const int kVideoChn = 0;
+    static const int kModelChn = 1;
+
+    CaptureParams params_;
+    bool ispStarted_;
+    bool devEnabled_;
+    bool chnEnabled_;
+    bool vpssStarted_;
+    bool vpssBound_;
+};
+
+// ============ NPU ============
+
+class RockchipNpuBackend : public NpuBackend {
+public:
+    RockchipNpuBackend() : ctx_(0) {}
+    ~RockchipNpuBackend() override { destroy(); }
+
+    int init(const std::string& modelPath) override {
+        return rknn_init(&ctx_, (char*)modelPath.c_str(), 0, 0, NULL);
+    }
+
+    void destroy() override {
+        if (ctx_) {
+            rknn_destroy(ctx_);
+            ctx_ = 0;
+        }
+    }
+
+    int queryIoNum(rknn_input_output_num& ioNum) override {
+        return rknn_query(ctx_, RKNN_QUERY_IN_OUT_NUM, &ioNum, sizeof(ioNum));
+    }
+
+    int queryInputAttr(rknn_tensor_attr& attr) override {
+        return rknn_query(ctx_, RKNN_QUERY_NATIVE_INPUT_ATTR, &attr, sizeof(rknn_tensor_attr));
+    }
+
+    int queryOutputAttr(rknn_tensor_attr& attr) override {
+        return rknn_query(ctx_, RKNN_QUERY_NATIVE_NHWC_OUTPUT_ATTR, &attr, sizeof(rknn_tensor_attr));
+    }
+
+    rknn_tensor_mem* createMem(uint32_t size) override {
+        return rknn_create_mem(ctx_, size);
+    }
+
+    void destroyMem(rknn_tensor_mem* mem) override {
+        rknn_destroy_mem(ctx_, mem);
+    }
+
+    rknn_tensor_mem* importMem(MB_BLK block, int fd, void* virt, uint32_t size) override {
+        if (block) {
+            return rknn_create_mem_from_mb_blk(ctx_, block, 0);
+        }
+        return fd >= 0 ? rknn_create_mem_from_fd(ctx_, fd, virt, size, 0) : nullptr;
+    }
+
+    int setInputMem(rknn_tensor_mem* mem, rknn_tensor_attr& attr) override {
+        return rknn_set_io_mem(ctx_, mem, &attr);
+    }
+
+    int setOutputMem(rknn_tensor_mem* mem, rknn_tensor_attr& attr) override {
+        return rknn_set_io_mem(ctx_, mem, &attr);
+    }
+
+    int syncMem(rknn_tensor_mem* mem, bool toDevice) override {
+        return rknn_mem_sync(ctx_, mem, toDevice ? RKNN_MEMORY_SYNC_TO_DEVICE : RKNN_MEMORY_SYNC_FROM_DEVICE);
+    }
+
+    int run() override {
+        return rknn_run(ctx_, nullptr);
+    }
+
+private:
+    rknn_context ctx_;
+};
+
+// ============ RTSP ============
+
+class RockchipRtspBackend : public RtspBackend {
+public:
+    RockchipRtspBackend() : handle_(nullptr), port_(0) {}
+    ~RockchipRtspBackend() override { destroy(); }
+
+    int create(int port) override {
+        port_ = port;
+        handle_ = create_rtsp_demo(port);
+        return handle_ ? 0 : -1;
+    }
+
+    int createSession(const char* path) override {
+        rtsp_session_handle session = rtsp_new_session(handle_, path);
+        if (!session) {
+            return -1;
+        }
+        sessions_.push_back(session);
+        return (int)sessions_.size() - 1;
+    }
+
+    int setVideo(int session, int codecId, const uint8_t* codecData, int dataLen) override {
+        return rtsp_set_video(sessions_[session], codecId, codecData, dataLen);
+    }
+
+    int sendVideo(int session, const uint8_t* frame, int len, uint64_t ts) override {
+        return rtsp_tx_video(sessions_[session], frame, len, ts);
+    }
+
+    int doEvent() override {
+        return rtsp_do_event(handle_);
+    }
+
+    int syncVideoTimestamp(int session, uint64_t ts, uint64_t ntpTime) override {
+        return rtsp_sync_video_ts(sessions_[session], ts, ntpTime);
+    }
+
+    void destroy() override {
+        for (rtsp_session_handle session : sessions_) {
+            rtsp_del_session(session);
+        }
+        sessions_.clear();
+        if (handle_) {
+            rtsp_del_demo(handle_);
+            handle_ = nullptr;
+        }
+    }
+
+    uint64_t getRelativeTime() override { return rtsp_get_reltime(); }
+    uint64_t getNtpTime() override { return rtsp_get_ntptime(); }
+
+    int getClientCount() override {
+        // librtsp не сообщает о клиентах: у каждого есть управляющее TCP соединение
+        // с портом сервера, в том числе при передаче RTP по UDP
+        int ipv4 = countEstablished("/proc/net/tcp");
+        int ipv6 = countEstablished("/proc/net/tcp6");
+        if (ipv4 < 0 && ipv6 < 0) {
+            return -1;
+        }
+        return std::max(ipv4, 0) + std::max(ipv6, 0);
+    }
+
+private:
+    int countEstablished(const char* path) const {
+        FILE *file = fopen(path, "r");
+        if (!file) {
+            return -1;
+        }
+
+        // sl local_address rem_address st ...: адреса в hex, 01 - ESTABLISHED
+        char line[256];
+        int count = 0;
+        while (fgets(line, sizeof(line), file)) {
+            char local[64];
+            unsigned int state = 0;
+            if (sscanf(line, " %*d: %63s %*s %x", local, &state) != 2) {
+                continue;
+            }
+            const char *colon = strrchr(local, ':');
+            if (colon && state == 0x01 && (int)strtoul(colon + 1, nullptr, 16) == port_) {
+                count++;
+            }
+        }
+
+        fclose(file);
+        return count;
+    }
+
+    rtsp_demo_handle handle_;
+    std::vector<rtsp_session_handle> sessions_;
+    int port_;
+};
+
+// ============ Платформа ============
+
+int initPlatform() {
+    // Штатный RTSP сервис прошивки занимает камеру и кодер
+    if (system("RkLunch-stop.sh") != 0) {
+        printf("ERROR: cant stop default rtsp\n");
+        return -1;
+    }
+
+    int ret = RK_MPI_SYS_Init();
+    if (ret != RK_SUCCESS) {
+        printf("ERROR: RK_MPI_SYS_Init failed: %x\n", ret);
+        return ret;
+    }
+
+    return 0;
+}
+
+void exitPlatform() {
+    RK_MPI_SYS_Exit();
+}
+
+const char* getPlatformName() {
+    return "RK MPI";
+}
+
+std::unique_ptr<MemoryBackend> createMemoryBackend() {
+    return std::unique_ptr<MemoryBackend>(new RockchipMemoryBackend());
+}
+
+std::unique_ptr<EncoderBackend> createEncoderBackend() {
+    return std::unique_ptr<EncoderBackend>(new RockchipEncoderBackend());
+}
+
+std::unique_ptr<CaptureBackend> createCaptureBackend() {
+    return std::unique_ptr<CaptureBackend>(new RockchipCaptureBackend());
+}
+
+std::unique_ptr<NpuBackend> createNpuBackend(const NpuOptions& options) {
+    return std::unique_ptr<NpuBackend>(new RockchipNpuBackend());
+}
+
+std::unique_ptr<RtspBackend> createRtspBackend() {
+    return std::unique_ptr<RtspBackend>(new RockchipRtspBackend());
+}
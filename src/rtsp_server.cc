@@ -1,8 +1,19 @@
 #include "rtsp_server.h"
+#include <algorithm>
+#include <cerrno>
 #include <cstdio>
+#include <cstring>
+#include <pthread.h>
+#include <sys/epoll.h>
+#include <sys/timerfd.h>
+#include <unistd.h>
+#include "thread_policy.h"
+#include "trace.h"
+#include "utilities.h"
 
 RtspServer::RtspServer(int port)
-    : port_(port), handle_(nullptr), session_(nullptr), initialized_(false) {
+    : backend_(createRtspBackend()), port_(port), initialized_(false), clients_(0),
+      eventIntervalMs_(0), events_(0) {
 }
 
 RtspServer::~RtspServer() {
@@ -12,8 +23,7 @@ RtspServer::~RtspServer() {
 int RtspServer::init() {
     printf("%s: port=%d\n", __func__, port_);
     
-    handle_ = create_rtsp_demo(port_);
-    if (!handle_) {
+    if (backend_->create(port_) != 0) {
         printf("ERROR: Failed to create RTSP demo\n");
         return -1;
     }
@@ -33,64 +43,265 @@ int RtspServer::createSession(const char *path) {
         printf("ERROR: Path is null\n");
         return -1;
     }
+
+    if (thread_.joinable()) {
+        printf("ERROR: RTSP event thread already running\n");
+        return -1;
+    }
     
-    session_ = rtsp_new_session(handle_, path);
-    if (!session_) {
+    int id = backend_->createSession(path);
+    if (id < 0) {
         printf("ERROR: Failed to create RTSP session\n");
         return -1;
     }
+
+    std::unique_ptr<Session> session(new Session());
+    session->id = id;
+    session->path = path;
+    sessions_.resize(std::max(sessions_.size(), (size_t)id + 1));
+    sessions_[id] = std::move(session);
     
     printf("RTSP session created: %s\n", path);
-    return 0;
+    return id;
 }
 
-int RtspServer::setVideoCodec(int codecId, const uint8_t *codecData, int dataLen) {
-    if (!session_) {
-        printf("ERROR: RTSP session not created\n");
+bool RtspServer::isValidSession(int session) const {
+    if (session < 0 || (size_t)session >= sessions_.size() || !sessions_[session]) {
+        printf("ERROR: RTSP session %d not created\n", session);
+        return false;
+    }
+    return true;
+}
+
+int RtspServer::setVideoCodec(int session, int codecId, const uint8_t *codecData, int dataLen) {
+    if (!isValidSession(session)) {
         return -1;
     }
     
-    int ret = rtsp_set_video(session_, codecId, codecData, dataLen);
+    int ret = backend_->setVideo(session, codecId, codecData, dataLen);
     if (ret != 0) {
         printf("ERROR: Failed to set video codec\n");
         return ret;
     }
     
-    printf("Video codec set successfully: codec=%d\n", codecId);
+    printf("Video codec set successfully: %s, codec=%d\n", sessions_[session]->path.c_str(), codecId);
     return 0;
 }
 
-int RtspServer::sendVideoFrame(const uint8_t *frame, int len, uint64_t ts) {
-    if (!session_) {
-        printf("ERROR: RTSP session not created\n");
-        return -1;
-    }
-    
+int RtspServer::sendVideoFrame(int session, const uint8_t *frame, int len, uint64_t ts) {
     if (!frame || len <= 0) {
         printf("ERROR: Invalid frame data\n");
         return -1;
     }
     
-    int ret = rtsp_tx_video(session_, frame, len, ts);
+    TraceScope trace("rtsp.sendVideoFrame", (uint32_t)session);
+    int ret = backend_->sendVideo(session, frame, len, ts);
     return ret;
 }
 
-int RtspServer::processEvents() {
-    if (!handle_) {
+int RtspServer::attachSink(int session, size_t queueDepth, int eventIntervalMs, SentCallback onSent) {
+    if (!isValidSession(session)) {
         return -1;
     }
-    
-    rtsp_do_event(handle_);
+
+    if (thread_.joinable()) {
+        printf("ERROR: RTSP event thread already running\n");
+        return -1;
+    }
+
+    if (queueDepth == 0 || eventIntervalMs <= 0) {
+        printf("ERROR: Invalid RTSP queue depth or event interval\n");
+        return -1;
+    }
+
+    Session& target = *sessions_[session];
+    if (target.pending) {
+        printf("ERROR: RTSP session %s already has a sink\n", target.path.c_str());
+        return -1;
+    }
+
+    target.pending.reset(new SpscQueue<OutgoingFrame*>(queueDepth));
+    target.free.reset(new SpscQueue<OutgoingFrame*>(queueDepth));
+    for (size_t i = 0; i < queueDepth; i++) {
+        target.frames.emplace_back(new OutgoingFrame());
+        target.free->tryPush(target.frames.back().get());
+    }
+    target.onSent = std::move(onSent);
+    attached_.push_back(&target);
+
+    eventIntervalMs_ = eventIntervalMs_ ? std::min(eventIntervalMs_, eventIntervalMs) : eventIntervalMs;
+    printf("RTSP session %s: queue=%zu\n", target.path.c_str(), queueDepth);
     return 0;
 }
 
-int RtspServer::syncVideoTimestamp(uint64_t ts, uint64_t ntpTime) {
-    if (!session_) {
-        printf("ERROR: RTSP session not created\n");
+int RtspServer::start() {
+    if (thread_.joinable()) {
+        printf("ERROR: RTSP event thread already running\n");
+        return -1;
+    }
+
+    // Кадры некому отправлять: в графе нет стадии rtsp
+    if (attached_.empty()) {
+        return 0;
+    }
+
+    thread_ = std::thread(&RtspServer::runEventLoop, this, eventIntervalMs_);
+    printf("RTSP event thread started: %zu sessions, interval=%d ms\n",
+           attached_.size(), eventIntervalMs_);
+    return 0;
+}
+
+void RtspServer::stop() {
+    if (!thread_.joinable()) {
+        return;
+    }
+
+    for (Session *session : attached_) {
+        session->pending->close();
+    }
+    thread_.join();
+}
+
+bool RtspServer::submitVideoFrame(int session, const uint8_t *frame, int len, uint64_t ts,
+                                  const FrameTimeline& timeline) {
+    if (!thread_.joinable()) {
+        printf("ERROR: RTSP event thread not started\n");
+        return false;
+    }
+
+    if (!frame || len <= 0) {
+        printf("ERROR: Invalid frame data\n");
+        return false;
+    }
+
+    // Все буферы в очереди: поток отправки не успевает, кадр отбрасывается
+    Session& target = *sessions_[session];
+    OutgoingFrame *outgoing = nullptr;
+    if (!target.free->tryPop(outgoing)) {
+        target.dropped.fetch_add(1, std::memory_order_relaxed);
+        return false;
+    }
+
+    outgoing->data.assign(frame, frame + len);
+    outgoing->pts = ts;
+    outgoing->timeline = timeline;
+    target.pending->tryPush(outgoing);
+    return true;
+}
+
+void RtspServer::sendPending(Session& session) {
+    OutgoingFrame *outgoing = nullptr;
+    while (session.pending->tryPop(outgoing)) {
+        // rtsp_tx_video отправляет RTP пакеты клиентам синхронно, внутри вызова
+        sendVideoFrame(session.id, outgoing->data.data(), (int)outgoing->data.size(), outgoing->pts);
+        session.sent.fetch_add(1, std::memory_order_relaxed);
+        if (session.onSent) {
+            session.onSent(outgoing->timeline, TimerUtils::getCurrentTimeUs());
+        }
+        session.free->tryPush(outgoing);
+    }
+}
+
+void RtspServer::runEventLoop(int eventIntervalMs) {
+    pthread_setname_np(pthread_self(), "rtsp-events");
+    ThreadRegistry::instance().registerCurrentThread("rtsp");
+
+    int epollFd = epoll_create1(EPOLL_CLOEXEC);
+    int timerFd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+    if (epollFd < 0 || timerFd < 0) {
+        printf("ERROR: RTSP event thread: %s\n", strerror(errno));
+    } else {
+        struct itimerspec interval;
+        interval.it_interval.tv_sec = eventIntervalMs / 1000;
+        interval.it_interval.tv_nsec = (long)(eventIntervalMs % 1000) * 1000000;
+        interval.it_value = interval.it_interval;
+        timerfd_settime(timerFd, 0, &interval, nullptr);
+
+        // Таймер помечен nullptr, очередь - своей сессией
+        struct epoll_event event;
+        memset(&event, 0, sizeof(event));
+        event.events = EPOLLIN;
+        event.data.ptr = nullptr;
+        epoll_ctl(epollFd, EPOLL_CTL_ADD, timerFd, &event);
+        for (Session *session : attached_) {
+            event.data.ptr = session;
+            epoll_ctl(epollFd, EPOLL_CTL_ADD, session->pending->eventFd(), &event);
+        }
+
+        std::vector<struct epoll_event> ready(attached_.size() + 1);
+        while (true) {
+            for (Session *session : attached_) {
+                sendPending(*session);
+            }
+            // Очереди закрываются вместе в stop()
+            if (attached_.front()->pending->isClosed()) {
+                break;
+            }
+
+            // Уведомление взведено только на время сна: в потоках кадров eventfd не пишется.
+            // Если кадры уже пришли, таймер все равно проверяется, чтобы не голодали события
+            bool armed = true;
+            for (Session *session : attached_) {
+                armed = session->pending->armWakeup() && armed;
+            }
+            int timeoutMs = armed ? -1 : 0;
+
+            int count = epoll_wait(epollFd, ready.data(), (int)ready.size(), timeoutMs);
+            if (count < 0 && errno != EINTR) {
+                printf("ERROR: RTSP epoll_wait: %s\n", strerror(errno));
+                break;
+            }
+
+            for (int i = 0; i < count; i++) {
+                Session *session = (Session*)ready[i].data.ptr;
+                if (!session) {
+                    uint64_t expirations;
+                    ssize_t ret = read(timerFd, &expirations, sizeof(expirations));
+                    (void)ret;
+
+                    // Подключения, RTSP запросы, RTCP и отключения клиентов
+                    TraceScope trace("rtsp.doEvent");
+                    backend_->doEvent();
+                    events_.fetch_add(1, std::memory_order_relaxed);
+                } else {
+                    session->pending->drainWakeup();
+                }
+            }
+        }
+    }
+
+    // Неотправленные кадры остаются в буферах сессий
+    for (Session *session : attached_) {
+        OutgoingFrame *outgoing = nullptr;
+        while (session->pending->tryPop(outgoing)) {
+            session->dropped.fetch_add(1, std::memory_order_relaxed);
+        }
+    }
+
+    if (timerFd >= 0) {
+        close(timerFd);
+    }
+    if (epollFd >= 0) {
+        close(epollFd);
+    }
+}
+
+RtspStats RtspServer::getStats(int session) const {
+    RtspStats stats;
+    const Session& source = *sessions_[session];
+    stats.sent = source.sent.load(std::memory_order_relaxed);
+    stats.dropped = source.dropped.load(std::memory_order_relaxed);
+    stats.events = events_.load(std::memory_order_relaxed);
+    stats.pending = source.pending ? source.pending->size() : 0;
+    return stats;
+}
+
+int RtspServer::syncVideoTimestamp(int session, uint64_t ts, uint64_t ntpTime) {
+    if (!isValidSession(session)) {
         return -1;
     }
     
-    int ret = rtsp_sync_video_ts(session_, ts, ntpTime);
+    int ret = backend_->syncVideoTimestamp(session, ts, ntpTime);
     if (ret != 0) {
         printf("ERROR: Failed to sync video timestamp\n");
         return ret;
@@ -99,20 +310,40 @@ int RtspServer::syncVideoTimestamp(uint64_t ts, uint64_t ntpTime) {
     return 0;
 }
 
-void RtspServer::shutdown() {
+int RtspServer::updateClientCount() {
     if (!initialized_) {
-        return;
+        return 0;
     }
-    
-    if (session_) {
-        rtsp_del_session(session_);
-        session_ = nullptr;
+
+    int count = backend_->getClientCount();
+    int previous = clients_.exchange(count, std::memory_order_relaxed);
+    if (count != previous) {
+        if (count < 0) {
+            printf("RTSP clients: unknown\n");
+        } else {
+            printf("RTSP clients: %d\n", count);
+        }
     }
-    
-    if (handle_) {
-        rtsp_del_demo(handle_);
-        handle_ = nullptr;
+    return count;
+}
+
+uint64_t RtspServer::getRelativeTime() const {
+    return backend_->getRelativeTime();
+}
+
+uint64_t RtspServer::getNtpTime() const {
+    return backend_->getNtpTime();
+}
+
+void RtspServer::shutdown() {
+    if (!initialized_) {
+        return;
     }
+
+    stop();
     
+    backend_->destroy();
+    attached_.clear();
+    sessions_.clear();
     initialized_ = false;
 }
@@ -0,0 +1,999 @@
+#include "stages.h"
+#include <algorithm>
+#include <cstring>
+#include <sstream>
+#include <unistd.h>
+#include "trace.h"
+#include "utilities.h"
+
+static ModelContext* requireModel(StageContext& context, const StageSpec& spec) {
+    std::string name = spec.getParam("model", "default");
+    ModelContext *model = context.findModel(name);
+    if (!model) {
+        printf("ERROR: Stage '%s': unknown model '%s'\n", spec.name.c_str(), name.c_str());
+    }
+    return model;
+}
+
+static StreamContext* requireStream(StageContext& context, const StageSpec& spec) {
+    StreamContext *stream = context.findStream(spec.stream);
+    if (!stream) {
+        printf("ERROR: Stage '%s': unknown stream '%s'\n", spec.name.c_str(), spec.stream.c_str());
+    }
+    return stream;
+}
+
+// Вход модели, подготовленный для этого кадра, или nullptr
+static ModelInput* findInput(const FrameRef& frame, const ModelContext *model) {
+    for (const auto& input : frame.meta().modelInputs) {
+        if (input->model == model) {
+            return input.get();
+        }
+    }
+    return nullptr;
+}
+
+// Размер NHWC uint8 входа модели с тремя каналами
+static int getModelInputSize(ModelContext *model, int& width, int& height) {
+    const TensorInfo& info = model->getInference().GetInputInfo();
+    height = info.dims[1];
+    width = info.dims[2];
+    if (width <= 0 || height <= 0 || info.dims[3] != 3) {
+        printf("ERROR: Unsupported model input shape\n");
+        return -1;
+    }
+    return 0;
+}
+
+SourceStage::SourceStage(const StageSpec& spec)
+    : Stage(spec), frameProcessor_(nullptr), memPool_(nullptr), sourceModel_(nullptr),
+      pixelFormat_(spec.getParam("pixel_format", "bgr") == "nv12" ? RK_FMT_YUV420SP : RK_FMT_BGR888),
+      pacer_(spec.getFloat("fps", 0.0f)), paced_(false),
+      frameLimit_((uint32_t)spec.getInt("frames", 0)), seq_(0) {
+}
+
+int SourceStage::init(StageContext& context) {
+    StreamContext *stream = requireStream(context, spec_);
+    if (!stream) {
+        return -1;
+    }
+    frameProcessor_ = stream->frameProcessor;
+    memPool_ = stream->memPool;
+    if (!frameProcessor_) {
+        printf("ERROR: Stage '%s' needs frame processor\n", spec_.name.c_str());
+        return -1;
+    }
+
+    source_ = createFrameSource(spec_, frameProcessor_->getWidth(), frameProcessor_->getHeight());
+    if (!source_) {
+        printf("ERROR: Stage '%s': unknown source '%s'\n",
+               spec_.name.c_str(), spec_.getParam("source").c_str());
+        return -1;
+    }
+    if (!source_->providesFrames() && !memPool_) {
+        printf("ERROR: Stage '%s' needs memory pool\n", spec_.name.c_str());
+        return -1;
+    }
+    if (!spec_.getParam("model").empty() && initModelOutput(context) != 0) {
+        return -1;
+    }
+    return source_->open();
+}
+
+int SourceStage::initModelOutput(StageContext& context) {
+    ModelContext *model = requireModel(context, spec_);
+    int modelWidth, modelHeight;
+    if (!model || getModelInputSize(model, modelWidth, modelHeight) != 0) {
+        return -1;
+    }
+
+    Letterbox box = computeLetterbox(frameProcessor_->getWidth(), frameProcessor_->getHeight(),
+                                     modelWidth, modelHeight);
+    ModelOutputParams params;
+    params.width = modelWidth;
+    params.height = modelHeight;
+    params.rectX = box.offsetX;
+    params.rectY = box.offsetY;
+    params.rectWidth = box.width;
+    params.rectHeight = box.height;
+    params.bgColor = 0x727272;      // Та же заливка 114, что у letterbox на CPU
+    params.fps = spec_.getInt("model_fps", 0);
+
+    if (source_->setModelOutput(params) != 0) {
+        printf("ERROR: Stage '%s': %s source cannot prepare model input\n",
+               spec_.name.c_str(), source_->getName());
+        return -1;
+    }
+    sourceModel_ = model;
+    printf("Stage '%s': model input %dx%d from %s source, frame at %d,%d %dx%d\n",
+           spec_.name.c_str(), modelWidth, modelHeight, source_->getName(),
+           box.offsetX, box.offsetY, box.width, box.height);
+    return 0;
+}
+
+StageStatus SourceStage::process(FrameRef& frame) {
+    if (frameLimit_ && seq_ >= frameLimit_) {
+        return finish();
+    }
+
+    // Ожидание блока пула не сдвигает расписание: опоздавший кадр учтет пейсер
+    if (!paced_) {
+        pacer_.wait();
+        paced_ = true;
+    }
+
+    SourceStatus status;
+    std::vector<Detection> groundTruth;
+    if (source_->providesFrames()) {
+        // Кадр остается в буфере источника, описание для VENC заполнено им
+        TraceScope trace("source.acquire", seq_);
+        status = source_->acquire(frame, groundTruth);
+    } else {
+        // Все блоки пула заняты кадрами в обороте: пул ждет, пока стадии их отпустят
+        frame = FrameRef::create(*memPool_, frameProcessor_->getWidth(), frameProcessor_->getHeight(),
+                                 pixelFormat_, 1000);
+        if (!frame) {
+            return StageStatus::Drop;
+        }
+
+        TraceScope trace("source.read", seq_);
+        if (frame.isNv12()) {
+            bgr_.create(frame.height(), frame.width(), CV_8UC3);
+            status = source_->read(bgr_, groundTruth);
+            if (status == SourceStatus::Frame) {
+                frameProcessor_->convertToNv12(bgr_, frame.image());
+            }
+        } else {
+            status = source_->read(frame.image(), groundTruth);
+        }
+        if (status == SourceStatus::Frame) {
+            frameProcessor_->initFrame(frame.vencFrame(), frame.block(), pixelFormat_);
+            // Кадр целиком записан CPU: сбрасывается сразу, оверлей потом отметит только свое
+            frame.markAllDirty();
+            frame.flushCpuWrites();
+        }
+    }
+    paced_ = false;
+
+    if (status == SourceStatus::Error) {
+        return StageStatus::Error;
+    }
+    if (status == SourceStatus::End) {
+        frame.reset();
+        return finish();
+    }
+    FrameMeta& meta = frame.meta();
+    meta.groundTruth = std::move(groundTruth);
+    meta.hasGroundTruth = source_->hasGroundTruth();
+    meta.sourceModel = sourceModel_;
+
+    // Метка после чтения: ожидание кадра камеры не входит в задержку конвейера
+    frameProcessor_->updateTimeForFrame(frame.vencFrame());
+
+    frame.setSeq(seq_++);
+    frame.setCaptureTimeUs(frame.vencFrame().stVFrame.u64PTS);
+    mark(frame, TimelinePoint::Capture, frame.captureTimeUs());
+    return StageStatus::Forward;
+}
+
+StageStatus SourceStage::finish() {
+    printf("Stage '%s': %s source finished after %u frames, %llu late\n",
+           spec_.name.c_str(), source_->getName(), seq_,
+           (unsigned long long)pacer_.getLateFrames());
+    return StageStatus::End;
+}
+
+static MotionConfig makeMotionConfig(const StageSpec& spec) {
+    MotionConfig config;
+    config.pixelThreshold = spec.getInt("threshold", config.pixelThreshold);
+    config.minBlocks = spec.getInt("min_blocks", config.minBlocks);
+    config.learnShift = spec.getInt("learn_shift", config.learnShift);
+    config.holdFrames = spec.getInt("hold_frames", config.holdFrames);
+    return config;
+}
+
+MotionStage::MotionStage(const StageSpec& spec)
+    : Stage(spec), detector_(makeMotionConfig(spec)) {
+}
+
+int MotionStage::init(StageContext& context) {
+    MotionConfig config = makeMotionConfig(spec_);
+    if (config.learnShift < 0 || config.learnShift > 8 || config.pixelThreshold <= 0) {
+        printf("ERROR: Stage '%s': invalid motion parameters\n", spec_.name.c_str());
+        return -1;
+    }
+    return 0;
+}
+
+StageStatus MotionStage::process(FrameRef& frame) {
+    // Маска новая на каждый кадр: потребители могут держать ее дольше кадра
+    std::shared_ptr<MotionMask> mask = std::make_shared<MotionMask>();
+    mask->frameSeq = frame.seq();
+    // Яркость записана ISP: строки в кэше могут остаться от прошлого оборота буфера
+    frame.beginCpuAccess(cv::Rect(0, 0, frame.width(), frame.height()), false);
+    detector_.update(frame.isNv12() ? frame.luma() : frame.image(), *mask);
+    frame.meta().motion = std::move(mask);
+    return StageStatus::Forward;
+}
+
+PreprocessStage::PreprocessStage(const StageSpec& spec)
+    : Stage(spec), model_(nullptr), nextTile_(0),
+      refreshUs_((uint64_t)spec.getInt("refresh_ms", 2000) * 1000), lastInputUs_(0) {
+}
+
+int PreprocessStage::init(StageContext& context) {
+    model_ = requireModel(context, spec_);
+    return model_ ? 0 : -1;
+}
+
+StageStatus PreprocessStage::process(FrameRef& frame) {
+    mark(frame, TimelinePoint::PreprocessStart, TimerUtils::getCurrentTimeUs());
+    frame.setPoolOwner(PoolOwner::Npu);
+
+    // Неподвижная сцена: прежние детекции верны, NPU не нужен
+    const MotionMask *motion = frame.meta().motion.get();
+    bool refreshDue = refreshUs_ && frame.captureTimeUs() - lastInputUs_ >= refreshUs_;
+    if (motion && !motion->active && !refreshDue) {
+        model_->recordMotionSkip();
+    } else if (model_->isNpuDue(TimerUtils::getCurrentTimeUs()) &&
+               model_->getScheduler().shouldRun(frame.seq())) {
+        // Кадр читается до того, как оверлей начнет в нем рисовать.
+        // Нет свободного входа: NPU занят, ящик полон - кадр идет без детекции
+        std::shared_ptr<ModelInput> input = model_->acquireInput();
+        bool prepared = false;
+        if (input && model_->getTiling().isEnabled()) {
+            // Плитки режутся из самого кадра, вход от источника им не подходит
+            frame.meta().modelFrame.reset();
+            prepared = prepareTiles(frame, *input) == 0;
+        } else if (input && frame.meta().sourceModel == model_) {
+            prepared = copyModelFrame(frame, *input) == 0;
+        } else if (input) {
+            prepared = prepareModelInput(frame, *input) == 0;
+        }
+        if (prepared && input->tileCount == 0 && !input->sourceFrame) {
+            // Пиксели в памяти NPU: до Run осталось сбросить кэш CPU
+            RKNNInference::QuantizeInput(input->tensor);
+            prepared = model_->getInference().SyncInput(input->tensor) == 0;
+        }
+        if (prepared) {
+            frame.meta().modelInputs.push_back(std::move(input));
+            model_->getScheduler().markRun(frame.seq());
+            lastInputUs_ = frame.captureTimeUs();
+        }
+    }
+    // Вход этой модели от VPSS не пошел в NPU (пропуск, не очередь, нет входа):
+    // буферов у канала модели мало, кадр дальше по конвейеру держать нельзя
+    if (frame.meta().sourceModel == model_) {
+        frame.meta().modelFrame.reset();
+    }
+
+    mark(frame, TimelinePoint::PreprocessEnd, TimerUtils::getCurrentTimeUs());
+    return StageStatus::Forward;
+}
+
+// Кадр VPSS как внешний буфер для входа NPU; кадр пишет VPSS, кэш CPU не задействован
+static DmaBuffer getFrameDmaBuffer(const FrameRef& frame) {
+    const cv::Mat& image = frame.image();
+    return DmaBuffer{frame.block(), -1, frame.data(), image.step * (size_t)frame.height(), image.step};
+}
+
+int PreprocessStage::copyModelFrame(FrameRef& frame, ModelInput& input) {
+    // Ветка модели прорежена: для этого кадра VPSS вход не готовил
+    std::shared_ptr<FrameRef> modelFrame = std::move(frame.meta().modelFrame);
+    if (!modelFrame) {
+        return -1;
+    }
+
+    int modelWidth, modelHeight;
+    if (getModelInputSize(model_, modelWidth, modelHeight) != 0) {
+        return -1;
+    }
+    if (modelFrame->pixelFormat() != RK_FMT_RGB888 ||
+        modelFrame->width() != modelWidth || modelFrame->height() != modelHeight) {
+        printf("ERROR: Model frame %dx%d does not match model input %dx%d\n",
+               modelFrame->width(), modelFrame->height(), modelWidth, modelHeight);
+        return -1;
+    }
+
+    if (model_->getInference().CanImportInput(input.tensor.index, getFrameDmaBuffer(*modelFrame))) {
+        // Раскладка совпадает с тензором: NPU прочитает кадр VPSS сам
+        input.sourceFrame = std::move(modelFrame);
+    } else {
+        // Кадр уже RGB с letterbox, остается разложить строки по шагу тензора
+        if (modelFrame->beginCpuAccess() != 0) {
+            return -1;
+        }
+        const cv::Mat& image = modelFrame->image();
+        InputTensorView& tensor = input.tensor;
+        size_t rowBytes = (size_t)modelWidth * 3;
+        if (image.step == tensor.pitch && image.isContinuous()) {
+            memcpy(tensor.data, image.data, tensor.pitch * modelHeight);
+        } else {
+            for (int y = 0; y < modelHeight; y++) {
+                memcpy(tensor.data + y * tensor.pitch, image.ptr<uint8_t>(y), rowBytes);
+            }
+        }
+        modelFrame.reset();
+    }
+
+    input.letterbox = computeLetterbox(frame.width(), frame.height(), modelWidth, modelHeight);
+    input.tileCount = 0;
+    fillModelInput(frame, input);
+    return 0;
+}
+
+// Заливка полей вокруг вписанного кадра: сам кадр пишется поверх
+static void fillLetterboxMargins(const InputTensorView& tensor, const Letterbox& box, uint8_t value) {
+    size_t rowBytes = (size_t)tensor.width * 3;
+    size_t leftBytes = (size_t)box.offsetX * 3;
+    size_t boxBytes = (size_t)box.width * 3;
+    for (int y = 0; y < tensor.height; y++) {
+        uint8_t *row = tensor.data + y * tensor.pitch;
+        if (y < box.offsetY || y >= box.offsetY + box.height) {
+            memset(row, value, rowBytes);
+        } else {
+            memset(row, value, leftBytes);
+            memset(row + leftBytes + boxBytes, value, rowBytes - leftBytes - boxBytes);
+        }
+    }
+}
+
+YuvLetterbox* PreprocessStage::getYuvLetterbox(int width, int height, const InputTensorView& tensor) {
+    for (YuvLetterboxEntry& entry : yuvLetterboxes_) {
+        if (entry.width == width && entry.height == height) {
+            return &entry.letterbox;
+        }
+    }
+
+    YuvLetterboxEntry entry;
+    entry.width = width;
+    entry.height = height;
+    if (entry.letterbox.configure(YuvLayout::Nv12, width, height,
+                                  tensor.width, tensor.height, tensor.pitch) != 0) {
+        return nullptr;
+    }
+    yuvLetterboxes_.push_back(std::move(entry));
+    return &yuvLetterboxes_.back().letterbox;
+}
+
+int PreprocessStage::prepareRegion(const FrameRef& frame, const TileRegion& region,
+                                   const InputTensorView& tensor, Letterbox& letterbox) {
+    const size_t pitch = tensor.pitch;
+    if (frame.beginCpuAccess(cv::Rect(region.x, region.y, region.width, region.height)) != 0) {
+        return -1;
+    }
+
+    if (frame.isNv12()) {
+        // Кадр VI читается прямо из его DMA буфера: перевод в RGB, масштаб
+        // и поля letterbox за один проход, без промежуточных кадров.
+        // Углы области четные, так что она начинается с целого блока UV
+        YuvLetterbox *yuvLetterbox = getYuvLetterbox(region.width, region.height, tensor);
+        if (!yuvLetterbox) {
+            return -1;
+        }
+
+        const cv::Mat& image = frame.image();
+        const uint8_t *uv = image.data + image.step * (image.rows * 2 / 3);
+        YuvImage yuv;
+        yuv.data = image.data + region.y * image.step + region.x;
+        yuv.uv = uv + (region.y / 2) * image.step + region.x;
+        yuv.width = region.width;
+        yuv.height = region.height;
+        yuv.stride = image.step;
+        if (yuvLetterbox->convert(yuv, tensor.data) != 0) {
+            return -1;
+        }
+
+        letterbox = yuvLetterbox->getLetterbox();
+        return 0;
+    }
+
+    Letterbox box = computeLetterbox(region.width, region.height, tensor.width, tensor.height);
+    fillLetterboxMargins(tensor, box, 114);
+
+    // Масштаб сразу в окно тензора и перестановка BGR -> RGB на месте
+    cv::Mat source = frame.image()(cv::Rect(region.x, region.y, region.width, region.height));
+    cv::Mat target(box.height, box.width, CV_8UC3, tensor.data + box.offsetY * pitch + box.offsetX * 3, pitch);
+    cv::resize(source, target, target.size());
+    cv::cvtColor(target, target, cv::COLOR_BGR2RGB);
+
+    letterbox = box;
+    return 0;
+}
+
+int PreprocessStage::prepareModelInput(const FrameRef& frame, ModelInput& input) {
+    // Нативный вход RV1106: NHWC uint8, кадр пишется прямо в память NPU
+    int modelWidth, modelHeight;
+    if (getModelInputSize(model_, modelWidth, modelHeight) != 0) {
+        return -1;
+    }
+
+    TileRegion whole = {0, 0, frame.width(), frame.height()};
+    if (prepareRegion(frame, whole, input.tensor, input.letterbox) != 0) {
+        return -1;
+    }
+
+    input.tileCount = 0;
+    fillModelInput(frame, input);
+    return 0;
+}
+
+int PreprocessStage::prepareTiles(const FrameRef& frame, ModelInput& input) {
+    int modelWidth, modelHeight;
+    if (getModelInputSize(model_, modelWidth, modelHeight) != 0) {
+        return -1;
+    }
+
+    const TilingConfig& tiling = model_->getTiling();
+    if (tileFrameSize_ != cv::Size(frame.width(), frame.height())) {
+        tileRegions_ = computeTiles(tiling, frame.width(), frame.height());
+        tileFrameSize_ = cv::Size(frame.width(), frame.height());
+        nextTile_ = 0;
+    }
+
+    // Обход - все плитки на кадр, чередование - следующая по кругу
+    for (size_t i = 0; i < input.tiles.size(); i++) {
+        ModelTile& tile = input.tiles[i];
+        tile.index = tiling.sweep ? (uint32_t)i : nextTile_;
+        tile.region = tileRegions_[tile.index];
+        tile.npuUs = 0;
+        tile.detections.clear();
+
+        if (prepareRegion(frame, tile.region, tile.tensor, tile.letterbox) != 0) {
+            return -1;
+        }
+        RKNNInference::QuantizeInput(tile.tensor);
+        if (model_->getInference().SyncInput(tile.tensor) != 0) {
+            return -1;
+        }
+    }
+    if (!tiling.sweep) {
+        nextTile_ = (nextTile_ + 1) % (uint32_t)tileRegions_.size();
+    }
+
+    input.tileCount = (uint32_t)input.tiles.size();
+    input.letterbox = computeLetterbox(frame.width(), frame.height(), modelWidth, modelHeight);
+    fillModelInput(frame, input);
+    return 0;
+}
+
+void PreprocessStage::fillModelInput(const FrameRef& frame, ModelInput& input) {
+    input.frameWidth = frame.width();
+    input.frameHeight = frame.height();
+
+    DetectionResult& result = input.result;
+    result.frameSeq = frame.seq();
+    result.captureTimeUs = frame.captureTimeUs();
+    result.inferenceStartUs = 0;
+    result.completeTimeUs = 0;
+    result.detections.clear();
+    result.tracks.clear();
+    result.hasGroundTruth = frame.meta().hasGroundTruth;
+    result.groundTruth = frame.meta().groundTruth;
+}
+
+InferStage::InferStage(const StageSpec& spec)
+    : Stage(spec), model_(nullptr) {
+}
+
+int InferStage::init(StageContext& context) {
+    model_ = requireModel(context, spec_);
+    return model_ ? 0 : -1;
+}
+
+bool InferStage::admit(FrameRef& frame, FrameRef& admitted) {
+    auto& inputs = frame.meta().modelInputs;
+    for (auto it = inputs.begin(); it != inputs.end(); ++it) {
+        if ((*it)->model == model_) {
+            admitted = FrameRef::createDetached(frame.width(), frame.height());
+            admitted.setSeq(frame.seq());
+            admitted.setCaptureTimeUs(frame.captureTimeUs());
+            admitted.timeline() = frame.timeline();
+            admitted.meta().modelInputs.push_back(std::move(*it));
+            inputs.erase(it);
+            return true;
+        }
+    }
+    return false;
+}
+
+StageStatus InferStage::process(FrameRef& frame) {
+    ModelInput *input = findInput(frame, model_);
+    if (!input) {
+        return StageStatus::Drop;
+    }
+
+    // Контекст RKNN может быть общим с моделями других потоков: очередь
+    // держится до конца декодирования, пока выходы лежат в его памяти
+    input->npuGrant = model_->acquireNpu();
+    if (!input->npuGrant) {
+        return StageStatus::Drop;
+    }
+
+    RKNNInference& inference = model_->getInference();
+    uint64_t startUs = TimerUtils::getCurrentTimeUs();
+    input->result.inferenceStartUs = startUs;
+    mark(frame, TimelinePoint::NpuStart, startUs);
+
+    int ret = 0;
+    if (input->tileCount) {
+        ret = runTiles(*input);
+    } else if (input->sourceFrame) {
+        // Импорт под очередью NPU: привязка входа меняет общий контекст
+        InputTensorView view;
+        ret = inference.ImportInputView(input->tensor.index, getFrameDmaBuffer(*input->sourceFrame), view);
+        if (ret == 0) {
+            ret = inference.BindInput(view);
+        }
+        if (ret == 0) {
+            ret = inference.Run();
+        }
+        input->sourceFrame.reset();
+    } else {
+        ret = inference.BindInput(input->tensor);
+        if (ret == 0) {
+            ret = inference.Run();
+        }
+    }
+    if (ret != 0) {
+        input->npuGrant.release();
+        return StageStatus::Drop;
+    }
+
+    uint64_t nowUs = TimerUtils::getCurrentTimeUs();
+    mark(frame, TimelinePoint::NpuEnd, nowUs);
+    // Шаг выбирается по времени всех плиток кадра: столько NPU стоит один вход
+    model_->getScheduler().recordRun(nowUs - startUs, nowUs);
+    if (input->tileCount) {
+        input->npuGrant.release();
+    } else {
+        model_->recordOutputs();
+    }
+    return StageStatus::Forward;
+}
+
+void InferStage::flush() {
+    // Импорты ссылаются на блоки VPSS: источник освободит их вместе с конвейером
+    if (model_) {
+        model_->getInference().ReleaseImports();
+    }
+}
+
+int InferStage::runTiles(ModelInput& input) {
+    RKNNInference& inference = model_->getInference();
+
+    // Выходы перезаписывает следующий Run(), поэтому плитка декодируется сразу;
+    // PostprocessStage только сводит рамки через швы
+    for (uint32_t i = 0; i < input.tileCount; i++) {
+        ModelTile& tile = input.tiles[i];
+        TraceScope trace("infer.tile", tile.index);
+        uint64_t tileStartUs = TimerUtils::getCurrentTimeUs();
+
+        if (inference.BindInput(tile.tensor) != 0 || inference.Run() != 0) {
+            return -1;
+        }
+        model_->recordOutputs();
+        if (model_->getDecoder().decode(inference, tile.letterbox, tile.region.width, tile.region.height,
+                                        tile.detections) != 0) {
+            return -1;
+        }
+        for (Detection& det : tile.detections) {
+            det.left += tile.region.x;
+            det.top += tile.region.y;
+            det.right += tile.region.x;
+            det.bottom += tile.region.y;
+        }
+
+        tile.npuUs = TimerUtils::getCurrentTimeUs() - tileStartUs;
+        model_->recordTile(tile);
+    }
+    return 0;
+}
+
+PostprocessStage::PostprocessStage(const StageSpec& spec)
+    : Stage(spec), model_(nullptr) {
+}
+
+int PostprocessStage::init(StageContext& context) {
+    model_ = requireModel(context, spec_);
+    return model_ ? 0 : -1;
+}
+
+StageStatus PostprocessStage::process(FrameRef& frame) {
+    ModelInput *input = findInput(frame, model_);
+    if (!input) {
+        return StageStatus::Drop;
+    }
+
+    if (input->tileCount) {
+        mergeTiles(*input);
+        mark(frame, TimelinePoint::Postprocess, TimerUtils::getCurrentTimeUs());
+        return StageStatus::Forward;
+    }
+
+    int ret = model_->getDecoder().decode(model_->getInference(), input->letterbox,
+                                          input->frameWidth, input->frameHeight,
+                                          input->result.detections);
+    input->npuGrant.release();
+    if (ret != 0) {
+        return StageStatus::Drop;
+    }
+
+    mark(frame, TimelinePoint::Postprocess, TimerUtils::getCurrentTimeUs());
+    return StageStatus::Forward;
+}
+
+void PostprocessStage::mergeTiles(ModelInput& input) {
+    // При чередовании у плиток, не запущенных на этом кадре, берутся
+    // последние рамки: они отстают не больше чем на круг плиток
+    const TilingConfig& tiling = model_->getTiling();
+    tileDetections_.resize(tiling.getTileCount());
+    for (uint32_t i = 0; i < input.tileCount; i++) {
+        const ModelTile& tile = input.tiles[i];
+        tileDetections_[tile.index] = tile.detections;
+    }
+    mergeTileDetections(tileDetections_, tiling, input.result.detections);
+}
+
+TrackStage::TrackStage(const StageSpec& spec)
+    : Stage(spec), model_(nullptr),
+      tracker_(spec.getFloat("iou", 0.3f), (uint32_t)spec.getInt("max_missed", 5)) {
+}
+
+int TrackStage::init(StageContext& context) {
+    model_ = requireModel(context, spec_);
+    return model_ ? 0 : -1;
+}
+
+StageStatus TrackStage::process(FrameRef& frame) {
+    ModelInput *input = findInput(frame, model_);
+    if (!input) {
+        return StageStatus::Drop;
+    }
+
+    tracker_.update(input->result.detections, input->result.tracks);
+    return StageStatus::Forward;
+}
+
+PublishStage::PublishStage(const StageSpec& spec)
+    : Stage(spec), model_(nullptr) {
+}
+
+int PublishStage::init(StageContext& context) {
+    model_ = requireModel(context, spec_);
+    return model_ ? 0 : -1;
+}
+
+StageStatus PublishStage::process(FrameRef& frame) {
+    ModelInput *input = findInput(frame, model_);
+    if (!input) {
+        return StageStatus::Drop;
+    }
+
+    input->result.completeTimeUs = TimerUtils::getCurrentTimeUs();
+    model_->publish(std::make_shared<const DetectionResult>(input->result));
+    return StageStatus::Forward;
+}
+
+OverlayStage::OverlayStage(const StageSpec& spec)
+    : Stage(spec), frameProcessor_(nullptr), stream_(nullptr), context_(nullptr) {
+}
+
+int OverlayStage::init(StageContext& context) {
+    stream_ = requireStream(context, spec_);
+    if (!stream_) {
+        return -1;
+    }
+    frameProcessor_ = stream_->frameProcessor;
+    context_ = &context;
+    if (!frameProcessor_) {
+        printf("ERROR: Stage '%s' needs frame processor\n", spec_.name.c_str());
+        return -1;
+    }
+
+    // Рамки модели другого потока к этому кадру не относятся
+    std::string names = spec_.getParam("models");
+    if (names.empty()) {
+        for (auto& entry : context.models) {
+            if (entry.second->getStreamName() == stream_->spec.name) {
+                models_.push_back(entry.second.get());
+            }
+        }
+        return 0;
+    }
+
+    std::stringstream stream(names);
+    std::string name;
+    while (std::getline(stream, name, ',')) {
+        ModelContext *model = context.findModel(name);
+        if (!model) {
+            printf("ERROR: Stage '%s': unknown model '%s'\n", spec_.name.c_str(), name.c_str());
+            return -1;
+        }
+        models_.push_back(model);
+    }
+    return 0;
+}
+
+StageStatus OverlayStage::process(FrameRef& frame) {
+    // Кадр без зрителей не рисуется, его отбросит стадия кодирования
+    if (!context_->isEncodeNeeded(*stream_)) {
+        return StageStatus::Forward;
+    }
+
+    FrameMeta& meta = frame.meta();
+    drawn_.clear();
+
+    // NV12 кадр рисуется в своих плоскостях, без перевода в BGR и обратно
+    std::unique_ptr<Nv12Canvas> nv12;
+    if (frame.isNv12()) {
+        nv12.reset(new Nv12Canvas(frame.image(), frame.width(), frame.height()));
+    }
+
+    // Рисуется последний готовый результат, даже если он получен на старом кадре
+    for (ModelContext *model : models_) {
+        std::shared_ptr<const DetectionResult> result = model->getLatestResult();
+        if (!result || frame.seq() < result->frameSeq) {
+            continue;
+        }
+
+        meta.detections.insert(meta.detections.end(),
+                               result->detections.begin(), result->detections.end());
+        meta.tracks.insert(meta.tracks.end(), result->tracks.begin(), result->tracks.end());
+        if (nv12) {
+            frameProcessor_->drawDetections(*nv12, result->detections, model->getDecoder(), &drawn_);
+        } else {
+            frameProcessor_->drawDetections(frame.image(), result->detections, model->getDecoder(), &drawn_);
+        }
+
+        // На неподвижной сцене результат устаревает намеренно
+        const MotionMask *motion = meta.motion.get();
+        if (!motion || motion->active) {
+            model->recordOverlay(frame.seq() - result->frameSeq,
+                                 frame.captureTimeUs() - result->captureTimeUs);
+        }
+    }
+
+    if (nv12) {
+        frameProcessor_->drawFpsText(*nv12, stream_->fps.load(), &drawn_);
+    } else {
+        frameProcessor_->drawFpsText(frame.image(), stream_->fps.load(), &drawn_);
+    }
+    for (const cv::Rect& rect : drawn_) {
+        frame.markDirty(rect);
+    }
+    mark(frame, TimelinePoint::Overlay, TimerUtils::getCurrentTimeUs());
+    return StageStatus::Forward;
+}
+
+EncodeStage::EncodeStage(const StageSpec& spec)
+    : Stage(spec), venc_(nullptr), stream_(nullptr), context_(nullptr), lastClients_(0),
+      skippedFrames_(0) {
+}
+
+int EncodeStage::init(StageContext& context) {
+    stream_ = requireStream(context, spec_);
+    if (!stream_) {
+        return -1;
+    }
+    venc_ = stream_->venc;
+    context_ = &context;
+    if (!venc_) {
+        printf("ERROR: Stage '%s' needs video encoder\n", spec_.name.c_str());
+        return -1;
+    }
+    return 0;
+}
+
+bool EncodeStage::updateDemand() {
+    int clients = context_->rtspClients.load(std::memory_order_relaxed);
+    int previous = lastClients_;
+    lastClients_ = clients;
+
+    if (!context_->isEncodeNeeded(*stream_)) {
+        if (!venc_->isSuspended() && venc_->suspend() == RK_SUCCESS) {
+            printf("Stage '%s': no consumers, encoder suspended\n", spec_.name.c_str());
+        }
+        skippedFrames_++;
+        return false;
+    }
+
+    if (venc_->isSuspended()) {
+        if (venc_->resume() != RK_SUCCESS) {
+            return false;
+        }
+        printf("Stage '%s': encoder resumed after %llu skipped frames\n",
+               spec_.name.c_str(), (unsigned long long)skippedFrames_);
+        skippedFrames_ = 0;
+    } else if (clients > previous && previous >= 0) {
+        // Новому клиенту нужен опорный кадр, не дожидаясь конца GOP
+        venc_->requestIdr();
+    }
+    return true;
+}
+
+StageStatus EncodeStage::process(FrameRef& frame) {
+    if (!updateDemand()) {
+        return StageStatus::Drop;
+    }
+
+    mark(frame, TimelinePoint::EncodeSubmit, TimerUtils::getCurrentTimeUs());
+    frame.setPoolOwner(PoolOwner::Encoder);
+    // VENC читает память, минуя кэш CPU: отмеченные записи должны дойти до нее
+    frame.flushCpuWrites();
+    if (venc_->sendFrame(&frame.vencFrame()) != RK_SUCCESS) {
+        return StageStatus::Drop;
+    }
+
+    std::shared_ptr<EncodedPacket> packet = std::make_shared<EncodedPacket>(*venc_);
+    if (packet->receive() != RK_SUCCESS) {
+        return StageStatus::Drop;
+    }
+    mark(frame, TimelinePoint::BitstreamReady, TimerUtils::getCurrentTimeUs());
+
+    frame.meta().packet = std::move(packet);
+    return StageStatus::Forward;
+}
+
+RtspSinkStage::RtspSinkStage(const StageSpec& spec)
+    : Stage(spec), rtspServer_(nullptr), venc_(nullptr), fps_(nullptr), session_(-1),
+      prevFrameTimeUs_(0) {
+}
+
+int RtspSinkStage::init(StageContext& context) {
+    StreamContext *stream = requireStream(context, spec_);
+    if (!stream) {
+        return -1;
+    }
+    rtspServer_ = context.rtspServer;
+    venc_ = stream->venc;
+    fps_ = &stream->fps;
+    session_ = stream->rtspSession;
+    if (!rtspServer_ || session_ < 0) {
+        printf("ERROR: Stage '%s' needs RTSP server\n", spec_.name.c_str());
+        return -1;
+    }
+    prevFrameTimeUs_ = TimerUtils::getCurrentTimeUs();
+
+    // Поток событий запускает App, когда очереди подключены у всех стадий
+    int queueDepth = spec_.getInt("queue", 4);
+    int eventMs = spec_.getInt("event_ms", 10);
+    return rtspServer_->attachSink(session_, queueDepth > 0 ? (size_t)queueDepth : 0, eventMs,
+                                   [this](FrameTimeline& timeline, uint64_t sentUs) {
+                                       onSent(timeline, sentUs);
+                                   });
+}
+
+StageStatus RtspSinkStage::process(FrameRef& frame) {
+    EncodedPacket *packet = frame.meta().packet.get();
+    if (!packet) {
+        return StageStatus::Drop;
+    }
+
+    if (!rtspServer_->submitVideoFrame(session_, packet->data(), packet->size(), packet->pts(),
+                                       frame.timeline())) {
+        // Клиент увидит следующий кадр только после опорного
+        if (venc_) {
+            venc_->requestIdr();
+        }
+        return StageStatus::Drop;
+    }
+    return StageStatus::Forward;
+}
+
+void RtspSinkStage::onSent(FrameTimeline& timeline, uint64_t sentUs) {
+    if (latency_) {
+        latency_->mark(timeline, TimelinePoint::RtpSent, sentUs);
+    }
+
+    fps_->store(TimerUtils::calculateFps(prevFrameTimeUs_, sentUs));
+    prevFrameTimeUs_ = sentUs;
+}
+
+void RtspSinkStage::flush() {
+    // Обработчик отправки ссылается на стадию: поток событий останавливается
+    // вместе с первой из стадий rtsp, остальные сессии к этому времени тоже стоят
+    if (rtspServer_) {
+        rtspServer_->stop();
+    }
+}
+
+RecorderSinkStage::RecorderSinkStage(const StageSpec& spec)
+    : Stage(spec), file_(nullptr) {
+}
+
+RecorderSinkStage::~RecorderSinkStage() {
+    flush();
+}
+
+int RecorderSinkStage::init(StageContext& context) {
+    StreamContext *stream = requireStream(context, spec_);
+    if (!stream) {
+        return -1;
+    }
+
+    std::string path = spec_.getParam("path", "record.h264");
+    file_ = fopen(path.c_str(), "wb");
+    if (!file_) {
+        printf("ERROR: Stage '%s': cannot open %s\n", spec_.name.c_str(), path.c_str());
+        return -1;
+    }
+
+    // Запись идет всегда, поэтому кодер не останавливается без клиентов
+    stream->recorders.fetch_add(1, std::memory_order_relaxed);
+    return 0;
+}
+
+StageStatus RecorderSinkStage::process(FrameRef& frame) {
+    frame.setPoolOwner(PoolOwner::Recorder);
+    EncodedPacket *packet = frame.meta().packet.get();
+    if (!packet) {
+        return StageStatus::Drop;
+    }
+
+    if (fwrite(packet->data(), 1, packet->size(), file_) != packet->size()) {
+        printf("ERROR: Stage '%s': write failed\n", spec_.name.c_str());
+        return StageStatus::Error;
+    }
+    return StageStatus::Forward;
+}
+
+void RecorderSinkStage::flush() {
+    if (file_) {
+        fclose(file_);
+        file_ = nullptr;
+    }
+}
+
+StreamContext* StageContext::findStream(const std::string& name) const {
+    if (name.empty()) {
+        return streams.empty() ? nullptr : streams.front().get();
+    }
+    for (const auto& stream : streams) {
+        if (stream->spec.name == name) {
+            return stream.get();
+        }
+    }
+    return nullptr;
+}
+
+ModelContext* StageContext::findModel(const std::string& name) const {
+    auto it = models.find(name);
+    return it != models.end() ? it->second.get() : nullptr;
+}
+
+template <typename T>
+static StageFactory::Creator makeCreator() {
+    return [](const StageSpec& spec) { return std::unique_ptr<Stage>(new T(spec)); };
+}
+
+StageFactory::StageFactory() {
+    registerType("source", makeCreator<SourceStage>());
+    registerType("motion", makeCreator<MotionStage>());
+    registerType("preprocess", makeCreator<PreprocessStage>());
+    registerType("infer", makeCreator<InferStage>());
+    registerType("postprocess", makeCreator<PostprocessStage>());
+    registerType("track", makeCreator<TrackStage>());
+    registerType("publish", makeCreator<PublishStage>());
+    registerType("overlay", makeCreator<OverlayStage>());
+    registerType("encode", makeCreator<EncodeStage>());
+    registerType("rtsp", makeCreator<RtspSinkStage>());
+    registerType("recorder", makeCreator<RecorderSinkStage>());
+}
+
+StageFactory& StageFactory::instance() {
+    static StageFactory factory;
+    return factory;
+}
+
+void StageFactory::registerType(const std::string& type, Creator creator) {
+    creators_[type] = std::move(creator);
+}
+
+std::unique_ptr<Stage> StageFactory::create(const StageSpec& spec) const {
+    auto it = creators_.find(spec.type);
+    if (it == creators_.end()) {
+        return nullptr;
+    }
+    return it->second(spec);
+}
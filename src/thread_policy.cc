@@ -0,0 +1,211 @@
+#include "thread_policy.h"
+#include <cerrno>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <sched.h>
+#include <sys/resource.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+int ThreadPolicy::parseCpus(const std::string& text) {
+    cpus.clear();
+
+    size_t pos = 0;
+    while (pos < text.size()) {
+        size_t end = text.find(',', pos);
+        if (end == std::string::npos) {
+            end = text.size();
+        }
+        std::string item = text.substr(pos, end - pos);
+        pos = end + 1;
+
+        char *rest = nullptr;
+        long first = strtol(item.c_str(), &rest, 10);
+        long last = first;
+        if (rest == item.c_str()) {
+            return -1;
+        }
+        if (*rest == '-') {
+            const char *from = rest + 1;
+            last = strtol(from, &rest, 10);
+            if (rest == from) {
+                return -1;
+            }
+        }
+        if (*rest != '\0' || first < 0 || last < first || last >= CPU_SETSIZE) {
+            return -1;
+        }
+        for (long cpu = first; cpu <= last; cpu++) {
+            cpus.push_back((int)cpu);
+        }
+    }
+    return cpus.empty() ? -1 : 0;
+}
+
+std::string ThreadPolicy::describe() const {
+    char text[64];
+    if (policy == "other") {
+        snprintf(text, sizeof(text), "other nice=%d", nice);
+    } else {
+        snprintf(text, sizeof(text), "%s:%d", policy.c_str(), priority);
+    }
+
+    std::string result = text;
+    if (!cpus.empty()) {
+        result += " cpus=";
+        for (size_t i = 0; i < cpus.size(); i++) {
+            result += (i ? "," : "") + std::to_string(cpus[i]);
+        }
+    }
+    return result;
+}
+
+// Счетчики voluntary_ctxt_switches и nonvoluntary_ctxt_switches потока
+static bool readContextSwitches(int tid, uint64_t& voluntary, uint64_t& involuntary) {
+    char path[64];
+    snprintf(path, sizeof(path), "/proc/self/task/%d/status", tid);
+    FILE *file = fopen(path, "r");
+    if (!file) {
+        return false;
+    }
+
+    int found = 0;
+    char line[128];
+    unsigned long long value;
+    while (fgets(line, sizeof(line), file)) {
+        if (sscanf(line, "voluntary_ctxt_switches: %llu", &value) == 1) {
+            voluntary = value;
+            found++;
+        } else if (sscanf(line, "nonvoluntary_ctxt_switches: %llu", &value) == 1) {
+            involuntary = value;
+            found++;
+        }
+    }
+    fclose(file);
+    return found == 2;
+}
+
+ThreadRegistry& ThreadRegistry::instance() {
+    static ThreadRegistry registry;
+    return registry;
+}
+
+void ThreadRegistry::setPolicies(const std::vector<ThreadPolicy>& policies) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    policies_.clear();
+    for (const ThreadPolicy& policy : policies) {
+        policies_[policy.name] = policy;
+    }
+}
+
+int ThreadRegistry::applyPolicy(const ThreadPolicy& policy, int tid) {
+    int ret = 0;
+
+    if (!policy.cpus.empty()) {
+        cpu_set_t set;
+        CPU_ZERO(&set);
+        for (int cpu : policy.cpus) {
+            CPU_SET(cpu, &set);
+        }
+        if (sched_setaffinity(tid, sizeof(set), &set) != 0) {
+            printf("WARNING: Thread '%s': sched_setaffinity failed: %s\n",
+                   policy.name.c_str(), strerror(errno));
+            ret = -1;
+        }
+    }
+
+    struct sched_param param;
+    memset(&param, 0, sizeof(param));
+    int sched = SCHED_OTHER;
+    if (policy.policy == "fifo") {
+        sched = SCHED_FIFO;
+        param.sched_priority = policy.priority;
+    } else if (policy.policy == "rr") {
+        sched = SCHED_RR;
+        param.sched_priority = policy.priority;
+    }
+
+    if (sched_setscheduler(tid, sched, &param) != 0) {
+        printf("WARNING: Thread '%s': cannot set %s: %s\n",
+               policy.name.c_str(), policy.describe().c_str(), strerror(errno));
+        return -1;
+    }
+
+    // nice действует только на SCHED_OTHER, у Linux он свой у каждого потока
+    if (sched == SCHED_OTHER && setpriority(PRIO_PROCESS, tid, policy.nice) != 0) {
+        printf("WARNING: Thread '%s': cannot set nice %d: %s\n",
+               policy.name.c_str(), policy.nice, strerror(errno));
+        ret = -1;
+    }
+    return ret;
+}
+
+void ThreadRegistry::registerCurrentThread(const std::string& name) {
+    int tid = (int)syscall(SYS_gettid);
+
+    std::lock_guard<std::mutex> lock(mutex_);
+
+    Entry entry;
+    entry.name = name;
+    entry.policy = "default";
+    entry.tid = tid;
+    entry.lastVoluntary = 0;
+    entry.lastInvoluntary = 0;
+
+    auto it = policies_.find(name);
+    if (it != policies_.end()) {
+        if (applyPolicy(it->second, tid) == 0) {
+            entry.policy = it->second.describe();
+        }
+        printf("Thread '%s' (tid %d): %s\n", name.c_str(), tid, entry.policy.c_str());
+    }
+
+    readContextSwitches(tid, entry.lastVoluntary, entry.lastInvoluntary);
+
+    // Перезапущенный поток заменяет прежнюю запись
+    for (Entry& existing : threads_) {
+        if (existing.name == name) {
+            existing = entry;
+            return;
+        }
+    }
+    threads_.push_back(entry);
+}
+
+std::vector<ThreadStats> ThreadRegistry::getStats() {
+    std::lock_guard<std::mutex> lock(mutex_);
+
+    std::vector<ThreadStats> result;
+    for (Entry& entry : threads_) {
+        ThreadStats stats;
+        stats.name = entry.name;
+        stats.policy = entry.policy;
+        stats.tid = entry.tid;
+        stats.voluntary = entry.lastVoluntary;
+        stats.involuntary = entry.lastInvoluntary;
+        stats.alive = readContextSwitches(entry.tid, stats.voluntary, stats.involuntary);
+        stats.voluntaryDelta = stats.voluntary - entry.lastVoluntary;
+        stats.involuntaryDelta = stats.involuntary - entry.lastInvoluntary;
+
+        entry.lastVoluntary = stats.voluntary;
+        entry.lastInvoluntary = stats.involuntary;
+        result.push_back(stats);
+    }
+    return result;
+}
+
+void ThreadRegistry::printStats() {
+    std::vector<ThreadStats> threads = getStats();
+    if (threads.empty()) {
+        return;
+    }
+
+    // Рост вытеснений у потока реального времени - его прерывает более приоритетный
+    printf("  %-12s %6s %-20s %10s %10s\n", "thread", "tid", "policy", "voluntary", "preempted");
+    for (const ThreadStats& stats : threads) {
+        printf("  %-12s %6d %-20s %10llu %10llu%s\n", stats.name.c_str(), stats.tid, stats.policy.c_str(),
+               (unsigned long long)stats.voluntaryDelta, (unsigned long long)stats.involuntaryDelta,
+               stats.alive ? "" : " (exited)");
+    }
+}
@@ -0,0 +1,118 @@
+#include "tiling.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include "yolo_decoder.h"
+
+int TilingConfig::parseGrid(const std::string& value) {
+    unsigned int parsedCols = 0, parsedRows = 0;
+    if (sscanf(value.c_str(), "%ux%u", &parsedCols, &parsedRows) != 2 ||
+        parsedCols == 0 || parsedRows == 0 || parsedCols * parsedRows > 16) {
+        return -1;
+    }
+    cols = parsedCols;
+    rows = parsedRows;
+    return 0;
+}
+
+// Размер и начала плиток по одной оси: плитки равные, крайние прижаты к краям кадра
+static void splitAxis(int frameSize, uint32_t count, float overlap, std::vector<int>& starts, int& size) {
+    starts.clear();
+    if (count <= 1) {
+        size = frameSize & ~1;
+        starts.push_back(0);
+        return;
+    }
+
+    float span = (float)count - (float)(count - 1) * overlap;
+    size = std::min(((int)std::ceil(frameSize / span) + 1) & ~1, frameSize & ~1);
+    for (uint32_t i = 0; i < count; i++) {
+        starts.push_back((int)((int64_t)i * (frameSize - size) / (count - 1)) & ~1);
+    }
+}
+
+std::vector<TileRegion> computeTiles(const TilingConfig& config, int frameWidth, int frameHeight) {
+    std::vector<TileRegion> tiles;
+    if (config.fullFrame) {
+        tiles.push_back(TileRegion{0, 0, frameWidth & ~1, frameHeight & ~1});
+    }
+
+    float overlap = std::min(std::max(config.overlap, 0.0f), 0.9f);
+    std::vector<int> xs, ys;
+    int width, height;
+    splitAxis(frameWidth, config.cols, overlap, xs, width);
+    splitAxis(frameHeight, config.rows, overlap, ys, height);
+
+    for (int y : ys) {
+        for (int x : xs) {
+            tiles.push_back(TileRegion{x, y, width, height});
+        }
+    }
+    return tiles;
+}
+
+struct TileDetection {
+    Detection box;
+    size_t tile;
+};
+
+// Доля меньшей рамки, покрытая пересечением
+static float computeIos(const Detection& a, const Detection& b) {
+    float width = (float)(std::min(a.right, b.right) - std::max(a.left, b.left));
+    float height = (float)(std::min(a.bottom, b.bottom) - std::max(a.top, b.top));
+    if (width <= 0.0f || height <= 0.0f) {
+        return 0.0f;
+    }
+    float areaA = (float)(a.right - a.left) * (float)(a.bottom - a.top);
+    float areaB = (float)(b.right - b.left) * (float)(b.bottom - b.top);
+    float smaller = std::min(areaA, areaB);
+    return smaller <= 0.0f ? 0.0f : width * height / smaller;
+}
+
+void mergeTileDetections(const std::vector<std::vector<Detection>>& tiles, const TilingConfig& config,
+                         std::vector<Detection>& detections) {
+    std::vector<TileDetection> all;
+    for (size_t tile = 0; tile < tiles.size(); tile++) {
+        for (const Detection& box : tiles[tile]) {
+            all.push_back(TileDetection{box, tile});
+        }
+    }
+    std::sort(all.begin(), all.end(), [](const TileDetection& a, const TileDetection& b) {
+        return a.box.score > b.box.score;
+    });
+
+    detections.clear();
+    std::vector<bool> suppressed(all.size(), false);
+    for (size_t i = 0; i < all.size(); i++) {
+        if (suppressed[i]) {
+            continue;
+        }
+        Detection kept = all[i].box;
+
+        // Выросшая рамка может накрыть уже пропущенную часть объекта: проход повторяется
+        bool grown = true;
+        while (grown) {
+            grown = false;
+            for (size_t j = i + 1; j < all.size(); j++) {
+                const Detection& other = all[j].box;
+                if (suppressed[j] || other.classId != kept.classId) {
+                    continue;
+                }
+                // Сначала вложенность: обрезанная швом рамка по IoU подавила бы целую
+                if (all[j].tile != all[i].tile && computeIos(kept, other) >= config.mergeIos) {
+                    // Часть объекта со шва: рамка растет до объединения, уверенность - лучшая
+                    grown = grown || other.left < kept.left || other.top < kept.top ||
+                            other.right > kept.right || other.bottom > kept.bottom;
+                    kept.left = std::min(kept.left, other.left);
+                    kept.top = std::min(kept.top, other.top);
+                    kept.right = std::max(kept.right, other.right);
+                    kept.bottom = std::max(kept.bottom, other.bottom);
+                    suppressed[j] = true;
+                } else if (YoloDecoder::computeIou(kept, other) > config.nmsIou) {
+                    suppressed[j] = true;
+                }
+            }
+        }
+        detections.push_back(kept);
+    }
+}
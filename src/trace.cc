@@ -0,0 +1,186 @@
+#include "trace.h"
+#include <cstdio>
+#include <pthread.h>
+#include <sys/syscall.h>
+#include <time.h>
+#include <unistd.h>
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
+static uint64_t readMonotonicNs() {
+    struct timespec time = {0, 0};
+    clock_gettime(CLOCK_MONOTONIC, &time);
+    return (uint64_t)time.tv_sec * 1000000000ull + (uint64_t)time.tv_nsec;
+}
+
+// Счетчик без системного вызова; частота определяется по монотонным часам при выгрузке
+static inline uint64_t readTicks() {
+#if defined(__x86_64__) || defined(__i386__)
+    return __rdtsc();
+#elif defined(__aarch64__)
+    uint64_t ticks;
+    asm volatile("mrs %0, cntvct_el0" : "=r"(ticks));
+    return ticks;
+#else
+    return readMonotonicNs();
+#endif
+}
+
+static void writeEscaped(FILE* file, const char* text) {
+    for (const char *c = text; *c; c++) {
+        if (*c == '"' || *c == '\\') {
+            fputc('\\', file);
+        }
+        if ((unsigned char)*c >= 0x20) {
+            fputc(*c, file);
+        }
+    }
+}
+
+Tracer& Tracer::instance() {
+    static Tracer tracer;
+    return tracer;
+}
+
+Tracer::Tracer()
+    : enabled_(false), dumpRequested_(false), ringSize_(0), startTicks_(0), startNs_(0) {
+}
+
+void Tracer::enable(size_t eventsPerThread) {
+    std::lock_guard<std::mutex> lock(ringsMutex_);
+
+    // Кольца уже розданы потокам: их размер не меняется
+    if (rings_.empty()) {
+        ringSize_ = 1;
+        while (ringSize_ < eventsPerThread) {
+            ringSize_ <<= 1;
+        }
+        startTicks_ = readTicks();
+        startNs_ = readMonotonicNs();
+    }
+
+    enabled_.store(true, std::memory_order_relaxed);
+    printf("Tracing enabled: %zu events per thread\n", ringSize_);
+}
+
+void Tracer::disable() {
+    enabled_.store(false, std::memory_order_relaxed);
+}
+
+Tracer::Ring* Tracer::getThreadRing() {
+    static thread_local Ring* ring = nullptr;
+    if (ring) {
+        return ring;
+    }
+
+    // Кольцо переживает поток: события завершившихся потоков тоже выгружаются
+    std::lock_guard<std::mutex> lock(ringsMutex_);
+
+    std::unique_ptr<Ring> created(new Ring());
+    created->events.resize(ringSize_);
+    created->mask = ringSize_ - 1;
+    created->tid = (int)syscall(SYS_gettid);
+
+    char name[16] = {0};
+    pthread_getname_np(pthread_self(), name, sizeof(name));
+    created->threadName = name;
+
+    rings_.push_back(std::move(created));
+    ring = rings_.back().get();
+    return ring;
+}
+
+void Tracer::append(char phase, const char* name, uint32_t arg) {
+    Ring *ring = getThreadRing();
+
+    uint64_t head = ring->head.load(std::memory_order_relaxed);
+    Event& event = ring->events[head & ring->mask];
+    event.ticks = readTicks();
+    event.name = name;
+    event.arg = arg;
+    event.phase = phase;
+    ring->head.store(head + 1, std::memory_order_release);
+}
+
+void Tracer::begin(const char* name, uint32_t arg) {
+    if (isEnabled()) {
+        append('B', name, arg);
+    }
+}
+
+void Tracer::end() {
+    if (isEnabled()) {
+        append('E', nullptr, kNoArg);
+    }
+}
+
+int Tracer::dump(const std::string& path) {
+    std::lock_guard<std::mutex> lock(ringsMutex_);
+
+    FILE *file = fopen(path.c_str(), "w");
+    if (!file) {
+        printf("ERROR: Cannot create trace file %s\n", path.c_str());
+        return -1;
+    }
+
+    uint64_t endTicks = readTicks();
+    uint64_t endNs = readMonotonicNs();
+    double nsPerTick = endTicks > startTicks_ ? (double)(endNs - startNs_) / (endTicks - startTicks_) : 1.0;
+
+    fprintf(file, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n");
+    bool first = true;
+    size_t written = 0;
+
+    std::vector<Event> events;
+    for (const auto& ring : rings_) {
+        fprintf(file, "%s{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":%d,\"tid\":%d,\"args\":{\"name\":\"",
+                first ? "" : ",\n", (int)getpid(), ring->tid);
+        writeEscaped(file, ring->threadName.c_str());
+        fprintf(file, "\"}}");
+        first = false;
+
+        // Копия кольца; события, затертые владельцем за время копирования, отбрасываются
+        uint64_t head = ring->head.load(std::memory_order_acquire);
+        uint64_t begin = head > ring->events.size() ? head - ring->events.size() : 0;
+        events.clear();
+        for (uint64_t i = begin; i < head; i++) {
+            events.push_back(ring->events[i & ring->mask]);
+        }
+        uint64_t after = ring->head.load(std::memory_order_acquire);
+        uint64_t validFrom = after > ring->events.size() ? after - ring->events.size() + 1 : 0;
+
+        for (uint64_t i = begin; i < head; i++) {
+            if (i < validFrom) {
+                continue;
+            }
+
+            const Event& event = events[i - begin];
+            double tsUs = (double)(event.ticks - startTicks_) * nsPerTick / 1000.0;
+            fprintf(file, ",\n{\"ph\":\"%c\",\"pid\":%d,\"tid\":%d,\"ts\":%.3f",
+                    event.phase, (int)getpid(), ring->tid, tsUs);
+            if (event.name) {
+                fprintf(file, ",\"name\":\"");
+                writeEscaped(file, event.name);
+                fprintf(file, "\"");
+            }
+            if (event.arg != kNoArg) {
+                fprintf(file, ",\"args\":{\"frame\":%u}", event.arg);
+            }
+            fprintf(file, "}");
+            written++;
+        }
+    }
+
+    fprintf(file, "\n]}\n");
+    bool ok = fflush(file) == 0;
+    fclose(file);
+
+    if (!ok) {
+        printf("ERROR: Failed to write trace file %s\n", path.c_str());
+        return -1;
+    }
+
+    printf("Trace written: %s, %zu events from %zu threads\n", path.c_str(), written, rings_.size());
+    return 0;
+}
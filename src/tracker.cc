@@ -0,0 +1,60 @@
+#include "tracker.h"
+#include "yolo_decoder.h"
+
+IouTracker::IouTracker(float iouThreshold, uint32_t maxMissed)
+    : iouThreshold_(iouThreshold), maxMissed_(maxMissed), nextId_(1) {
+}
+
+void IouTracker::update(const std::vector<Detection>& detections, std::vector<Track>& tracks) {
+    std::vector<bool> matched(tracks_.size(), false);
+    tracks.clear();
+
+    // Детекции отсортированы по убыванию уверенности: сильные выбирают трек первыми
+    for (const Detection& det : detections) {
+        int best = -1;
+        float bestIou = iouThreshold_;
+        for (size_t i = 0; i < tracks_.size(); i++) {
+            if (matched[i] || tracks_[i].box.classId != det.classId) {
+                continue;
+            }
+            float iou = YoloDecoder::computeIou(tracks_[i].box, det);
+            if (iou > bestIou) {
+                bestIou = iou;
+                best = (int)i;
+            }
+        }
+
+        if (best >= 0) {
+            Track& track = tracks_[best];
+            track.box = det;
+            track.age++;
+            track.missed = 0;
+            matched[best] = true;
+            tracks.push_back(track);
+        } else {
+            tracks.push_back(Track{nextId_++, det, 0, 0});
+        }
+    }
+
+    // Неподтвержденные треки стареют, новые добавляются в конец
+    std::vector<Track> alive;
+    for (size_t i = 0; i < tracks_.size(); i++) {
+        if (matched[i]) {
+            continue;
+        }
+        Track& track = tracks_[i];
+        track.age++;
+        if (++track.missed <= maxMissed_) {
+            alive.push_back(track);
+        }
+    }
+    for (const Track& track : tracks) {
+        alive.push_back(track);
+    }
+    tracks_.swap(alive);
+}
+
+void IouTracker::reset() {
+    tracks_.clear();
+    nextId_ = 1;
+}
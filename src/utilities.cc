@@ -2,7 +2,7 @@
 #include <time.h>
 #include <cstdlib>
 #include <cstdio>
-#include "luckfox_mpi.h"
+#include "backend.h"
 
 // TimerUtils implementation
 uint64_t TimerUtils::getCurrentTimeUs() {
@@ -26,21 +26,21 @@ float TimerUtils::calculateFps(uint64_t prevTimeUs, uint64_t currTimeUs) {
 
 // SystemUtils implementation
 int SystemUtils::initMpiSystem() {
-    printf("Initializing RK MPI system...\n");
+    printf("Initializing %s platform...\n", getPlatformName());
 
-    int ret = RK_MPI_SYS_Init();
-    if (ret != RK_SUCCESS) {
-        printf("ERROR: RK_MPI_SYS_Init failed: %x\n", ret);
+    int ret = initPlatform();
+    if (ret != 0) {
+        printf("ERROR: Platform initialization failed: %x\n", ret);
         return ret;
     }
 
-    printf("RK MPI system initialized successfully\n");
-    return RK_SUCCESS;
+    printf("Platform initialized successfully\n");
+    return 0;
 }
 
 void SystemUtils::exitMpiSystem() {
-    printf("Exiting RK MPI system...\n");
-    RK_MPI_SYS_Exit();
+    printf("Exiting %s platform...\n", getPlatformName());
+    exitPlatform();
 }
 
 int SystemUtils::executeSystemCommand(const char *command) {
@@ -1,30 +1,36 @@
 #include "video_encoder.h"
 #include <cstring>
 #include <cstdio>
+#include "trace.h"
 
 VideoEncoder::VideoEncoder(int width, int height, int bitrate)
-    : width_(width), height_(height), bitrate_(bitrate),
-      channelId_(-1), initialized_(false) {
+    : backend_(createEncoderBackend()), width_(width), height_(height), bitrate_(bitrate),
+      channelId_(-1), initialized_(false), suspended_(false) {
 }
 
 VideoEncoder::~VideoEncoder() {
     shutdown();
 }
 
-int VideoEncoder::init(int channelId, RK_CODEC_ID_E codecType) {
-    printf("%s: channel=%d, codec=%d\n", __func__, channelId, codecType);
+int VideoEncoder::init(int channelId, RK_CODEC_ID_E codecType, PIXEL_FORMAT_E pixelFormat) {
+    printf("%s: channel=%d, codec=%d, format=%s\n", __func__, channelId, codecType,
+           pixelFormat == RK_FMT_YUV420SP ? "NV12" : "BGR888");
 
     channelId_ = channelId;
 
-    int ret = configureEncoder(codecType);
+    EncoderParams params;
+    params.codec = codecType;
+    params.pixelFormat = pixelFormat;
+    params.width = width_;
+    params.height = height_;
+    params.bitrate = bitrate_;
+    params.gop = 1;
+    params.streamBufCount = 2;
+    params.bufSize = width_ * height_ * 3 / 2;
+
+    int ret = backend_->createChannel(channelId_, params);
     if (ret != RK_SUCCESS) {
-        printf("ERROR: Failed to configure encoder\n");
-        return ret;
-    }
-
-    ret = startReceivingFrames();
-    if (ret != RK_SUCCESS) {
-        printf("ERROR: Failed to start receiving frames\n");
+        printf("ERROR: Failed to create encoder channel\n");
         return ret;
     }
 
@@ -33,49 +39,6 @@ int VideoEncoder::init(int channelId, RK_CODEC_ID_E codecType) {
     return RK_SUCCESS;
 }
 
-int VideoEncoder::configureEncoder(RK_CODEC_ID_E codecType) {
-    VENC_CHN_ATTR_S stAttr;
-    memset(&stAttr, 0, sizeof(VENC_CHN_ATTR_S));
-
-    stAttr.stVencAttr.enType = codecType;
-    stAttr.stVencAttr.enPixelFormat = RK_FMT_BGR888;
-    stAttr.stVencAttr.u32Profile = H264E_PROFILE_MAIN;
-    stAttr.stVencAttr.u32PicWidth = width_;
-    stAttr.stVencAttr.u32PicHeight = height_;
-    stAttr.stVencAttr.u32VirWidth = width_;
-    stAttr.stVencAttr.u32VirHeight = height_;
-    stAttr.stVencAttr.u32StreamBufCnt = 2;
-    stAttr.stVencAttr.u32BufSize = width_ * height_ * 3 / 2;
-    stAttr.stVencAttr.enMirror = MIRROR_NONE;
-
-    stAttr.stRcAttr.enRcMode = VENC_RC_MODE_H264CBR;
-    stAttr.stRcAttr.stH264Cbr.u32BitRate = bitrate_;
-    stAttr.stRcAttr.stH264Cbr.u32Gop = 1;
-
-    int ret = RK_MPI_VENC_CreateChn(channelId_, &stAttr);
-    if (ret != RK_SUCCESS) {
-        printf("RK_MPI_VENC_CreateChn failed: %x\n", ret);
-        return ret;
-    }
-
-    return RK_SUCCESS;
-}
-
-int VideoEncoder::startReceivingFrames() {
-    VENC_RECV_PIC_PARAM_S stRecvParam;
-    memset(&stRecvParam, 0, sizeof(VENC_RECV_PIC_PARAM_S));
-
-    stRecvParam.s32RecvPicNum = -1;  // Continuous reception
-
-    int ret = RK_MPI_VENC_StartRecvFrame(channelId_, &stRecvParam);
-    if (ret != RK_SUCCESS) {
-        printf("RK_MPI_VENC_StartRecvFrame failed: %x\n", ret);
-        return ret;
-    }
-
-    return RK_SUCCESS;
-}
-
 int VideoEncoder::sendFrame(const VIDEO_FRAME_INFO_S *frame) const {
     if (!initialized_) {
         printf("ERROR: Encoder not initialized\n");
@@ -87,13 +50,8 @@ int VideoEncoder::sendFrame(const VIDEO_FRAME_INFO_S *frame) const {
         return -1;
     }
 
-    int ret = RK_MPI_VENC_SendFrame(channelId_, frame, -1);
-    if (ret != RK_SUCCESS) {
-        printf("RK_MPI_VENC_SendFrame failed: %x\n", ret);
-        return ret;
-    }
-
-    return RK_SUCCESS;
+    TraceScope trace("venc.sendFrame", frame->stVFrame.u32TimeRef);
+    return backend_->sendFrame(channelId_, frame, -1);
 }
 
 int VideoEncoder::getStream(VENC_STREAM_S *stream) {
@@ -107,8 +65,8 @@ int VideoEncoder::getStream(VENC_STREAM_S *stream) {
         return -1;
     }
 
-    int ret = RK_MPI_VENC_GetStream(channelId_, stream, -1);
-    return ret;
+    TraceScope trace("venc.getStream");
+    return backend_->getStream(channelId_, stream, -1);
 }
 
 int VideoEncoder::releaseStream(VENC_STREAM_S *stream) {
@@ -120,21 +78,103 @@ int VideoEncoder::releaseStream(VENC_STREAM_S *stream) {
         return -1;
     }
 
-    int ret = RK_MPI_VENC_ReleaseStream(channelId_, stream);
+    return backend_->releaseStream(channelId_, stream);
+}
+
+const uint8_t* VideoEncoder::getPackData(const VENC_PACK_S& pack) const {
+    return backend_->getPackData(pack);
+}
+
+int VideoEncoder::suspend() {
+    if (!initialized_) {
+        printf("ERROR: Encoder not initialized\n");
+        return -1;
+    }
+
+    if (suspended_) {
+        return RK_SUCCESS;
+    }
+
+    int ret = backend_->stopReceiving(channelId_);
     if (ret != RK_SUCCESS) {
-        printf("RK_MPI_VENC_ReleaseStream failed: %x\n", ret);
+        printf("ERROR: Failed to stop encoder channel %d\n", channelId_);
         return ret;
     }
 
+    suspended_ = true;
     return RK_SUCCESS;
 }
 
+int VideoEncoder::resume() {
+    if (!initialized_) {
+        printf("ERROR: Encoder not initialized\n");
+        return -1;
+    }
+
+    if (!suspended_) {
+        return RK_SUCCESS;
+    }
+
+    int ret = backend_->startReceiving(channelId_);
+    if (ret != RK_SUCCESS) {
+        printf("ERROR: Failed to start encoder channel %d\n", channelId_);
+        return ret;
+    }
+
+    suspended_ = false;
+
+    // Новый клиент не может декодировать P-кадры без опорного
+    return requestIdr();
+}
+
+int VideoEncoder::requestIdr() {
+    if (!initialized_) {
+        printf("ERROR: Encoder not initialized\n");
+        return -1;
+    }
+
+    int ret = backend_->requestIdr(channelId_);
+    if (ret != RK_SUCCESS) {
+        printf("ERROR: Failed to request IDR on channel %d\n", channelId_);
+    }
+    return ret;
+}
+
 void VideoEncoder::shutdown() {
     if (!initialized_) {
         return;
     }
 
-    RK_MPI_VENC_StopRecvFrame(channelId_);
-    RK_MPI_VENC_DestroyChn(channelId_);
+    backend_->destroyChannel(channelId_);
     initialized_ = false;
+    suspended_ = false;
+}
+
+EncodedPacket::EncodedPacket(VideoEncoder& venc)
+    : venc_(venc), data_(nullptr), received_(false) {
+    memset(&stream_, 0, sizeof(VENC_STREAM_S));
+    memset(&pack_, 0, sizeof(VENC_PACK_S));
+    stream_.pstPack = &pack_;
+}
+
+EncodedPacket::~EncodedPacket() {
+    if (received_) {
+        venc_.releaseStream(&stream_);
+    }
+}
+
+int EncodedPacket::receive() {
+    int ret = venc_.getStream(&stream_);
+    if (ret != RK_SUCCESS) {
+        return ret;
+    }
+    received_ = true;
+
+    data_ = venc_.getPackData(pack_);
+    if (!data_) {
+        printf("ERROR: Failed to get stream virtual address\n");
+        return -1;
+    }
+
+    return RK_SUCCESS;
 }
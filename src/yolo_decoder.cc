@@ -0,0 +1,211 @@
+#include "yolo_decoder.h"
+#include <algorithm>
+#include <cstdio>
+#include <fstream>
+
+// Якоря YOLOv5 по умолчанию (model/anchors_yolov5.txt)
+static const float kDefaultAnchors[3][6] = {
+    {10, 13, 16, 30, 33, 23},
+    {30, 61, 62, 45, 59, 119},
+    {116, 90, 156, 198, 373, 326}
+};
+
+static const int kAnchorsPerHead = 3;
+
+YoloDecoder::YoloDecoder(float confThreshold, float nmsThreshold)
+    : confThreshold_(confThreshold), nmsThreshold_(nmsThreshold) {
+    std::copy(&kDefaultAnchors[0][0], &kDefaultAnchors[0][0] + 18, &anchors_[0][0]);
+}
+
+int YoloDecoder::loadAnchors(const std::string& path) {
+    std::ifstream file(path);
+    if (!file.is_open()) {
+        printf("WARNING: Cannot open anchors file %s, using defaults\n", path.c_str());
+        return -1;
+    }
+
+    float values[18];
+    for (int i = 0; i < 18; i++) {
+        if (!(file >> values[i])) {
+            printf("WARNING: Anchors file %s is incomplete, using defaults\n", path.c_str());
+            return -1;
+        }
+    }
+
+    std::copy(values, values + 18, &anchors_[0][0]);
+    return 0;
+}
+
+int YoloDecoder::loadLabels(const std::string& path) {
+    std::ifstream file(path);
+    if (!file.is_open()) {
+        printf("WARNING: Cannot open labels file %s\n", path.c_str());
+        return -1;
+    }
+
+    labels_.clear();
+    std::string line;
+    while (std::getline(file, line)) {
+        if (!line.empty() && line.back() == '\r') {
+            line.pop_back();
+        }
+        labels_.push_back(line);
+    }
+
+    return (int)labels_.size();
+}
+
+const char* YoloDecoder::getLabel(int classId) const {
+    if (classId < 0 || classId >= (int)labels_.size()) {
+        return "object";
+    }
+    return labels_[classId].c_str();
+}
+
+float YoloDecoder::computeIou(const Detection& a, const Detection& b) {
+    int left = std::max(a.left, b.left);
+    int top = std::max(a.top, b.top);
+    int right = std::min(a.right, b.right);
+    int bottom = std::min(a.bottom, b.bottom);
+
+    float inter = (float)std::max(0, right - left) * (float)std::max(0, bottom - top);
+    float areaA = (float)(a.right - a.left) * (float)(a.bottom - a.top);
+    float areaB = (float)(b.right - b.left) * (float)(b.bottom - b.top);
+    float uni = areaA + areaB - inter;
+
+    return uni <= 0.0f ? 0.0f : inter / uni;
+}
+
+void YoloDecoder::applyNms(std::vector<Detection>& detections, float nmsThreshold) {
+    std::sort(detections.begin(), detections.end(),
+              [](const Detection& a, const Detection& b) { return a.score > b.score; });
+
+    std::vector<bool> suppressed(detections.size(), false);
+    std::vector<Detection> kept;
+
+    for (size_t i = 0; i < detections.size(); i++) {
+        if (suppressed[i]) {
+            continue;
+        }
+        kept.push_back(detections[i]);
+
+        for (size_t j = i + 1; j < detections.size(); j++) {
+            if (!suppressed[j] && detections[j].classId == detections[i].classId &&
+                computeIou(detections[i], detections[j]) > nmsThreshold) {
+                suppressed[j] = true;
+            }
+        }
+    }
+
+    detections.swap(kept);
+}
+
+int YoloDecoder::decode(RKNNInference& inference, const Letterbox& letterbox,
+                        int frameWidth, int frameHeight,
+                        std::vector<Detection>& detections) const {
+    detections.clear();
+
+    if (inference.GetOutputCount() != 3) {
+        printf("ERROR: YOLOv5 decoder expects 3 outputs, model has %d\n",
+               inference.GetOutputCount());
+        return -1;
+    }
+
+    const TensorInfo& input = inference.GetInputInfo();
+    int modelHeight = input.dims[1];
+
+    // Головы упорядочиваются по убыванию размера сетки (шаг 8, 16, 32)
+    int order[3] = {0, 1, 2};
+    std::sort(order, order + 3, [&inference](int a, int b) {
+        return inference.GetOutputInfo(a).dims[1] > inference.GetOutputInfo(b).dims[1];
+    });
+
+    for (int head = 0; head < 3; head++) {
+        int index = order[head];
+        const TensorInfo& info = inference.GetOutputInfo(index);
+        const void *data = inference.GetOutputPtr(index);
+        if (!data) {
+            return -1;
+        }
+
+        int gridHeight = info.dims[1];
+        int gridWidth = info.dims[2];
+        int channels = info.dims[3];
+        int propSize = channels / kAnchorsPerHead;
+        int numClasses = propSize - 5;
+        if (gridHeight <= 0 || numClasses <= 0) {
+            printf("ERROR: Unexpected YOLOv5 output shape\n");
+            return -1;
+        }
+        int stride = modelHeight / gridHeight;
+
+        bool quantized = info.type == TensorType::INT8;
+        if (!quantized && info.type != TensorType::FLOAT32) {
+            printf("ERROR: Unsupported YOLOv5 output type\n");
+            return -1;
+        }
+        const int8_t *qdata = (const int8_t *)data;
+        const float *fdata = (const float *)data;
+        int8_t qThreshold = RKNNInference::Quantize(confThreshold_, info.zp, info.scale);
+
+        auto value = [&](size_t offset) {
+            return quantized ? RKNNInference::Dequantize(qdata[offset], info.zp, info.scale)
+                             : fdata[offset];
+        };
+
+        for (int y = 0; y < gridHeight; y++) {
+            for (int x = 0; x < gridWidth; x++) {
+                for (int a = 0; a < kAnchorsPerHead; a++) {
+                    size_t base = ((size_t)(y * gridWidth + x) * kAnchorsPerHead + a) * propSize;
+
+                    if (quantized ? qdata[base + 4] < qThreshold : fdata[base + 4] < confThreshold_) {
+                        continue;
+                    }
+                    float objectness = value(base + 4);
+
+                    int bestClass = 0;
+                    float bestScore = value(base + 5);
+                    for (int c = 1; c < numClasses; c++) {
+                        float score = value(base + 5 + c);
+                        if (score > bestScore) {
+                            bestScore = score;
+                            bestClass = c;
+                        }
+                    }
+
+                    float score = objectness * bestScore;
+                    if (score < confThreshold_) {
+                        continue;
+                    }
+
+                    float boxX = value(base + 0) * 2.0f - 0.5f;
+                    float boxY = value(base + 1) * 2.0f - 0.5f;
+                    float boxW = value(base + 2) * 2.0f;
+                    float boxH = value(base + 3) * 2.0f;
+                    boxW = boxW * boxW * anchors_[head][a * 2];
+                    boxH = boxH * boxH * anchors_[head][a * 2 + 1];
+                    boxX = (boxX + x) * stride;
+                    boxY = (boxY + y) * stride;
+
+                    // Обратное преобразование letterbox в координаты кадра
+                    float left = (boxX - boxW / 2 - letterbox.offsetX) / letterbox.scale;
+                    float top = (boxY - boxH / 2 - letterbox.offsetY) / letterbox.scale;
+                    float right = (boxX + boxW / 2 - letterbox.offsetX) / letterbox.scale;
+                    float bottom = (boxY + boxH / 2 - letterbox.offsetY) / letterbox.scale;
+
+                    Detection det;
+                    det.left = std::max(0, std::min(frameWidth - 1, (int)left));
+                    det.top = std::max(0, std::min(frameHeight - 1, (int)top));
+                    det.right = std::max(0, std::min(frameWidth - 1, (int)right));
+                    det.bottom = std::max(0, std::min(frameHeight - 1, (int)bottom));
+                    det.score = score;
+                    det.classId = bestClass;
+                    detections.push_back(det);
+                }
+            }
+        }
+    }
+
+    applyNms(detections, nmsThreshold_);
+    return 0;
+}